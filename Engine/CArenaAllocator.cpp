@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+
+// The arena allocator hands out memory by bumping a pointer through chunks
+// taken from the parent allocator. Individual frees do nothing, everything 
+// is released in one go when the arena is reset or destroyed. Objects created
+// with NewObj can still be passed to FreeObj to run their destructors.
+//
+// Each allocation is prefixed with its size so InternalSize works. There is
+// no locking, arenas are meant to be owned by a single thread.
+
+#include <stdio.h>
+
+#include "CArenaAllocator.h"
+
+using namespace Engine::Memory::Allocators;
+
+CArenaAllocator::CArenaChunk* CArenaAllocator::AllocateChunk(u32 minimumSize)
+{
+	u32 size = (minimumSize > _chunkSize ? minimumSize : _chunkSize);
+
+	CArenaChunk* chunk = (CArenaChunk*)_parent->Alloc(_chunkHeaderSize + size, 16);
+	LOG_ASSERT(chunk != NULL);
+
+	chunk->Next = _chunks;
+	chunk->Size = size;
+	chunk->Used = 0;
+	_chunks = chunk;
+
+	return chunk;
+}
+
+void* CArenaAllocator::InternalAlloc(u32 size, u32 align)
+{
+	if (align < 4)
+		align = 4;
+
+	// Room for the size prefix plus worst case alignment padding.
+	u32 required = size + align + 4;
+
+	CArenaChunk* chunk = _chunks;
+	if (chunk == NULL || chunk->Size - chunk->Used < required)
+		chunk = AllocateChunk(required);
+
+	u8* data	= (u8*)chunk + _chunkHeaderSize;
+	u8* base	= data + chunk->Used;
+	u8* aligned = (u8*)(((size_t)base + 4 + (align - 1)) & ~(size_t)(align - 1));
+
+	// Store the size below the pointer.
+	*((u32*)(aligned - 4)) = size;
+
+	chunk->Used = (u32)((aligned + size) - data);
+
+	return aligned;
+}
+
+void CArenaAllocator::InternalFree(void* ptr)
+{
+	// Memory is only released on Reset.
+}
+
+u32 CArenaAllocator::InternalSize(void* ptr)
+{
+	return ((u32*)((u8*)ptr - 4))[0];
+}
+
+void CArenaAllocator::Reset()
+{
+	CArenaChunk* chunk = _chunks;
+	while (chunk != NULL)
+	{
+		CArenaChunk* next = chunk->Next;
+		_parent->Free(&chunk);
+		chunk = next;
+	}
+
+	_chunks = NULL;
+}
+
+CArenaAllocator::CArenaAllocator(Engine::Containers::CString name, CAllocator* parent, u32 chunkSize)
+{
+	_name			 = name;
+    _parent			 = parent;
+	_chunkSize		 = chunkSize;
+	_chunkHeaderSize = (sizeof(CArenaChunk) + 15) & ~15;
+	_chunks			 = NULL;
+}
+
+CArenaAllocator::~CArenaAllocator()
+{
+	Reset();
+    _parent = NULL;
+}
@@ -0,0 +1,52 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "CAllocator.h"
+
+namespace Engine
+{
+    namespace Memory
+    {
+        namespace Allocators
+        {
+
+			// Default size of each chunk taken from the parent allocator.
+			#define ARENA_ALLOCATOR_DEFAULT_CHUNK_SIZE	(64 * 1024)
+
+            class CArenaAllocator : public CAllocator
+            {
+            private:
+				// Chunks are kept in an intrusive singly linked list, the most
+				// recent (the one being allocated from) at the head.
+				struct CArenaChunk
+				{
+					CArenaChunk*	Next;
+					u32				Size;
+					u32				Used;
+				};
+
+                CAllocator*		_parent;
+
+				u32				_chunkSize;
+				u32				_chunkHeaderSize;
+				CArenaChunk*	_chunks;
+
+				CArenaChunk* AllocateChunk(u32 minimumSize);
+
+            public:
+                virtual void* InternalAlloc  (u32 size, u32 align=16);
+                virtual void  InternalFree   (void* ptr);
+                virtual u32   InternalSize   (void* ptr);
+
+				void Reset();
+
+                CArenaAllocator(Engine::Containers::CString name, CAllocator* parentAllocator, u32 chunkSize=ARENA_ALLOCATOR_DEFAULT_CHUNK_SIZE);
+                ~CArenaAllocator();
+            };
+
+        }
+    }
+}
@@ -7,6 +7,7 @@
 #include "Platform.h"
 #include "CFileStream.h"
 #include "CFilePackageStream.h"
+#include "CLog.h"
 
 using namespace Engine::FileSystem;
 
@@ -287,6 +288,17 @@ Engine::FileSystem::Streams::CStream* CFileSystem::CreateReadStream(const Engine
 		return Engine::Memory::GetDefaultAllocator()->NewObj<Engine::FileSystem::Streams::CFileStream>(file->FullPath, Engine::Platform::FILE_ACCESS_MODE_READ, Engine::Platform::FILE_OPEN_MODE_OPEN_EXISTING);
 }
 
+// Opens a file previously written with CreateWriteStream. Unlike CreateReadStream this reads
+// straight from the save folder without attribute expansion or package lookups.
+Engine::FileSystem::Streams::CStream* CFileSystem::CreateSaveReadStream(const Engine::Containers::CString& url)
+{
+	Engine::Containers::CString real_url = Engine::Platform::PathNormalize(_saveFolder + "/" + url.Trim("\\/"));
+	if (!Engine::Platform::PathExists(real_url))
+		return NULL;
+
+	return Engine::Memory::GetDefaultAllocator()->NewObj<Engine::FileSystem::Streams::CFileStream>(real_url, Engine::Platform::FILE_ACCESS_MODE_READ, Engine::Platform::FILE_OPEN_MODE_OPEN_EXISTING);
+}
+
 void CFileSystem::DestroyStream(Engine::FileSystem::Streams::CStream* stream)
 {
 	Engine::Memory::GetDefaultAllocator()->FreeObj(&stream);
@@ -298,25 +310,99 @@ bool CFileSystem::CanAccess(const Engine::Containers::CString& url)
 	return (attr != NULL);
 }
 
-/*			
 u32 CFileSystem::HotReloadGroup(const Engine::Containers::CString& group)
 {
-	return 0;
+	return InvokeHotReload("", group, false);
 }
 
 u32 CFileSystem::HotReloadFile(const Engine::Containers::CString& url)
 {
-	return 0;
+	return InvokeHotReload(url, "", false);
 }
 
 u32 CFileSystem::HotReloadAll()
 {
-	HotReloadEvent evt;
-	evt.ReloadType = HOT_RELOAD_ALL;
-	evt.Source = this;
+	return InvokeHotReload("", "", true);
+}
+
+void CFileSystem::AddHotReloadHook(IHotReloadable* target, const Engine::Containers::CString& url, const Engine::Containers::CString& group)
+{
+	for (u32 i = 0; i < _hotReloadHooks.Size(); i++)
+	{
+		CFileSystemHotReloadHook& hook = _hotReloadHooks[i];
+		if (hook.Target == target && hook.URL == url && hook.Group == group)
+			return;
+	}
 
-	_eventManager->PostEvent(evt);
+	CFileSystemHotReloadHook hook;
+	hook.URL	= url;
+	hook.Group	= group;
+	hook.Target = target;
+	_hotReloadHooks.AddToEnd(hook);
+}
 
-	return 0;
+void CFileSystem::RemoveHotReloadHooks(IHotReloadable* target)
+{
+	for (u32 i = 0; i < _hotReloadHooks.Size(); )
+	{
+		if (_hotReloadHooks[i].Target == target)
+			_hotReloadHooks.RemoveIndex(i);
+		else
+			i++;
+	}
 }
-*/
\ No newline at end of file
+
+// Returns the number of callbacks invoked. The matching hooks are copied out first as
+// callbacks are free to hook and unhook.
+u32 CFileSystem::InvokeHotReload(const Engine::Containers::CString& url, const Engine::Containers::CString& group, bool all)
+{
+	Engine::Containers::CArray<CFileSystemHotReloadHook> hooks;
+	for (u32 i = 0; i < _hotReloadHooks.Size(); i++)
+	{
+		CFileSystemHotReloadHook& hook = _hotReloadHooks[i];
+		if (all == true ||
+			(url != "" && hook.URL == url) ||
+			(group != "" && hook.Group == group))
+			hooks.AddToEnd(hook);
+	}
+
+	for (u32 i = 0; i < hooks.Size(); i++)
+		hooks[i].Target->HotReload(hooks[i].URL != "" ? hooks[i].URL : hooks[i].Group);
+
+	return hooks.Size();
+}
+
+IHotReloadable::IHotReloadable()
+{
+	_hotReloadFileSystem = NULL;
+}
+
+IHotReloadable::~IHotReloadable()
+{
+	UnhookHotReload();
+}
+
+void IHotReloadable::HookHotReloadURL(CFileSystem* fileSystem, const Engine::Containers::CString& url)
+{
+	LOG_ASSERT_MSG(_hotReloadFileSystem == NULL || _hotReloadFileSystem == fileSystem, "Hot reloads can only be hooked on one file system.");
+
+	_hotReloadFileSystem = fileSystem;
+	fileSystem->AddHotReloadHook(this, url, "");
+}
+
+void IHotReloadable::HookHotReloadGroup(CFileSystem* fileSystem, const Engine::Containers::CString& group)
+{
+	LOG_ASSERT_MSG(_hotReloadFileSystem == NULL || _hotReloadFileSystem == fileSystem, "Hot reloads can only be hooked on one file system.");
+
+	_hotReloadFileSystem = fileSystem;
+	fileSystem->AddHotReloadHook(this, "", group);
+}
+
+void IHotReloadable::UnhookHotReload()
+{
+	if (_hotReloadFileSystem == NULL)
+		return;
+
+	_hotReloadFileSystem->RemoveHotReloadHooks(this);
+	_hotReloadFileSystem = NULL;
+}
\ No newline at end of file
@@ -60,20 +60,6 @@ namespace Engine
 		*/
 
 		/*
-		// Any class that uses hot-reloadable assets derive from this class. This is primarily used to keep
-		// the compiler happy when taking member function pointers to use with hot reloading.
-		class IHotReloadable
-		{
-		public:
-			void HookHotReloadURL		(CFileSystem* fileSystem, const Engine::Containers::CString& url);
-			void HookHotReloadGroup		(CFileSystem* fileSystem, const Engine::Containers::CString& group);
-			void UnhookHotReload		();
-
-			virtual void HotReload		() = 0;
-
-			~IHotReloadable				();
-		};
-
 		EVENT_HOT_RELOAD_URL
 		EVENT_HOT_RELOAD_GROUP
 		EVENT_APP_CLOSE
@@ -98,6 +84,35 @@ namespace Engine
 		}
 		*/
 
+		class CFileSystem;
+
+		// Any class that uses hot-reloadable assets derive from this class. HotReload is invoked
+		// with the url (or group) that was hooked when the file system is asked to reload it.
+		class IHotReloadable
+		{
+		private:
+			CFileSystem* _hotReloadFileSystem;
+
+		public:
+			IHotReloadable				();
+			virtual ~IHotReloadable		();
+
+			void HookHotReloadURL		(CFileSystem* fileSystem, const Engine::Containers::CString& url);
+			void HookHotReloadGroup		(CFileSystem* fileSystem, const Engine::Containers::CString& group);
+			void UnhookHotReload		();
+
+			virtual void HotReload		(const Engine::Containers::CString& url) = 0;
+		};
+
+		// A hot reload callback registered with the file system, either URL or Group is set.
+		class CFileSystemHotReloadHook
+		{
+		public:
+			Engine::Containers::CString	URL;
+			Engine::Containers::CString	Group;
+			IHotReloadable*				Target;
+		};
+
 		// Stores a cached list of files in a directory.
 		class CFileSystemCachedFile
 		{
@@ -133,6 +148,12 @@ namespace Engine
 
 				bool _diskFilesAllowed;
 
+				Engine::Containers::CArray<CFileSystemHotReloadHook>						_hotReloadHooks;
+
+				void AddHotReloadHook		(IHotReloadable* target, const Engine::Containers::CString& url, const Engine::Containers::CString& group);
+				void RemoveHotReloadHooks	(IHotReloadable* target);
+				u32	 InvokeHotReload		(const Engine::Containers::CString& url, const Engine::Containers::CString& group, bool all);
+
 				// Path manipulation junk.
 				CFileSystemCachedDirectoryList	GetDirectoryListing	(const Engine::Containers::CString& url);
 				CFileSystemCachedFile*			ExpandPathAttributes(const Engine::Containers::CString& url);
@@ -158,6 +179,7 @@ namespace Engine
 				// to the given resource group.
 				Engine::FileSystem::Streams::CStream* CreateWriteStream	(const Engine::Containers::CString& url);
 				Engine::FileSystem::Streams::CStream* CreateReadStream	(const Engine::Containers::CString& url);
+				Engine::FileSystem::Streams::CStream* CreateSaveReadStream(const Engine::Containers::CString& url);
 				void								  DestroyStream		(Engine::FileSystem::Streams::CStream* stream);
 				bool								  CanAccess			(const Engine::Containers::CString& url);
 				
@@ -166,6 +188,8 @@ namespace Engine
 				u32 HotReloadGroup		(const Engine::Containers::CString& group);
 				u32 HotReloadFile		(const Engine::Containers::CString& url);
 				u32 HotReloadAll		();
+
+			friend class IHotReloadable;
 		};
 
 	}
@@ -283,6 +283,9 @@ bool CGameEngine::BaseInitialize()
 	// Create the task managers workers.
 	_taskManager->CreateWorkers(max((s32)Engine::Platform::GetProcessorCount() - 2, 0));
 
+	// Let the script manager spread batches of files over the workers when compiling.
+	_scriptManager->SetTaskManager(_taskManager);
+
 	// Initialize the game.
 	return Initialize();
 }
@@ -3,9 +3,14 @@
 //  Copyright  2011 Timothy Leonard
 ///////////////////////////////////////////////////////////////////////////////
 
-// The pool allocater is very simple. It assumes all allocations are the same
-// size as the initial allocation. Everything is tightly packed in memory, with
-// minimal headers (only a allocated/deallocated flag). 
+// The pool allocater is very simple. All allocations are the same size (the
+// block size given when its constructed). Memory is taken from the parent in
+// slabs of blocks, freed blocks are pushed onto a free list and handed straight
+// back out on the next allocation. Slabs are only released when the pool is
+// destroyed.
+//
+// Blocks are aligned to 16 bytes. There is no locking, pools are meant to be
+// owned by a single thread.
 
 #include <stdio.h>
 
@@ -13,32 +18,80 @@
 
 using namespace Engine::Memory::Allocators;
 
-void* CPoolAllocator::Alloc(u32 size, u32 align)
+void CPoolAllocator::AllocateSlab()
 {
-	if (size == 0) _blockSize = size;
-	LOG_ASSERT(size == _blockSize);
+	u8* slab = (u8*)_parent->Alloc(_slabHeaderSize + (_blockSize * _blocksPerSlab), 16);
+	LOG_ASSERT(slab != NULL);
 
+	// Link slab into slab list.
+	CPoolLink* link = (CPoolLink*)slab;
+	link->Next = _slabs;
+	_slabs = link;
 
+	// Push all blocks onto the free list, in reverse so they are handed
+	// out in address order.
+	u8* blocks = slab + _slabHeaderSize;
+	for (s32 i = _blocksPerSlab - 1; i >= 0; i--)
+	{
+		CPoolLink* block = (CPoolLink*)(blocks + (i * _blockSize));
+		block->Next = _freeBlocks;
+		_freeBlocks = block;
+	}
 }
 
-void CPoolAllocator::Free(void* ptr)
+void* CPoolAllocator::InternalAlloc(u32 size, u32 align)
 {
+	LOG_ASSERT(size <= _blockSize && align <= 16);
+
+	if (_freeBlocks == NULL)
+		AllocateSlab();
+
+	CPoolLink* block = _freeBlocks;
+	_freeBlocks = block->Next;
+
+	return block;
+}
+
+void CPoolAllocator::InternalFree(void* ptr)
+{
+	CPoolLink* block = (CPoolLink*)ptr;
+	block->Next = _freeBlocks;
+	_freeBlocks = block;
 }
 
-u32 CPoolAllocator::Size(void* ptr)
+u32 CPoolAllocator::InternalSize(void* ptr)
 {
-	LOG_ASSERT(_blockSize != 0);
 	return _blockSize;
 }
 
-CPoolAllocator::CPoolAllocator(Engine::Types::CString name, CAllocator* parent)
+u32 CPoolAllocator::GetBlockSize()
 {
-	_name = name;
-    _parent = parent;
+	return _blockSize;
 }
 
-CPoolAllocator::~CPoolAllocator()
+CPoolAllocator::CPoolAllocator(Engine::Containers::CString name, CAllocator* parent, u32 blockSize, u32 blocksPerSlab)
 {
-    _parent = NULL;
+	_name			= name;
+    _parent			= parent;
+	_blockSize		= (blockSize < sizeof(CPoolLink) ? sizeof(CPoolLink) : blockSize);
+	_blockSize		= (_blockSize + 15) & ~15;
+	_blocksPerSlab	= blocksPerSlab;
+	_slabHeaderSize = (sizeof(CPoolLink) + 15) & ~15;
+	_slabs			= NULL;
+	_freeBlocks		= NULL;
 }
 
+CPoolAllocator::~CPoolAllocator()
+{
+	CPoolLink* slab = _slabs;
+	while (slab != NULL)
+	{
+		CPoolLink* next = slab->Next;
+		_parent->Free(&slab);
+		slab = next;
+	}
+
+	_slabs		= NULL;
+	_freeBlocks = NULL;
+    _parent		= NULL;
+}
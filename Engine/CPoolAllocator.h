@@ -13,19 +13,37 @@ namespace Engine
         namespace Allocators
         {
 
+			// Default number of blocks carved out of each slab.
+			#define POOL_ALLOCATOR_DEFAULT_BLOCKS_PER_SLAB	64
+
             class CPoolAllocator : public CAllocator
             {
             private:
+				// Free blocks and slabs are kept in intrusive singly linked lists.
+				struct CPoolLink
+				{
+					CPoolLink* Next;
+				};
+
                 CAllocator* _parent;
 
-				u32 _blockSize;
+				u32			_blockSize;
+				u32			_blocksPerSlab;
+				u32			_slabHeaderSize;
+
+				CPoolLink*	_slabs;
+				CPoolLink*	_freeBlocks;
+
+				void AllocateSlab();
 
             public:
-                virtual void* Alloc  (u32 size, u32 align=16);
-                virtual void  Free   (void* ptr);
-                virtual u32   Size   (void* ptr);
+                virtual void* InternalAlloc  (u32 size, u32 align=16);
+                virtual void  InternalFree   (void* ptr);
+                virtual u32   InternalSize   (void* ptr);
+
+				u32 GetBlockSize();
 
-                CPoolAllocator(Engine::Types::CString name, CAllocator* parentAllocator);
+                CPoolAllocator(Engine::Containers::CString name, CAllocator* parentAllocator, u32 blockSize, u32 blocksPerSlab=POOL_ALLOCATOR_DEFAULT_BLOCKS_PER_SLAB);
                 ~CPoolAllocator();
             };
 
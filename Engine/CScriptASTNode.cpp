@@ -25,6 +25,8 @@ CScriptASTNode::CScriptASTNode()
 	_parent					= NULL;
 	_continueJumpTarget		= NULL;
 	_breakJumpTarget		= NULL;
+	_symbolSlots			= NULL;
+	_symbolSlotCount		= 0;
 }
 
 CScriptASTNode::CScriptASTNode(Engine::Scripting::CScriptToken token, CScriptASTNode* parent)
@@ -35,16 +37,23 @@ CScriptASTNode::CScriptASTNode(Engine::Scripting::CScriptToken token, CScriptAST
 		parent->_children.AddToEnd(this);
 	}
 	_parent = parent;
+	_symbolSlots = NULL;
+	_symbolSlotCount = 0;
 }
 
 CScriptASTNode::~CScriptASTNode()
 {
-	// Dispose of children.
+	// Dispose of children. Node memory belongs to the compile context's
+	// arena, so we only need to run their destructors.
 	for (u32 i = 0; i < _children.Size(); i++)
 	{
-		Engine::Scripting::GetScriptAllocator()->FreeObj(&_children[i]);
+		_children[i]->~CScriptASTNode();
 	}
 	_children.Clear();
+
+	// Dispose of symbol lookup table.
+	if (_symbolSlots != NULL)
+		Engine::Scripting::GetScriptAllocator()->FreeArray(&_symbolSlots);
 }
 
 void CScriptASTNode::PrettyPrint(u32 tabs)
@@ -123,32 +132,93 @@ Engine::Containers::CArray<Symbols::CScriptSymbol*>& CScriptASTNode::GetSymbols(
 	return _symbols;
 }
 
-Symbols::CScriptSymbol*	CScriptASTNode::FindSymbol(Engine::Containers::CString& identifier, bool recursive, u32 type, u32 exceptType)
+u32 CScriptASTNode::HashIdentifier(const Engine::Containers::CString& identifier)
 {
-	Engine::Containers::CString ourIdentifier = identifier.ToLower();
+	// Same hash as CString::ToHashCode, but folded to lower case as we go so
+	// we don't have to allocate a lowered copy of the identifier.
+	const u8* str = identifier.c_str();
+	u32 length	  = identifier.Length();
+	u32 hash	  = 0;
 
-	// Mask of "type" bits from "except type" bits lol, having both makes no sense.
-	type = type & ~exceptType;
+	for (u32 i = 0; i < length; i++)
+		hash = (31 * hash) + (u32)tolower(str[i]);
 
-	for (u32 i = 0; i < _symbols.Size(); i++)
+	return hash;
+}
+
+// Case-insensitive comparison of two identifiers without allocating.
+static bool CompareIdentifiers(const Engine::Containers::CString& a, const Engine::Containers::CString& b)
+{
+	u32 length = a.Length();
+	if (length != b.Length())
+		return false;
+
+	const u8* aStr = a.c_str();
+	const u8* bStr = b.c_str();
+	for (u32 i = 0; i < length; i++)
+	{
+		if (aStr[i] != bStr[i] && tolower(aStr[i]) != tolower(bStr[i]))
+			return false;
+	}
+
+	return true;
+}
+
+Symbols::CScriptSymbol* CScriptASTNode::FindLocalSymbol(const Engine::Containers::CString& identifier, u32 hash, u32 type, u32 exceptType)
+{
+	if (_symbolSlotCount == 0)
+		return NULL;
+
+	// Duplicate identifiers are allowed, they are inserted in declaration order
+	// along the probe sequence so the first match is the first one declared.
+	u32 mask = _symbolSlotCount - 1;
+	for (u32 slot = hash & mask; _symbolSlots[slot] >= 0; slot = (slot + 1) & mask)
 	{
-		Engine::Containers::CString symbolIdentifier = _symbols[i]->GetIdentifier();
+		s32 index = _symbolSlots[slot];
+		if (_symbolHashes[index] != hash)
+			continue;
+
+		Symbols::CScriptSymbol* symbol = _symbols[index];
 
 		// Do we need to check the type.
-		if (type != 0 && (type & _symbols[i]->GetType()) == 0)
+		if (type != 0 && (type & symbol->GetType()) == 0)
 			continue;
 
-		if (exceptType != 0 && (exceptType & _symbols[i]->GetType()) != 0)
+		if (exceptType != 0 && (exceptType & symbol->GetType()) != 0)
 			continue;
 
-		if (symbolIdentifier.ToLower() == ourIdentifier)
-			return _symbols[i];
+		if (CompareIdentifiers(symbol->GetToken().Literal, identifier))
+			return symbol;
 	}
 
-	if (recursive == true && _parent != NULL)
-		return _parent->FindSymbol(identifier, recursive, type);
-	else
-		return NULL;
+	return NULL;
+}
+
+Symbols::CScriptSymbol*	CScriptASTNode::FindSymbol(Engine::Containers::CString& identifier, bool recursive, u32 type, u32 exceptType)
+{
+	// Mask of "type" bits from "except type" bits lol, having both makes no sense.
+	type = type & ~exceptType;
+
+	// Hash once and probe each scope on the way up, rather than re-lowering
+	// the identifier (and every symbol) at each level. Scopes are probed in place 
+	// rather than flattened into a table per scope: symbols keep being added to 
+	// enclosing scopes after inner ones are created (loop jump targets and string 
+	// symbols to the root while instructions are generated) and the parser re-parents 
+	// expression nodes, so a flattened copy would go stale. Each level costs one 
+	// probe, nodes without symbols return straight away.
+	u32 hash = HashIdentifier(identifier);
+
+	for (CScriptASTNode* node = this; node != NULL; node = node->_parent)
+	{
+		Symbols::CScriptSymbol* symbol = node->FindLocalSymbol(identifier, hash, type, exceptType);
+		if (symbol != NULL)
+			return symbol;
+
+		if (recursive == false)
+			break;
+	}
+
+	return NULL;
 }
 
 void CScriptASTNode::AddChild(CScriptASTNode* node)
@@ -159,12 +229,53 @@ void CScriptASTNode::AddChild(CScriptASTNode* node)
 
 void CScriptASTNode::AddSymbolToParent(Symbols::CScriptSymbol* symbol)
 {
-	_parent->_symbols.AddToEnd(symbol);
+	_parent->InsertSymbol(symbol);
 }
 
 void CScriptASTNode::AddSymbol(Symbols::CScriptSymbol* symbol)
+{
+	InsertSymbol(symbol);
+}
+
+void CScriptASTNode::InsertSymbol(Symbols::CScriptSymbol* symbol)
 {
 	_symbols.AddToEnd(symbol);
+	_symbolHashes.AddToEnd(HashIdentifier(symbol->GetToken().Literal));
+
+	// Keep load factor under 3/4.
+	if (_symbols.Size() * 4 > _symbolSlotCount * 3)
+	{
+		RehashSymbols(_symbolSlotCount == 0 ? 8 : _symbolSlotCount * 2);
+		return;
+	}
+
+	u32 index = _symbols.Size() - 1;
+	u32 mask  = _symbolSlotCount - 1;
+	u32 slot  = _symbolHashes[index] & mask;
+	while (_symbolSlots[slot] >= 0)
+		slot = (slot + 1) & mask;
+	_symbolSlots[slot] = index;
+}
+
+void CScriptASTNode::RehashSymbols(u32 slotCount)
+{
+	if (_symbolSlots != NULL)
+		Engine::Scripting::GetScriptAllocator()->FreeArray(&_symbolSlots);
+
+	_symbolSlots	 = Engine::Scripting::GetScriptAllocator()->AllocArray<s32>(slotCount);
+	_symbolSlotCount = slotCount;
+	for (u32 i = 0; i < slotCount; i++)
+		_symbolSlots[i] = -1;
+
+	// Reinsert in declaration order so duplicates keep their precedence.
+	u32 mask = slotCount - 1;
+	for (u32 i = 0; i < _symbols.Size(); i++)
+	{
+		u32 slot = _symbolHashes[i] & mask;
+		while (_symbolSlots[slot] >= 0)
+			slot = (slot + 1) & mask;
+		_symbolSlots[slot] = i;
+	}
 }
 
 void CScriptASTNode::AddInstruction(CScriptGenerator* gen, Instructions::CScriptInstruction* instr)
@@ -43,6 +43,13 @@ namespace Engine
 					Engine::Scripting::CScriptToken									_token;
 					Engine::Containers::CArray<CScriptASTNode*>						_children;
 					Engine::Containers::CArray<Symbols::CScriptSymbol*>				_symbols;
+
+					// Open-addressed lookup table over _symbols, keyed on the case-folded
+					// hash of each identifier (stored in _symbolHashes, parallel to _symbols).
+					// Each slot holds an index into _symbols or -1 if empty.
+					Engine::Containers::CArray<u32>									_symbolHashes;
+					s32*															_symbolSlots;
+					u32																_symbolSlotCount;
 				
 					Symbols::CScriptJumpTargetSymbol* _continueJumpTarget;
 					Symbols::CScriptJumpTargetSymbol* _breakJumpTarget;
@@ -70,6 +77,15 @@ namespace Engine
 					void												  AddSymbolToParent		    (Symbols::CScriptSymbol* symbol);
 					void												  AddSymbol				    (Symbols::CScriptSymbol* symbol);
 
+					static u32											  HashIdentifier			(const Engine::Containers::CString& identifier);
+
+				private:
+					void												  InsertSymbol			    (Symbols::CScriptSymbol* symbol);
+					void												  RehashSymbols			    (u32 slotCount);
+					Symbols::CScriptSymbol*								  FindLocalSymbol			(const Engine::Containers::CString& identifier, u32 hash, u32 type, u32 exceptType);
+
+				public:
+
 					// Instruction creation/modification.
 					void															AddInstruction			(CScriptGenerator* gen, Instructions::CScriptInstruction* instr);
 
@@ -11,6 +11,7 @@
 #include "CScriptFunctionSymbol.h"
 #include "CScriptVariableSymbol.h"
 #include "CScriptStringSymbol.h"
+#include "CScriptVirtualMachine.h"
 
 #include "CFileStream.h"
 
@@ -22,6 +23,7 @@ CScriptCompileContext::CScriptCompileContext(const Engine::Containers::CString&
 	_rawSource		= raw;
 	_initialFile	= file;
 	_astTree		= NULL;
+	_astAllocator	= Engine::Scripting::GetScriptAllocator()->NewObj<Engine::Memory::Allocators::CArenaAllocator>("Script AST Allocator", Engine::Scripting::GetScriptAllocator());
 
 	_isClass		= false;
 	_className		= "";
@@ -30,19 +32,36 @@ CScriptCompileContext::CScriptCompileContext(const Engine::Containers::CString&
 	_globalVariableCount = 0;
 	_functionTableSize = 0;
 
+	_packedInstructions	  = NULL;
+	_instructionDebugInfo = NULL;
+
 	_saveable		= false;
+
+	_optimizationLevel = SCRIPT_OPTIMIZATION_FULL;
+
+	_stats.UnoptimizedLoads	 = 0;
+	_stats.UnoptimizedStores = 0;
+	_stats.Loads			 = 0;
+	_stats.Stores			 = 0;
 }
 
 CScriptCompileContext::~CScriptCompileContext()
 {
 	DisposeAll();
+
+	Engine::Scripting::GetScriptAllocator()->FreeObj(&_astAllocator);
 }
 
 void CScriptCompileContext::DisposeAll()
 {
-	// Dispose of the AST tree.
+	// Dispose of the AST tree. This only runs destructors, the node memory
+	// is all released when the arena is reset.
 	if (_astTree != NULL)
-		Engine::Scripting::GetScriptAllocator()->FreeObj(&_astTree);
+		_astAllocator->FreeObj(&_astTree);
+	_astAllocator->Reset();
+
+	// Destroy packed instructions.
+	DisposePackedInstructions();
 
 	// Destroy instructions.
 	for (u32 i = 0; i < _instructions.Size(); i++)
@@ -74,6 +93,123 @@ AST::CScriptASTNode* CScriptCompileContext::GetASTRoot()
 	return _astTree;
 }
 
+Engine::Memory::Allocators::CArenaAllocator* CScriptCompileContext::GetASTAllocator()
+{
+	return _astAllocator;
+}
+
+ScriptOptimizationLevel CScriptCompileContext::GetOptimizationLevel()
+{
+	return _optimizationLevel;
+}
+
+void CScriptCompileContext::SetOptimizationLevel(ScriptOptimizationLevel level)
+{
+	_optimizationLevel = level;
+}
+
+const CScriptCompileStats& CScriptCompileContext::GetStats()
+{
+	return _stats;
+}
+
+const Engine::Containers::CString& CScriptCompileContext::GetDisassembly()
+{
+	return _disassembly;
+}
+
+void CScriptCompileContext::DisposePackedInstructions()
+{
+	if (_packedInstructions != NULL)
+		Engine::Scripting::GetScriptAllocator()->FreeArray(&_packedInstructions);
+	if (_instructionDebugInfo != NULL)
+		Engine::Scripting::GetScriptAllocator()->FreeArray(&_instructionDebugInfo);
+}
+
+// Converts the instruction list into the compact format executed by the VM. Register
+// operands go into A/B/C in order, any other operand goes into the immediate field.
+void CScriptCompileContext::PackInstructions()
+{
+	DisposePackedInstructions();
+
+	_packedInstructions	  = Engine::Scripting::GetScriptAllocator()->AllocArray<Instructions::CScriptPackedInstruction>(_instructions.Size());
+	_instructionDebugInfo = Engine::Scripting::GetScriptAllocator()->AllocArray<Instructions::CScriptInstructionDebugInfo>(_instructions.Size());
+
+	for (u32 i = 0; i < _instructions.Size(); i++)
+	{
+		Instructions::CScriptInstruction*		instr  = _instructions[i];
+		Instructions::CScriptPackedInstruction& packed = _packedInstructions[i];
+
+		packed.Opcode		= (u8)instr->Opcode;
+		packed.OperandCount = (u8)instr->OperandCount;
+		packed.A			= 0;
+		packed.B			= 0;
+		packed.Index		= 0;
+
+		u32 registerCount = 0;
+		for (u32 op = 0; op < instr->OperandCount; op++)
+		{
+			Instructions::CScriptOperand& operand = instr->Operands[op];
+			switch (operand.Type)
+			{
+				case Instructions::SCRIPT_OPERAND_REGISTER:
+					{
+						switch (registerCount++)
+						{
+							case 0:		packed.A = (u8)operand.RegisterIndex;	break;
+							case 1:		packed.B = (u8)operand.RegisterIndex;	break;
+							default:	packed.C = operand.RegisterIndex;		break;
+						}
+						break;
+					}
+
+				case Instructions::SCRIPT_OPERAND_LITERAL_INT:
+					packed.IntLiteral = operand.IntLiteral;
+					break;
+
+				case Instructions::SCRIPT_OPERAND_LITERAL_FLOAT:
+					packed.FloatLiteral = operand.FloatLiteral;
+					break;
+				
+				case Instructions::SCRIPT_OPERAND_INSTRUCTION:
+					packed.Index = operand.InstructionIndex;
+					break;
+
+				case Instructions::SCRIPT_OPERAND_STACK_INDEX:
+					packed.IntLiteral = operand.StackIndex;
+					break;
+
+				case Instructions::SCRIPT_OPERAND_JUMP_TARGET:
+					packed.Index = reinterpret_cast<Symbols::CScriptJumpTargetSymbol*>(operand.Symbol)->Index;
+					break;
+
+				case Instructions::SCRIPT_OPERAND_SYMBOL:
+					packed.Index = _symbols.IndexOf(operand.Symbol);
+					break;
+			}
+		}
+
+		_instructionDebugInfo[i].Line	= instr->Token.Line;
+		_instructionDebugInfo[i].Column = instr->Token.Column;
+	}
+}
+
+Instructions::CScriptPackedInstruction* CScriptCompileContext::GetPackedInstructions()
+{
+	if (_packedInstructions == NULL)
+		PackInstructions();
+
+	return _packedInstructions;
+}
+
+Instructions::CScriptInstructionDebugInfo* CScriptCompileContext::GetInstructionDebugInfo()
+{
+	if (_instructionDebugInfo == NULL)
+		PackInstructions();
+
+	return _instructionDebugInfo;
+}
+
 void CScriptCompileContext::PushError(const CScriptError& error)
 {
 	_errorList.AddToEnd(error);
@@ -167,6 +303,10 @@ bool CScriptCompileContext::Load(Engine::FileSystem::Streams::CStream* stream)
 	if (stream->ReadU8() != SCRIPT_FILE_VERSION)
 		return false;
 
+	// Native calls are compiled to binding table indexes, so the table has to match.
+	if (stream->ReadU32() != CScriptVirtualMachine::GetNativeBindingHash())
+		return false;
+
 	u32 instructionCount	= stream->ReadU32();
 	u32 symbolCount			= stream->ReadU32();
 	_isClass				= stream->ReadU8() != 0;
@@ -196,15 +336,17 @@ bool CScriptCompileContext::Load(Engine::FileSystem::Streams::CStream* stream)
 					func->LocalCount = stream->ReadU32();
 					func->Index = stream->ReadU16();
 					
+					_symbols.AddToEnd(func);
+
 					s32 idx = stream->ReadS32();
 					if (idx < 0)
 						func->State = NULL;
-					else
+					else if (idx < (s32)_symbols.Size() - 1 && _symbols[idx]->GetType() == SCRIPT_SYMBOL_TYPE_STATE)
 						func->State = static_cast<Symbols::CScriptStateSymbol*>(_symbols[idx]);
+					else
+						return false;
 					
 					func->Type = static_cast<AST::ScriptFunctionType>(stream->ReadU8());
-
-					_symbols.AddToEnd(func);
 				}
 				break;
 
@@ -244,6 +386,9 @@ bool CScriptCompileContext::Load(Engine::FileSystem::Streams::CStream* stream)
 		instr->OperandCount = stream->ReadU8();
 		instr->Token.Line	= stream->ReadU16();
 		instr->Token.Column	= stream->ReadU16();
+
+		if (instr->Opcode >= Instructions::SCRIPT_OPCODE_COUNT || instr->OperandCount > SCRIPT_MAX_OPERAND_COUNT)
+			return false;
 	
 		for (u32 op = 0; op < instr->OperandCount; op++)
 		{
@@ -273,16 +418,43 @@ bool CScriptCompileContext::Load(Engine::FileSystem::Streams::CStream* stream)
 				case Instructions::SCRIPT_OPERAND_SYMBOL:
 					{
 						u32 idx = stream->ReadU32();
+						if (idx >= _symbols.Size())
+							return false;
+
 						instr->Operands[op].Symbol = _symbols[idx];
 						break;
 					}
 
+				// Jump targets are stored resolved.
 				case Instructions::SCRIPT_OPERAND_JUMP_TARGET:
+					instr->Operands[op].Type			 = Instructions::SCRIPT_OPERAND_INSTRUCTION;
 					instr->Operands[op].InstructionIndex = stream->ReadU32();
 					break;
 			}
 
 		}
+
+		// The VM indexes the binding table with these directly, so they are checked here 
+		// rather than trusting the file.
+		u32 binding = 0xFFFFFFFF;
+		switch (instr->Opcode)
+		{
+			case Instructions::SCRIPT_OPCODE_INVKNATIVE:
+				if (instr->OperandCount == 1 && instr->Operands[0].Type == Instructions::SCRIPT_OPERAND_LITERAL_INT)
+					binding = SCRIPT_NATIVE_CALL_INDEX((u32)instr->Operands[0].IntLiteral);
+				break;
+
+			case Instructions::SCRIPT_OPCODE_LDNATIVE:
+				if (instr->OperandCount == 2 && instr->Operands[1].Type == Instructions::SCRIPT_OPERAND_LITERAL_INT)
+					binding = (u32)instr->Operands[1].IntLiteral;
+				break;
+
+			default:
+				continue;
+		}
+
+		if (binding >= CScriptVirtualMachine::GetNativeBindingCount())
+			return false;
 	}
 	
 	_saveable = true;
@@ -293,31 +465,26 @@ void CScriptCompileContext::Save(Engine::FileSystem::Streams::CStream* stream)
 {
 	LOG_ASSERT(_saveable == true);
 
-	// Strip all jump targets from symbol table.
-	while (true)
-	{
-		u32 counter = 0;
-
-		for (u32 i = 0; i < _symbols.Size(); i++)
-		{
-			if (_symbols[i]->GetType() == SCRIPT_SYMBOL_TYPE_JUMPTARGET)
-			{
-				Engine::Scripting::GetScriptAllocator()->FreeObj(&_symbols[i]);
-				_symbols.RemoveIndex(i);
-				counter++;
-				break;
-			}
-		}
+	// Jump targets are written resolved, so they are left out of the saved symbol
+	// table. Rather than stripping them from our own table (which would leave the
+	// instruction list pointing at freed symbols) we remap symbol indexes as we write.
+	Engine::Containers::CArray<s32> symbolRemap;
+	u32 savedSymbolCount = 0;
 
-		if (counter <= 0)
-			break;
+	for (u32 i = 0; i < _symbols.Size(); i++)
+	{
+		if (_symbols[i]->GetType() == SCRIPT_SYMBOL_TYPE_JUMPTARGET)
+			symbolRemap.AddToEnd(-1);
+		else
+			symbolRemap.AddToEnd(savedSymbolCount++);
 	}
 
 	// Write header.
 	stream->WriteU32	(SCRIPT_FILE_SIGNATURE);
 	stream->WriteU8		(SCRIPT_FILE_VERSION);
+	stream->WriteU32	(CScriptVirtualMachine::GetNativeBindingHash());
 	stream->WriteU32	(_instructions.Size());
-	stream->WriteU32	(_symbols.Size());
+	stream->WriteU32	(savedSymbolCount);
 	stream->WriteU8		(_isClass);
 	stream->WriteString	(_className);
 	stream->WriteString	(_classBaseName);
@@ -329,6 +496,9 @@ void CScriptCompileContext::Save(Engine::FileSystem::Streams::CStream* stream)
 	for (u32 i = 0; i < _symbols.Size(); i++)
 	{
 		Symbols::CScriptSymbol* sym = _symbols[i];
+		if (symbolRemap[i] < 0)
+			continue;
+
 		stream->WriteU8		(sym->GetType());
 		stream->WriteString	(sym->GetToken().Literal);
 		stream->WriteU16	(sym->GetToken().Line);
@@ -346,7 +516,7 @@ void CScriptCompileContext::Save(Engine::FileSystem::Streams::CStream* stream)
 					if (func->State == NULL)
 						stream->WriteS32(-1);
 					else
-						stream->WriteS32(_symbols.IndexOf(func->State));
+						stream->WriteS32(symbolRemap[_symbols.IndexOf(func->State)]);
 
 					stream->WriteU8(func->Type);
 				}
@@ -411,7 +581,7 @@ void CScriptCompileContext::Save(Engine::FileSystem::Streams::CStream* stream)
 					break;
 
 				case Instructions::SCRIPT_OPERAND_SYMBOL:
-					stream->WriteU32(_symbols.IndexOf(op.Symbol));
+					stream->WriteU32(symbolRemap[_symbols.IndexOf(op.Symbol)]);
 					break;
 			}
 		}
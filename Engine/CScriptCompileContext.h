@@ -25,6 +25,7 @@
 #include "CScriptCompileContext.h"
 
 #include "CStream.h"
+#include "CArenaAllocator.h"
 
 namespace Engine
 {
@@ -73,9 +74,28 @@ namespace Engine
 			}
 		};
 
+		// How hard the generator tries to optimize the instructions it emits. Each
+		// level includes all the passes of the levels below it.
+		enum ScriptOptimizationLevel
+		{
+			SCRIPT_OPTIMIZATION_NONE	= 0,	// Emit instructions exactly as the AST describes them.
+			SCRIPT_OPTIMIZATION_BASIC	= 1,	// Constant folding, jump threading and dead code removal.
+			SCRIPT_OPTIMIZATION_FULL	= 2,	// Locals promoted to registers, copy propagation and redundant load removal.
+		};
+
+		// Counts of local and global loads / stores in the generated instructions, before
+		// and after optimization. Filled in by the generator, zero for loaded scripts.
+		struct CScriptCompileStats
+		{
+			u32		UnoptimizedLoads;
+			u32		UnoptimizedStores;
+			u32		Loads;
+			u32		Stores;
+		};
+
 		// Script file defines.
 		#define SCRIPT_FILE_SIGNATURE				*((u32*)"ISCR")
-		#define SCRIPT_FILE_VERSION					1
+		#define SCRIPT_FILE_VERSION					4
 
 		// The compiler context is used to pass the script source between the different
 		// parts of the scripting language compiler.
@@ -88,6 +108,10 @@ namespace Engine
 				Engine::Containers::CArray<CScriptToken>						_tokenList;
 				AST::CScriptASTNode*											_astTree;
 
+				// AST nodes are allocated from this and released in one go
+				// when the tree is disposed.
+				Engine::Memory::Allocators::CArenaAllocator*					_astAllocator;
+
 				// Final "output" state.
 				Engine::Containers::CArray<Instructions::CScriptInstruction*>	_instructions;
 				Engine::Containers::CArray<Symbols::CScriptSymbol*>				_symbols;
@@ -96,6 +120,10 @@ namespace Engine
 				Engine::Containers::CString										_classBaseName;
 				u32																_globalVariableCount;
 				u32																_functionTableSize;
+
+				// Packed form of the instruction list that the VM executes.
+				Instructions::CScriptPackedInstruction*							_packedInstructions;
+				Instructions::CScriptInstructionDebugInfo*						_instructionDebugInfo;
 	
 
 				// Used with the parser for unexpected eof messages.
@@ -104,10 +132,18 @@ namespace Engine
 
 				bool															_saveable;
 
+				ScriptOptimizationLevel											_optimizationLevel;
+				CScriptCompileStats												_stats;
+
+				// Listing of the generated instructions. Kept rather than printed by the generator
+				// as files can be compiled on task workers.
+				Engine::Containers::CString										_disassembly;
+
 			protected:
 				void PushError				(const CScriptError& error);
 				void PushToken				(const CScriptToken& token);
 				void DisposeAll				();
+				void DisposePackedInstructions	();
 
 			public:
 				CScriptCompileContext		(const Engine::Containers::CString& raw, const Engine::Containers::CString& file = "<string>");
@@ -115,6 +151,11 @@ namespace Engine
 				
 				Engine::Containers::CArray<Instructions::CScriptInstruction*>&		GetInstructions();
 				AST::CScriptASTNode*												GetASTRoot();
+				Engine::Memory::Allocators::CArenaAllocator*						GetASTAllocator();
+
+				void																PackInstructions();
+				Instructions::CScriptPackedInstruction*								GetPackedInstructions();
+				Instructions::CScriptInstructionDebugInfo*							GetInstructionDebugInfo();
 
 				u32							GetErrorCount	(ScriptErrorLevel level = SCRIPT_ERROR_ALL);
 				CScriptError&				GetError		(u32 index);
@@ -125,10 +166,19 @@ namespace Engine
 
 				void						ReloadRawSource	();
 
+				ScriptOptimizationLevel		GetOptimizationLevel();
+				void						SetOptimizationLevel(ScriptOptimizationLevel level);
+
+				const CScriptCompileStats&	GetStats		();
+				const Engine::Containers::CString& GetDisassembly();
+
 			friend class CScriptLexer;
 			friend class CScriptParser;
 			friend class CScriptGenerator;
 			friend class CScriptExecutionContext;
+			friend class CScriptProfiler;
+			friend class CScriptSnapshotWriter;
+			friend class CScriptSnapshotReader;
 
 			friend class AST::CScriptASTNode;
 			friend class AST::CScriptClassASTNode;
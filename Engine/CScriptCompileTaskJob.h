@@ -0,0 +1,48 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Conditionals.h"
+#include "Platform.h"
+
+#include "CTaskJob.h"
+
+#include "CScriptCompileContext.h"
+#include "CScriptManager.h"
+
+namespace Engine
+{
+    namespace Scripting
+    {
+
+		// Task job used by the script manager to compile a single file on a
+		// worker thread. Compiling only touches the compile context it's given,
+		// so any number of these can run at once.
+		class CScriptCompileTaskJob : public Engine::Core::Tasks::Jobs::CTaskJob
+		{
+			private:
+				CScriptCompileContext*	_context;
+
+			public:
+
+				CScriptCompileTaskJob()
+				{
+					_context = NULL;
+				}
+
+				void Setup(CScriptCompileContext* context)
+				{
+					_context = context;
+				}
+
+				virtual void Run()
+				{
+					CScriptManager::Compile(_context);
+				}
+
+		};
+
+	}
+}
\ No newline at end of file
@@ -62,10 +62,68 @@ CScriptContextObject::CScriptContextObject(CScriptExecutionContext* context, CSc
 
 void CScriptContextObject::Finalize(CScriptExecutionContext* context)
 {
-	_context.Dispose();
+	_context.Dispose(context);
 	_finalized = true;
 }
 
+void CScriptContextObject::VisitReferences(CScriptExecutionContext* context, ScriptGCVisitor visitor)
+{
+	// Locals are reference counted by the context (see CScriptCallContext::Dispose), 
+	// registers are not so they don't count.
+	if (_context.Symbol != NULL && _context.Locals != NULL)
+	{
+		for (u32 i = 0; i < _context.Symbol->LocalCount; i++)
+		{
+			CScriptValue& val = _context.Locals[i];
+			if (val.Type == SCRIPT_VALUE_TYPE_OBJECT && val.Object != NULL)
+				visitor(context, val.Object);
+		}
+	}
+}
+
+// Indirection operations.
+bool CScriptContextObject::GetAttribute(CScriptExecutionContext* context, CScriptValue& dest, const Engine::Containers::CString& name)
+{
+	return GetAttribute(context, dest, GetScriptStringTable()->Intern(name));
+}
+
+bool CScriptContextObject::SetAttribute(CScriptExecutionContext* context, const Engine::Containers::CString& name, const CScriptValue& value)
+{
+	return SetAttribute(context, GetScriptStringTable()->Intern(name), value);
+}
+
+bool CScriptContextObject::GetAttribute(CScriptExecutionContext* context, CScriptValue& dest, CScriptInternedString* name)
+{
+	return context->GetScopeSlot(FindAttributeSlot(context, name), dest);
+}
+
+bool CScriptContextObject::SetAttribute(CScriptExecutionContext* context, CScriptInternedString* name, const CScriptValue& value)
+{
+	return context->SetScopeSlot(FindAttributeSlot(context, name), value);
+}
+
+// Inline cache support.
+void* CScriptContextObject::GetShape(CScriptExecutionContext* context)
+{
+	return _context.Symbol;
+}
+
+s32 CScriptContextObject::FindAttributeSlot(CScriptExecutionContext* context, CScriptInternedString* name)
+{
+	Symbols::CScriptStateSymbol* state = (_context.Symbol != NULL ? _context.Symbol->State : NULL);
+	return context->FindScopeSlot(state, name);
+}
+
+bool CScriptContextObject::GetAttributeSlot(CScriptExecutionContext* context, CScriptValue& dest, s32 slot)
+{
+	return context->GetScopeSlot(slot, dest);
+}
+
+bool CScriptContextObject::SetAttributeSlot(CScriptExecutionContext* context, s32 slot, const CScriptValue& value)
+{
+	return context->SetScopeSlot(slot, value);
+}
+
 // Metadata.
 Engine::Containers::CString	CScriptContextObject::GetName()
 {
@@ -82,7 +140,7 @@ bool CScriptContextObject::CoerceToString(CScriptExecutionContext* context, Engi
 // Iteration.
 CScriptIteratorObject* CScriptContextObject::CreateIterator(CScriptExecutionContext* context)
 {
-	CScriptContextIteratorObject* iter = Engine::Scripting::GetScriptAllocator()->NewObj<CScriptContextIteratorObject>(context, this);
+	CScriptContextIteratorObject* iter = context->NewObject<CScriptContextIteratorObject>(this);
 	context->GCAdd(iter);
 
 	iter->CalcNext(context);
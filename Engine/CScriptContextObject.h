@@ -64,6 +64,21 @@ namespace Engine
 				// Metadata.
 				virtual Engine::Containers::CString		GetName		();
 				virtual void							Finalize	(CScriptExecutionContext* context);
+				virtual void							VisitReferences	(CScriptExecutionContext* context, ScriptGCVisitor visitor);
+
+				// Indirection. Attributes are the scope the function was declared in, functions in
+				// its state then global functions and variables.
+				virtual bool GetAttribute							(CScriptExecutionContext* context, CScriptValue& dest, const Engine::Containers::CString& name);
+				virtual bool SetAttribute							(CScriptExecutionContext* context, const Engine::Containers::CString& name, const CScriptValue& value);
+				virtual bool GetAttribute							(CScriptExecutionContext* context, CScriptValue& dest, CScriptInternedString* name);
+				virtual bool SetAttribute							(CScriptExecutionContext* context, CScriptInternedString* name, const CScriptValue& value);
+
+				// Inline cache support. The shape is the function the context was created from, 
+				// as that decides the scope, and slots are symbol table indexes.
+				virtual void* GetShape								(CScriptExecutionContext* context);
+				virtual s32	  FindAttributeSlot						(CScriptExecutionContext* context, CScriptInternedString* name);
+				virtual bool  GetAttributeSlot						(CScriptExecutionContext* context, CScriptValue& dest, s32 slot);
+				virtual bool  SetAttributeSlot						(CScriptExecutionContext* context, s32 slot, const CScriptValue& value);
 				
 				// Iterators.
 				virtual CScriptIteratorObject*		CreateIterator	(CScriptExecutionContext* context);
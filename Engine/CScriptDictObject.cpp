@@ -8,11 +8,19 @@
 #include "CScriptStringObject.h"
 
 #include "CScriptVirtualMachine.h"
+#include "CScriptSnapshot.h"
+#include "CStream.h"
+
+#include <cstring>
 
 using namespace Engine::Scripting;
 using namespace Engine::Scripting::Symbols;
 using namespace Engine::Scripting::Objects;
 
+CScriptDictIteratorObject::CScriptDictIteratorObject(CScriptExecutionContext* context)
+{
+}
+
 CScriptDictIteratorObject::CScriptDictIteratorObject(CScriptExecutionContext* context, CScriptObject* obj)
 {
 	_index = 0;
@@ -20,6 +28,11 @@ CScriptDictIteratorObject::CScriptDictIteratorObject(CScriptExecutionContext* co
 	_obj->IncRef();
 }
 
+ScriptSnapshotObjectType CScriptDictIteratorObject::GetSnapshotType()
+{
+	return SCRIPT_SNAPSHOT_OBJECT_DICT_ITERATOR;
+}
+
 bool CScriptDictIteratorObject::IsFinished(CScriptExecutionContext* context)
 {
 	CScriptDictObject* obj = reinterpret_cast<CScriptDictObject*>(_obj);
@@ -35,7 +48,8 @@ CScriptValue CScriptDictIteratorObject::NextValue(CScriptExecutionContext* conte
 
 CScriptDictObject::CScriptDictObject(CScriptExecutionContext* context)
 {
-
+	_slots	   = NULL;
+	_slotCount = 0;
 }
 
 void CScriptDictObject::Finalize(CScriptExecutionContext* context)
@@ -55,10 +69,62 @@ void CScriptDictObject::Finalize(CScriptExecutionContext* context)
 
 	_keys.Clear();
 	_values.Clear();
+	_hashes.Clear();
+
+	if (_slots != NULL)
+	{
+		Engine::Scripting::GetScriptAllocator()->FreeArray(&_slots);
+		_slots	   = NULL;
+		_slotCount = 0;
+	}
 
 	_finalized = true;
 }
 
+void CScriptDictObject::VisitReferences(CScriptExecutionContext* context, ScriptGCVisitor visitor)
+{
+	for (u32 i = 0; i < _keys.Size(); i++)
+	{
+		CScriptValue& val = _keys[i];
+		if (val.Type == SCRIPT_VALUE_TYPE_OBJECT && val.Object != NULL)
+			visitor(context, val.Object);
+	}
+	for (u32 i = 0; i < _values.Size(); i++)
+	{
+		CScriptValue& val = _values[i];
+		if (val.Type == SCRIPT_VALUE_TYPE_OBJECT && val.Object != NULL)
+			visitor(context, val.Object);
+	}
+}
+
+// Snapshots. Keys are written in insertion order so iterators resume at the same place, 
+// the hash table is rebuilt as they are added back.
+ScriptSnapshotObjectType CScriptDictObject::GetSnapshotType()
+{
+	return SCRIPT_SNAPSHOT_OBJECT_DICT;
+}
+
+void CScriptDictObject::WriteSnapshot(CScriptSnapshotWriter* writer)
+{
+	writer->GetStream()->WriteU32(_keys.Size());
+	for (u32 i = 0; i < _keys.Size(); i++)
+	{
+		writer->WriteValue(_keys[i]);
+		writer->WriteValue(_values[i]);
+	}
+}
+
+void CScriptDictObject::ReadSnapshot(CScriptSnapshotReader* reader)
+{
+	u32 count = reader->GetStream()->ReadU32();
+	for (u32 i = 0; i < count && reader->Failed() == false; i++)
+	{
+		CScriptValue key   = reader->ReadValue();
+		CScriptValue value = reader->ReadValue();
+		AddItem(reader->GetContext(), key, value);
+	}
+}
+
 // Metadata.
 Engine::Containers::CString	CScriptDictObject::GetName()
 {
@@ -68,7 +134,7 @@ Engine::Containers::CString	CScriptDictObject::GetName()
 // Iteration.
 CScriptIteratorObject* CScriptDictObject::CreateIterator(CScriptExecutionContext* context)
 {
-	CScriptDictIteratorObject* iter = Engine::Scripting::GetScriptAllocator()->NewObj<CScriptDictIteratorObject>(context, this);
+	CScriptDictIteratorObject* iter = context->NewObject<CScriptDictIteratorObject>(this);
 	context->GCAdd(iter);
 
 	return iter;
@@ -85,18 +151,161 @@ Engine::Containers::CArray<CScriptValue>& CScriptDictObject::GetValues()
 	return _values;
 }
 
-s32 CScriptDictObject::GetIndex(CScriptExecutionContext* context, const CScriptValue& key)
+// Hashing.
+static u32 HashInteger(u32 value)
 {
-	CScriptValue k = key;
+	// Mix the bits up so sequential keys don't cluster in the table.
+	value ^= value >> 16;
+	value *= 0x85ebca6b;
+	value ^= value >> 13;
+	value *= 0xc2b2ae35;
+	value ^= value >> 16;
+	return value;
+}
+
+static u32 HashPointer(const void* ptr)
+{
+	u64 value = (u64)(size_t)ptr;
+	return HashInteger((u32)(value ^ (value >> 32)));
+}
 
+// Calculates the hash of a key. Keys that compare equal with KeysEqual always
+// produce the same hash, so ints and whole-number floats hash the same.
+u32 CScriptDictObject::HashKey(const CScriptValue& key)
+{
+	switch (key.Type)
+	{
+		case SCRIPT_VALUE_TYPE_INT:				
+			return HashInteger((u32)key.IntValue);
+
+		case SCRIPT_VALUE_TYPE_FLOAT:
+			{
+				f32 value = key.FloatValue;
+				if (value >= -2147483648.0f && value < 2147483648.0f && value == (f32)(s32)value)
+					return HashInteger((u32)(s32)value);
+
+				u32 bits = 0;
+				memcpy(&bits, &value, sizeof(u32));
+				return HashInteger(bits);
+			}
+
+		case SCRIPT_VALUE_TYPE_OBJECT:
+			if (key.Object != NULL && typeid(*key.Object) == typeid(CScriptStringObject))
+				return static_cast<CScriptStringObject*>(key.Object)->GetHashCode();
+			return HashPointer(key.Object);
+
+		case SCRIPT_VALUE_TYPE_FUNCTION:		
+			return HashInteger((u32)key.IntValue);
+
+		case SCRIPT_VALUE_TYPE_SYMBOL:			
+			return HashPointer(key.Symbol);
+
+		case SCRIPT_VALUE_TYPE_NATIVE_FUNCTION:	
+			return HashPointer(key.NativeFunction);
+
+		default:
+			return 0;
+	}
+}
+
+// Checks if two keys are the same. Numbers compare by value, strings by their contents
+// and all other objects by identity.
+bool CScriptDictObject::KeysEqual(const CScriptValue& a, const CScriptValue& b)
+{
+	bool aNumeric = (a.Type == SCRIPT_VALUE_TYPE_INT || a.Type == SCRIPT_VALUE_TYPE_FLOAT);
+	bool bNumeric = (b.Type == SCRIPT_VALUE_TYPE_INT || b.Type == SCRIPT_VALUE_TYPE_FLOAT);
+	if (aNumeric == true && bNumeric == true)
+	{
+		if (a.Type == SCRIPT_VALUE_TYPE_INT && b.Type == SCRIPT_VALUE_TYPE_INT)
+			return a.IntValue == b.IntValue;
+
+		f32 aValue = (a.Type == SCRIPT_VALUE_TYPE_INT ? (f32)a.IntValue : a.FloatValue);
+		f32 bValue = (b.Type == SCRIPT_VALUE_TYPE_INT ? (f32)b.IntValue : b.FloatValue);
+		return aValue == bValue;
+	}
+
+	if (a.Type != b.Type)
+		return false;
+
+	switch (a.Type)
+	{
+		case SCRIPT_VALUE_TYPE_OBJECT:
+			{
+				if (a.Object == b.Object)
+					return true;
+				if (a.Object == NULL || b.Object == NULL)
+					return false;
+
+				if (typeid(*a.Object) == typeid(CScriptStringObject) && typeid(*b.Object) == typeid(CScriptStringObject))
+				{
+					CScriptStringObject* aStr = static_cast<CScriptStringObject*>(a.Object);
+					CScriptStringObject* bStr = static_cast<CScriptStringObject*>(b.Object);
+					return aStr->GetHashCode() == bStr->GetHashCode() && aStr->GetString() == bStr->GetString();
+				}
+
+				return false;
+			}
+
+		case SCRIPT_VALUE_TYPE_FUNCTION:		return a.IntValue == b.IntValue;
+		case SCRIPT_VALUE_TYPE_SYMBOL:			return a.Symbol == b.Symbol;
+		case SCRIPT_VALUE_TYPE_NATIVE_FUNCTION:	return a.NativeFunction == b.NativeFunction;
+		case SCRIPT_VALUE_TYPE_NULL:			return true;
+		default:								return false;
+	}
+}
+
+// Finds the slot the key is stored in, or the empty slot it should be stored
+// in if it dosen't exist. The table must have been allocated.
+u32 CScriptDictObject::FindSlot(const CScriptValue& key, u32 hash)
+{
+	u32 mask = _slotCount - 1;
+	u32 slot = hash & mask;
+
+	while (true)
+	{
+		s32 index = _slots[slot];
+		if (index == SCRIPT_DICT_EMPTY_SLOT)
+			return slot;
+		if (_hashes[index] == hash && KeysEqual(_keys[index], key))
+			return slot;
+
+		slot = (slot + 1) & mask;
+	}
+}
+
+// Reallocates the hash table with the given number of slots and reinserts all keys.
+void CScriptDictObject::Rehash(u32 slotCount)
+{
+	if (_slots != NULL)
+		Engine::Scripting::GetScriptAllocator()->FreeArray(&_slots);
+
+	_slots	   = Engine::Scripting::GetScriptAllocator()->AllocArray<s32>(slotCount);
+	_slotCount = slotCount;
+
+	for (u32 i = 0; i < _slotCount; i++)
+	{
+		_slots[i] = SCRIPT_DICT_EMPTY_SLOT;
+	}
+
+	// Keys are unique so we only need to find an empty slot for each.
+	u32 mask = _slotCount - 1;
 	for (u32 i = 0; i < _keys.Size(); i++)
 	{
-		if (context->CompareScriptValues(k, _keys[i]))
+		u32 slot = _hashes[i] & mask;
+		while (_slots[slot] != SCRIPT_DICT_EMPTY_SLOT)
 		{
-			return i;
+			slot = (slot + 1) & mask;
 		}
+		_slots[slot] = i;
 	}
-	return -1;
+}
+
+s32 CScriptDictObject::GetIndex(CScriptExecutionContext* context, const CScriptValue& key)
+{
+	if (_slots == NULL)
+		return -1;
+
+	return _slots[FindSlot(key, HashKey(key))];
 }
 
 void CScriptDictObject::AddItem(CScriptExecutionContext* context, const CScriptValue& keyInternal, const CScriptValue& valInternal)
@@ -104,8 +313,16 @@ void CScriptDictObject::AddItem(CScriptExecutionContext* context, const CScriptV
 	CScriptValue key   = keyInternal;
 	CScriptValue value = valInternal;
 
+	// Grow the table if its over 3/4 full.
+	if (_slots == NULL)
+		Rehash(SCRIPT_DICT_INITIAL_SLOTS);
+	else if ((_keys.Size() + 1) * 4 > _slotCount * 3)
+		Rehash(_slotCount * 2);
+
 	// Check key is not a duplicate.
-	if (GetIndex(context, key) >= 0)
+	u32 hash = HashKey(key);
+	u32 slot = FindSlot(key, hash);
+	if (_slots[slot] != SCRIPT_DICT_EMPTY_SLOT)
 	{
 		CScriptValue v;
 		v.Type = SCRIPT_VALUE_TYPE_OBJECT;
@@ -114,9 +331,11 @@ void CScriptDictObject::AddItem(CScriptExecutionContext* context, const CScriptV
 		context->DuplicateIndex(v, key);
 		return;
 	}
+	_slots[slot] = _keys.Size();
 
 	// Add key.
 	_keys.AddToEnd(key);
+	_hashes.AddToEnd(hash);
  	if (key.Type == SCRIPT_VALUE_TYPE_OBJECT && key.Object != NULL)
 		key.Object->IncRef();
 
@@ -28,18 +28,40 @@ namespace Engine
 			class CScriptDictIteratorObject : public CScriptIteratorObject
 			{
 			public:
+				CScriptDictIteratorObject							(CScriptExecutionContext* context);
 				CScriptDictIteratorObject							(CScriptExecutionContext* context, CScriptObject* obj);
 
+				virtual ScriptSnapshotObjectType	GetSnapshotType	();
+
 				virtual bool			IsFinished					(CScriptExecutionContext* context);
 				virtual CScriptValue	NextValue					(CScriptExecutionContext* context);
 			};
 
+			// Initial number of slots in a dicts hash table, must be a power of 2.
+			#define SCRIPT_DICT_INITIAL_SLOTS	16
+
+			// Value stored in an unused hash table slot.
+			#define SCRIPT_DICT_EMPTY_SLOT		-1
+
 			// Dict object! Stores the current state of a list.
+			//
+			// Keys and values are stored in insertion order (which is the order we iterate in), 
+			// lookups go through an open addressing hash table that maps a keys hash to its 
+			// index in the key list.
 			class CScriptDictObject : public CScriptObject
 			{
 			private:
 				Engine::Containers::CArray<CScriptValue> _keys;
 				Engine::Containers::CArray<CScriptValue> _values;
+				Engine::Containers::CArray<u32>			 _hashes;
+
+				s32*									 _slots;
+				u32										 _slotCount;
+
+				u32											HashKey		(const CScriptValue& key);
+				bool										KeysEqual	(const CScriptValue& a, const CScriptValue& b);
+				u32											FindSlot	(const CScriptValue& key, u32 hash);
+				void										Rehash		(u32 slotCount);
 
 			public:
 
@@ -49,6 +71,12 @@ namespace Engine
 				virtual Engine::Containers::CString			GetName		();
 
 				virtual void Finalize									(CScriptExecutionContext* context);
+				virtual void VisitReferences							(CScriptExecutionContext* context, ScriptGCVisitor visitor);
+
+				// Snapshots.
+				virtual ScriptSnapshotObjectType	GetSnapshotType	();
+				virtual void						WriteSnapshot	(CScriptSnapshotWriter* writer);
+				virtual void						ReadSnapshot	(CScriptSnapshotReader* reader);
 
 				// Array related stuff.
 				Engine::Containers::CArray<CScriptValue>&	GetKeys		();
@@ -7,6 +7,7 @@
 #include "CScriptGenerator.h"
 #include "CScriptManager.h"
 #include "CScriptExpressionASTNode.h"
+#include "CScriptIntrinsicASTNode.h"
 #include "CScriptCompileContext.h"
 
 using namespace Engine::Scripting;
@@ -79,6 +80,15 @@ void CScriptFunctionASTNode::GenerateSymbols(CScriptGenerator* gen)
 		blockNode->GenerateSymbols(gen);
 
 	symbol->LocalCount = LocalCount;
+
+	// function x() = native("x"); can be bound straight to the native. Function symbols 
+	// are only ever stored to by their declaration so this is safe.
+	if (Assigned == true && blockNode->GetChildren().Size() == 1)
+	{
+		CScriptIntrinsicASTNode* intrinsic = dynamic_cast<CScriptIntrinsicASTNode*>(blockNode->GetChildren()[0]);
+		if (intrinsic != NULL)
+			symbol->NativeBinding = intrinsic->GetNativeBinding();
+	}
 }
 
 u32 CScriptFunctionASTNode::GenerateInstructions(CScriptGenerator* gen)
@@ -6,6 +6,7 @@
 #include "CScriptCompileContext.h"
 #include "CScriptASTNode.h"
 #include "CScriptLexer.h"
+#include "CScriptJIT.h"
 
 using namespace Engine::Scripting::Symbols;
 using namespace Engine::Scripting::AST;
@@ -18,17 +19,24 @@ CScriptFunctionSymbol::CScriptFunctionSymbol(Engine::Scripting::AST::CScriptASTN
 	_token		= _astNode->GetToken();
 	Index		= 0;
 	Type		= AST::SCRIPT_FUNCTION_NORMAL;
+	NativeBinding	= -1;
+	CallCount	= 0;
+	Compiled	= NULL;
 }
 
 CScriptFunctionSymbol::CScriptFunctionSymbol(Engine::Scripting::CScriptToken token)
 {
-	_token = token;
+	_token		= token;
+	NativeBinding	= -1;
+	CallCount	= 0;
+	Compiled	= NULL;
 }
 
 
 CScriptFunctionSymbol::~CScriptFunctionSymbol()
 {
-
+	if (Compiled != NULL)
+		CScriptJIT::Free(Compiled);
 }
 
 ScriptSymbolTypes CScriptFunctionSymbol::GetType()
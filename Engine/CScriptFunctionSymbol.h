@@ -15,6 +15,8 @@ namespace Engine
 {
     namespace Scripting
     {
+		struct CScriptCompiledFunction;
+
 		namespace AST
 		{
 			class CScriptASTNode;
@@ -35,6 +37,18 @@ namespace Engine
 					u32						Index;
 					AST::ScriptFunctionType	Type;
 
+					// Index in the native binding table if the function is assigned a native
+					// that was resolved at compile time, otherwise -1. Calls to it are bound 
+					// directly to the native.
+					s32						NativeBinding;
+
+					// Native code for the function, once its been called enough to be compiled.
+					// Both are shared by every context running the function, possibly on other
+					// threads, so CallCount is only changed atomically and Compiled is published 
+					// and read through AtomicSwapPointer/AtomicLoadPointer.
+					s32							CallCount;
+					CScriptCompiledFunction*	Compiled;
+
 					CScriptFunctionSymbol					(Engine::Scripting::AST::CScriptASTNode* node);
 					CScriptFunctionSymbol					(CScriptToken token);
 					~CScriptFunctionSymbol					();
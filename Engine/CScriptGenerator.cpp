@@ -35,6 +35,32 @@ CScriptCompileContext* CScriptGenerator::GetContext()
 	return _context;
 }
 
+// Counts the instructions that load and store locals and globals.
+static void CountMemoryAccesses(Engine::Containers::CArray<CScriptInstruction*>& instructions, u32& loads, u32& stores)
+{
+	for (u32 i = 0; i < instructions.Size(); i++)
+	{
+		switch (instructions[i]->Opcode)
+		{
+			case SCRIPT_OPCODE_LLOCAL:
+			case SCRIPT_OPCODE_LGLOBAL:
+				loads++;
+				break;
+			case SCRIPT_OPCODE_SLOCAL:
+			case SCRIPT_OPCODE_SGLOBAL:
+			case SCRIPT_OPCODE_ADDSLOCAL:
+			case SCRIPT_OPCODE_SUBSLOCAL:
+				stores++;
+				break;
+			case SCRIPT_OPCODE_INCLOCAL:
+			case SCRIPT_OPCODE_DECLOCAL:
+				loads++;
+				stores++;
+				break;
+		}
+	}
+}
+
 bool CScriptGenerator::Analyze(CScriptCompileContext* context)
 {
 	_context = context;
@@ -71,6 +97,21 @@ bool CScriptGenerator::Analyze(CScriptCompileContext* context)
 		// Create our final symbol list.
 		GenerateSymbolList(_context->_astTree);
 
+		// Clean up the instruction list.
+		CScriptCompileStats& stats = _context->_stats;
+		stats.UnoptimizedLoads	= 0;
+		stats.UnoptimizedStores = 0;
+		CountMemoryAccesses(_context->_instructions, stats.UnoptimizedLoads, stats.UnoptimizedStores);
+
+		Optimize();
+
+		// Fuse common instruction sequences into superinstructions.
+		FuseSuperInstructions();
+
+		stats.Loads	 = 0;
+		stats.Stores = 0;
+		CountMemoryAccesses(_context->_instructions, stats.Loads, stats.Stores);
+
 		// Patch all references to instruction jump targets
 		// to actual instruction indexes.
 		//PatchJumpTargets();
@@ -110,6 +151,1160 @@ void CScriptGenerator::GenerateNonGlobalScope(CScriptASTNode* root)
 }
 
 
+// Returns true if the operand is the given register.
+static bool IsRegisterOperand(const CScriptOperand& op, u32 reg)
+{
+	return op.Type == SCRIPT_OPERAND_REGISTER && op.RegisterIndex == reg;
+}
+
+// Returns true if both operands refer to the same local/global index.
+static bool IsSameIndexOperand(const CScriptOperand& op1, const CScriptOperand& op2)
+{
+	return op1.Type == SCRIPT_OPERAND_LITERAL_INT && op2.Type == SCRIPT_OPERAND_LITERAL_INT && op1.IntLiteral == op2.IntLiteral;
+}
+
+// Returns true if the instruction is a jump whose only operand is its target.
+static bool IsJumpInstruction(CScriptInstruction* instr)
+{
+	switch (instr->Opcode)
+	{
+		case SCRIPT_OPCODE_JMP:
+		case SCRIPT_OPCODE_JEQ:
+		case SCRIPT_OPCODE_JL:
+		case SCRIPT_OPCODE_JG:
+		case SCRIPT_OPCODE_JLE:
+		case SCRIPT_OPCODE_JGE:
+		case SCRIPT_OPCODE_JNE:
+			return instr->OperandCount == 1 && instr->Operands[0].Type == SCRIPT_OPERAND_JUMP_TARGET;
+	}
+	return false;
+}
+
+// Returns true if the instruction only writes its first (register) operand, and 
+// dosen't read any other register.
+static bool IsRegisterLoadInstruction(CScriptInstruction* instr)
+{
+	switch (instr->Opcode)
+	{
+		case SCRIPT_OPCODE_LDI:
+		case SCRIPT_OPCODE_LDF:
+		case SCRIPT_OPCODE_LDS:
+		case SCRIPT_OPCODE_LDN:
+		case SCRIPT_OPCODE_LLOCAL:
+		case SCRIPT_OPCODE_LGLOBAL:
+		case SCRIPT_OPCODE_LFUNC:
+		case SCRIPT_OPCODE_MOV:
+			return instr->OperandCount >= 1 && instr->Operands[0].Type == SCRIPT_OPERAND_REGISTER;
+	}
+	return false;
+}
+
+// Returns true if the instruction writes to the register in its first operand.
+static bool WritesFirstOperand(CScriptInstruction* instr)
+{
+	if (instr->OperandCount < 1 || instr->Operands[0].Type != SCRIPT_OPERAND_REGISTER)
+		return false;
+
+	switch (instr->Opcode)
+	{
+		case SCRIPT_OPCODE_LDI:
+		case SCRIPT_OPCODE_LDF:
+		case SCRIPT_OPCODE_LDS:
+		case SCRIPT_OPCODE_LDN:
+		case SCRIPT_OPCODE_LLOCAL:
+		case SCRIPT_OPCODE_LGLOBAL:
+		case SCRIPT_OPCODE_LFUNC:
+		case SCRIPT_OPCODE_MOV:
+		case SCRIPT_OPCODE_ADD:
+		case SCRIPT_OPCODE_SUB:
+		case SCRIPT_OPCODE_MUL:
+		case SCRIPT_OPCODE_DIV:
+		case SCRIPT_OPCODE_INC:
+		case SCRIPT_OPCODE_DEC:
+		case SCRIPT_OPCODE_NEG:
+		case SCRIPT_OPCODE_ABS:
+		case SCRIPT_OPCODE_MOD:
+		case SCRIPT_OPCODE_BWOR:
+		case SCRIPT_OPCODE_BWXOR:
+		case SCRIPT_OPCODE_BWAND:
+		case SCRIPT_OPCODE_BWNOT:
+		case SCRIPT_OPCODE_BWSHL:
+		case SCRIPT_OPCODE_BWSHR:
+		case SCRIPT_OPCODE_IEQ:
+		case SCRIPT_OPCODE_IL:
+		case SCRIPT_OPCODE_IG:
+		case SCRIPT_OPCODE_ILE:
+		case SCRIPT_OPCODE_IGE:
+		case SCRIPT_OPCODE_INE:
+		case SCRIPT_OPCODE_LAND:
+		case SCRIPT_OPCODE_LOR:
+		case SCRIPT_OPCODE_LNOT:
+		case SCRIPT_OPCODE_IDX:
+		case SCRIPT_OPCODE_INDR:
+		case SCRIPT_OPCODE_GETNATIVE:
+		case SCRIPT_OPCODE_LDNATIVE:
+		case SCRIPT_OPCODE_DICTNEW:
+		case SCRIPT_OPCODE_LISTNEW:
+		case SCRIPT_OPCODE_ITERNEW:
+		case SCRIPT_OPCODE_ITERDONE:
+		case SCRIPT_OPCODE_ITERNEXT:
+		case SCRIPT_OPCODE_ISTYPE:
+		case SCRIPT_OPCODE_ASTYPE:
+		case SCRIPT_OPCODE_INCLOCAL:
+		case SCRIPT_OPCODE_DECLOCAL:
+		case SCRIPT_OPCODE_ADDSLOCAL:
+		case SCRIPT_OPCODE_SUBSLOCAL:
+			return true;
+	}
+	return false;
+}
+
+// Returns true if the instruction reads the register in its first operand. Anything
+// we don't know about is assumed to.
+static bool ReadsFirstOperand(CScriptInstruction* instr)
+{
+	if (instr->OperandCount < 1 || instr->Operands[0].Type != SCRIPT_OPERAND_REGISTER)
+		return false;
+
+	switch (instr->Opcode)
+	{
+		case SCRIPT_OPCODE_LDI:
+		case SCRIPT_OPCODE_LDF:
+		case SCRIPT_OPCODE_LDS:
+		case SCRIPT_OPCODE_LDN:
+		case SCRIPT_OPCODE_LLOCAL:
+		case SCRIPT_OPCODE_LGLOBAL:
+		case SCRIPT_OPCODE_LFUNC:
+		case SCRIPT_OPCODE_LDNATIVE:
+		case SCRIPT_OPCODE_MOV:
+		case SCRIPT_OPCODE_DICTNEW:
+		case SCRIPT_OPCODE_LISTNEW:
+		case SCRIPT_OPCODE_ITERNEW:
+		case SCRIPT_OPCODE_ITERDONE:
+		case SCRIPT_OPCODE_ITERNEXT:
+		case SCRIPT_OPCODE_INCLOCAL:
+		case SCRIPT_OPCODE_DECLOCAL:
+			return false;
+	}
+	return true;
+}
+
+// Returns a mask of the registers the instruction reads.
+static u32 GetRegisterUses(CScriptInstruction* instr)
+{
+	u32 uses = 0;
+	for (u32 i = 0; i < instr->OperandCount; i++)
+	{
+		if (instr->Operands[i].Type == SCRIPT_OPERAND_REGISTER && (i > 0 || ReadsFirstOperand(instr)))
+			uses |= (1 << instr->Operands[i].RegisterIndex);
+	}
+
+	switch (instr->Opcode)
+	{
+		case SCRIPT_OPCODE_JEQ:
+		case SCRIPT_OPCODE_JL:
+		case SCRIPT_OPCODE_JG:
+		case SCRIPT_OPCODE_JLE:
+		case SCRIPT_OPCODE_JGE:
+		case SCRIPT_OPCODE_JNE:
+			uses |= (1 << SCRIPT_CONST_REGISTER_CMP);
+			break;
+	}
+	return uses;
+}
+
+// Returns a mask of the registers the instruction always writes.
+static u32 GetRegisterDefs(CScriptInstruction* instr)
+{
+	u32 defs = 0;
+	if (WritesFirstOperand(instr))
+		defs |= (1 << instr->Operands[0].RegisterIndex);
+
+	switch (instr->Opcode)
+	{
+		case SCRIPT_OPCODE_CMP:
+		case SCRIPT_OPCODE_CMPII:
+		case SCRIPT_OPCODE_CMPFF:
+			defs |= (1 << SCRIPT_CONST_REGISTER_CMP);
+			break;
+		case SCRIPT_OPCODE_INVK:
+		case SCRIPT_OPCODE_INVKNATIVE:
+			defs |= (1 << SCRIPT_CONST_REGISTER_RETURN);
+			break;
+	}
+	return defs;
+}
+
+// Returns true if the instruction is a register to register move.
+static bool IsRegisterMove(CScriptInstruction* instr)
+{
+	return instr->Opcode == SCRIPT_OPCODE_MOV &&
+		   instr->OperandCount == 2 &&
+		   instr->Operands[0].Type == SCRIPT_OPERAND_REGISTER &&
+		   instr->Operands[1].Type == SCRIPT_OPERAND_REGISTER;
+}
+
+// Returns true if execution can't fall through to the next instruction, or may continue 
+// somewhere else.
+static bool EndsBasicBlock(CScriptInstruction* instr)
+{
+	if (instr->Opcode == SCRIPT_OPCODE_JMP || instr->Opcode == SCRIPT_OPCODE_RET)
+		return true;
+
+	for (u32 i = 0; i < instr->OperandCount; i++)
+	{
+		if (instr->Operands[i].Type == SCRIPT_OPERAND_JUMP_TARGET)
+			return true;
+	}
+	return false;
+}
+
+// Marks every instruction that can be entered from somewhere other than the instruction
+// before it; anything a jump references, function entry points and the start of the 
+// global scope. jumpTargets must be instruction count + 1 long.
+void CScriptGenerator::MarkJumpTargets(bool* jumpTargets)
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+	u32 count = instructions.Size();
+
+	for (u32 i = 0; i <= count; i++)
+	{
+		jumpTargets[i] = false;
+	}
+	jumpTargets[0] = true;
+
+	for (u32 i = 0; i < count; i++)
+	{
+		CScriptInstruction* instr = instructions[i];
+		for (u32 j = 0; j < instr->OperandCount; j++)
+		{
+			CScriptOperand& op = instr->Operands[j];
+			if (op.Type == SCRIPT_OPERAND_JUMP_TARGET)
+			{
+				u32 target = reinterpret_cast<CScriptJumpTargetSymbol*>(op.Symbol)->Index;
+				if (target <= count)
+					jumpTargets[target] = true;
+			}
+			else if (op.Type == SCRIPT_OPERAND_INSTRUCTION && op.InstructionIndex <= count)
+			{
+				jumpTargets[op.InstructionIndex] = true;
+			}
+		}
+	}
+
+	for (u32 i = 0; i < _context->_symbols.Size(); i++)
+	{
+		CScriptFunctionSymbol* func = dynamic_cast<CScriptFunctionSymbol*>(_context->_symbols[i]);
+		if (func != NULL && func->EntryPoint <= count)
+			jumpTargets[func->EntryPoint] = true;
+	}
+}
+
+// Frees and removes all instructions flagged in removed (which must be instruction count
+// + 1 long), then remaps jump targets, function entry points and instruction operands. 
+// Anything that referenced a removed instruction now references the next one kept.
+void CScriptGenerator::RemoveInstructions(bool* removed)
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+	u32 count = instructions.Size();
+
+	u32* remap = GetScriptAllocator()->AllocArray<u32>(count + 1);
+
+	Engine::Containers::CArray<CScriptInstruction*> kept;
+	for (u32 i = 0; i < count; i++)
+	{
+		remap[i] = kept.Size();
+		if (removed[i] == true)
+			GetScriptAllocator()->FreeObj(&instructions[i]);
+		else
+			kept.AddToEnd(instructions[i]);
+	}
+	remap[count] = kept.Size();
+
+	// Only need to remap things if we actually removed something.
+	if (kept.Size() != count)
+	{
+		instructions = kept;
+
+		// Remap jump targets and entry points.
+		for (u32 i = 0; i < _context->_symbols.Size(); i++)
+		{
+			CScriptJumpTargetSymbol* jumpTarget = dynamic_cast<CScriptJumpTargetSymbol*>(_context->_symbols[i]);
+			if (jumpTarget != NULL && jumpTarget->Index <= count)
+				jumpTarget->Index = remap[jumpTarget->Index];
+
+			CScriptFunctionSymbol* func = dynamic_cast<CScriptFunctionSymbol*>(_context->_symbols[i]);
+			if (func != NULL && func->EntryPoint <= count)
+				func->EntryPoint = remap[func->EntryPoint];
+		}
+
+		// Remap any direct instruction references.
+		for (u32 i = 0; i < instructions.Size(); i++)
+		{
+			CScriptInstruction* instr = instructions[i];
+			for (u32 j = 0; j < instr->OperandCount; j++)
+			{
+				if (instr->Operands[j].Type == SCRIPT_OPERAND_INSTRUCTION && instr->Operands[j].InstructionIndex <= count)
+					instr->Operands[j].InstructionIndex = remap[instr->Operands[j].InstructionIndex];
+			}
+		}
+	}
+
+	GetScriptAllocator()->FreeArray(&remap);
+}
+
+// Runs the optimization passes enabled by the contexts optimization level over the
+// instruction list. Constant folding is done earlier, while generating instructions 
+// from the AST.
+void CScriptGenerator::Optimize()
+{
+	ScriptOptimizationLevel level = _context->GetOptimizationLevel();
+	if (level >= SCRIPT_OPTIMIZATION_BASIC)
+	{
+		ThreadJumps();
+		RemoveDeadCode();
+	}
+	if (level >= SCRIPT_OPTIMIZATION_FULL)
+	{
+		PromoteLocals();
+		PropagateCopies();
+	}
+}
+
+// Retargets jumps that land on an unconditional jump to that jumps final destination, 
+// and removes jumps to the instruction directly after them. Loops and nested if/else 
+// blocks generate a lot of both.
+void CScriptGenerator::ThreadJumps()
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+	u32 count = instructions.Size();
+
+	bool* removed = GetScriptAllocator()->AllocArray<bool>(count + 1);
+	for (u32 i = 0; i <= count; i++)
+	{
+		removed[i] = false;
+	}
+
+	for (u32 i = 0; i < count; i++)
+	{
+		CScriptInstruction* instr = instructions[i];
+		if (!IsJumpInstruction(instr))
+			continue;
+
+		// Follow the chain, bounded so a jump cycle can't hang us.
+		CScriptJumpTargetSymbol* target = reinterpret_cast<CScriptJumpTargetSymbol*>(instr->Operands[0].Symbol);
+		for (u32 hops = 0; hops < count && target->Index < count; hops++)
+		{
+			CScriptInstruction* next = instructions[target->Index];
+			if (next->Opcode != SCRIPT_OPCODE_JMP || !IsJumpInstruction(next))
+				break;
+
+			CScriptJumpTargetSymbol* nextTarget = reinterpret_cast<CScriptJumpTargetSymbol*>(next->Operands[0].Symbol);
+			if (nextTarget == target)
+				break;
+
+			target = nextTarget;
+		}
+		instr->Operands[0].Symbol = target;
+
+		if (target->Index == i + 1)
+			removed[i] = true;
+	}
+
+	RemoveInstructions(removed);
+	GetScriptAllocator()->FreeArray(&removed);
+}
+
+// Removes instructions that can never be executed, ie. anything following an 
+// unconditional jump or return that nothing jumps to.
+void CScriptGenerator::RemoveDeadCode()
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+	u32 count = instructions.Size();
+
+	bool* jumpTargets = GetScriptAllocator()->AllocArray<bool>(count + 1);
+	bool* removed	  = GetScriptAllocator()->AllocArray<bool>(count + 1);
+	MarkJumpTargets(jumpTargets);
+
+	bool reachable = true;
+	for (u32 i = 0; i < count; i++)
+	{
+		if (jumpTargets[i] == true)
+			reachable = true;
+
+		removed[i] = !reachable;
+
+		if (instructions[i]->Opcode == SCRIPT_OPCODE_JMP ||
+			instructions[i]->Opcode == SCRIPT_OPCODE_RET)
+			reachable = false;
+	}
+	removed[count] = false;
+
+	RemoveInstructions(removed);
+
+	GetScriptAllocator()->FreeArray(&jumpTargets);
+	GetScriptAllocator()->FreeArray(&removed);
+}
+
+// Fills successors with the indexes of every instruction that can execute after the
+// given one, and returns how many there are. Indexes may be one past the end of the list.
+u32 CScriptGenerator::GetSuccessors(u32 index, u32* successors)
+{
+	CScriptInstruction* instr = _context->_instructions[index];
+	u32 count = 0;
+
+	if (instr->Opcode != SCRIPT_OPCODE_JMP && instr->Opcode != SCRIPT_OPCODE_RET)
+		successors[count++] = index + 1;
+
+	for (u32 i = 0; i < instr->OperandCount; i++)
+	{
+		if (instr->Operands[i].Type == SCRIPT_OPERAND_JUMP_TARGET)
+			successors[count++] = reinterpret_cast<CScriptJumpTargetSymbol*>(instr->Operands[i].Symbol)->Index;
+	}
+
+	return count;
+}
+
+// Works out which registers hold a value that may still be read after each instruction
+// executes. liveOut must be instruction count + 1 long, each entry is a mask of registers.
+void CScriptGenerator::ComputeLiveness(u32* liveOut)
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+	u32 count = instructions.Size();
+
+	u32* liveIn = GetScriptAllocator()->AllocArray<u32>(count + 1);
+	for (u32 i = 0; i <= count; i++)
+	{
+		liveIn[i]  = 0;
+		liveOut[i] = 0;
+	}
+
+	// Keep walking backwards until nothing changes. Only loops jump backwards so this 
+	// dosen't take many passes.
+	bool changed = true;
+	while (changed == true)
+	{
+		changed = false;
+		for (s32 i = (s32)count - 1; i >= 0; i--)
+		{
+			CScriptInstruction* instr = instructions[i];
+
+			u32 successors[SCRIPT_MAX_OPERAND_COUNT + 1];
+			u32 successorCount = GetSuccessors(i, successors);
+
+			u32 out = 0;
+			for (u32 j = 0; j < successorCount; j++)
+			{
+				if (successors[j] < count)
+					out |= liveIn[successors[j]];
+			}
+			u32 in = GetRegisterUses(instr) | (out & ~GetRegisterDefs(instr));
+
+			if (out != liveOut[i] || in != liveIn[i])
+			{
+				liveOut[i] = out;
+				liveIn[i]  = in;
+				changed	   = true;
+			}
+		}
+	}
+
+	GetScriptAllocator()->FreeArray(&liveIn);
+}
+
+// Returns true if the instruction is the given local load/store of a local.
+static bool IsLocalAccess(CScriptInstruction* instr, ScriptInstructionOpCodes opcode, u32 local)
+{
+	return instr->Opcode == opcode && instr->Operands[1].IntLiteral == local;
+}
+
+// Live range of a local variable that is being promoted to a register.
+struct CScriptLocalInterval
+{
+	u32		Local;
+	u32		Start;
+	u32		End;
+	u32		Register;
+};
+
+// Moves local variables into registers the functions temporaries don't use, turning their
+// loads and stores into register moves that copy propagation can then remove. Function 
+// bodies are generated back to back after the global scope, so each one runs from its
+// entry point up to the next.
+void CScriptGenerator::PromoteLocals()
+{
+	u32 count = _context->_instructions.Size();
+
+	Engine::Containers::CArray<CScriptFunctionSymbol*> functions;
+	for (u32 i = 0; i < _context->_symbols.Size(); i++)
+	{
+		CScriptFunctionSymbol* func = dynamic_cast<CScriptFunctionSymbol*>(_context->_symbols[i]);
+		if (func != NULL && func->EntryPoint > 0 && func->EntryPoint < count)
+			functions.AddToEnd(func);
+	}
+
+	// Sort by entry point.
+	for (u32 i = 1; i < functions.Size(); i++)
+	{
+		for (u32 j = i; j > 0 && functions[j - 1]->EntryPoint > functions[j]->EntryPoint; j--)
+		{
+			CScriptFunctionSymbol* swap = functions[j];
+			functions[j]	 = functions[j - 1];
+			functions[j - 1] = swap;
+		}
+	}
+
+	for (u32 i = 0; i < functions.Size(); i++)
+	{
+		// Don't know which symbol describes the body if two share it.
+		if ((i > 0 && functions[i - 1]->EntryPoint == functions[i]->EntryPoint) ||
+			(i + 1 < functions.Size() && functions[i + 1]->EntryPoint == functions[i]->EntryPoint))
+			continue;
+
+		u32 end = (i + 1 < functions.Size() ? functions[i + 1]->EntryPoint : count);
+		PromoteFunctionLocals(functions[i], functions[i]->EntryPoint, end);
+	}
+}
+
+// Assigns registers to the locals of the function between start and end with a linear 
+// scan over their live intervals, so locals that are never live at the same time can
+// share a register. Parameters are left in memory as they are passed in through the locals.
+void CScriptGenerator::PromoteFunctionLocals(CScriptFunctionSymbol* func, u32 start, u32 end)
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+	u32 localCount = func->LocalCount;
+
+	// A suspended generators registers are not seen by the garbage collector, so
+	// anything they reference has to stay in the locals.
+	if (func->Type == AST::SCRIPT_FUNCTION_GENERATOR || localCount <= func->ParameterCount)
+		return;
+
+	// Find the registers used by temporaries, and make sure the only thing touching the
+	// locals are plain loads and stores and nothing jumps outside the function.
+	u32 usedRegisters = 0;
+	for (u32 i = start; i < end; i++)
+	{
+		CScriptInstruction* instr = instructions[i];
+		for (u32 j = 0; j < instr->OperandCount; j++)
+		{
+			CScriptOperand& op = instr->Operands[j];
+			if (op.Type == SCRIPT_OPERAND_REGISTER)
+			{
+				usedRegisters |= (1 << op.RegisterIndex);
+			}
+			else if (op.Type == SCRIPT_OPERAND_JUMP_TARGET)
+			{
+				u32 target = reinterpret_cast<CScriptJumpTargetSymbol*>(op.Symbol)->Index;
+				if (target < start || target >= end)
+					return;
+			}
+			else if (op.Type == SCRIPT_OPERAND_INSTRUCTION)
+			{
+				return;
+			}
+		}
+
+		if ((instr->Opcode == SCRIPT_OPCODE_LLOCAL || instr->Opcode == SCRIPT_OPCODE_SLOCAL) &&
+			(instr->OperandCount != 2 ||
+			 instr->Operands[0].Type != SCRIPT_OPERAND_REGISTER ||
+			 instr->Operands[1].Type != SCRIPT_OPERAND_LITERAL_INT ||
+			 instr->Operands[1].IntLiteral >= localCount))
+			return;
+	}
+
+	// Build the live interval of each local.
+	Engine::Containers::CArray<CScriptLocalInterval> intervals;
+	for (u32 local = func->ParameterCount; local < localCount; local++)
+	{
+		CScriptLocalInterval interval;
+		interval.Local	  = local;
+		interval.Start	  = end;
+		interval.End	  = start;
+		interval.Register = 0;
+
+		for (u32 i = start; i < end; i++)
+		{
+			if (IsLocalAccess(instructions[i], SCRIPT_OPCODE_LLOCAL, local) ||
+				IsLocalAccess(instructions[i], SCRIPT_OPCODE_SLOCAL, local))
+			{
+				if (interval.Start == end)
+					interval.Start = i;
+				interval.End = i;
+			}
+		}
+
+		if (interval.Start == end)
+			continue;
+
+		// If the local can be read before it's assigned it has to hold null from the 
+		// start of the function, registers are nulled when the function is invoked.
+		if (MayReadUninitialized(start, end, local))
+			interval.Start = start;
+
+		intervals.AddToEnd(interval);
+	}
+
+	// Anything live inside a loop is live for the whole of it.
+	bool changed = true;
+	while (changed == true)
+	{
+		changed = false;
+		for (u32 i = start; i < end; i++)
+		{
+			CScriptInstruction* instr = instructions[i];
+			for (u32 j = 0; j < instr->OperandCount; j++)
+			{
+				if (instr->Operands[j].Type != SCRIPT_OPERAND_JUMP_TARGET)
+					continue;
+
+				u32 target = reinterpret_cast<CScriptJumpTargetSymbol*>(instr->Operands[j].Symbol)->Index;
+				if (target > i)
+					continue;
+
+				for (u32 k = 0; k < intervals.Size(); k++)
+				{
+					CScriptLocalInterval& interval = intervals[k];
+					if (interval.Start <= i && interval.End >= target &&
+						(interval.Start > target || interval.End < i))
+					{
+						interval.Start	= (interval.Start < target ? interval.Start : target);
+						interval.End	= (interval.End > i ? interval.End : i);
+						changed			= true;
+					}
+				}
+			}
+		}
+	}
+
+	// Sort by start.
+	for (u32 i = 1; i < intervals.Size(); i++)
+	{
+		for (u32 j = i; j > 0 && intervals[j - 1].Start > intervals[j].Start; j--)
+		{
+			CScriptLocalInterval swap = intervals[j];
+			intervals[j]	 = intervals[j - 1];
+			intervals[j - 1] = swap;
+		}
+	}
+
+	// Linear scan.
+	u32 freeRegisters = 0;
+	for (u32 i = SCRIPT_MIN_GEN_PURPOSE_REGISTER; i <= SCRIPT_MAX_GEN_PURPOSE_REGISTER; i++)
+	{
+		if ((usedRegisters & (1 << i)) == 0)
+			freeRegisters |= (1 << i);
+	}
+
+	Engine::Containers::CArray<u32> active;
+	for (u32 i = 0; i < intervals.Size(); i++)
+	{
+		CScriptLocalInterval& interval = intervals[i];
+
+		// Release the registers of anything that has ended.
+		for (u32 j = 0; j < active.Size(); )
+		{
+			if (intervals[active[j]].End < interval.Start)
+			{
+				freeRegisters |= (1 << intervals[active[j]].Register);
+				active.RemoveIndex(j);
+			}
+			else
+			{
+				j++;
+			}
+		}
+
+		if (freeRegisters != 0)
+		{
+			u32 reg = SCRIPT_MIN_GEN_PURPOSE_REGISTER;
+			while ((freeRegisters & (1 << reg)) == 0)
+				reg++;
+
+			freeRegisters &= ~(1 << reg);
+			interval.Register = reg;
+			active.AddToEnd(i);
+		}
+
+		// Out of registers, whichever local lives the longest stays in memory.
+		else if (active.Size() > 0)
+		{
+			u32 furthest = 0;
+			for (u32 j = 1; j < active.Size(); j++)
+			{
+				if (intervals[active[j]].End > intervals[active[furthest]].End)
+					furthest = j;
+			}
+
+			if (intervals[active[furthest]].End > interval.End)
+			{
+				interval.Register = intervals[active[furthest]].Register;
+				intervals[active[furthest]].Register = 0;
+				active.RemoveIndex(furthest);
+				active.AddToEnd(i);
+			}
+		}
+	}
+
+	// Rewrite loads and stores as moves.
+	//		loadlocal reg, index	->  mov reg, local_reg
+	//		storelocal reg, index	->  mov local_reg, reg
+	u32* localRegisters = GetScriptAllocator()->AllocArray<u32>(localCount);
+	for (u32 i = 0; i < localCount; i++)
+	{
+		localRegisters[i] = 0;
+	}
+	for (u32 i = 0; i < intervals.Size(); i++)
+	{
+		localRegisters[intervals[i].Local] = intervals[i].Register;
+	}
+
+	for (u32 i = start; i < end; i++)
+	{
+		CScriptInstruction* instr = instructions[i];
+		if (instr->Opcode != SCRIPT_OPCODE_LLOCAL && instr->Opcode != SCRIPT_OPCODE_SLOCAL)
+			continue;
+
+		u32 reg = localRegisters[instr->Operands[1].IntLiteral];
+		if (reg == 0)
+			continue;
+
+		if (instr->Opcode == SCRIPT_OPCODE_LLOCAL)
+		{
+			instr->Operands[1].Type			 = SCRIPT_OPERAND_REGISTER;
+			instr->Operands[1].RegisterIndex = reg;
+		}
+		else
+		{
+			instr->Operands[1]				 = instr->Operands[0];
+			instr->Operands[0].RegisterIndex = reg;
+		}
+		instr->Opcode = SCRIPT_OPCODE_MOV;
+	}
+
+	GetScriptAllocator()->FreeArray(&localRegisters);
+}
+
+// Returns true if there is any path through the function between start and end that 
+// loads the given local before storing to it.
+bool CScriptGenerator::MayReadUninitialized(u32 start, u32 end, u32 local)
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+
+	// Whether the local is always assigned by the time we reach each instruction.
+	bool* assigned = GetScriptAllocator()->AllocArray<bool>(end - start);
+	for (u32 i = start; i < end; i++)
+	{
+		assigned[i - start] = (i > start);
+	}
+
+	bool changed = true;
+	while (changed == true)
+	{
+		changed = false;
+		for (u32 i = start; i < end; i++)
+		{
+			if (assigned[i - start] == true || IsLocalAccess(instructions[i], SCRIPT_OPCODE_SLOCAL, local))
+				continue;
+
+			u32 successors[SCRIPT_MAX_OPERAND_COUNT + 1];
+			u32 successorCount = GetSuccessors(i, successors);
+			for (u32 j = 0; j < successorCount; j++)
+			{
+				if (successors[j] >= start && successors[j] < end && assigned[successors[j] - start] == true)
+				{
+					assigned[successors[j] - start] = false;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	bool result = false;
+	for (u32 i = start; i < end && result == false; i++)
+	{
+		if (IsLocalAccess(instructions[i], SCRIPT_OPCODE_LLOCAL, local) && assigned[i - start] == false)
+			result = true;
+	}
+
+	GetScriptAllocator()->FreeArray(&assigned);
+	return result;
+}
+
+// Removes redundant register moves and loads. Each pass works on its own view of the
+// instruction list, so they are repeated until nothing changes.
+void CScriptGenerator::PropagateCopies()
+{
+	for (u32 i = 0; i < SCRIPT_MAX_COPY_PROPAGATION_PASSES; i++)
+	{
+		bool changed = false;
+		if (RunCopyPass(&CScriptGenerator::ForwardCopies))		changed = true;
+		if (RunCopyPass(&CScriptGenerator::CoalesceCopies))		changed = true;
+		if (RunCopyPass(&CScriptGenerator::FoldCopies))			changed = true;
+		if (RunCopyPass(&CScriptGenerator::RemoveDeadLoads))	changed = true;
+
+		if (changed == false)
+			break;
+	}
+}
+
+// Runs a single copy propagation pass with up to date jump targets and liveness, then
+// removes any instructions it flagged.
+bool CScriptGenerator::RunCopyPass(CopyPass pass)
+{
+	u32 count = _context->_instructions.Size();
+
+	bool* jumpTargets = GetScriptAllocator()->AllocArray<bool>(count + 1);
+	bool* removed	  = GetScriptAllocator()->AllocArray<bool>(count + 1);
+	u32*  liveOut	  = GetScriptAllocator()->AllocArray<u32>(count + 1);
+	MarkJumpTargets(jumpTargets);
+	ComputeLiveness(liveOut);
+	for (u32 i = 0; i <= count; i++)
+	{
+		removed[i] = false;
+	}
+
+	bool changed = (this->*pass)(jumpTargets, liveOut, removed);
+	RemoveInstructions(removed);
+
+	GetScriptAllocator()->FreeArray(&jumpTargets);
+	GetScriptAllocator()->FreeArray(&removed);
+	GetScriptAllocator()->FreeArray(&liveOut);
+
+	return changed;
+}
+
+// Replaces reads of a moved register with the source register for as long as neither
+// is changed, which often leaves the move dead.
+//
+//		mov reg1, reg2 / push reg1				->  mov reg1, reg2 / push reg2
+bool CScriptGenerator::ForwardCopies(bool* jumpTargets, u32* liveOut, bool* removed)
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+	u32 count = instructions.Size();
+	bool changed = false;
+
+	for (u32 i = 0; i < count; i++)
+	{
+		CScriptInstruction* instr = instructions[i];
+		if (!IsRegisterMove(instr))
+			continue;
+
+		u32 dest = instr->Operands[0].RegisterIndex;
+		u32 src  = instr->Operands[1].RegisterIndex;
+		if (dest == src || dest < SCRIPT_MIN_GEN_PURPOSE_REGISTER)
+			continue;
+
+		for (u32 j = i + 1; j < count && jumpTargets[j] == false; j++)
+		{
+			CScriptInstruction* next = instructions[j];
+			for (u32 k = 0; k < next->OperandCount; k++)
+			{
+				if (IsRegisterOperand(next->Operands[k], dest) && (k > 0 || !WritesFirstOperand(next)))
+				{
+					next->Operands[k].RegisterIndex = src;
+					changed = true;
+				}
+			}
+
+			if ((GetRegisterDefs(next) & ((1 << dest) | (1 << src))) != 0 || EndsBasicBlock(next))
+				break;
+		}
+	}
+
+	return changed;
+}
+
+// Operates directly on a register that is copied out, modified and copied back.
+//
+//		mov reg1, reg2 / inc reg1 / mov reg2, reg1	->  inc reg2
+bool CScriptGenerator::CoalesceCopies(bool* jumpTargets, u32* liveOut, bool* removed)
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+	u32 count = instructions.Size();
+	bool changed = false;
+
+	for (u32 i = 0; i < count; i++)
+	{
+		CScriptInstruction* instr = instructions[i];
+		if (!IsRegisterMove(instr))
+			continue;
+
+		u32 temp = instr->Operands[0].RegisterIndex;
+		u32 var  = instr->Operands[1].RegisterIndex;
+		if (temp == var || temp < SCRIPT_MIN_GEN_PURPOSE_REGISTER || var < SCRIPT_MIN_GEN_PURPOSE_REGISTER)
+			continue;
+
+		// Find the move back, the original register can't be touched in between.
+		u32 end = 0;
+		for (u32 j = i + 1; j < count && jumpTargets[j] == false; j++)
+		{
+			CScriptInstruction* next = instructions[j];
+			if (IsRegisterMove(next) && 
+				next->Operands[0].RegisterIndex == var && 
+				next->Operands[1].RegisterIndex == temp)
+			{
+				end = j;
+				break;
+			}
+
+			if (((GetRegisterUses(next) | GetRegisterDefs(next)) & (1 << var)) != 0 || EndsBasicBlock(next))
+				break;
+		}
+
+		if (end == 0 || (liveOut[end] & (1 << temp)) != 0)
+			continue;
+
+		for (u32 j = i + 1; j < end; j++)
+		{
+			CScriptInstruction* next = instructions[j];
+			for (u32 k = 0; k < next->OperandCount; k++)
+			{
+				if (IsRegisterOperand(next->Operands[k], temp))
+					next->Operands[k].RegisterIndex = var;
+			}
+		}
+
+		removed[i]	 = true;
+		removed[end] = true;
+		changed		 = true;
+		i			 = end;
+	}
+
+	return changed;
+}
+
+// Folds moves into the instruction before them where possible.
+//
+//		mov reg1, reg1								->  <removed>
+//		ldi reg2, 1 / mov reg1, reg2				->  ldi reg1, 1
+//		mov reg1, reg2 / mov reg2, reg1				->  mov reg1, reg2
+//		storelocal reg, index / loadlocal reg, index ->  storelocal reg, index
+bool CScriptGenerator::FoldCopies(bool* jumpTargets, u32* liveOut, bool* removed)
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+	u32 count = instructions.Size();
+	bool changed = false;
+
+	for (u32 i = 0; i < count; i++)
+	{
+		CScriptInstruction* instr = instructions[i];
+
+		if (IsRegisterMove(instr) && instr->Operands[0].RegisterIndex == instr->Operands[1].RegisterIndex)
+		{
+			removed[i] = true;
+			changed	   = true;
+			continue;
+		}
+
+		// Everything else looks at the previous instruction, which we can only do if
+		// nothing jumps in between.
+		if (i == 0 || jumpTargets[i] == true || removed[i - 1] == true)
+			continue;
+
+		CScriptInstruction* prev = instructions[i - 1];
+		switch (instr->Opcode)
+		{
+			case SCRIPT_OPCODE_MOV:
+				{
+					if (!IsRegisterMove(instr))
+						break;
+
+					u32 dest = instr->Operands[0].RegisterIndex;
+					u32 src  = instr->Operands[1].RegisterIndex;
+
+					if (src >= SCRIPT_MIN_GEN_PURPOSE_REGISTER &&
+						(liveOut[i] & (1 << src)) == 0 &&
+						IsRegisterLoadInstruction(prev) &&
+						IsRegisterOperand(prev->Operands[0], src))
+					{
+						prev->Operands[0].RegisterIndex = dest;
+						removed[i] = true;
+						changed	   = true;
+					}
+					else if (IsRegisterMove(prev) &&
+							 IsRegisterOperand(prev->Operands[0], src) &&
+							 IsRegisterOperand(prev->Operands[1], dest))
+					{
+						removed[i] = true;
+						changed	   = true;
+					}
+					break;
+				}
+			case SCRIPT_OPCODE_LLOCAL:
+			case SCRIPT_OPCODE_LGLOBAL:
+				{
+					ScriptInstructionOpCodes store = (instr->Opcode == SCRIPT_OPCODE_LLOCAL ? SCRIPT_OPCODE_SLOCAL : SCRIPT_OPCODE_SGLOBAL);
+					if (prev->Opcode == store &&
+						IsRegisterOperand(prev->Operands[0], instr->Operands[0].RegisterIndex) &&
+						IsSameIndexOperand(prev->Operands[1], instr->Operands[1]))
+					{
+						removed[i] = true;
+						changed	   = true;
+					}
+					break;
+				}
+		}
+	}
+
+	return changed;
+}
+
+// Removes loads into registers that are never read.
+bool CScriptGenerator::RemoveDeadLoads(bool* jumpTargets, u32* liveOut, bool* removed)
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+	u32 count = instructions.Size();
+	bool changed = false;
+
+	for (u32 i = 0; i < count; i++)
+	{
+		CScriptInstruction* instr = instructions[i];
+		if (IsRegisterLoadInstruction(instr) &&
+			instr->Operands[0].RegisterIndex >= SCRIPT_MIN_GEN_PURPOSE_REGISTER &&
+			(liveOut[i] & (1 << instr->Operands[0].RegisterIndex)) == 0)
+		{
+			removed[i] = true;
+			changed	   = true;
+		}
+	}
+
+	return changed;
+}
+
+// Peephole pass that rewrites common instruction sequences into single fused 
+// instructions, which saves us a dispatch for each instruction removed. As this removes
+// instructions all jump targets and function entry points are remapped afterwards.
+void CScriptGenerator::FuseSuperInstructions()
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+	u32 count = instructions.Size();
+
+	// Mark all instructions something can jump to, we can't fuse a sequence
+	// if anything jumps into the middle of it.
+	bool* jumpTargets = GetScriptAllocator()->AllocArray<bool>(count + 1);
+	bool* removed	  = GetScriptAllocator()->AllocArray<bool>(count + 1);
+	MarkJumpTargets(jumpTargets);
+
+	// Fuse everything we can.
+	u32 index = 0;
+	while (index < count)
+	{
+		u32 length = FuseSequence(index, jumpTargets);
+		for (u32 i = 0; i < length; i++)
+		{
+			removed[index + i] = (i > 0);
+		}
+		index += length;
+	}
+	removed[count] = false;
+
+	RemoveInstructions(removed);
+
+	GetScriptAllocator()->FreeArray(&jumpTargets);
+	GetScriptAllocator()->FreeArray(&removed);
+}
+
+// Attempts to fuse the instruction sequence starting at the given index. If successful
+// the first instruction is rewritten as the fused instruction. Returns the number of
+// instructions the (possibly fused) instruction now covers.
+u32 CScriptGenerator::FuseSequence(u32 index, bool* jumpTargets)
+{
+	Engine::Containers::CArray<CScriptInstruction*>& instructions = _context->_instructions;
+
+	// How many instructions can we look at before we hit the end
+	// or something that is jumped to.
+	u32 available = 1;
+	while (index + available < instructions.Size() && jumpTargets[index + available] == false && available < 3)
+	{
+		available++;
+	}
+	if (available < 2)
+		return 1;
+
+	CScriptInstruction* a = instructions[index];
+	CScriptInstruction* b = instructions[index + 1];
+	CScriptInstruction* c = available >= 3 ? instructions[index + 2] : NULL;
+
+	switch (a->Opcode)
+	{
+		// ieq reg1, reg2 / cmp reg1, 0 / jeq address  ->  ieqjz reg1, reg2, address
+		case SCRIPT_OPCODE_IEQ:
+		case SCRIPT_OPCODE_IL:
+		case SCRIPT_OPCODE_IG:
+		case SCRIPT_OPCODE_ILE:
+		case SCRIPT_OPCODE_IGE:
+		case SCRIPT_OPCODE_INE:
+			{
+				if (c != NULL &&
+					b->Opcode == SCRIPT_OPCODE_CMP &&
+					IsRegisterOperand(b->Operands[0], a->Operands[0].RegisterIndex) &&
+					IsRegisterOperand(b->Operands[1], SCRIPT_CONST_REGISTER_ZERO) &&
+					c->Opcode == SCRIPT_OPCODE_JEQ)
+				{
+					switch (a->Opcode)
+					{
+						case SCRIPT_OPCODE_IEQ:	a->Opcode = SCRIPT_OPCODE_IEQJZ; break;
+						case SCRIPT_OPCODE_IL:	a->Opcode = SCRIPT_OPCODE_ILJZ;  break;
+						case SCRIPT_OPCODE_IG:	a->Opcode = SCRIPT_OPCODE_IGJZ;  break;
+						case SCRIPT_OPCODE_ILE:	a->Opcode = SCRIPT_OPCODE_ILEJZ; break;
+						case SCRIPT_OPCODE_IGE:	a->Opcode = SCRIPT_OPCODE_IGEJZ; break;
+						case SCRIPT_OPCODE_INE:	a->Opcode = SCRIPT_OPCODE_INEJZ; break;
+					}
+					a->Operands[2]	= c->Operands[0];
+					a->OperandCount = 3;
+					return 3;
+				}
+				break;
+			}
+
+		// cmp reg1, reg2 / jeq address  ->  cmpjeq reg1, reg2, address
+		case SCRIPT_OPCODE_CMP:
+			{
+				if (b->Opcode == SCRIPT_OPCODE_JEQ || b->Opcode == SCRIPT_OPCODE_JNE)
+				{
+					a->Opcode		= (b->Opcode == SCRIPT_OPCODE_JEQ ? SCRIPT_OPCODE_CMPJEQ : SCRIPT_OPCODE_CMPJNE);
+					a->Operands[2]	= b->Operands[0];
+					a->OperandCount = 3;
+					return 2;
+				}
+				break;
+			}
+
+		// loadlocal reg, index / inc reg / storelocal reg, index  ->  inclocal reg, index
+		case SCRIPT_OPCODE_LLOCAL:
+			{
+				if (c != NULL &&
+					(b->Opcode == SCRIPT_OPCODE_INC || b->Opcode == SCRIPT_OPCODE_DEC) &&
+					IsRegisterOperand(b->Operands[0], a->Operands[0].RegisterIndex) &&
+					c->Opcode == SCRIPT_OPCODE_SLOCAL &&
+					IsRegisterOperand(c->Operands[0], a->Operands[0].RegisterIndex) &&
+					IsSameIndexOperand(c->Operands[1], a->Operands[1]))
+				{
+					a->Opcode = (b->Opcode == SCRIPT_OPCODE_INC ? SCRIPT_OPCODE_INCLOCAL : SCRIPT_OPCODE_DECLOCAL);
+					return 3;
+				}
+				break;
+			}
+
+		// add dest, src / storelocal dest, index  ->  addslocal dest, src, index
+		case SCRIPT_OPCODE_ADD:
+		case SCRIPT_OPCODE_SUB:
+			{
+				if (b->Opcode == SCRIPT_OPCODE_SLOCAL &&
+					IsRegisterOperand(b->Operands[0], a->Operands[0].RegisterIndex))
+				{
+					a->Opcode		= (a->Opcode == SCRIPT_OPCODE_ADD ? SCRIPT_OPCODE_ADDSLOCAL : SCRIPT_OPCODE_SUBSLOCAL);
+					a->Operands[2]	= b->Operands[1];
+					a->OperandCount = 3;
+					return 2;
+				}
+				break;
+			}
+	}
+
+	return 1;
+}
+
 u32	CScriptGenerator::AllocateRegister(CScriptASTNode* node)
 {
 	for (u32 i = SCRIPT_MIN_GEN_PURPOSE_REGISTER; i <= SCRIPT_MAX_GEN_PURPOSE_REGISTER; i++)
@@ -140,8 +1335,9 @@ void CScriptGenerator::DeallocateRegister(CScriptASTNode* node, u32 idx)
 void CScriptGenerator::Disassemble()
 {
 	Engine::Containers::CArray<CScriptSymbol*> symbols = _context->_symbols;
+	Engine::Containers::CString& listing = _context->_disassembly;
 
-	printf("\nGlobal:\n");
+	listing = "\nGlobal:\n";
 	for (u32 i = 0; i < _context->_instructions.Size() + 1; i++)
 	{
 		// Any jump targets point here?
@@ -151,14 +1347,14 @@ void CScriptGenerator::Disassemble()
 			if (func != NULL)
 			{
 				if (func->EntryPoint == i && func->EntryPoint != 0)
-					printf("\n%s:\n", func->GetIdentifier().c_str());
+					listing += S("\n%s:\n").Format(func->GetIdentifier().c_str());
 			}
 
 			CScriptJumpTargetSymbol* jumpTarget = dynamic_cast<CScriptJumpTargetSymbol*>(symbols[j]);
 			if (jumpTarget != NULL)
 			{
 				if (jumpTarget->Index == i)
-					printf("jmp_%i:\n", j);
+					listing += S("jmp_%i:\n").Format(j);
 			}
 		}
 
@@ -189,7 +1385,8 @@ void CScriptGenerator::Disassemble()
 					str += (", ");
 			}
 
-			printf("%s\n", str.c_str());
+			listing += str;
+			listing += "\n";
 		}
 	}
 }
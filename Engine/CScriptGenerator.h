@@ -18,15 +18,26 @@ namespace Engine
 			class CScriptASTNode;
 		}
 
+		namespace Symbols
+		{
+			class CScriptFunctionSymbol;
+		}
+
 		class CScriptCompileContext;
 
+		// Maximum number of times the copy propagation passes are repeated. Each 
+		// repeat normally only picks up what the previous one exposed.
+		#define SCRIPT_MAX_COPY_PROPAGATION_PASSES	4
+
 		// The script generator is responsible for taking an AST representation of source
 		// code and turning it into symbols and byte code.
 		class CScriptGenerator
 		{
 			private:
 				CScriptCompileContext* _context;
-				bool				   _registersAllocated[SCRIPT_MAX_GEN_PURPOSE_REGISTER];
+				bool				   _registersAllocated[SCRIPT_TOTAL_REGISTERS];
+
+				typedef bool (CScriptGenerator::*CopyPass)(bool* jumpTargets, u32* liveOut, bool* removed);
 				
 			public:
 				CScriptGenerator				();
@@ -42,6 +53,29 @@ namespace Engine
 
 				void	GenerateSymbolList		(AST::CScriptASTNode* node);
 				void	GenerateNonGlobalScope	(AST::CScriptASTNode* root);
+
+				void	MarkJumpTargets			(bool* jumpTargets);
+				void	RemoveInstructions		(bool* removed);
+				u32		GetSuccessors			(u32 index, u32* successors);
+				void	ComputeLiveness			(u32* liveOut);
+
+				void	Optimize				();
+				void	ThreadJumps				();
+				void	RemoveDeadCode			();
+
+				void	PromoteLocals			();
+				void	PromoteFunctionLocals	(Symbols::CScriptFunctionSymbol* func, u32 start, u32 end);
+				bool	MayReadUninitialized	(u32 start, u32 end, u32 local);
+
+				void	PropagateCopies			();
+				bool	RunCopyPass				(CopyPass pass);
+				bool	ForwardCopies			(bool* jumpTargets, u32* liveOut, bool* removed);
+				bool	CoalesceCopies			(bool* jumpTargets, u32* liveOut, bool* removed);
+				bool	FoldCopies				(bool* jumpTargets, u32* liveOut, bool* removed);
+				bool	RemoveDeadLoads			(bool* jumpTargets, u32* liveOut, bool* removed);
+
+				void	FuseSuperInstructions	();
+				u32		FuseSequence			(u32 index, bool* jumpTargets);
 				
 				u32		AllocateRegister		(AST::CScriptASTNode* node);
 				u32		AllocateRegister		(AST::CScriptASTNode* node, u32 idx);
@@ -29,6 +29,8 @@ namespace Engine
 				#define X(v) SCRIPT_OPCODE_ ## v,
 				#include "opcodes.def"
 				#undef X
+
+				SCRIPT_OPCODE_COUNT
 			};
 			char const* const ScriptInstructionOpCodes_String[] = {
 				#define X(v) #v,
@@ -63,6 +65,13 @@ namespace Engine
 			#define SCRIPT_MIN_GEN_PURPOSE_REGISTER	4
 			#define SCRIPT_MAX_GEN_PURPOSE_REGISTER	31
 			#define	SCRIPT_TOTAL_REGISTERS			32
+
+			// INVKNATIVE packs the binding index and parameter count into its immediate. Calls 
+			// that don't fit are made with INVK instead.
+			#define SCRIPT_NATIVE_CALL_MAX						0xFFFF
+			#define SCRIPT_NATIVE_CALL_OPERAND(index, count)	(((count) << 16) | (index))
+			#define SCRIPT_NATIVE_CALL_INDEX(operand)			((operand) & 0xFFFF)
+			#define SCRIPT_NATIVE_CALL_PARAMETERS(operand)		(((u32)(operand)) >> 16)
 			
 			// Base class for operands assigned to an instruction.
 			struct CScriptOperand
@@ -103,6 +112,37 @@ namespace Engine
 					CScriptOperand				Operands[SCRIPT_MAX_OPERAND_COUNT];
 			};
 
+			// Compact fixed-width encoding of an instruction, this is what the virtual
+			// machine actually executes. Register operands are packed into A/B/C in
+			// the order they appear in the original instruction. The single literal,
+			// symbol or jump operand (if any) is stored in the immediate field. C shares
+			// storage with the immediate as no instruction uses both.
+			//
+			// Symbols are stored as an index into the compile contexts symbol table and
+			// jump targets as resolved instruction indexes.
+			struct CScriptPackedInstruction
+			{
+				u8		Opcode;
+				u8		OperandCount;
+				u8		A;
+				u8		B;
+				union
+				{
+					s32	IntLiteral;
+					f32	FloatLiteral;
+					u32	Index;
+					u32	C;
+				};
+			};
+
+			// Debug information for a packed instruction. Kept in a seperate table
+			// (indexed by PC) so it dosen't pollute the cache while executing.
+			struct CScriptInstructionDebugInfo
+			{
+				u32		Line;
+				u32		Column;
+			};
+
 		}
 	}
 }
\ No newline at end of file
@@ -12,6 +12,8 @@
 #include "CScriptVariableSymbol.h"
 #include "CScriptStringSymbol.h"
 #include "CScriptCompileContext.h"
+#include "CScriptLiteralASTNode.h"
+#include "CScriptVirtualMachine.h"
 
 using namespace Engine::Scripting;
 using namespace Engine::Scripting::AST;
@@ -43,8 +45,28 @@ void CScriptIntrinsicASTNode::GenerateSymbols(CScriptGenerator* gen)
 	CScriptASTNode::GenerateSymbols(gen);
 }
 
+s32 CScriptIntrinsicASTNode::GetNativeBinding()
+{
+	if (_token.ID != TOKEN_KEYWORD_NATIVE || 
+		dynamic_cast<CScriptLiteralASTNode*>(_children[0]) == NULL ||
+		_children[0]->GetToken().ID != TOKEN_LITERAL_STRING)
+		return -1;
+
+	return CScriptVirtualMachine::FindNativeBinding(_children[0]->GetToken().Literal);
+}
+
 u32 CScriptIntrinsicASTNode::GenerateInstructions(CScriptGenerator* gen)
 {
+	// Natives in the binding table are loaded by index rather than looked up by name.
+	s32 binding = GetNativeBinding();
+	if (binding >= 0)
+	{
+		u32 output_reg = gen->AllocateRegister(this);
+		CreateInstruction(gen, Instructions::SCRIPT_OPCODE_LDNATIVE, CreateRegisterOperand(output_reg), CreateIntOperand(binding));
+		gen->DeallocateRegister(this, output_reg);
+		return output_reg;
+	}
+
 	u32 output_reg = _children[0]->GenerateInstructions(gen);
 	gen->AllocateRegister(this, output_reg);
 	
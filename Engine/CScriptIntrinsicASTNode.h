@@ -36,6 +36,10 @@ namespace Engine
 					virtual void						 GenerateSymbols		(CScriptGenerator* gen);
 					virtual u32							 GenerateInstructions	(CScriptGenerator* gen);
 
+					// Index in the native binding table if this imports a native by a literal
+					// name that can be resolved at compile time, otherwise -1.
+					s32									 GetNativeBinding		();
+
 			};
 
 		}
@@ -8,6 +8,8 @@
 #include "CScriptStringObject.h"
 
 #include "CScriptVirtualMachine.h"
+#include "CScriptSnapshot.h"
+#include "CStream.h"
 
 using namespace Engine::Scripting;
 using namespace Engine::Scripting::Symbols;
@@ -33,6 +35,28 @@ void CScriptIteratorObject::Finalize(CScriptExecutionContext* context)
 		_obj->DecRef();
 }
 
+void CScriptIteratorObject::VisitReferences(CScriptExecutionContext* context, ScriptGCVisitor visitor)
+{
+	if (_obj != NULL)
+		visitor(context, _obj);
+}
+
+// Snapshots.
+void CScriptIteratorObject::WriteSnapshot(CScriptSnapshotWriter* writer)
+{
+	writer->WriteObject(_obj);
+	writer->GetStream()->WriteU32(_index);
+}
+
+void CScriptIteratorObject::ReadSnapshot(CScriptSnapshotReader* reader)
+{
+	_obj   = reader->ReadObject();
+	_index = reader->GetStream()->ReadU32();
+
+	if (_obj != NULL)
+		_obj->IncRef();
+}
+
 // Metadata.
 Engine::Containers::CString	CScriptIteratorObject::GetName()
 {
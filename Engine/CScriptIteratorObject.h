@@ -38,6 +38,11 @@ namespace Engine
 				// Metadata.
 				virtual Engine::Containers::CString		GetName			();
 				virtual void							Finalize		(CScriptExecutionContext* context);
+				virtual void							VisitReferences	(CScriptExecutionContext* context, ScriptGCVisitor visitor);
+
+				// Snapshots, derived iterators supply the type.
+				virtual void							WriteSnapshot	(CScriptSnapshotWriter* writer);
+				virtual void							ReadSnapshot	(CScriptSnapshotReader* reader);
 				
 				// Casting.
 				virtual bool							CoerceToString	(CScriptExecutionContext* context, Engine::Containers::CString& result);
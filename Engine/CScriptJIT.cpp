@@ -0,0 +1,805 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#include "CScriptJIT.h"
+#include "CScriptVirtualMachine.h"
+#include "CScriptFunctionSymbol.h"
+#include "CScriptManager.h"
+#include "CArray.h"
+
+#include <stddef.h>
+
+using namespace Engine::Scripting;
+using namespace Engine::Scripting::Symbols;
+using namespace Engine::Scripting::Instructions;
+
+#ifdef SCRIPT_VM_JIT
+
+// Signature of the entry point of compiled code. The address is the instruction to
+// start executing from.
+typedef u32 (*CScriptJITEntry)(CScriptJITFrame* frame, u8* address);
+
+// Registers by their encoding. EBX holds the frame, ESI the register file and EDI
+// the locals of the function being run, all three are callee saved in every calling
+// convention we care about.
+enum JITRegister
+{
+	JIT_EAX		= 0,
+	JIT_ECX		= 1,
+	JIT_EDX		= 2,
+	JIT_EBX		= 3,
+	JIT_ESI		= 6,
+	JIT_EDI		= 7,
+};
+
+// Condition codes (low nibble of the jcc/setcc opcodes).
+enum JITCondition
+{
+	JIT_CC_B		= 0x2,
+	JIT_CC_E		= 0x4,
+	JIT_CC_NE		= 0x5,
+	JIT_CC_L		= 0xC,
+	JIT_CC_GE		= 0xD,
+	JIT_CC_LE		= 0xE,
+	JIT_CC_G		= 0xF,
+	JIT_CC_ALWAYS	= 0x10,
+};
+
+// Integer and SSE opcodes used by the arithmetic templates,
+// two byte opcodes have their prefix in the high byte.
+#define JIT_OP_ADD		0x03
+#define JIT_OP_SUB		0x2B
+#define JIT_OP_IMUL		0x0FAF
+#define JIT_OP_MOVSS	0x10
+#define JIT_OP_MOVSS_ST	0x11
+#define JIT_OP_ADDSS	0x58
+#define JIT_OP_MULSS	0x59
+#define JIT_OP_SUBSS	0x5C
+#define JIT_OP_DIVSS	0x5E
+
+// A jump to an instruction thats not been emitted yet.
+struct CScriptJITFixup
+{
+	u32	Patch;
+	u32	Target;
+};
+
+// Returns true if the instruction has a jump target in its index.
+static bool HasJumpTarget(u8 opcode)
+{
+	switch (opcode)
+	{
+		case SCRIPT_OPCODE_JMP:
+		case SCRIPT_OPCODE_JEQ:
+		case SCRIPT_OPCODE_JL:
+		case SCRIPT_OPCODE_JG:
+		case SCRIPT_OPCODE_JLE:
+		case SCRIPT_OPCODE_JGE:
+		case SCRIPT_OPCODE_JNE:
+		case SCRIPT_OPCODE_CMPJEQ:
+		case SCRIPT_OPCODE_CMPJNE:
+		case SCRIPT_OPCODE_IEQJZ:
+		case SCRIPT_OPCODE_ILJZ:
+		case SCRIPT_OPCODE_IGJZ:
+		case SCRIPT_OPCODE_ILEJZ:
+		case SCRIPT_OPCODE_IGEJZ:
+		case SCRIPT_OPCODE_INEJZ:
+			return true;
+	}
+	return false;
+}
+
+// Returns the condition a comparison instruction tests its result against zero with.
+static JITCondition GetCondition(u8 opcode)
+{
+	switch (opcode)
+	{
+		case SCRIPT_OPCODE_JL:		case SCRIPT_OPCODE_IL:		case SCRIPT_OPCODE_ILJZ:	return JIT_CC_L;
+		case SCRIPT_OPCODE_JG:		case SCRIPT_OPCODE_IG:		case SCRIPT_OPCODE_IGJZ:	return JIT_CC_G;
+		case SCRIPT_OPCODE_JLE:		case SCRIPT_OPCODE_ILE:		case SCRIPT_OPCODE_ILEJZ:	return JIT_CC_LE;
+		case SCRIPT_OPCODE_JGE:		case SCRIPT_OPCODE_IGE:		case SCRIPT_OPCODE_IGEJZ:	return JIT_CC_GE;
+		case SCRIPT_OPCODE_JNE:		case SCRIPT_OPCODE_INE:		case SCRIPT_OPCODE_INEJZ:	return JIT_CC_NE;
+	}
+	return JIT_CC_E;
+}
+
+// Translates a single function to machine code.
+class CScriptJITCompiler
+{
+private:
+	Engine::Containers::CArray<u8>				_code;
+	Engine::Containers::CArray<CScriptJITFixup>	_fixups;
+
+	CScriptPackedInstruction*	_instructions;
+	void*						_step;
+	u32							_start;
+	u32							_end;
+	u32*						_offsets;
+	u32							_epilogue;
+
+	// Layout of a value, the union is pointer sized so this differs between 32 and 64 bit.
+	u32							_valueSize;
+	u32							_typeOffset;
+	u32							_dataOffset;
+
+	// Encoding.
+	u32		Offset				()							{ return _code.Size(); }
+	void	Byte				(u8 value)					{ _code.AddToEnd(value); }
+	void	Dword				(u32 value);
+	void	Pointer				(void* value);
+	void	Operand				(u32 reg, u32 base, u32 disp);
+
+	void	Load				(u32 reg, u32 base, u32 disp);
+	void	Store				(u32 base, u32 disp, u32 reg);
+	void	StoreImm			(u32 base, u32 disp, u32 value);
+	void	AddImm				(u32 base, u32 disp, u32 value);
+	void	CompareImm			(u32 base, u32 disp, u32 value);
+	void	Arith				(u32 op, u32 reg, u32 base, u32 disp);
+	void	FloatOp				(u32 op, u32 base, u32 disp);
+	void	LoadFramePointer	(u32 reg, u32 disp);
+
+	u32		Jump				(u32 cc);
+	void	Bind				(u32 patch);
+	void	JumpTo				(u32 cc, u32 offset);
+	void	JumpToInstruction	(u32 cc, u32 pc);
+
+	// Templates.
+	u32		TypeOf				(u32 index)					{ return index * _valueSize + _typeOffset; }
+	u32		DataOf				(u32 index)					{ return index * _valueSize + _dataOffset; }
+
+	u32		Guard				(u32 base, u32 index, ScriptValueType type, u32 cc);
+	void	Copy				(u32 dstBase, u32 dst, u32 srcBase, u32 src);
+	void	StoreCompareResult	();
+
+	void	EmitPrologue		();
+	void	EmitEpilogue		();
+	void	EmitExit			(u32 pc);
+	void	EmitStep			(u32 pc);
+	void	EmitBranch			(u32 cc, u32 pc, u32 target);
+	void	EmitArithmetic		(u32 pc, u32 intOp, u32 floatOp);
+	void	EmitInstruction		(u32 pc);
+
+public:
+	CScriptJITCompiler			(CScriptPackedInstruction* instructions, void* step);
+
+	CScriptCompiledFunction*	Compile	(CScriptFunctionSymbol* symbol, u32 count);
+
+};
+
+CScriptJITCompiler::CScriptJITCompiler(CScriptPackedInstruction* instructions, void* step)
+{
+	_instructions	= instructions;
+	_step			= step;
+	_start			= 0;
+	_end			= 0;
+	_offsets		= NULL;
+	_epilogue		= 0;
+
+	CScriptValue value;
+	_valueSize		= sizeof(CScriptValue);
+	_typeOffset		= (u32)((u8*)&value.Type	 - (u8*)&value);
+	_dataOffset		= (u32)((u8*)&value.IntValue - (u8*)&value);
+}
+
+void CScriptJITCompiler::Dword(u32 value)
+{
+	Byte((u8)(value));
+	Byte((u8)(value >> 8));
+	Byte((u8)(value >> 16));
+	Byte((u8)(value >> 24));
+}
+
+void CScriptJITCompiler::Pointer(void* value)
+{
+	u8* bytes = (u8*)&value;
+	for (u32 i = 0; i < sizeof(void*); i++)
+		Byte(bytes[i]);
+}
+
+// ModRM byte for [base + disp32].
+void CScriptJITCompiler::Operand(u32 reg, u32 base, u32 disp)
+{
+	Byte((u8)(0x80 | (reg << 3) | base));
+	Dword(disp);
+}
+
+void CScriptJITCompiler::Load(u32 reg, u32 base, u32 disp)
+{
+	Byte(0x8B);
+	Operand(reg, base, disp);
+}
+
+void CScriptJITCompiler::Store(u32 base, u32 disp, u32 reg)
+{
+	Byte(0x89);
+	Operand(reg, base, disp);
+}
+
+void CScriptJITCompiler::StoreImm(u32 base, u32 disp, u32 value)
+{
+	Byte(0xC7);
+	Operand(0, base, disp);
+	Dword(value);
+}
+
+void CScriptJITCompiler::AddImm(u32 base, u32 disp, u32 value)
+{
+	Byte(0x81);
+	Operand(0, base, disp);
+	Dword(value);
+}
+
+void CScriptJITCompiler::CompareImm(u32 base, u32 disp, u32 value)
+{
+	Byte(0x81);
+	Operand(7, base, disp);
+	Dword(value);
+}
+
+void CScriptJITCompiler::Arith(u32 op, u32 reg, u32 base, u32 disp)
+{
+	if (op > 0xFF)
+		Byte((u8)(op >> 8));
+	Byte((u8)op);
+	Operand(reg, base, disp);
+}
+
+// Scalar single precision op on xmm0.
+void CScriptJITCompiler::FloatOp(u32 op, u32 base, u32 disp)
+{
+	Byte(0xF3);
+	Byte(0x0F);
+	Byte((u8)op);
+	Operand(0, base, disp);
+}
+
+// Loads a pointer from the frame structure (pointed to by EBX).
+void CScriptJITCompiler::LoadFramePointer(u32 reg, u32 disp)
+{
+#ifdef ARCH_X64
+	Byte(0x48);
+#endif
+	Byte(0x8B);
+	Byte((u8)(0x40 | (reg << 3) | JIT_EBX));
+	Byte((u8)disp);
+}
+
+// Emits a jump with an unresolved target, returns the offset to patch.
+u32 CScriptJITCompiler::Jump(u32 cc)
+{
+	if (cc == JIT_CC_ALWAYS)
+	{
+		Byte(0xE9);
+	}
+	else
+	{
+		Byte(0x0F);
+		Byte((u8)(0x80 | cc));
+	}
+
+	u32 patch = Offset();
+	Dword(0);
+	return patch;
+}
+
+// Points a jump at the current offset.
+void CScriptJITCompiler::Bind(u32 patch)
+{
+	u32 rel = Offset() - (patch + 4);
+	_code[patch + 0] = (u8)(rel);
+	_code[patch + 1] = (u8)(rel >> 8);
+	_code[patch + 2] = (u8)(rel >> 16);
+	_code[patch + 3] = (u8)(rel >> 24);
+}
+
+void CScriptJITCompiler::JumpTo(u32 cc, u32 offset)
+{
+	u32 patch = Jump(cc);
+	u32 rel   = offset - (patch + 4);
+	_code[patch + 0] = (u8)(rel);
+	_code[patch + 1] = (u8)(rel >> 8);
+	_code[patch + 2] = (u8)(rel >> 16);
+	_code[patch + 3] = (u8)(rel >> 24);
+}
+
+void CScriptJITCompiler::JumpToInstruction(u32 cc, u32 pc)
+{
+	CScriptJITFixup fixup;
+	fixup.Patch  = Jump(cc);
+	fixup.Target = pc;
+	_fixups.AddToEnd(fixup);
+}
+
+// Compares the type of a register or local, returns a jump taken if the condition holds.
+u32 CScriptJITCompiler::Guard(u32 base, u32 index, ScriptValueType type, u32 cc)
+{
+	CompareImm(base, TypeOf(index), type);
+	return Jump(cc);
+}
+
+void CScriptJITCompiler::Copy(u32 dstBase, u32 dst, u32 srcBase, u32 src)
+{
+	for (u32 i = 0; i < _valueSize; i += 4)
+	{
+		Load(JIT_EAX, srcBase, src * _valueSize + i);
+		Store(dstBase, dst * _valueSize + i, JIT_EAX);
+	}
+}
+
+// Stores EAX as the result of a comparison.
+void CScriptJITCompiler::StoreCompareResult()
+{
+	Store(JIT_ESI, DataOf(SCRIPT_CONST_REGISTER_CMP), JIT_EAX);
+	StoreImm(JIT_ESI, TypeOf(SCRIPT_CONST_REGISTER_CMP), SCRIPT_VALUE_TYPE_INT);
+}
+
+void CScriptJITCompiler::EmitPrologue()
+{
+	Byte(0x53);												// push ebx
+	Byte(0x56);												// push esi
+	Byte(0x57);												// push edi
+#ifdef ARCH_X64
+	Byte(0x48); Byte(0x83); Byte(0xEC); Byte(0x20);			// sub rsp, 32 (shadow space for calls)
+	Byte(0x48); Byte(0x8B); Byte(0xD9);						// mov rbx, rcx
+#else
+	Byte(0x8B); Byte(0x5C); Byte(0x24); Byte(0x10);			// mov ebx, [esp + 16]
+#endif
+	LoadFramePointer(JIT_ESI, offsetof(CScriptJITFrame, Registers));
+	LoadFramePointer(JIT_EDI, offsetof(CScriptJITFrame, Locals));
+#ifndef ARCH_X64
+	Byte(0x8B); Byte(0x54); Byte(0x24); Byte(0x14);			// mov edx, [esp + 20]
+#endif
+	Byte(0xFF); Byte(0xE2);									// jmp edx
+}
+
+void CScriptJITCompiler::EmitEpilogue()
+{
+#ifdef ARCH_X64
+	Byte(0x48); Byte(0x83); Byte(0xC4); Byte(0x20);			// add rsp, 32
+#endif
+	Byte(0x5F);												// pop edi
+	Byte(0x5E);												// pop esi
+	Byte(0x5B);												// pop ebx
+	Byte(0xC3);												// ret
+}
+
+// Returns to the interpreter, which continues from the given instruction.
+void CScriptJITCompiler::EmitExit(u32 pc)
+{
+	Byte(0xB8);												// mov eax, pc
+	Dword(pc);
+	JumpTo(JIT_CC_ALWAYS, _epilogue);
+}
+
+// Has the interpreter execute the instruction, then continues from wherever it left the PC.
+void CScriptJITCompiler::EmitStep(u32 pc)
+{
+#ifdef ARCH_X64
+	Byte(0x48); Byte(0x8B); Byte(0xCB);						// mov rcx, rbx
+	Byte(0xBA); Dword(pc);									// mov edx, pc
+	Byte(0x48); Byte(0xB8); Pointer(_step);					// mov rax, step
+	Byte(0xFF); Byte(0xD0);									// call rax
+#else
+	Byte(0x68); Dword(pc);									// push pc
+	Byte(0x53);												// push ebx
+	Byte(0xB8); Pointer(_step);								// mov eax, step
+	Byte(0xFF); Byte(0xD0);									// call eax
+	Byte(0x83); Byte(0xC4); Byte(0x08);						// add esp, 8
+#endif
+
+	// The call stack may have been reallocated.
+	LoadFramePointer(JIT_ESI, offsetof(CScriptJITFrame, Registers));
+	LoadFramePointer(JIT_EDI, offsetof(CScriptJITFrame, Locals));
+
+	Byte(0x3D); Dword(pc + 1);								// cmp eax, pc + 1
+	JumpToInstruction(JIT_CC_E, pc + 1);
+
+	if (HasJumpTarget(_instructions[pc].Opcode))
+	{
+		Byte(0x3D); Dword(_instructions[pc].Index);			// cmp eax, target
+		EmitBranch(JIT_CC_E, pc, _instructions[pc].Index);
+	}
+
+	// Anywhere else (or SCRIPT_JIT_EXIT) is up to the interpreter.
+	JumpTo(JIT_CC_ALWAYS, _epilogue);
+}
+
+// Jumps to the target if the condition holds. Backwards jumps are loops, they are
+// counted against the budget so the interpreter still gets to timeslice.
+void CScriptJITCompiler::EmitBranch(u32 cc, u32 pc, u32 target)
+{
+	if (target > pc)
+	{
+		JumpToInstruction(cc, target);
+		return;
+	}
+
+	u32 skip = 0;
+	if (cc != JIT_CC_ALWAYS)
+		skip = Jump(cc ^ 1);
+
+	Byte(0x81); Byte(0x43); Byte(offsetof(CScriptJITFrame, Executed)); Dword(pc - target + 1);	// add [ebx + Executed], n
+	Byte(0x8B); Byte(0x43); Byte(offsetof(CScriptJITFrame, Executed));							// mov eax, [ebx + Executed]
+	Byte(0x3B); Byte(0x43); Byte(offsetof(CScriptJITFrame, Budget));							// cmp eax, [ebx + Budget]
+	JumpToInstruction(JIT_CC_B, target);
+	EmitExit(target);
+
+	if (cc != JIT_CC_ALWAYS)
+		Bind(skip);
+}
+
+// Arithmetic with an int fast path, a float fast path, or both.
+void CScriptJITCompiler::EmitArithmetic(u32 pc, u32 intOp, u32 floatOp)
+{
+	CScriptPackedInstruction* instr = &_instructions[pc];
+	u32 slow[4];
+	u32 slowCount = 0;
+
+	if (intOp != 0)
+	{
+		u32 notInt = Guard(JIT_ESI, instr->A, SCRIPT_VALUE_TYPE_INT, JIT_CC_NE);
+		slow[slowCount++] = Guard(JIT_ESI, instr->B, SCRIPT_VALUE_TYPE_INT, JIT_CC_NE);
+
+		Load(JIT_EAX, JIT_ESI, DataOf(instr->A));
+		Arith(intOp, JIT_EAX, JIT_ESI, DataOf(instr->B));
+		Store(JIT_ESI, DataOf(instr->A), JIT_EAX);
+		JumpToInstruction(JIT_CC_ALWAYS, pc + 1);
+
+		if (floatOp != 0)
+			Bind(notInt);
+		else
+			slow[slowCount++] = notInt;
+	}
+
+	if (floatOp != 0)
+	{
+		slow[slowCount++] = Guard(JIT_ESI, instr->A, SCRIPT_VALUE_TYPE_FLOAT, JIT_CC_NE);
+		slow[slowCount++] = Guard(JIT_ESI, instr->B, SCRIPT_VALUE_TYPE_FLOAT, JIT_CC_NE);
+
+		FloatOp(JIT_OP_MOVSS,	 JIT_ESI, DataOf(instr->A));
+		FloatOp(floatOp,		 JIT_ESI, DataOf(instr->B));
+		FloatOp(JIT_OP_MOVSS_ST, JIT_ESI, DataOf(instr->A));
+		JumpToInstruction(JIT_CC_ALWAYS, pc + 1);
+	}
+
+	for (u32 i = 0; i < slowCount; i++)
+		Bind(slow[i]);
+	EmitStep(pc);
+}
+
+void CScriptJITCompiler::EmitInstruction(u32 pc)
+{
+	CScriptPackedInstruction* instr = &_instructions[pc];
+	u32 slow[3];
+	u32 slowCount = 0;
+
+	switch (instr->Opcode)
+	{
+		// Anything that changes the call stack is left to the interpreter.
+		case SCRIPT_OPCODE_INVK:
+		case SCRIPT_OPCODE_RET:
+		case SCRIPT_OPCODE_YIELD:
+		case SCRIPT_OPCODE_SETSTATE:
+		case SCRIPT_OPCODE_ITERNEW:
+		case SCRIPT_OPCODE_ITERNEXT:
+			EmitExit(pc);
+			return;
+
+		// Load / Store
+		case SCRIPT_OPCODE_LDI:
+			StoreImm(JIT_ESI, TypeOf(instr->A), SCRIPT_VALUE_TYPE_INT);
+			StoreImm(JIT_ESI, DataOf(instr->A), instr->IntLiteral);
+			return;
+
+		case SCRIPT_OPCODE_LDF:
+			StoreImm(JIT_ESI, TypeOf(instr->A), SCRIPT_VALUE_TYPE_FLOAT);
+			StoreImm(JIT_ESI, DataOf(instr->A), instr->Index);
+			return;
+
+		case SCRIPT_OPCODE_LDN:
+			StoreImm(JIT_ESI, TypeOf(instr->A), SCRIPT_VALUE_TYPE_NULL);
+			return;
+
+		case SCRIPT_OPCODE_MOV:
+			Copy(JIT_ESI, instr->A, JIT_ESI, instr->B);
+			return;
+
+		case SCRIPT_OPCODE_LLOCAL:
+			Copy(JIT_ESI, instr->A, JIT_EDI, instr->IntLiteral);
+			return;
+
+		// Objects need reference counting.
+		case SCRIPT_OPCODE_SLOCAL:
+			slow[slowCount++] = Guard(JIT_ESI, instr->A,			SCRIPT_VALUE_TYPE_OBJECT, JIT_CC_E);
+			slow[slowCount++] = Guard(JIT_EDI, instr->IntLiteral,	SCRIPT_VALUE_TYPE_OBJECT, JIT_CC_E);
+			Copy(JIT_EDI, instr->IntLiteral, JIT_ESI, instr->A);
+			break;
+
+		// Arithmetic
+		case SCRIPT_OPCODE_ADD:		EmitArithmetic(pc, JIT_OP_ADD,  JIT_OP_ADDSS);	return;
+		case SCRIPT_OPCODE_ADDII:	EmitArithmetic(pc, JIT_OP_ADD,  0);				return;
+		case SCRIPT_OPCODE_ADDFF:	EmitArithmetic(pc, 0,			JIT_OP_ADDSS);	return;
+		case SCRIPT_OPCODE_SUB:		EmitArithmetic(pc, JIT_OP_SUB,  JIT_OP_SUBSS);	return;
+		case SCRIPT_OPCODE_SUBII:	EmitArithmetic(pc, JIT_OP_SUB,  0);				return;
+		case SCRIPT_OPCODE_SUBFF:	EmitArithmetic(pc, 0,			JIT_OP_SUBSS);	return;
+		case SCRIPT_OPCODE_MUL:		EmitArithmetic(pc, JIT_OP_IMUL, JIT_OP_MULSS);	return;
+		case SCRIPT_OPCODE_MULII:	EmitArithmetic(pc, JIT_OP_IMUL, 0);				return;
+		case SCRIPT_OPCODE_MULFF:	EmitArithmetic(pc, 0,			JIT_OP_MULSS);	return;
+
+		// Integer division is left to the interpreter.
+		case SCRIPT_OPCODE_DIV:
+		case SCRIPT_OPCODE_DIVFF:	EmitArithmetic(pc, 0,			JIT_OP_DIVSS);	return;
+
+		case SCRIPT_OPCODE_INC:
+		case SCRIPT_OPCODE_DEC:
+			slow[slowCount++] = Guard(JIT_ESI, instr->A, SCRIPT_VALUE_TYPE_INT, JIT_CC_NE);
+			AddImm(JIT_ESI, DataOf(instr->A), instr->Opcode == SCRIPT_OPCODE_INC ? 1 : (u32)-1);
+			break;
+
+		case SCRIPT_OPCODE_INCLOCAL:
+		case SCRIPT_OPCODE_DECLOCAL:
+			slow[slowCount++] = Guard(JIT_EDI, instr->IntLiteral, SCRIPT_VALUE_TYPE_INT, JIT_CC_NE);
+			Load(JIT_EAX, JIT_EDI, DataOf(instr->IntLiteral));
+			Byte(0x05); Dword(instr->Opcode == SCRIPT_OPCODE_INCLOCAL ? 1 : (u32)-1);	// add eax, 1
+			Store(JIT_EDI, DataOf(instr->IntLiteral), JIT_EAX);
+			Store(JIT_ESI, DataOf(instr->A), JIT_EAX);
+			StoreImm(JIT_ESI, TypeOf(instr->A), SCRIPT_VALUE_TYPE_INT);
+			break;
+
+		case SCRIPT_OPCODE_ADDSLOCAL:
+		case SCRIPT_OPCODE_SUBSLOCAL:
+			slow[slowCount++] = Guard(JIT_ESI, instr->A,			SCRIPT_VALUE_TYPE_INT,	  JIT_CC_NE);
+			slow[slowCount++] = Guard(JIT_ESI, instr->B,			SCRIPT_VALUE_TYPE_INT,	  JIT_CC_NE);
+			slow[slowCount++] = Guard(JIT_EDI, instr->IntLiteral,	SCRIPT_VALUE_TYPE_OBJECT, JIT_CC_E);
+			Load(JIT_EAX, JIT_ESI, DataOf(instr->A));
+			Arith(instr->Opcode == SCRIPT_OPCODE_ADDSLOCAL ? JIT_OP_ADD : JIT_OP_SUB, JIT_EAX, JIT_ESI, DataOf(instr->B));
+			Store(JIT_ESI, DataOf(instr->A), JIT_EAX);
+			Store(JIT_EDI, DataOf(instr->IntLiteral), JIT_EAX);
+			StoreImm(JIT_EDI, TypeOf(instr->IntLiteral), SCRIPT_VALUE_TYPE_INT);
+			break;
+
+		// Comparison
+		case SCRIPT_OPCODE_CMP:
+		case SCRIPT_OPCODE_CMPII:
+		case SCRIPT_OPCODE_CMPJEQ:
+		case SCRIPT_OPCODE_CMPJNE:
+			slow[slowCount++] = Guard(JIT_ESI, instr->A, SCRIPT_VALUE_TYPE_INT, JIT_CC_NE);
+			slow[slowCount++] = Guard(JIT_ESI, instr->B, SCRIPT_VALUE_TYPE_INT, JIT_CC_NE);
+			Load(JIT_EAX, JIT_ESI, DataOf(instr->A));
+			Arith(JIT_OP_SUB, JIT_EAX, JIT_ESI, DataOf(instr->B));
+			StoreCompareResult();
+
+			if (instr->Opcode == SCRIPT_OPCODE_CMPJEQ || instr->Opcode == SCRIPT_OPCODE_CMPJNE)
+			{
+				Byte(0x85); Byte(0xC0);													// test eax, eax
+				EmitBranch(instr->Opcode == SCRIPT_OPCODE_CMPJEQ ? JIT_CC_E : JIT_CC_NE, pc, instr->Index);
+			}
+			break;
+
+		case SCRIPT_OPCODE_CMPFF:
+			slow[slowCount++] = Guard(JIT_ESI, instr->A, SCRIPT_VALUE_TYPE_FLOAT, JIT_CC_NE);
+			slow[slowCount++] = Guard(JIT_ESI, instr->B, SCRIPT_VALUE_TYPE_FLOAT, JIT_CC_NE);
+			FloatOp(JIT_OP_MOVSS, JIT_ESI, DataOf(instr->A));
+			FloatOp(JIT_OP_SUBSS, JIT_ESI, DataOf(instr->B));
+			Byte(0xF3); Byte(0x0F); Byte(0x2C); Byte(0xC0);							// cvttss2si eax, xmm0
+			StoreCompareResult();
+			break;
+
+		case SCRIPT_OPCODE_IEQ:
+		case SCRIPT_OPCODE_IL:
+		case SCRIPT_OPCODE_IG:
+		case SCRIPT_OPCODE_ILE:
+		case SCRIPT_OPCODE_IGE:
+		case SCRIPT_OPCODE_INE:
+		case SCRIPT_OPCODE_IEQJZ:
+		case SCRIPT_OPCODE_ILJZ:
+		case SCRIPT_OPCODE_IGJZ:
+		case SCRIPT_OPCODE_ILEJZ:
+		case SCRIPT_OPCODE_IGEJZ:
+		case SCRIPT_OPCODE_INEJZ:
+			slow[slowCount++] = Guard(JIT_ESI, instr->A, SCRIPT_VALUE_TYPE_INT, JIT_CC_NE);
+			slow[slowCount++] = Guard(JIT_ESI, instr->B, SCRIPT_VALUE_TYPE_INT, JIT_CC_NE);
+			Load(JIT_EAX, JIT_ESI, DataOf(instr->A));
+			Arith(JIT_OP_SUB, JIT_EAX, JIT_ESI, DataOf(instr->B));
+			Byte(0x85); Byte(0xC0);														// test eax, eax
+			Byte(0x0F); Byte((u8)(0x90 | GetCondition(instr->Opcode))); Byte(0xC0);	// setcc al
+			Byte(0x0F); Byte(0xB6); Byte(0xC0);											// movzx eax, al
+			Store(JIT_ESI, DataOf(instr->A), JIT_EAX);
+
+			if (HasJumpTarget(instr->Opcode))
+			{
+				StoreCompareResult();
+				Byte(0x85); Byte(0xC0);													// test eax, eax
+				EmitBranch(JIT_CC_E, pc, instr->Index);
+			}
+			break;
+
+		// Branching
+		case SCRIPT_OPCODE_JMP:
+			EmitBranch(JIT_CC_ALWAYS, pc, instr->Index);
+			return;
+
+		case SCRIPT_OPCODE_JEQ:
+		case SCRIPT_OPCODE_JL:
+		case SCRIPT_OPCODE_JG:
+		case SCRIPT_OPCODE_JLE:
+		case SCRIPT_OPCODE_JGE:
+		case SCRIPT_OPCODE_JNE:
+			CompareImm(JIT_ESI, DataOf(SCRIPT_CONST_REGISTER_CMP), 0);
+			EmitBranch(GetCondition(instr->Opcode), pc, instr->Index);
+			return;
+
+		// Everything else is run by the interpreter.
+		default:
+			EmitStep(pc);
+			return;
+	}
+
+	// Fast path falls through to the next instruction, the guards to the interpreter.
+	JumpToInstruction(JIT_CC_ALWAYS, pc + 1);
+
+	for (u32 i = 0; i < slowCount; i++)
+		Bind(slow[i]);
+	EmitStep(pc);
+}
+
+CScriptCompiledFunction* CScriptJITCompiler::Compile(CScriptFunctionSymbol* symbol, u32 count)
+{
+	// Functions aren't stored with their extent, so follow the control flow from the
+	// entry point to find it.
+	_start = symbol->EntryPoint;
+	_end   = _start;
+
+	bool* reachable = GetScriptAllocator()->AllocArray<bool>(count);
+	for (u32 i = 0; i < count; i++)
+		reachable[i] = false;
+
+	Engine::Containers::CArray<u32> pending;
+	pending.AddToEnd(_start);
+
+	while (pending.Size() > 0)
+	{
+		u32 pc = pending[pending.Size() - 1];
+		pending.RemoveFromEnd();
+
+		if (pc >= count || reachable[pc] == true)
+			continue;
+
+		reachable[pc] = true;
+		if (pc + 1 > _end)
+			_end = pc + 1;
+
+		u8 opcode = _instructions[pc].Opcode;
+		if (HasJumpTarget(opcode))
+			pending.AddToEnd(_instructions[pc].Index);
+		if (opcode != SCRIPT_OPCODE_JMP && opcode != SCRIPT_OPCODE_RET && opcode != SCRIPT_OPCODE_YIELD)
+			pending.AddToEnd(pc + 1);
+	}
+
+	GetScriptAllocator()->FreeArray(&reachable);
+
+	if (_end <= _start)
+		return NULL;
+
+	// Emit the code, with an extra entry at the end for falling off the function.
+	_offsets = GetScriptAllocator()->AllocArray<u32>(_end - _start + 1);
+	for (u32 i = 0; i <= _end - _start; i++)
+		_offsets[i] = SCRIPT_JIT_EXIT;
+
+	EmitPrologue();
+	_epilogue = Offset();
+	EmitEpilogue();
+
+	for (u32 pc = _start; pc < _end; pc++)
+	{
+		_offsets[pc - _start] = Offset();
+		EmitInstruction(pc);
+	}
+
+	_offsets[_end - _start] = Offset();
+	EmitExit(_end);
+
+	// Resolve jumps between instructions. Anything jumping outside the function or to an
+	// instruction that wasn't emitted is left to the interpreter.
+	for (u32 i = 0; i < _fixups.Size(); i++)
+	{
+		CScriptJITFixup& fixup = _fixups[i];
+		if (fixup.Target < _start || fixup.Target >= _end || _offsets[fixup.Target - _start] == SCRIPT_JIT_EXIT)
+		{
+			GetScriptAllocator()->FreeArray(&_offsets);
+			return NULL;
+		}
+
+		u32 rel = _offsets[fixup.Target - _start] - (fixup.Patch + 4);
+		_code[fixup.Patch + 0] = (u8)(rel);
+		_code[fixup.Patch + 1] = (u8)(rel >> 8);
+		_code[fixup.Patch + 2] = (u8)(rel >> 16);
+		_code[fixup.Patch + 3] = (u8)(rel >> 24);
+	}
+
+	// Copy it somewhere we can run it.
+	u8* code = (u8*)Engine::Platform::MemoryAllocExecutable(_code.Size());
+	if (code == NULL)
+	{
+		GetScriptAllocator()->FreeArray(&_offsets);
+		return NULL;
+	}
+
+	for (u32 i = 0; i < _code.Size(); i++)
+		code[i] = _code[i];
+
+	if (!Engine::Platform::MemoryProtectExecutable(code, _code.Size()))
+	{
+		Engine::Platform::MemoryFreeExecutable(code);
+		GetScriptAllocator()->FreeArray(&_offsets);
+		return NULL;
+	}
+
+	CScriptCompiledFunction* function = GetScriptAllocator()->NewObj<CScriptCompiledFunction>();
+	function->Code		= code;
+	function->CodeSize	= _code.Size();
+	function->Start		= _start;
+	function->End		= _end;
+	function->Offsets	= _offsets;
+
+	return function;
+}
+
+#endif
+
+bool CScriptJIT::Compile(Symbols::CScriptFunctionSymbol* symbol, Instructions::CScriptPackedInstruction* instructions, u32 count)
+{
+#ifdef SCRIPT_VM_JIT
+	_mutex.Lock();
+
+	// Another context may have got here first. Compiled is only written with the 
+	// mutex held so there's no need for an atomic read here.
+	if (symbol->Compiled != NULL)
+	{
+		_mutex.Unlock();
+		return true;
+	}
+
+	CScriptJITCompiler compiler(instructions, (void*)&CScriptJIT::Step);
+	CScriptCompiledFunction* function = compiler.Compile(symbol, count);
+
+	// Publish it to contexts running on other threads.
+	if (function != NULL)
+		Engine::Platform::AtomicSwapPointer((void**)&symbol->Compiled, function);
+
+	_mutex.Unlock();
+
+	return function != NULL;
+#else
+	return false;
+#endif
+}
+
+u32 CScriptJIT::Run(CScriptCompiledFunction* function, CScriptJITFrame* frame, u32 pc)
+{
+#ifdef SCRIPT_VM_JIT
+	if (pc < function->Start || pc >= function->End)
+		return pc;
+
+	CScriptJITEntry entry = (CScriptJITEntry)function->Code;
+	return entry(frame, function->Code + function->Offsets[pc - function->Start]);
+#else
+	return pc;
+#endif
+}
+
+void CScriptJIT::Free(CScriptCompiledFunction* function)
+{
+#ifdef SCRIPT_VM_JIT
+	Engine::Platform::MemoryFreeExecutable(function->Code);
+	GetScriptAllocator()->FreeArray(&function->Offsets);
+	GetScriptAllocator()->FreeObj(&function);
+#endif
+}
+
+// Called by compiled code to have the interpreter execute a single instruction.
+u32 CScriptJIT::Step(CScriptJITFrame* frame, u32 pc)
+{
+	return frame->Context->StepCompiledCode(frame, pc);
+}
@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Conditionals.h"
+#include "Platform.h"
+#include "CMutex.h"
+
+#include "CScriptInstruction.h"
+
+// Compile hot script functions to native code. The code generator emits x86 machine
+// code (the same templates work in 32 and 64 bit mode) so this is only available on
+// the windows builds, everywhere else functions are always interpreted.
+#if defined(OS_WIN) && (defined(ARCH_X86) || defined(ARCH_X64))
+	#define SCRIPT_VM_JIT
+#endif
+
+// Number of calls a function has to receive before it is compiled.
+#define SCRIPT_JIT_CALL_THRESHOLD	64
+
+// Returned by compiled code when the frame it was running is no longer the
+// current one (it was popped or something was called on top of it).
+#define SCRIPT_JIT_EXIT				0xFFFFFFFF
+
+namespace Engine
+{
+    namespace Scripting
+    {
+		namespace Symbols
+		{
+			class CScriptFunctionSymbol;
+		}
+
+		class CScriptValue;
+		class CScriptExecutionContext;
+
+		// State shared between compiled code and the runtime. Compiled code keeps a
+		// pointer to this in a register and only touches the frame through it, so it
+		// can be reloaded after anything that may have moved the call stack.
+		struct CScriptJITFrame
+		{
+			CScriptExecutionContext*	Context;
+			CScriptValue*				Registers;
+			CScriptValue*				Locals;
+			u32							Depth;		// Call stack depth of the frame being run.
+			u32							Executed;	// Approximate instructions executed.
+			u32							Budget;		// Loops exit to the interpreter once this is used up.
+		};
+
+		// Native code generated for a single function. Every instruction in the
+		// function has an entry point, so it can be entered at any PC.
+		struct CScriptCompiledFunction
+		{
+			u8*		Code;
+			u32		CodeSize;
+			u32		Start;
+			u32		End;
+			u32*	Offsets;
+		};
+
+		// Baseline template compiler. Each instruction is translated on its own to a
+		// fixed sequence of machine code; numeric instructions get an inline fast path
+		// guarded by type checks, anything else (or a failed guard) calls back into
+		// the interpreter to execute that single instruction. Instructions that change
+		// the call stack (calls, returns, yields, ...) exit back to the interpreter.
+		class CScriptJIT
+		{
+		private:
+			Engine::Threading::CMutex	_mutex;
+
+			static u32				Step			(CScriptJITFrame* frame, u32 pc);
+
+		public:
+
+			// Compiles the function, returns false if it couldn't be.
+			bool					Compile			(Symbols::CScriptFunctionSymbol* symbol, Instructions::CScriptPackedInstruction* instructions, u32 count);
+
+			// Runs compiled code from the given PC. Returns the PC the interpreter should
+			// continue from, or SCRIPT_JIT_EXIT.
+			static u32				Run				(CScriptCompiledFunction* function, CScriptJITFrame* frame, u32 pc);
+
+			static void				Free			(CScriptCompiledFunction* function);
+
+		};
+
+	}
+}
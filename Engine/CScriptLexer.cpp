@@ -115,6 +115,54 @@ TokenKeywordTableEntry Engine::Scripting::TokenKeywordTable[] = {
 	TokenKeywordTableEntry(NULL,			(TokenID)0)
 };
 
+u32 Engine::Scripting::TokenKeywordHashSeed = SCRIPT_KEYWORD_HASH_BASIS;
+u8  Engine::Scripting::TokenKeywordHashTable[SCRIPT_KEYWORD_HASH_SIZE];
+u8  Engine::Scripting::TokenKeywordLengthTable[sizeof(TokenKeywordTable) / sizeof(TokenKeywordTableEntry)];
+
+// Slot an identifier hash maps to. The hash itself is a seeded FNV-1a of the
+// lower case identifier, which the lexer builds as it reads.
+inline u32 KeywordHashSlot(u32 hash)
+{
+	return (hash ^ (hash >> 16)) & SCRIPT_KEYWORD_HASH_MASK;
+}
+
+void Engine::Scripting::InitScriptKeywordTable()
+{
+	u32 keywordCount = 0;
+	while (TokenKeywordTable[keywordCount].Identifier != NULL)
+	{
+		TokenKeywordLengthTable[keywordCount] = (u8)strlen(TokenKeywordTable[keywordCount].Identifier);
+		keywordCount++;
+	}
+
+	// Keep trying seeds until we get one with no collisions. With the table
+	// a good deal larger than the keyword count this only takes a few tries.
+	for (u32 seed = SCRIPT_KEYWORD_HASH_BASIS; ; seed++)
+	{
+		bool collision = false;
+		memset(TokenKeywordHashTable, 0, sizeof(TokenKeywordHashTable));
+
+		for (u32 i = 0; i < keywordCount && collision == false; i++)
+		{
+			u32 hash = seed;
+			for (u8* c = TokenKeywordTable[i].Identifier; *c != '\0'; c++)
+				hash = (hash ^ (u8)*c) * SCRIPT_KEYWORD_HASH_PRIME;
+
+			u32 slot = KeywordHashSlot(hash);
+			if (TokenKeywordHashTable[slot] != 0)
+				collision = true;
+			else
+				TokenKeywordHashTable[slot] = (u8)(i + 1);
+		}
+
+		if (collision == false)
+		{
+			TokenKeywordHashSeed = seed;
+			break;
+		}
+	}
+}
+
 CScriptLexer::CScriptLexer()
 {
 }
@@ -126,6 +174,8 @@ CScriptLexer::~CScriptLexer()
 bool CScriptLexer::Analyze(CScriptCompileContext* context)
 {
 	_context = context;
+	_source = context->_rawSource.c_str();
+	_sourceLength = context->_rawSource.Length();
 	_position = 0;
 	_line = 1;
 	_column = 0;
@@ -514,7 +564,7 @@ void CScriptLexer::Error(const Engine::Containers::CString& str)
 //
 bool CScriptLexer::ReadNumber(u8 startChar, CScriptToken& token)
 {
-	Engine::Containers::CString lit			= "";
+	u32							length		= 0;
 	TokenID						id			= TOKEN_LITERAL_INT;
 	bool						isHex		= false;
 	bool						isFloat		= false;
@@ -534,7 +584,7 @@ bool CScriptLexer::ReadNumber(u8 startChar, CScriptToken& token)
 		if ((chr == 'x' || chr == 'X') && offset == 1 && startChar == '0')
 		{
 			isHex	 = true;		
-			lit		+= chr;
+			length++;
 		}
 		
 		// Floating point radix.
@@ -542,7 +592,7 @@ bool CScriptLexer::ReadNumber(u8 startChar, CScriptToken& token)
 		{
 			isFloat		 = true;			
 			foundRadix	 = true;
-			lit			+= chr;
+			length++;
 			id			= TOKEN_LITERAL_FLOAT;
 		}	
 
@@ -552,26 +602,26 @@ bool CScriptLexer::ReadNumber(u8 startChar, CScriptToken& token)
 			isFloat		 = true;			
 			foundExp 	 = true;
 			expPosition  = offset;
-			lit			+= chr;
+			length++;
 		}	
 
 		// Unary +/-
 		else if ((chr == '-' || chr == '+') && (offset == 0 || (foundExp == true && expPosition == offset - 1)))
 		{
-			lit	+= chr;
+			length++;
 		}		
 
 		// Hex digit.
 		else if (((chr >= 'A' && chr <= 'F') || (chr >= 'a' && chr <= 'f')) && isHex == true)
 		{
-			lit += chr;
+			length++;
 			numberCount++;
 		}
 
 		// Standard digit.
 		else if (chr >= '0' && chr <= '9')
 		{
-			lit += chr;
+			length++;
 			numberCount++;
 		}
 
@@ -585,6 +635,9 @@ bool CScriptLexer::ReadNumber(u8 startChar, CScriptToken& token)
 		chr = NextChar();
 	}
 
+	// Everything we accepted is contiguous in the source, so take it in one go.
+	Engine::Containers::CString lit(_source + _tokenStart, length);
+
 	// . - +
 	// Parse sepcial unary operators.
 	if (lit == ".")
@@ -627,7 +680,8 @@ bool CScriptLexer::ReadNumber(u8 startChar, CScriptToken& token)
 
 bool CScriptLexer::ReadIdentifier(u8 startChar, CScriptToken& token)
 {
-	Engine::Containers::CString lit			= "";
+	u32							length		= 0;
+	u32							hash		= TokenKeywordHashSeed;
 	TokenID						id			= TOKEN_LITERAL_IDENTIFIER;
 
 	StartToken();
@@ -636,13 +690,14 @@ bool CScriptLexer::ReadIdentifier(u8 startChar, CScriptToken& token)
 
 	while (!EndOfFile())
 	{
-		// Hex prefix 0X or 0x
 		if ((chr >= 'A' && chr <= 'Z') ||
 			(chr >= 'a' && chr <= 'z') ||
 			(chr >= '0' && chr <= '9') ||
 			chr == '_')
 		{
-			lit += chr;
+			// Hash the lower case form as we go for the keyword lookup.
+			hash = (hash ^ (u8)tolower(chr)) * SCRIPT_KEYWORD_HASH_PRIME;
+			length++;
 		}
 		else
 		{
@@ -653,34 +708,49 @@ bool CScriptLexer::ReadIdentifier(u8 startChar, CScriptToken& token)
 	}
 
 	// Convert to keywords.
-	u32 index = 0;
-	Engine::Containers::CString lower = lit.ToLower();
-	while (TokenKeywordTable[index].Identifier != NULL)
-	{
-		if (strcmp(lower.c_str(), TokenKeywordTable[index].Identifier) == 0)
-		{
-			id = TokenKeywordTable[index++].ID;
-			break;
-		}
-		index++;
-	}
+	const u8* start = _source + _tokenStart;
+	TokenID keyword = LookupKeyword(start, length, hash);
+	if (keyword != TOKEN_OP_EOF)
+		id = keyword;
 
 	// Convert true/false/null to integer tokens.
 	if (id == TOKEN_LITERAL_TRUE)
 	{
-		lit = "1";
-		id = TOKEN_LITERAL_INT;
+		token = MakeToken(TOKEN_LITERAL_INT, "1");
 	}
 	else if (id == TOKEN_LITERAL_FALSE)
 	{
-		lit = "0";
-		id = TOKEN_LITERAL_INT;
+		token = MakeToken(TOKEN_LITERAL_INT, "0");
+	}
+	else
+	{
+		token = MakeToken(id, Engine::Containers::CString(start, length));
 	}
 
-	token = MakeToken(id, lit);
 	return true;
 }
 
+// Returns the keyword the given identifier represents, or TOKEN_OP_EOF if it isn't one.
+TokenID CScriptLexer::LookupKeyword(const u8* str, u32 length, u32 hash)
+{
+	u8 index = TokenKeywordHashTable[KeywordHashSlot(hash)];
+	if (index == 0)
+		return TOKEN_OP_EOF;
+
+	// Perfect hash, so there is only ever one candidate to compare against.
+	TokenKeywordTableEntry& entry = TokenKeywordTable[index - 1];
+	if (TokenKeywordLengthTable[index - 1] != length)
+		return TOKEN_OP_EOF;
+
+	for (u32 i = 0; i < length; i++)
+	{
+		if ((u8)tolower(str[i]) != (u8)entry.Identifier[i])
+			return TOKEN_OP_EOF;
+	}
+
+	return entry.ID;
+}
+
 void CScriptLexer::StartToken()
 {
 	_tokenStart       = _position - 1;
@@ -695,12 +765,14 @@ CScriptToken CScriptLexer::MakeToken(TokenID id, const Engine::Containers::CStri
 	tok.Literal = str;
 	tok.Line	= _tokenStartLine;
 	tok.Column	= _tokenStartColumn;
+	tok.Offset	= _tokenStart;
+	tok.Length	= (_position - 1) - _tokenStart;
 	return tok;
 }
 
 bool CScriptLexer::EndOfFile(u32 offset)
 {
-	return _position + offset >= _context->_rawSource.Length();
+	return _position + offset >= _sourceLength;
 }
 
 u8 CScriptLexer::NextChar()
@@ -708,7 +780,7 @@ u8 CScriptLexer::NextChar()
 	if (EndOfFile())
 		return '\0';
 
-	u8 c = _context->_rawSource[_position];
+	u8 c = _source[_position];
 	_position++;
 
 	_column++;
@@ -723,12 +795,12 @@ u8 CScriptLexer::NextChar()
 
 u8 CScriptLexer::CurrentChar()
 {
-	return _context->_rawSource[_position - 1];
+	return _source[_position - 1];
 }
 
 u8 CScriptLexer::PreviousChar()
 {
-	return _context->_rawSource[_position - 2];
+	return _source[_position - 2];
 }
 
 u8 CScriptLexer::LookAheadChar(u32 offset)
@@ -736,7 +808,7 @@ u8 CScriptLexer::LookAheadChar(u32 offset)
 	if (EndOfFile(offset))
 		return '\0';
 
-	u8 c = _context->_rawSource[_position + offset];
+	u8 c = _source[_position + offset];
 
 	return c;
 }
@@ -205,6 +205,19 @@ namespace Engine
 
 		extern TokenKeywordTableEntry TokenKeywordTable[];
 
+		// Keywords are looked up through a perfect hash of the (lower case) identifier, 
+		// the seed is searched for at startup so no two keywords share a slot. Each slot
+		// holds an index into TokenKeywordTable plus one, or 0 if empty.
+		#define SCRIPT_KEYWORD_HASH_SIZE		1024
+		#define SCRIPT_KEYWORD_HASH_MASK		(SCRIPT_KEYWORD_HASH_SIZE - 1)
+		#define SCRIPT_KEYWORD_HASH_BASIS		2166136261
+		#define SCRIPT_KEYWORD_HASH_PRIME		16777619
+
+		extern u32 TokenKeywordHashSeed;
+		extern u8  TokenKeywordHashTable[SCRIPT_KEYWORD_HASH_SIZE];
+		extern u8  TokenKeywordLengthTable[];
+		void InitScriptKeywordTable();
+
 		// Stores a tokenized segment of the script.
 		struct CScriptToken
 		{
@@ -213,9 +226,14 @@ namespace Engine
 			u32							Line;
 			u32							Column;
 
+			// Slice of the raw source the token was read from.
+			u32							Offset;
+			u32							Length;
+
 			CScriptToken()
 			{
-
+				Offset	= 0;
+				Length	= 0;
 			}
 			CScriptToken(TokenID id, const Engine::Containers::CString& lit, u32 line=0, u32 column=0)
 			{
@@ -223,6 +241,8 @@ namespace Engine
 				Literal = lit;
 				Line	= line;
 				Column	= column;
+				Offset	= 0;
+				Length	= 0;
 			}
 		};
 
@@ -232,6 +252,8 @@ namespace Engine
 		{
 			private:
 				CScriptCompileContext* _context;
+				const u8*			   _source;
+				u32					   _sourceLength;
 				s32					   _position;
 
 				s32					   _line;
@@ -260,6 +282,8 @@ namespace Engine
 				bool			ReadNumber		(u8 startChar, CScriptToken& token);
 				bool			ReadIdentifier	(u8 startChar, CScriptToken& token);
 
+				static TokenID	LookupKeyword	(const u8* str, u32 length, u32 hash);
+
 				bool			Analyze			(CScriptCompileContext* context);
 
 		};
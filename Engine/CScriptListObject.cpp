@@ -8,11 +8,17 @@
 #include "CScriptStringObject.h"
 
 #include "CScriptVirtualMachine.h"
+#include "CScriptSnapshot.h"
+#include "CStream.h"
 
 using namespace Engine::Scripting;
 using namespace Engine::Scripting::Symbols;
 using namespace Engine::Scripting::Objects;
 
+CScriptListIteratorObject::CScriptListIteratorObject(CScriptExecutionContext* context)
+{
+}
+
 CScriptListIteratorObject::CScriptListIteratorObject(CScriptExecutionContext* context, CScriptObject* obj)
 {
 	_index = 0;
@@ -20,6 +26,11 @@ CScriptListIteratorObject::CScriptListIteratorObject(CScriptExecutionContext* co
 	_obj->IncRef();
 }
 
+ScriptSnapshotObjectType CScriptListIteratorObject::GetSnapshotType()
+{
+	return SCRIPT_SNAPSHOT_OBJECT_LIST_ITERATOR;
+}
+
 bool CScriptListIteratorObject::IsFinished(CScriptExecutionContext* context)
 {
 	CScriptListObject* obj = reinterpret_cast<CScriptListObject*>(_obj);
@@ -51,6 +62,16 @@ void CScriptListObject::Finalize(CScriptExecutionContext* context)
 	_finalized = true;
 }
 
+void CScriptListObject::VisitReferences(CScriptExecutionContext* context, ScriptGCVisitor visitor)
+{
+	for (u32 i = 0; i < _array.Size(); i++)
+	{
+		CScriptValue& val = _array[i];
+		if (val.Type == SCRIPT_VALUE_TYPE_OBJECT && val.Object != NULL)
+			visitor(context, val.Object);
+	}
+}
+
 // Metadata.
 Engine::Containers::CString	CScriptListObject::GetName()
 {
@@ -63,6 +84,26 @@ Engine::Containers::CArray<CScriptValue>& CScriptListObject::GetArray()
 	return _array;
 }
 
+// Snapshots.
+ScriptSnapshotObjectType CScriptListObject::GetSnapshotType()
+{
+	return SCRIPT_SNAPSHOT_OBJECT_LIST;
+}
+
+void CScriptListObject::WriteSnapshot(CScriptSnapshotWriter* writer)
+{
+	writer->GetStream()->WriteU32(_array.Size());
+	for (u32 i = 0; i < _array.Size(); i++)
+		writer->WriteValue(_array[i]);
+}
+
+void CScriptListObject::ReadSnapshot(CScriptSnapshotReader* reader)
+{
+	u32 count = reader->GetStream()->ReadU32();
+	for (u32 i = 0; i < count && reader->Failed() == false; i++)
+		AddItem(reader->GetContext(), reader->ReadValue());
+}
+
 void CScriptListObject::AddItem(CScriptExecutionContext* context, const CScriptValue& val)
 {
 	CScriptValue value = val;
@@ -76,7 +117,7 @@ void CScriptListObject::AddItem(CScriptExecutionContext* context, const CScriptV
 // Iteration.
 CScriptIteratorObject* CScriptListObject::CreateIterator(CScriptExecutionContext* context)
 {
-	CScriptListIteratorObject* iter = Engine::Scripting::GetScriptAllocator()->NewObj<CScriptListIteratorObject>(context, this);
+	CScriptListIteratorObject* iter = context->NewObject<CScriptListIteratorObject>(this);
 	context->GCAdd(iter);
 
 	return iter;
@@ -28,8 +28,11 @@ namespace Engine
 			class CScriptListIteratorObject : public CScriptIteratorObject
 			{
 			public:
+				CScriptListIteratorObject							(CScriptExecutionContext* context);
 				CScriptListIteratorObject							(CScriptExecutionContext* context, CScriptObject* obj);
 
+				virtual ScriptSnapshotObjectType	GetSnapshotType	();
+
 				virtual bool			IsFinished					(CScriptExecutionContext* context);
 				virtual CScriptValue	NextValue					(CScriptExecutionContext* context);
 			};
@@ -48,6 +51,12 @@ namespace Engine
 				virtual Engine::Containers::CString			GetName		();
 
 				virtual void Finalize									(CScriptExecutionContext* context);
+				virtual void VisitReferences							(CScriptExecutionContext* context, ScriptGCVisitor visitor);
+
+				// Snapshots.
+				virtual ScriptSnapshotObjectType	GetSnapshotType	();
+				virtual void						WriteSnapshot	(CScriptSnapshotWriter* writer);
+				virtual void						ReadSnapshot	(CScriptSnapshotReader* reader);
 
 				// Array related stuff.
 				Engine::Containers::CArray<CScriptValue>&	GetArray	();
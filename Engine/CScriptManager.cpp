@@ -8,7 +8,9 @@
 #include "CScriptParser.h"
 #include "CScriptGenerator.h"
 #include "CScriptVirtualMachine.h"
+#include "CScriptCompileTaskJob.h"
 #include "CFileSystem.h"
+#include "CTaskManager.h"
 
 using namespace Engine::Scripting;
 
@@ -29,6 +31,9 @@ void Engine::Scripting::FreeScriptAllocator()
 CScriptManager::CScriptManager(Engine::FileSystem::CFileSystem* fileSystem)
 {
 	_fileSystem = fileSystem;
+	_compileCacheEnabled = true;
+	_optimizationLevel = SCRIPT_OPTIMIZATION_FULL;
+	_taskManager = NULL;
 
 	_vm = GetScriptAllocator()->NewObj<CScriptVirtualMachine>();
 	_vm->LoadNativeLibrary();
@@ -45,6 +50,7 @@ CScriptManager::~CScriptManager()
 	}
 
 	// Destroy all compile contexts we are holding.
+	_compileCache.Clear();
 	for (u32 i = 0; i < _compileContexts.Size(); i++)
 	{
 		CScriptCompileContext* context = _compileContexts[i];
@@ -66,15 +72,136 @@ void CScriptManager::Run(f32 timeslice)
 	_vm->Run(timeslice);
 }
 
-CScriptCompileContext* CScriptManager::CompileString(const Engine::Containers::CString& source, const Engine::Containers::CString& file)
+void CScriptManager::SetTaskManager(Engine::Core::Tasks::CTaskManager* manager)
+{
+	_taskManager = manager;
+	_vm->SetTaskManager(manager);
+}
+
+void CScriptManager::SetParallel(bool parallel)
+{
+	_vm->SetParallel(parallel);
+}
+
+// 64bit FNV-1a over the source and file name. The file name is included as it's
+// stored in (and reported by) the compiled output, the optimization level as it 
+// changes the instructions generated and the native binding table as natives are
+// referenced by their index in it.
+u64 CScriptManager::HashSource(const Engine::Containers::CString& source, const Engine::Containers::CString& file, ScriptOptimizationLevel level)
+{
+	u64 hash = 14695981039346656037ULL;
+
+	const u8* data = source.c_str();
+	for (u32 i = 0; i < source.Length(); i++)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	data = file.c_str();
+	for (u32 i = 0; i < file.Length(); i++)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	hash ^= (u8)level;
+	hash *= 1099511628211ULL;
+
+	hash ^= CScriptVirtualMachine::GetNativeBindingHash();
+	hash *= 1099511628211ULL;
+
+	return hash;
+}
+
+Engine::Containers::CString CScriptManager::GetCachePath(u64 hash)
+{
+	return S(SCRIPT_COMPILE_CACHE_FOLDER "/%08x%08x.compiled").Format((u32)(hash >> 32), (u32)(hash & 0xFFFFFFFF));
+}
+
+// Attempts to load pre-compiled output for the given source from the save folder. 
+// Returns NULL if there is no cached output or it dosen't match the source.
+CScriptCompileContext* CScriptManager::LoadCached(const Engine::Containers::CString& source, const Engine::Containers::CString& file, u64 hash)
+{
+	Engine::FileSystem::Streams::CStream* s = _fileSystem->CreateSaveReadStream(GetCachePath(hash));
+	if (s == NULL)
+		return NULL;
+
+	CScriptCompileContext* context = NULL;
+	if (s->Open())
+	{
+		// Cache header, guards against hash collisions and partially written files.
+		if (s->ReadU32() == SCRIPT_COMPILE_CACHE_SIGNATURE &&
+			s->ReadU64() == hash &&
+			s->ReadU32() == source.Length())
+		{
+			context = GetScriptAllocator()->NewObj<CScriptCompileContext>(source, file);
+			if (!context->Load(s))
+				GetScriptAllocator()->FreeObj(&context);
+		}
+		s->Close();
+	}
+	
+	_fileSystem->DestroyStream(s);
+	return context;
+}
+
+void CScriptManager::SaveCached(CScriptCompileContext* context, u64 hash, u32 length)
+{
+	Engine::FileSystem::Streams::CStream* s = _fileSystem->CreateWriteStream(GetCachePath(hash));
+	if (s == NULL)
+		return;
+
+	if (s->Open())
+	{
+		s->WriteU32(SCRIPT_COMPILE_CACHE_SIGNATURE);
+		s->WriteU64(hash);
+		s->WriteU32(length);
+		context->Save(s);
+		s->Close();
+	}
+	
+	_fileSystem->DestroyStream(s);
+}
+
+// Looks for compiled output for the given source, first in memory then on disk.
+CScriptCompileContext* CScriptManager::FindCached(const Engine::Containers::CString& source, const Engine::Containers::CString& file, u64 hash)
+{
+	// Already compiled this source?
+	for (u32 i = 0; i < _compileCache.Size(); i++)
+	{
+		CScriptCompileCacheEntry& entry = _compileCache[i];
+		if (entry.Hash == hash && entry.Length == source.Length() && entry.File == file)
+			return entry.Context;
+	}
+
+	// Compiled in a previous run?
+	CScriptCompileContext* cached = LoadCached(source, file, hash);
+	if (cached != NULL)
+	{
+		_compileContexts.AddToEnd(cached);
+		AddCached(cached, source, file, hash);
+	}
+
+	return cached;
+}
+
+void CScriptManager::AddCached(CScriptCompileContext* context, const Engine::Containers::CString& source, const Engine::Containers::CString& file, u64 hash)
+{
+	CScriptCompileCacheEntry entry;
+	entry.Hash		= hash;
+	entry.Length	= source.Length();
+	entry.File		= file;
+	entry.Context	= context;
+	_compileCache.AddToEnd(entry);
+}
+
+void CScriptManager::Compile(CScriptCompileContext* context)
 {
-	CScriptCompileContext*	context = GetScriptAllocator()->NewObj<CScriptCompileContext>(source, file);
 	CScriptLexer			lexer;
 	CScriptParser			parser;
 	CScriptGenerator		generator;
 
-	_compileContexts.AddToEnd(context);
-
 	if (lexer.Analyze(context))
 	{
 		if (parser.Analyze(context))
@@ -82,6 +209,59 @@ CScriptCompileContext* CScriptManager::CompileString(const Engine::Containers::C
 			generator.Analyze(context);			
 		}
 	}
+}
+
+// Returns cached output for the source if there is any, otherwise a new context that 
+// needs to be compiled (compile is set) and then passed to FinishCompile.
+CScriptCompileContext* CScriptManager::PrepareCompile(const Engine::Containers::CString& source, const Engine::Containers::CString& file, u64& hash, bool& compile)
+{
+	hash	= 0;
+	compile = false;
+
+	if (_compileCacheEnabled == true)
+	{
+		hash = HashSource(source, file, _optimizationLevel);
+
+		CScriptCompileContext* cached = FindCached(source, file, hash);
+		if (cached != NULL)
+			return cached;
+	}
+
+	CScriptCompileContext* context = GetScriptAllocator()->NewObj<CScriptCompileContext>(source, file);
+	context->SetOptimizationLevel(_optimizationLevel);
+	_compileContexts.AddToEnd(context);
+
+	compile = true;
+	return context;
+}
+
+// Called on this thread once a context from PrepareCompile has been compiled.
+void CScriptManager::FinishCompile(CScriptCompileContext* context, const Engine::Containers::CString& source, const Engine::Containers::CString& file, u64 hash)
+{
+	printf("%s", context->GetDisassembly().c_str());
+
+	if (_compileCacheEnabled == true)
+	{
+		AddCached(context, source, file, hash);
+
+		// Only write out successful compiles, failed ones are cheap to recompile
+		// and we want the errors reported again.
+		if (context->GetErrorCount(SCRIPT_ERROR_FATAL) <= 0)
+			SaveCached(context, hash, source.Length());
+	}
+}
+
+CScriptCompileContext* CScriptManager::CompileString(const Engine::Containers::CString& source, const Engine::Containers::CString& file)
+{
+	u64  hash;
+	bool compile;
+
+	CScriptCompileContext* context = PrepareCompile(source, file, hash, compile);
+	if (compile == true)
+	{
+		Compile(context);
+		FinishCompile(context, source, file, hash);
+	}
 
 	return context;
 }
@@ -96,6 +276,8 @@ CScriptCompileContext* CScriptManager::CompileFile(const Engine::Containers::CSt
 		{
 			context = CompileString(s->ReadToEnd(), path);			
 			s->Close();
+
+			HookHotReloadURL(_fileSystem, path);
 		}
 	
 		_fileSystem->DestroyStream(s);
@@ -103,6 +285,130 @@ CScriptCompileContext* CScriptManager::CompileFile(const Engine::Containers::CSt
 	return context;
 }				
 
+// Compiles a batch of files, spreading the work over the task manager if one is set.
+// Reading source, cache lookups, writing cached output and printing listings are done
+// on this thread, each file is then compiled as its own task. Files have no 
+// compile-time dependencies on each other (using is resolved by the VM at runtime) so 
+// nothing else needs to be serialized. The returned array is parallel to paths, with 
+// NULL for any file that could not be read.
+Engine::Containers::CArray<CScriptCompileContext*> CScriptManager::CompileFiles(const Engine::Containers::CArray<Engine::Containers::CString>& paths)
+{
+	Engine::Containers::CArray<CScriptCompileContext*> results;
+	Engine::Containers::CArray<u32>						pending;
+	Engine::Containers::CArray<u64>						hashes;
+	Engine::Containers::CArray<Engine::Containers::CString> sources;
+
+	for (u32 i = 0; i < paths.Size(); i++)
+	{
+		CScriptCompileContext* context = NULL;
+
+		Engine::FileSystem::Streams::CStream* s = _fileSystem->CreateReadStream(paths[i]);
+		if (s != NULL)
+		{
+			if (s->Open())
+			{
+				Engine::Containers::CString source = s->ReadToEnd();
+				s->Close();
+
+				HookHotReloadURL(_fileSystem, paths[i]);
+
+				u64  hash;
+				bool compile;
+
+				context = PrepareCompile(source, paths[i], hash, compile);
+				if (compile == true)
+				{
+					pending.AddToEnd(i);
+					hashes.AddToEnd(hash);
+					sources.AddToEnd(source);
+				}
+			}
+		
+			_fileSystem->DestroyStream(s);
+		}
+
+		results.AddToEnd(context);
+	}
+
+	// Compile everything that missed the cache.
+	if (_taskManager != NULL && pending.Size() > 1)
+	{
+		CScriptCompileTaskJob* jobs = GetScriptAllocator()->AllocArray<CScriptCompileTaskJob>(pending.Size() + 1);
+		Engine::Core::Tasks::TaskID* tasks = GetScriptAllocator()->AllocArray<Engine::Core::Tasks::TaskID>(pending.Size());
+
+		// Add all the tasks before queueing any of them, workers modify the parent 
+		// task as they complete.
+		Engine::Core::Tasks::TaskID parent = _taskManager->AddTask(&jobs[pending.Size()]);
+		for (u32 i = 0; i < pending.Size(); i++)
+		{
+			jobs[i].Setup(results[pending[i]]);
+			tasks[i] = _taskManager->AddTask(&jobs[i], parent);
+		}
+
+		for (u32 i = 0; i < pending.Size(); i++)
+			_taskManager->QueueTask(tasks[i]);
+		_taskManager->QueueTask(parent);
+
+		// Help out until everything is done.
+		_taskManager->WaitFor(parent);
+
+		GetScriptAllocator()->FreeArray(&tasks);
+		GetScriptAllocator()->FreeArray(&jobs);
+	}
+	else
+	{
+		for (u32 i = 0; i < pending.Size(); i++)
+			Compile(results[pending[i]]);
+	}
+
+	for (u32 i = 0; i < pending.Size(); i++)
+		FinishCompile(results[pending[i]], sources[i], paths[pending[i]], hashes[i]);
+
+	return results;
+}
+
+void CScriptManager::SetCompileCacheEnabled(bool enabled)
+{
+	_compileCacheEnabled = enabled;
+}
+
+// Sets the optimization level used by any following compiles. Cached output is keyed
+// on the level so this dosen't need to invalidate anything.
+void CScriptManager::SetOptimizationLevel(ScriptOptimizationLevel level)
+{
+	_optimizationLevel = level;
+}
+
+ScriptOptimizationLevel CScriptManager::GetOptimizationLevel()
+{
+	return _optimizationLevel;
+}
+
+// Drops the in-memory cache entries for the given file, invoked by HotReload when the
+// file is hot-reloaded. Changed source will always miss the cache as it's keyed on a
+// hash of the contents, this just stops stale entries accumulating. The compile 
+// contexts themselves are still owned by the manager as they may be loaded.
+void CScriptManager::InvalidateCompileCache(const Engine::Containers::CString& file)
+{
+	for (u32 i = 0; i < _compileCache.Size(); )
+	{
+		if (_compileCache[i].File == file)
+			_compileCache.RemoveIndex(i);
+		else
+			i++;
+	}
+}
+
+void CScriptManager::InvalidateCompileCache()
+{
+	_compileCache.Clear();
+}
+
+void CScriptManager::HotReload(const Engine::Containers::CString& url)
+{
+	InvalidateCompileCache(url);
+}
+
 CScriptExecutionContext* CScriptManager::Load(CScriptCompileContext* compile_context)
 {
 	LOG_ASSERT_MSG(compile_context->GetErrorCount(SCRIPT_ERROR_FATAL) <= 0, "Attempt to load compile context that contains compile errors.");
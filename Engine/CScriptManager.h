@@ -13,6 +13,10 @@
 #include "CProxyAllocator.h"
 
 #include "CArray.h"
+#include "CString.h"
+
+#include "CScriptCompileContext.h"
+#include "CFileSystem.h"
 
 namespace Engine
 {
@@ -20,11 +24,19 @@ namespace Engine
 	{
 		class CFileSystem;
 	}
+	namespace Core
+	{
+		namespace Tasks
+		{
+			class CTaskManager;
+		}
+	}
 	namespace Scripting
     {
 		class CScriptCompileContext;
 		class CScriptVirtualMachine;
 		class CScriptExecutionContext;
+		class CScriptCompileTaskJob;
 
 		// Allocators!
 		extern Engine::Memory::Allocators::CProxyAllocator* g_script_allocator;
@@ -32,14 +44,41 @@ namespace Engine
 		void FreeScriptAllocator();
 		inline Engine::Memory::Allocators::CProxyAllocator* GetScriptAllocator() { return Engine::Scripting::g_script_allocator; }
 
+		// Folder (relative to the save folder) compiled scripts are cached in.
+		#define SCRIPT_COMPILE_CACHE_FOLDER		"scriptcache"
+		#define SCRIPT_COMPILE_CACHE_SIGNATURE	*((u32*)"ISCC")
+
+		// An entry in the compiled script cache. Entries are keyed by a hash of the source
+		// and the file it came from, so changing either causes a recompile.
+		struct CScriptCompileCacheEntry
+		{
+			u64								Hash;
+			u32								Length;
+			Engine::Containers::CString		File;
+			CScriptCompileContext*			Context;
+		};
+
 		// The script manager is the main interface to the scripting language, none
 		// of the other classes should be used directly.
-		class CScriptManager
+		class CScriptManager : public Engine::FileSystem::IHotReloadable
 		{
 			private:
 				CScriptVirtualMachine*								_vm;
 				Engine::FileSystem::CFileSystem*					_fileSystem;
 				Engine::Containers::CArray<CScriptCompileContext*>	_compileContexts;
+				Engine::Containers::CArray<CScriptCompileCacheEntry>	_compileCache;
+				bool												_compileCacheEnabled;
+				ScriptOptimizationLevel								_optimizationLevel;
+				Engine::Core::Tasks::CTaskManager*					_taskManager;
+
+				static u64						HashSource		(const Engine::Containers::CString& source, const Engine::Containers::CString& file, ScriptOptimizationLevel level);
+				Engine::Containers::CString		GetCachePath	(u64 hash);
+				CScriptCompileContext*			LoadCached		(const Engine::Containers::CString& source, const Engine::Containers::CString& file, u64 hash);
+				void							SaveCached		(CScriptCompileContext* context, u64 hash, u32 length);
+				CScriptCompileContext*			FindCached		(const Engine::Containers::CString& source, const Engine::Containers::CString& file, u64 hash);
+				void							AddCached		(CScriptCompileContext* context, const Engine::Containers::CString& source, const Engine::Containers::CString& file, u64 hash);
+				CScriptCompileContext*			PrepareCompile	(const Engine::Containers::CString& source, const Engine::Containers::CString& file, u64& hash, bool& compile);
+				void							FinishCompile	(CScriptCompileContext* context, const Engine::Containers::CString& source, const Engine::Containers::CString& file, u64 hash);
 
 			public:
 				CScriptManager									(Engine::FileSystem::CFileSystem* fileSystem);
@@ -47,9 +86,26 @@ namespace Engine
 
 				const CScriptVirtualMachine*	GetVM			();
 				void							Run				(f32 timeslice = 0.0f);
+				void							SetTaskManager	(Engine::Core::Tasks::CTaskManager* manager);
+				void							SetParallel		(bool parallel);
+
+				// Lexes, parses and generates code for a compile context. This is the whole of the
+				// compile pipeline, it only touches the context so it's safe to call on any thread.
+				static void						Compile			(CScriptCompileContext* context);
 
 				CScriptCompileContext*			CompileString	(const Engine::Containers::CString& str, const Engine::Containers::CString& file="<string>");
 				CScriptCompileContext*			CompileFile		(const Engine::Containers::CString& path);
+				Engine::Containers::CArray<CScriptCompileContext*> CompileFiles(const Engine::Containers::CArray<Engine::Containers::CString>& paths);
+
+				void							SetCompileCacheEnabled	(bool enabled);
+				void							SetOptimizationLevel	(ScriptOptimizationLevel level);
+				ScriptOptimizationLevel			GetOptimizationLevel	();
+				void							InvalidateCompileCache	(const Engine::Containers::CString& file);
+				void							InvalidateCompileCache	();
+
+				// Files compiled with CompileFile(s) are hooked for hot reloading, which
+				// invalidates their cache entries.
+				virtual void					HotReload				(const Engine::Containers::CString& url);
 				
 				CScriptExecutionContext*		Load			(CScriptCompileContext* compile_context);
 				void							Unload			(CScriptExecutionContext* context);
@@ -8,6 +8,7 @@
 
 #include "CScriptVirtualMachine.h"
 #include "CScriptIteratorObject.h"
+#include "CScriptStringTable.h"
 
 using namespace Engine::Scripting;
 using namespace Engine::Scripting::Symbols;
@@ -16,7 +17,13 @@ using namespace Engine::Scripting::Objects;
 CScriptObject::CScriptObject()
 {
 	_refCount = 0;
+	_snapshotIndex = SCRIPT_SNAPSHOT_NO_INDEX;
 	_finalized = false;
+	_allocator = NULL;
+
+	_gcShaded	= true;
+	_gcBuffered = false;
+	_gcColor	= SCRIPT_GC_COLOR_BLACK;
 }
 
 void CScriptObject::IncRef()
@@ -28,6 +35,13 @@ void CScriptObject::DecRef()
 {
 	_refCount--;
 	//LOG_ASSERT(_refCount >= 0);
+
+	// Write barrier. Someone may still have this object in a register, so make sure 
+	// the collector dosen't free it during the current pass. If references are left 
+	// the object could also be part of a garbage cycle now.
+	_gcShaded = true;
+	if (_refCount > 0)
+		_gcColor = SCRIPT_GC_COLOR_PURPLE;
 }
 
 s32 CScriptObject::GetRefs()
@@ -40,6 +54,28 @@ void CScriptObject::Finalize(CScriptExecutionContext* context)
 	_finalized = true;
 }
 
+void CScriptObject::VisitReferences(CScriptExecutionContext* context, ScriptGCVisitor visitor)
+{
+}
+
+// Snapshots.
+ScriptSnapshotObjectType CScriptObject::GetSnapshotType()
+{
+	return SCRIPT_SNAPSHOT_OBJECT_NONE;
+}
+
+void CScriptObject::WriteSnapshotHeader(CScriptSnapshotWriter* writer)
+{
+}
+
+void CScriptObject::WriteSnapshot(CScriptSnapshotWriter* writer)
+{
+}
+
+void CScriptObject::ReadSnapshot(CScriptSnapshotReader* reader)
+{
+}
+
 // Casting.
 bool CScriptObject::CoerceToInt(CScriptExecutionContext* context, s32& result)
 {
@@ -205,3 +241,34 @@ bool CScriptObject::SetAttribute(CScriptExecutionContext* context, const Engine:
 {
 	return false;
 }
+
+bool CScriptObject::GetAttribute(CScriptExecutionContext* context, CScriptValue& dest, CScriptInternedString* name)
+{
+	return GetAttribute(context, dest, name->String);
+}
+
+bool CScriptObject::SetAttribute(CScriptExecutionContext* context, CScriptInternedString* name, const CScriptValue& value)
+{
+	return SetAttribute(context, name->String, value);
+}
+
+// Inline cache support.
+void* CScriptObject::GetShape(CScriptExecutionContext* context)
+{
+	return NULL;
+}
+
+s32 CScriptObject::FindAttributeSlot(CScriptExecutionContext* context, CScriptInternedString* name)
+{
+	return -1;
+}
+
+bool CScriptObject::GetAttributeSlot(CScriptExecutionContext* context, CScriptValue& dest, s32 slot)
+{
+	return false;
+}
+
+bool CScriptObject::SetAttributeSlot(CScriptExecutionContext* context, s32 slot, const CScriptValue& value)
+{
+	return false;
+}
@@ -10,16 +10,53 @@
 
 namespace Engine
 {
+	namespace Memory
+	{
+		namespace Allocators
+		{
+			class CAllocator;
+		}
+	}
     namespace Scripting
     {
 		class CScriptValue;
 		class CScriptExecutionContext;
 		class CScriptVirtualMachine;
 		class CScriptCallContext;
+		class CScriptInternedString;
+		class CScriptSnapshotWriter;
+		class CScriptSnapshotReader;
 
 		namespace Objects
 		{
 			class CScriptIteratorObject;
+			class CScriptObject;
+
+			// Colors used by the cycle collector (see CScriptExecutionContext::GCCollectCycles).
+			enum ScriptGCColor
+			{
+				SCRIPT_GC_COLOR_BLACK,		// In use (or not being looked at).
+				SCRIPT_GC_COLOR_GRAY,		// Possible member of a cycle.
+				SCRIPT_GC_COLOR_WHITE,		// Member of a garbage cycle.
+				SCRIPT_GC_COLOR_PURPLE,		// Possible root of a garbage cycle.
+			};
+
+			// Types of object that can be written to a snapshot (see CScriptExecutionContext::Snapshot).
+			enum ScriptSnapshotObjectType
+			{
+				SCRIPT_SNAPSHOT_OBJECT_NONE,			// Can't be snapshotted.
+				SCRIPT_SNAPSHOT_OBJECT_STRING,
+				SCRIPT_SNAPSHOT_OBJECT_LIST,
+				SCRIPT_SNAPSHOT_OBJECT_DICT,
+				SCRIPT_SNAPSHOT_OBJECT_LIST_ITERATOR,
+				SCRIPT_SNAPSHOT_OBJECT_DICT_ITERATOR,
+			};
+
+			// Value of _snapshotIndex for objects that are not being written to a snapshot.
+			#define SCRIPT_SNAPSHOT_NO_INDEX	0xFFFFFFFF
+
+			// Callback passed to VisitReferences.
+			typedef void (*ScriptGCVisitor)(CScriptExecutionContext* context, CScriptObject* object);
 
 			// This is the base class that all script objects need to extend from, it 
 			// provides the functionality required to perform different operators 
@@ -29,7 +66,9 @@ namespace Engine
 			protected:
 				// Reference counting.
 				s32				_refCount;
-				u32				_allocCallDepth;
+
+				// Index of this object in the snapshot currently being written.
+				u32				_snapshotIndex;
 
 				// GC Linked list stuff.
 				CScriptObject*	_next;
@@ -37,6 +76,16 @@ namespace Engine
 				u32				_generation;
 				bool			_finalized;
 
+				// Allocator this object was created from (see CScriptExecutionContext::NewObject).
+				Engine::Memory::Allocators::CAllocator*	_allocator;
+
+				// GC state. Shaded objects survive the next time the collector looks 
+				// at them (without being promoted), this is set when they are allocated, 
+				// found in a register or lose a reference (the write barrier).
+				bool			_gcShaded;
+				bool			_gcBuffered;
+				ScriptGCColor	_gcColor;
+
 			public:
 
 				CScriptObject										();
@@ -47,6 +96,19 @@ namespace Engine
 				s32  GetRefs										();
 
 				virtual void Finalize								(CScriptExecutionContext* context);
+
+				// Calls the visitor for every object this object holds a reference to. Anything that
+				// counts a reference with IncRef must report it here or cycles through it will 
+				// never be collected.
+				virtual void VisitReferences						(CScriptExecutionContext* context, ScriptGCVisitor visitor);
+
+				// Snapshots. The header is written with the first reference to the object and 
+				// should hold anything needed to create it, the rest of its state is written 
+				// once every object is known, so may reference any other object.
+				virtual ScriptSnapshotObjectType	GetSnapshotType		();
+				virtual void						WriteSnapshotHeader	(CScriptSnapshotWriter* writer);
+				virtual void						WriteSnapshot		(CScriptSnapshotWriter* writer);
+				virtual void						ReadSnapshot		(CScriptSnapshotReader* reader);
 				
 				// Metadata.
 				virtual Engine::Containers::CString	GetName			()=0;
@@ -96,10 +158,27 @@ namespace Engine
 				// Indirection operations.
 				virtual bool GetAttribute							(CScriptExecutionContext* context, CScriptValue& dest, const Engine::Containers::CString& name);
 				virtual bool SetAttribute							(CScriptExecutionContext* context, const Engine::Containers::CString& name, const CScriptValue& value);
+
+				// Interned indirection operations, these are what the VM calls. Names are interned so objects 
+				// can compare them against their own interned names by pointer. By default these just pass 
+				// through to the string versions above.
+				virtual bool GetAttribute							(CScriptExecutionContext* context, CScriptValue& dest, CScriptInternedString* name);
+				virtual bool SetAttribute							(CScriptExecutionContext* context, CScriptInternedString* name, const CScriptValue& value);
+
+				// Inline cache support. Objects whose attributes live at fixed slots for a given layout
+				// can return that layout from GetShape (NULL means the object can't be cached). The VM
+				// remembers the slot FindAttributeSlot returns for each INDR/INDRS instruction and 
+				// goes straight to Get/SetAttributeSlot while the objects shape stays the same.
+				virtual void* GetShape								(CScriptExecutionContext* context);
+				virtual s32	  FindAttributeSlot						(CScriptExecutionContext* context, CScriptInternedString* name);
+				virtual bool  GetAttributeSlot						(CScriptExecutionContext* context, CScriptValue& dest, s32 slot);
+				virtual bool  SetAttributeSlot						(CScriptExecutionContext* context, s32 slot, const CScriptValue& value);
 				
 				friend class CScriptVirtualMachine;
 				friend class CScriptExecutionContext;
 				friend class CScriptCallContext;
+				friend class Engine::Scripting::CScriptSnapshotWriter;
+				friend class Engine::Scripting::CScriptSnapshotReader;
 			};
 
 		}
@@ -12,6 +12,10 @@
 #include "CScriptVariableSymbol.h"
 #include "CScriptStringSymbol.h"
 #include "CScriptCompileContext.h"
+#include "CScriptLiteralASTNode.h"
+#include "CScriptExpressionASTNode.h"
+#include "CScriptIntrinsicASTNode.h"
+#include "CScriptIdentifierASTNode.h"
 
 using namespace Engine::Scripting;
 using namespace Engine::Scripting::AST;
@@ -65,10 +69,249 @@ void CScriptOperatorASTNode::GenerateSymbols(CScriptGenerator* gen)
 	CScriptASTNode::GenerateSymbols(gen);
 }
 
+// Value of a constant expression evaluated at compile time.
+struct CScriptConstantValue
+{
+	bool	IsFloat;
+	s32		IntValue;
+	f32		FloatValue;
+};
+
+// Promotes both values to floats if either is one, the same as the VM's implicit cast.
+static bool BalanceConstants(CScriptConstantValue& a, CScriptConstantValue& b)
+{
+	if (a.IsFloat == b.IsFloat)
+		return a.IsFloat;
+
+	if (a.IsFloat == false)	{ a.FloatValue = (f32)a.IntValue; a.IsFloat = true; }
+	if (b.IsFloat == false)	{ b.FloatValue = (f32)b.IntValue; b.IsFloat = true; }
+	return true;
+}
+
+// Attempts to evaluate the given node as a constant expression, following the VM's 
+// semantics for each operation. Returns false if the node is not constant, or if evaluating 
+// it would cause a runtime error (division by zero, bitwise operations on floats, etc), in
+// which case it's left for the VM so the error is still reported.
+static bool EvaluateConstant(CScriptASTNode* node, CScriptConstantValue& result)
+{
+	if (dynamic_cast<CScriptLiteralASTNode*>(node) != NULL)
+	{
+		switch (node->GetToken().ID)
+		{
+			case TOKEN_LITERAL_INT:		result.IsFloat = false; result.IntValue	= node->GetToken().Literal.ToInt();		return true;
+			case TOKEN_LITERAL_FLOAT:	result.IsFloat = true;	result.FloatValue	= node->GetToken().Literal.ToFloat();	return true;
+		}
+		return false;
+	}
+
+	if (dynamic_cast<CScriptExpressionASTNode*>(node) != NULL)
+	{
+		return node->GetChildren().Size() == 1 && EvaluateConstant(node->GetChildren()[0], result);
+	}
+
+	if (dynamic_cast<CScriptOperatorASTNode*>(node) == NULL)
+		return false;
+
+	Engine::Containers::CArray<CScriptASTNode*>& children = node->GetChildren();
+	CScriptConstantValue a;
+	CScriptConstantValue b;
+
+	// Unary operations.
+	if (children.Size() == 1 && node->GetToken().ID != TOKEN_OP_OPEN_PARENT)
+	{
+		if (!EvaluateConstant(children[0], a))
+			return false;
+
+		result = a;
+		switch (node->GetToken().ID)
+		{
+			case TOKEN_OP_ADD:
+				if (a.IsFloat)	result.FloatValue = a.FloatValue >= 0 ? a.FloatValue : -a.FloatValue;
+				else			result.IntValue	  = a.IntValue >= 0 ? a.IntValue : (s32)(0 - (u32)a.IntValue);
+				return true;
+
+			case TOKEN_OP_SUB:
+				if (a.IsFloat)	result.FloatValue = -a.FloatValue;
+				else			result.IntValue	  = (s32)(0 - (u32)a.IntValue);
+				return true;
+
+			case TOKEN_OP_LOGICAL_NOT:
+				result.IsFloat	= false;
+				result.IntValue	= (a.IsFloat ? a.FloatValue != 0 : a.IntValue != 0) ? 0 : 1;
+				return true;
+		}
+		return false;
+	}
+
+	// Binary operations.
+	if (children.Size() != 2 || 
+		!EvaluateConstant(children[0], a) ||
+		!EvaluateConstant(children[1], b))
+		return false;
+
+	switch (node->GetToken().ID)
+	{
+		// Arithmetic, ints wrap the same as they do in the VM.
+		case TOKEN_OP_ADD:
+		case TOKEN_OP_SUB:
+		case TOKEN_OP_MUL:
+		case TOKEN_OP_DIV:
+			{
+				result.IsFloat = BalanceConstants(a, b);
+				if (result.IsFloat)
+				{
+					switch (node->GetToken().ID)
+					{
+						case TOKEN_OP_ADD:	result.FloatValue = a.FloatValue + b.FloatValue; break;
+						case TOKEN_OP_SUB:	result.FloatValue = a.FloatValue - b.FloatValue; break;
+						case TOKEN_OP_MUL:	result.FloatValue = a.FloatValue * b.FloatValue; break;
+						case TOKEN_OP_DIV:	
+							if (b.FloatValue == 0)
+								return false;
+							result.FloatValue = a.FloatValue / b.FloatValue; 
+							break;
+					}
+				}
+				else
+				{
+					switch (node->GetToken().ID)
+					{
+						case TOKEN_OP_ADD:	result.IntValue = (s32)((u32)a.IntValue + (u32)b.IntValue); break;
+						case TOKEN_OP_SUB:	result.IntValue = (s32)((u32)a.IntValue - (u32)b.IntValue); break;
+						case TOKEN_OP_MUL:	result.IntValue = (s32)((u32)a.IntValue * (u32)b.IntValue); break;
+						case TOKEN_OP_DIV:	
+							if (b.IntValue == 0 || (b.IntValue == -1 && a.IntValue == (s32)0x80000000))
+								return false;
+							result.IntValue = a.IntValue / b.IntValue; 
+							break;
+					}
+				}
+				return true;
+			}
+
+		// Integer only operations.
+		case TOKEN_OP_MOD:
+		case TOKEN_OP_BITWISE_OR:
+		case TOKEN_OP_BITWISE_AND:
+		case TOKEN_OP_BITWISE_XOR:
+		case TOKEN_OP_BITWISE_SHL:
+		case TOKEN_OP_BITWISE_SHR:
+			{
+				if (a.IsFloat || b.IsFloat)
+					return false;
+
+				result.IsFloat = false;
+				switch (node->GetToken().ID)
+				{
+					case TOKEN_OP_MOD:			
+						if (b.IntValue == 0 || (b.IntValue == -1 && a.IntValue == (s32)0x80000000))
+							return false;
+						result.IntValue = a.IntValue % b.IntValue;	
+						break;
+					case TOKEN_OP_BITWISE_OR:	result.IntValue = a.IntValue | b.IntValue;	break;
+					case TOKEN_OP_BITWISE_AND:	result.IntValue = a.IntValue & b.IntValue;	break;
+					case TOKEN_OP_BITWISE_XOR:	result.IntValue = a.IntValue ^ b.IntValue;	break;
+					case TOKEN_OP_BITWISE_SHL:	
+					case TOKEN_OP_BITWISE_SHR:
+						if (b.IntValue < 0 || b.IntValue >= 32)
+							return false;
+						result.IntValue = (node->GetToken().ID == TOKEN_OP_BITWISE_SHL ? (s32)((u32)a.IntValue << b.IntValue) : a.IntValue >> b.IntValue);
+						break;
+				}
+				return true;
+			}
+
+		// Logical operations.
+		case TOKEN_OP_LOGICAL_AND:
+		case TOKEN_OP_LOGICAL_OR:
+			{
+				bool aValid = (a.IsFloat ? a.FloatValue != 0 : a.IntValue != 0);
+				bool bValid = (b.IsFloat ? b.FloatValue != 0 : b.IntValue != 0);
+
+				result.IsFloat  = false;
+				result.IntValue = (node->GetToken().ID == TOKEN_OP_LOGICAL_AND ? (aValid && bValid) : (aValid || bValid)) ? 1 : 0;
+				return true;
+			}
+
+		// Comparison operations. The VM compares on the truncated difference of the 
+		// two values, so we do the same.
+		case TOKEN_OP_LESS:
+		case TOKEN_OP_GREATER:
+		case TOKEN_OP_LESS_EQUAL:
+		case TOKEN_OP_GREATER_EQUAL:
+		case TOKEN_OP_NOT_EQUAL:
+		case TOKEN_OP_EQUAL:
+			{
+				s32 diff = 0;
+				if (BalanceConstants(a, b))
+				{
+					f32 fdiff = a.FloatValue - b.FloatValue;
+					if (!(fdiff > -2147483648.0f && fdiff < 2147483648.0f))
+						return false;
+					diff = (s32)fdiff;
+				}
+				else
+				{
+					diff = (s32)((u32)a.IntValue - (u32)b.IntValue);
+				}
+
+				result.IsFloat = false;
+				switch (node->GetToken().ID)
+				{
+					case TOKEN_OP_LESS:				result.IntValue = diff <  0 ? 1 : 0; break;
+					case TOKEN_OP_GREATER:			result.IntValue = diff >  0 ? 1 : 0; break;
+					case TOKEN_OP_LESS_EQUAL:		result.IntValue = diff <= 0 ? 1 : 0; break;
+					case TOKEN_OP_GREATER_EQUAL:	result.IntValue = diff >= 0 ? 1 : 0; break;
+					case TOKEN_OP_NOT_EQUAL:		result.IntValue = diff != 0 ? 1 : 0; break;
+					case TOKEN_OP_EQUAL:			result.IntValue = diff == 0 ? 1 : 0; break;
+				}
+				return true;
+			}
+	}
+
+	return false;
+}
+
+// Returns the binding table index of the native the node calls if it can be resolved 
+// at compile time, either native("x") itself or a function assigned to it.
+static s32 GetNativeBinding(CScriptASTNode* node)
+{
+	if (dynamic_cast<CScriptIntrinsicASTNode*>(node) != NULL)
+		return dynamic_cast<CScriptIntrinsicASTNode*>(node)->GetNativeBinding();
+
+	if (dynamic_cast<CScriptIdentifierASTNode*>(node) != NULL)
+	{
+		CScriptToken token = node->GetToken();
+		Symbols::CScriptFunctionSymbol* symbol = dynamic_cast<Symbols::CScriptFunctionSymbol*>(node->FindSymbol(token.Literal, true, Symbols::SCRIPT_SYMBOL_TYPE_FUNCTION|Symbols::SCRIPT_SYMBOL_TYPE_VARIABLE));
+		if (symbol != NULL)
+			return symbol->NativeBinding;
+	}
+
+	return -1;
+}
+
 u32 CScriptOperatorASTNode::GenerateInstructions(CScriptGenerator* gen)
 {
 	u32 output_reg = 0;
 
+	// ---------------------------------------------------------------------------------------
+	// Constant expression, fold it into a single load.
+	// ---------------------------------------------------------------------------------------
+	CScriptConstantValue constant;
+	if (gen->GetContext()->GetOptimizationLevel() >= SCRIPT_OPTIMIZATION_BASIC &&
+		EvaluateConstant(this, constant))
+	{
+		output_reg = gen->AllocateRegister(this);
+
+		if (constant.IsFloat)
+			CreateInstruction(gen, Instructions::SCRIPT_OPCODE_LDF, CreateRegisterOperand(output_reg), CreateFloatOperand(constant.FloatValue));
+		else
+			CreateInstruction(gen, Instructions::SCRIPT_OPCODE_LDI, CreateRegisterOperand(output_reg), CreateIntOperand(constant.IntValue));
+
+		gen->DeallocateRegister(this, output_reg);
+		return output_reg;
+	}
+
 	// ---------------------------------------------------------------------------------------
 	// Unary operation.
 	// ---------------------------------------------------------------------------------------
@@ -193,6 +436,23 @@ u32 CScriptOperatorASTNode::GenerateInstructions(CScriptGenerator* gen)
 			// Invokation,
 			case TOKEN_OP_OPEN_PARENT:
 				{
+					// Natives resolved at compile time are called directly by their binding index.
+					s32 binding = GetNativeBinding(_children[0]);
+					if (binding >= 0 && binding <= SCRIPT_NATIVE_CALL_MAX && _children.Size() - 1 <= SCRIPT_NATIVE_CALL_MAX)
+					{
+						output_reg = gen->AllocateRegister(this);
+
+						for (u32 i = 1; i < _children.Size(); i++)
+						{
+							u32 value_reg = _children[i]->GenerateInstructions(gen);	
+							CreateInstruction(gen, Instructions::SCRIPT_OPCODE_PUSH, CreateRegisterOperand(value_reg));
+						}
+
+						CreateInstruction(gen, Instructions::SCRIPT_OPCODE_INVKNATIVE, CreateIntOperand(SCRIPT_NATIVE_CALL_OPERAND(binding, _children.Size() - 1)));
+						CreateInstruction(gen, Instructions::SCRIPT_OPCODE_MOV, CreateRegisterOperand(output_reg), CreateRegisterOperand(SCRIPT_CONST_REGISTER_RETURN));					
+						break;
+					}
+
 					// Load in the function pointer.
 					output_reg = _children[0]->GenerateInstructions(gen);	
 					gen->AllocateRegister(this, output_reg);
@@ -220,11 +480,12 @@ u32 CScriptOperatorASTNode::GenerateInstructions(CScriptGenerator* gen)
 					output_reg = _children[0]->GenerateInstructions(gen);	
 					gen->AllocateRegister(this, output_reg);
 
-					// Parse the r-value.
-					u32 rvalue_reg = _children[1]->GenerateInstructions(gen);	
+					// Find the name of the attribute, we reference this directly rather than loading 
+					// it into a register so the VM can use its interned name.
+					Symbols::CScriptSymbol* rvaluesym = gen->GetContext()->GetASTRoot()->FindSymbol(_children[1]->GetToken().Literal, true, Symbols::SCRIPT_SYMBOL_TYPE_STRING, 0);
 
 					// Get the symbol indirection value.
-					CreateInstruction(gen, Instructions::SCRIPT_OPCODE_INDR, CreateRegisterOperand(output_reg), CreateRegisterOperand(rvalue_reg));
+					CreateInstruction(gen, Instructions::SCRIPT_OPCODE_INDR, CreateRegisterOperand(output_reg), CreateSymbolOperand(rvaluesym));
 
 					break;
 				}
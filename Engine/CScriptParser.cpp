@@ -213,7 +213,7 @@ bool CScriptParser::Analyze(CScriptCompileContext* context)
 	_tokenIndex = 0;
 
 	// Create the root AST node with a token for the start of the file.
-	_scope = GetScriptAllocator()->NewObj<CScriptASTNode>(PreviousToken(), (CScriptASTNode*)NULL);
+	_scope = _context->GetASTAllocator()->NewObj<CScriptASTNode>(PreviousToken(), (CScriptASTNode*)NULL);
 	_globalScope = _scope;
 
 	while (!EndOfTokens() && context->GetErrorCount(SCRIPT_ERROR_FATAL) <= 0)
@@ -342,7 +342,7 @@ void CScriptParser::ParseStatement()
 void CScriptParser::ParseBlock()
 {
 	// Create a new node.
-	CScriptBlockASTNode* node = GetScriptAllocator()->NewObj<CScriptBlockASTNode>(CurrentToken(), _scope); 
+	CScriptBlockASTNode* node = _context->GetASTAllocator()->NewObj<CScriptBlockASTNode>(CurrentToken(), _scope); 
 	PushScope(node);
 
 	// Empty block or full?
@@ -394,7 +394,7 @@ void CScriptParser::ParseVar()
 	while (true)
 	{
 		CScriptToken		    identifierToken	   = ExpectToken(TOKEN_LITERAL_IDENTIFIER);
-		CScriptVariableASTNode* variable		   = GetScriptAllocator()->NewObj<CScriptVariableASTNode>(identifierToken, _scope, type);
+		CScriptVariableASTNode* variable		   = _context->GetASTAllocator()->NewObj<CScriptVariableASTNode>(identifierToken, _scope, type);
 
 		// Read in an assignment?
 		if (LookAheadToken().ID == TOKEN_OP_ASSIGN)
@@ -517,7 +517,7 @@ void CScriptParser::ParseFunction()
 	}
 	
 	// Create the node.
-	CScriptFunctionASTNode* node = GetScriptAllocator()->NewObj<CScriptFunctionASTNode>(identifierToken, _scope, type);
+	CScriptFunctionASTNode* node = _context->GetASTAllocator()->NewObj<CScriptFunctionASTNode>(identifierToken, _scope, type);
 
 	// Read in the parameters.
 	ExpectToken(TOKEN_OP_OPEN_PARENT);
@@ -527,7 +527,7 @@ void CScriptParser::ParseFunction()
 		CScriptToken paramIdentifierToken = ExpectToken(TOKEN_LITERAL_IDENTIFIER);
 
 		// Read in the parameter.
-		CScriptVariableASTNode* param = GetScriptAllocator()->NewObj<CScriptVariableASTNode>(paramIdentifierToken, node, SCRIPT_VARIABLE_PARAMETER);
+		CScriptVariableASTNode* param = _context->GetASTAllocator()->NewObj<CScriptVariableASTNode>(paramIdentifierToken, node, SCRIPT_VARIABLE_PARAMETER);
 		node->ParameterCount++;
 
 		// Another parameter.
@@ -581,7 +581,7 @@ void CScriptParser::ParseFor()
 		return;
 	}
 
-	CScriptForASTNode* expr = GetScriptAllocator()->NewObj<CScriptForASTNode>(CurrentToken(), _scope);
+	CScriptForASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptForASTNode>(CurrentToken(), _scope);
 	PushScope(expr);
 		
 	// Read in opening parenthesis.
@@ -636,7 +636,7 @@ void CScriptParser::ParseWhile()
 		return;
 	}
 
-	CScriptWhileASTNode* expr = GetScriptAllocator()->NewObj<CScriptWhileASTNode>(CurrentToken(), _scope);
+	CScriptWhileASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptWhileASTNode>(CurrentToken(), _scope);
 	PushScope(expr);
 		
 	// Read in opening parenthesis.
@@ -680,7 +680,7 @@ void CScriptParser::ParseDo()
 		return;
 	}
 
-	CScriptDoASTNode* expr = GetScriptAllocator()->NewObj<CScriptDoASTNode>(CurrentToken(), _scope);
+	CScriptDoASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptDoASTNode>(CurrentToken(), _scope);
 	PushScope(expr);
 		
 	// Read in the block.
@@ -733,7 +733,7 @@ void CScriptParser::ParseForeach()
 		return;
 	}
 
-	CScriptForeachASTNode* expr = GetScriptAllocator()->NewObj<CScriptForeachASTNode>(CurrentToken(), _scope);
+	CScriptForeachASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptForeachASTNode>(CurrentToken(), _scope);
 	expr->NewVariable = false;
 	PushScope(expr);
 		
@@ -747,7 +747,7 @@ void CScriptParser::ParseForeach()
 		expr->NewVariable = true;
 	}
 	CScriptToken tok = ExpectToken(TOKEN_LITERAL_IDENTIFIER);
-	GetScriptAllocator()->NewObj<CScriptIdentifierASTNode>(tok, expr);
+	_context->GetASTAllocator()->NewObj<CScriptIdentifierASTNode>(tok, expr);
 
 	// Read the in keyword.
 	ExpectToken(TOKEN_KEYWORD_IN);
@@ -781,7 +781,7 @@ void CScriptParser::ParseReturn()
 		return;
 	}
 
-	CScriptReturnASTNode* expr = GetScriptAllocator()->NewObj<CScriptReturnASTNode>(CurrentToken(), _scope);
+	CScriptReturnASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptReturnASTNode>(CurrentToken(), _scope);
 
 	if (LookAheadToken().ID != TOKEN_OP_SEMICOLON)
 	{
@@ -812,7 +812,7 @@ void CScriptParser::ParseYield()
 		return;
 	}
 
-	CScriptYieldASTNode* expr = GetScriptAllocator()->NewObj<CScriptYieldASTNode>(CurrentToken(), _scope);
+	CScriptYieldASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptYieldASTNode>(CurrentToken(), _scope);
 	
 	PushScope(expr);
 	ParseExpression();
@@ -847,7 +847,7 @@ void CScriptParser::ParseSwitch()
 		return;
 	}
 
-	CScriptSwitchASTNode* expr = GetScriptAllocator()->NewObj<CScriptSwitchASTNode>(CurrentToken(), _scope);
+	CScriptSwitchASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptSwitchASTNode>(CurrentToken(), _scope);
 	PushScope(expr);
 		
 	// Read in opening parenthesis.
@@ -876,7 +876,7 @@ void CScriptParser::ParseSwitch()
 				Error("The default block in a switch statement must must the last block.");
 			}
 
-			CScriptSwitchCaseASTNode* node = GetScriptAllocator()->NewObj<CScriptSwitchCaseASTNode>(CurrentToken(), expr);
+			CScriptSwitchCaseASTNode* node = _context->GetASTAllocator()->NewObj<CScriptSwitchCaseASTNode>(CurrentToken(), expr);
 			PushScope(node);
 
 			NextToken();
@@ -900,7 +900,7 @@ void CScriptParser::ParseSwitch()
 				Error("Switch statements can only contain one default block.");
 			}
 
-			CScriptSwitchDefaultASTNode* node = GetScriptAllocator()->NewObj<CScriptSwitchDefaultASTNode>(CurrentToken(), expr);
+			CScriptSwitchDefaultASTNode* node = _context->GetASTAllocator()->NewObj<CScriptSwitchDefaultASTNode>(CurrentToken(), expr);
 			PushScope(node);
 
 			NextToken();
@@ -955,7 +955,7 @@ void CScriptParser::ParseIf()
 		return;
 	}
 
-	CScriptIfASTNode* expr = GetScriptAllocator()->NewObj<CScriptIfASTNode>(CurrentToken(), _scope);
+	CScriptIfASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptIfASTNode>(CurrentToken(), _scope);
 	PushScope(expr);
 		
 	// Read in opening parenthesis.
@@ -986,7 +986,7 @@ void CScriptParser::ParseIf()
 //	continue <expr>;
 void CScriptParser::ParseContinue()
 {
-	CScriptContinueASTNode* expr = GetScriptAllocator()->NewObj<CScriptContinueASTNode>(CurrentToken(), _scope);
+	CScriptContinueASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptContinueASTNode>(CurrentToken(), _scope);
 
 	// Read in optional level.
 	u32 level = 1;
@@ -1015,7 +1015,7 @@ void CScriptParser::ParseContinue()
 //	break <expr>;
 void CScriptParser::ParseBreak()
 {
-	CScriptBreakASTNode* expr = GetScriptAllocator()->NewObj<CScriptBreakASTNode>(CurrentToken(), _scope);
+	CScriptBreakASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptBreakASTNode>(CurrentToken(), _scope);
 
 	// Read in optional level.
 	u32 level = 1;
@@ -1056,11 +1056,11 @@ void CScriptParser::ParseUsing()
 		return;
 	}
 
-	CScriptUsingASTNode* expr = GetScriptAllocator()->NewObj<CScriptUsingASTNode>(CurrentToken(), _scope);
+	CScriptUsingASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptUsingASTNode>(CurrentToken(), _scope);
 	u32 offset = 0;
 	
 	CScriptToken tok = ExpectToken(TOKEN_LITERAL_IDENTIFIER);
-	GetScriptAllocator()->NewObj<CScriptIdentifierASTNode>(tok, expr);
+	_context->GetASTAllocator()->NewObj<CScriptIdentifierASTNode>(tok, expr);
 
 	/*
 	while (true)
@@ -1075,12 +1075,12 @@ void CScriptParser::ParseUsing()
 				return;
 			}
 
-			GetScriptAllocator()->NewObj<CScriptIdentifierASTNode>(tok, expr);
+			_context->GetASTAllocator()->NewObj<CScriptIdentifierASTNode>(tok, expr);
 		}
 		else
 		{
 			CScriptToken tok = ExpectToken(TOKEN_LITERAL_IDENTIFIER);
-			GetScriptAllocator()->NewObj<CScriptIdentifierASTNode>(tok, expr);
+			_context->GetASTAllocator()->NewObj<CScriptIdentifierASTNode>(tok, expr);
 		}
 
 		if (LookAheadToken().ID != TOKEN_OP_SEMICOLON)
@@ -1111,19 +1111,19 @@ void CScriptParser::ParseClass()
 	}
 
 	CScriptToken tok = ExpectToken(TOKEN_LITERAL_IDENTIFIER);
-	CScriptClassASTNode* expr = GetScriptAllocator()->NewObj<CScriptClassASTNode>(tok, _scope);
+	CScriptClassASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptClassASTNode>(tok, _scope);
 	
 	if (LookAheadToken().ID == TOKEN_KEYWORD_EXTENDS)
 	{
 		NextToken();
 		
 		CScriptToken tok = ExpectToken(TOKEN_LITERAL_IDENTIFIER);
-		GetScriptAllocator()->NewObj<CScriptIdentifierASTNode>(tok, expr);
+		_context->GetASTAllocator()->NewObj<CScriptIdentifierASTNode>(tok, expr);
 
 		/*while (true)
 		{
 			CScriptToken tok = ExpectToken(TOKEN_LITERAL_IDENTIFIER);
-			GetScriptAllocator()->NewObj<CScriptIdentifierASTNode>(tok, expr);
+			_context->GetASTAllocator()->NewObj<CScriptIdentifierASTNode>(tok, expr);
 
 			if (LookAheadToken().ID != TOKEN_OP_SEMICOLON)
 			{
@@ -1159,7 +1159,7 @@ void CScriptParser::ParseState()
 	}
 
 	CScriptToken tok = ExpectToken(TOKEN_LITERAL_IDENTIFIER);
-	CScriptStateASTNode* expr = GetScriptAllocator()->NewObj<CScriptStateASTNode>(tok, _scope);
+	CScriptStateASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptStateASTNode>(tok, _scope);
 
 	// Is default?
 	if (LookAheadToken().ID == TOKEN_KEYWORD_AS &&
@@ -1197,7 +1197,7 @@ void CScriptParser::ParseGotoState()
 	}
 
 	CScriptToken tok = ExpectToken(TOKEN_LITERAL_IDENTIFIER);
-	CScriptGotoStateASTNode* expr = GetScriptAllocator()->NewObj<CScriptGotoStateASTNode>(tok, _scope);
+	CScriptGotoStateASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptGotoStateASTNode>(tok, _scope);
 
 	if (hasParent == true)
 		ExpectToken(TOKEN_OP_CLOSE_PARENT);
@@ -1212,7 +1212,7 @@ void CScriptParser::ParseExpression()
 	AST::CScriptASTNode* node = ParseExprLevel0();
 	if (node != NULL)
 	{
-		CScriptExpressionASTNode* expr = GetScriptAllocator()->NewObj<CScriptExpressionASTNode>(CurrentToken(), _scope);
+		CScriptExpressionASTNode* expr = _context->GetASTAllocator()->NewObj<CScriptExpressionASTNode>(CurrentToken(), _scope);
 		expr->AddChild(node);
 		//expr->GetChildren().AddToEnd(node);
 	}
@@ -1237,7 +1237,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel0()
 	NextToken();
 
 	// Create operator.
-	CScriptOperatorASTNode* op = GetScriptAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
+	CScriptOperatorASTNode* op = _context->GetASTAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
 
 	// Parse r-value.
 	CScriptToken tok = LookAheadToken();
@@ -1251,7 +1251,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel0()
 	else
 		NextToken();
 	
-	AST::CScriptASTNode* rvalue = GetScriptAllocator()->NewObj<CScriptIdentifierASTNode>(tok, (AST::CScriptASTNode*)NULL);
+	AST::CScriptASTNode* rvalue = _context->GetASTAllocator()->NewObj<CScriptIdentifierASTNode>(tok, (AST::CScriptASTNode*)NULL);
 
 	// Add children.
 	op->AddChild(lvalue);
@@ -1287,7 +1287,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel1()
 	NextToken();
 
 	// Create operator.
-	CScriptOperatorASTNode* op = GetScriptAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
+	CScriptOperatorASTNode* op = _context->GetASTAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
 
 	// Parse r-value.
 	AST::CScriptASTNode* rvalue = ParseExprLevel2();
@@ -1316,7 +1316,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel2()
 	NextToken();
 
 	// Create operator.
-	CScriptOperatorASTNode* op = GetScriptAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
+	CScriptOperatorASTNode* op = _context->GetASTAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
 
 	// Parse r-value.
 	AST::CScriptASTNode* rvalue = ParseExprLevel3();
@@ -1357,7 +1357,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel3()
 		NextToken();
 
 		// Create operator.
-		CScriptOperatorASTNode* op = GetScriptAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
+		CScriptOperatorASTNode* op = _context->GetASTAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
 
 		// Parse r-value.
 		AST::CScriptASTNode* rvalue = ParseExprLevel4();
@@ -1395,7 +1395,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel4()
 		NextToken();
 
 		// Create operator.
-		CScriptOperatorASTNode* op = GetScriptAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
+		CScriptOperatorASTNode* op = _context->GetASTAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
 
 		// Parse r-value.
 		AST::CScriptASTNode* rvalue = ParseExprLevel5();
@@ -1434,7 +1434,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel5()
 		NextToken();
 
 		// Create operator.
-		CScriptOperatorASTNode* op = GetScriptAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
+		CScriptOperatorASTNode* op = _context->GetASTAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
 
 		// Parse r-value.
 		AST::CScriptASTNode* rvalue = ParseExprLevel6();
@@ -1469,7 +1469,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel6()
 		NextToken();
 
 		// Create operator.
-		CScriptOperatorASTNode* op = GetScriptAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
+		CScriptOperatorASTNode* op = _context->GetASTAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
 
 		// Parse r-value.
 		AST::CScriptASTNode* rvalue = ParseExprLevel7();
@@ -1504,7 +1504,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel7()
 		NextToken();
 
 		// Create operator.
-		CScriptOperatorASTNode* op = GetScriptAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
+		CScriptOperatorASTNode* op = _context->GetASTAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
 
 		// Parse r-value.
 		AST::CScriptASTNode* rvalue = ParseExprLevel8();
@@ -1543,7 +1543,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel8()
 	// Perform unary operation.
 	if (hasUnary == true)
 	{
-		CScriptOperatorASTNode* op = GetScriptAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
+		CScriptOperatorASTNode* op = _context->GetASTAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
 		op->AddChild(lvalue);
 		//op->GetChildren().AddToEnd(lvalue);
 
@@ -1595,12 +1595,12 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel9()
 		// Create operator.
 		CScriptASTNode* op = NULL;
 		if (isList == true)
-			op = GetScriptAllocator()->NewObj<CScriptListASTNode>(opToken, (AST::CScriptASTNode*)NULL);
+			op = _context->GetASTAllocator()->NewObj<CScriptListASTNode>(opToken, (AST::CScriptASTNode*)NULL);
 		else if (isDict == true)
-			op = GetScriptAllocator()->NewObj<CScriptDictASTNode>(opToken, (AST::CScriptASTNode*)NULL);
+			op = _context->GetASTAllocator()->NewObj<CScriptDictASTNode>(opToken, (AST::CScriptASTNode*)NULL);
 		else
 		{
-			op = GetScriptAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
+			op = _context->GetASTAllocator()->NewObj<CScriptOperatorASTNode>(opToken, (AST::CScriptASTNode*)NULL);
 			((CScriptOperatorASTNode*)op)->PostFix = true;
 		}
 
@@ -1634,7 +1634,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel9()
 			{
 				// Read key.
 				CScriptToken key = ExpectToken(TOKEN_LITERAL_STRING);	
-				CScriptASTNode* keyOp = GetScriptAllocator()->NewObj<CScriptLiteralASTNode>(key, (AST::CScriptASTNode*)NULL);
+				CScriptASTNode* keyOp = _context->GetASTAllocator()->NewObj<CScriptLiteralASTNode>(key, (AST::CScriptASTNode*)NULL);
 			//	op->GetChildren().AddToEnd(keyOp);
 				op->AddChild(keyOp);
 
@@ -1685,7 +1685,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel9()
 			CScriptToken tok = CurrentToken();
 			tok.ID = TOKEN_LITERAL_STRING;
 
-			AST::CScriptLiteralASTNode* rvalue = GetScriptAllocator()->NewObj<CScriptLiteralASTNode>(tok, (AST::CScriptASTNode*)NULL);
+			AST::CScriptLiteralASTNode* rvalue = _context->GetASTAllocator()->NewObj<CScriptLiteralASTNode>(tok, (AST::CScriptASTNode*)NULL);
 
 			// Add symbol 
 			op->AddChild(rvalue);
@@ -1716,10 +1716,10 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel10()
 		case TOKEN_LITERAL_INT:
 		case TOKEN_LITERAL_STRING:
 		case TOKEN_LITERAL_NULL:
-			return GetScriptAllocator()->NewObj<CScriptLiteralASTNode>(token, (AST::CScriptASTNode*)NULL);
+			return _context->GetASTAllocator()->NewObj<CScriptLiteralASTNode>(token, (AST::CScriptASTNode*)NULL);
 
 		case TOKEN_LITERAL_IDENTIFIER:
-			return GetScriptAllocator()->NewObj<CScriptIdentifierASTNode>(token, (AST::CScriptASTNode*)NULL);
+			return _context->GetASTAllocator()->NewObj<CScriptIdentifierASTNode>(token, (AST::CScriptASTNode*)NULL);
 
 		case TOKEN_OP_OPEN_PARENT:
 		{
@@ -1731,7 +1731,7 @@ AST::CScriptASTNode* CScriptParser::ParseExprLevel10()
 		// Native import intrinsic.
 		case TOKEN_KEYWORD_NATIVE:
 			{				
-				AST::CScriptASTNode* op = GetScriptAllocator()->NewObj<CScriptIntrinsicASTNode>(token, (AST::CScriptASTNode*)NULL);
+				AST::CScriptASTNode* op = _context->GetASTAllocator()->NewObj<CScriptIntrinsicASTNode>(token, (AST::CScriptASTNode*)NULL);
 
 				ExpectToken(TOKEN_OP_OPEN_PARENT);
 				AST::CScriptASTNode* node = ParseExprLevel0();
@@ -0,0 +1,351 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#include "CScriptProfiler.h"
+#include "CScriptVirtualMachine.h"
+#include "CScriptCompileContext.h"
+#include "CScriptFunctionSymbol.h"
+#include "CScriptManager.h"
+#include "CStream.h"
+
+#include <stdio.h>
+
+using namespace Engine::Scripting;
+using namespace Engine::Scripting::Symbols;
+
+// 32bit FNV-1a step over a value. Entries are keyed by their symbol and line rather
+// than by name, so nothing has to be formatted to find them.
+static u32 HashValue(u32 hash, u32 value)
+{
+	for (u32 i = 0; i < 4; i++)
+	{
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+static u32 HashPointer(u32 hash, void* ptr)
+{
+	u64 value = (u64)ptr;
+	return HashValue(HashValue(hash, (u32)value), (u32)(value >> 32));
+}
+
+// Returns the source line the frame is on. The PC of the top frame is the instruction
+// after the one being run and the PC of any other frame is the instruction after the
+// call it's waiting on, so either way its the previous instruction we want.
+static u32 GetFrameLine(CScriptCallContext& frame, Instructions::CScriptInstructionDebugInfo* debugInfo)
+{
+	return frame.PC > 0 ? debugInfo[frame.PC - 1].Line : 0;
+}
+
+static Engine::Containers::CString GetFrameName(CScriptCallContext& frame, const Engine::Containers::CString& file)
+{
+	if (frame.Symbol == NULL)
+		return file + ":<global>";
+	return file + ":" + frame.Symbol->GetToken().Literal;
+}
+
+CScriptProfiler::CScriptProfiler(u32 interval)
+{
+	_interval			 = interval;
+	_depth				 = 0;
+	_enterTime			 = 0;
+	_pendingTime		 = 0;
+	_pendingInstructions = 0;
+	_sampleCount		 = 0;
+}
+
+CScriptProfiler::~CScriptProfiler()
+{
+	Reset();
+}
+
+void CScriptProfiler::SetInterval(u32 interval)
+{
+	_interval = interval;
+}
+
+u32 CScriptProfiler::GetInterval()
+{
+	return _interval;
+}
+
+u32 CScriptProfiler::GetSampleCount()
+{
+	return _sampleCount;
+}
+
+void CScriptProfiler::Reset()
+{
+	for (u32 i = 0; i < _functions.Size(); i++)
+		GetScriptAllocator()->FreeObj(&_functions[i]);
+	for (u32 i = 0; i < _lines.Size(); i++)
+		GetScriptAllocator()->FreeObj(&_lines[i]);
+	for (u32 i = 0; i < _stacks.Size(); i++)
+		GetScriptAllocator()->FreeObj(&_stacks[i]);
+
+	_functions.Clear();
+	_lines.Clear();
+	_stacks.Clear();
+	_functionTable.Clear();
+	_lineTable.Clear();
+	_stackTable.Clear();
+
+	_pendingTime		 = 0;
+	_pendingInstructions = 0;
+	_sampleCount		 = 0;
+}
+
+CScriptProfilerEntry* CScriptProfiler::FindFunction(CScriptExecutionContext* context, u32 frameIndex)
+{
+	CScriptCallContext& frame = context->_callStack[frameIndex];
+	u32 hash = HashPointer(HashPointer(2166136261, context->_context), frame.Symbol);
+
+	if (_functionTable.Contains(hash))
+		return _functionTable[hash];
+
+	CScriptProfilerEntry* entry = GetScriptAllocator()->NewObj<CScriptProfilerEntry>();
+	entry->Name				= GetFrameName(frame, context->_context->_initialFile);
+	entry->Line				= 0;
+	entry->Samples			= 0;
+	entry->InclusiveSamples = 0;
+	entry->Instructions		= 0;
+	entry->Time				= 0;
+	entry->Allocations		= 0;
+	entry->AllocatedBytes	= 0;
+
+	_functionTable.Insert(hash, entry);
+	_functions.AddToEnd(entry);
+	return entry;
+}
+
+CScriptProfilerEntry* CScriptProfiler::FindLine(CScriptExecutionContext* context, u32 frameIndex)
+{
+	CScriptCallContext& frame = context->_callStack[frameIndex];
+	u32 line = GetFrameLine(frame, context->_debugInfo);
+	u32 hash = HashValue(HashPointer(HashPointer(2166136261, context->_context), frame.Symbol), line);
+
+	if (_lineTable.Contains(hash))
+		return _lineTable[hash];
+
+	CScriptProfilerEntry* entry = GetScriptAllocator()->NewObj<CScriptProfilerEntry>();
+	entry->Name				= GetFrameName(frame, context->_context->_initialFile);
+	entry->Line				= line;
+	entry->Samples			= 0;
+	entry->InclusiveSamples = 0;
+	entry->Instructions		= 0;
+	entry->Time				= 0;
+	entry->Allocations		= 0;
+	entry->AllocatedBytes	= 0;
+
+	_lineTable.Insert(hash, entry);
+	_lines.AddToEnd(entry);
+	return entry;
+}
+
+void CScriptProfiler::Enter()
+{
+	if (_depth++ == 0)
+		_enterTime = Engine::Platform::GetMillisecs();
+}
+
+void CScriptProfiler::Leave(CScriptExecutionContext* context, u32 executed)
+{
+	// Compiled code steps instructions it can't run through a nested Execute, these
+	// are already counted by the outermost one so only it is recorded. The profiler
+	// may also have been set part way through a batch.
+	if (_depth == 0 || --_depth > 0)
+		return;
+
+	_pendingInstructions += executed;
+	_pendingTime		 += Engine::Platform::GetMillisecs() - _enterTime;
+
+	if (_pendingInstructions >= _interval)
+	{
+		if (context->_callStack.Size() > 0)
+			Sample(context);
+
+		_pendingTime		 = 0;
+		_pendingInstructions = 0;
+	}
+}
+
+void CScriptProfiler::Sample(CScriptExecutionContext* context)
+{
+	u32 top	  = context->_callStack.Size() - 1;
+	u32 first = context->_callStack.Size() > SCRIPT_PROFILER_MAX_STACK_DEPTH ? context->_callStack.Size() - SCRIPT_PROFILER_MAX_STACK_DEPTH : 0;
+
+	_sampleCount++;
+
+	// Self cost goes to the function and line on top of the stack.
+	CScriptProfilerEntry* function = FindFunction(context, top);
+	function->Samples++;
+	function->Instructions += _pendingInstructions;
+	function->Time		   += _pendingTime;
+
+	CScriptProfilerEntry* line = FindLine(context, top);
+	line->Samples++;
+	line->InclusiveSamples++;
+	line->Instructions += _pendingInstructions;
+	line->Time		   += _pendingTime;
+
+	// Every function on the stack gets an inclusive sample, recursive functions only
+	// get the one.
+	CScriptProfilerEntry*	counted[SCRIPT_PROFILER_MAX_STACK_DEPTH];
+	u32						countedSize = 0;
+	u32						stackHash	= 2166136261;
+
+	for (u32 i = first; i <= top; i++)
+	{
+		CScriptCallContext& frame = context->_callStack[i];
+		stackHash = HashValue(HashPointer(stackHash, frame.Symbol), i == top ? GetFrameLine(frame, context->_debugInfo) : 0);
+
+		CScriptProfilerEntry* entry = FindFunction(context, i);
+		bool found = false;
+		for (u32 j = 0; j < countedSize && found == false; j++)
+			found = (counted[j] == entry);
+
+		if (found == false)
+		{
+			entry->InclusiveSamples++;
+			counted[countedSize++] = entry;
+		}
+	}
+	stackHash = HashPointer(stackHash, context->_context);
+
+	// And the whole stack gets its cost for the folded output.
+	CScriptProfilerStack* stack = NULL;
+	if (_stackTable.Contains(stackHash))
+	{
+		stack = _stackTable[stackHash];
+	}
+	else
+	{
+		stack = GetScriptAllocator()->NewObj<CScriptProfilerStack>();
+		stack->Frames		= "";
+		stack->Samples		= 0;
+		stack->Instructions = 0;
+		stack->Time			= 0;
+
+		for (u32 i = first; i <= top; i++)
+		{
+			CScriptCallContext& frame = context->_callStack[i];
+			if (i != first)
+				stack->Frames += ";";
+			stack->Frames += GetFrameName(frame, context->_context->_initialFile);
+		}
+		stack->Frames += S(":") + GetFrameLine(context->_callStack[top], context->_debugInfo);
+
+		_stackTable.Insert(stackHash, stack);
+		_stacks.AddToEnd(stack);
+	}
+
+	stack->Samples++;
+	stack->Instructions += _pendingInstructions;
+	stack->Time			+= _pendingTime;
+}
+
+void CScriptProfiler::Allocation(CScriptExecutionContext* context, u32 size)
+{
+	if (context->_callStack.Size() <= 0)
+		return;
+
+	u32 top = context->_callStack.Size() - 1;
+
+	CScriptProfilerEntry* function = FindFunction(context, top);
+	function->Allocations++;
+	function->AllocatedBytes += size;
+
+	CScriptProfilerEntry* line = FindLine(context, top);
+	line->Allocations++;
+	line->AllocatedBytes += size;
+}
+
+const Engine::Containers::CArray<CScriptProfilerEntry*>& CScriptProfiler::GetFunctions()
+{
+	return _functions;
+}
+
+const Engine::Containers::CArray<CScriptProfilerEntry*>& CScriptProfiler::GetLines()
+{
+	return _lines;
+}
+
+const Engine::Containers::CArray<CScriptProfilerStack*>& CScriptProfiler::GetStacks()
+{
+	return _stacks;
+}
+
+// Fills output with up to count of the entries with the most time, most expensive first.
+static u32 GetMostExpensive(const Engine::Containers::CArray<CScriptProfilerEntry*>& entries, CScriptProfilerEntry** output, u32 count)
+{
+	u32 size = 0;
+	for (u32 i = 0; i < entries.Size(); i++)
+	{
+		CScriptProfilerEntry* entry = entries[i];
+
+		u32 index = size;
+		while (index > 0 && output[index - 1]->Time < entry->Time)
+		{
+			if (index < count)
+				output[index] = output[index - 1];
+			index--;
+		}
+
+		if (index < count)
+		{
+			output[index] = entry;
+			if (size < count)
+				size++;
+		}
+	}
+	return size;
+}
+
+void CScriptProfiler::Report(u32 count)
+{
+	CScriptProfilerEntry** sorted = GetScriptAllocator()->AllocArray<CScriptProfilerEntry*>(count);
+
+	f64 totalTime = 0;
+	for (u32 i = 0; i < _functions.Size(); i++)
+		totalTime += _functions[i]->Time;
+	if (totalTime <= 0)
+		totalTime = 1;
+
+	printf("Script profile, %i samples every %i instructions.\n", _sampleCount, _interval);
+
+	printf("\n%-48s %8s %8s %12s %10s %8s %10s\n", "Function", "Self%", "Total%", "Instructions", "Time (ms)", "Allocs", "Bytes");
+	u32 size = GetMostExpensive(_functions, sorted, count);
+	for (u32 i = 0; i < size; i++)
+	{
+		CScriptProfilerEntry* entry = sorted[i];
+		f64 total = _sampleCount > 0 ? ((f64)entry->InclusiveSamples / _sampleCount) * 100.0 : 0.0;
+		printf("%-48s %7.2f%% %7.2f%% %12.0f %10.2f %8i %10.0f\n", entry->Name.c_str(), (entry->Time / totalTime) * 100.0, total, (f64)entry->Instructions, entry->Time, entry->Allocations, (f64)entry->AllocatedBytes);
+	}
+
+	printf("\n%-48s %8s %8s %12s %10s %8s %10s\n", "Line", "Self%", "Samples", "Instructions", "Time (ms)", "Allocs", "Bytes");
+	size = GetMostExpensive(_lines, sorted, count);
+	for (u32 i = 0; i < size; i++)
+	{
+		CScriptProfilerEntry* entry = sorted[i];
+		Engine::Containers::CString name = entry->Name + "(" + entry->Line + ")";
+		printf("%-48s %7.2f%% %8i %12.0f %10.2f %8i %10.0f\n", name.c_str(), (entry->Time / totalTime) * 100.0, entry->Samples, (f64)entry->Instructions, entry->Time, entry->Allocations, (f64)entry->AllocatedBytes);
+	}
+
+	GetScriptAllocator()->FreeArray(&sorted);
+}
+
+void CScriptProfiler::WriteFoldedStacks(Engine::FileSystem::Streams::CStream* stream, bool weightByTime)
+{
+	for (u32 i = 0; i < _stacks.Size(); i++)
+	{
+		CScriptProfilerStack* stack = _stacks[i];
+		u32 weight = weightByTime == true ? (u32)(stack->Time * 1000.0) : (u32)stack->Instructions;
+		if (weight == 0)
+			continue;
+
+		stream->WriteLine(stack->Frames + " " + weight);
+	}
+}
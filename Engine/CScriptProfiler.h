@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Conditionals.h"
+#include "Platform.h"
+
+#include "CString.h"
+#include "CArray.h"
+#include "CHashTable.h"
+
+#define SCRIPT_PROFILER_DEFAULT_INTERVAL	1000	// Instructions executed between each sample.
+#define SCRIPT_PROFILER_MAX_STACK_DEPTH		64		// Deeper frames are left out of samples.
+
+namespace Engine
+{
+	namespace FileSystem
+	{
+		namespace Streams
+		{
+			class CStream;
+		}
+	}
+
+    namespace Scripting
+    {
+		class CScriptExecutionContext;
+
+		// Cost attributed to a function, or to a single line of one.
+		struct CScriptProfilerEntry
+		{
+			Engine::Containers::CString	Name;
+			u32							Line;				// 0 for function entries.
+			u32							Samples;			// Samples taken while at the top of the stack.
+			u32							InclusiveSamples;	// Samples taken while anywhere on the stack.
+			u64							Instructions;
+			f64							Time;				// Milliseconds.
+			u32							Allocations;
+			u64							AllocatedBytes;
+		};
+
+		// A unique call stack and the cost of the samples taken in it.
+		struct CScriptProfilerStack
+		{
+			Engine::Containers::CString	Frames;				// Outermost first, seperated by ;'s.
+			u32							Samples;
+			u64							Instructions;
+			f64							Time;
+		};
+
+		// Sampling profiler for execution contexts. Rather than timing every call, every
+		// time a context has run the sample interval worth of instructions its call stack
+		// is walked and the instructions and time since the last sample are attributed to 
+		// the function and line at the top of it. Allocations are attributed to the line
+		// that made them as they happen.
+		//
+		// Samples are only taken between batches of instructions (see SCRIPT_VM_TIMESLICE_CHECK_INTERVAL)
+		// so intervals smaller than a batch sample every batch. A profiler is not thread 
+		// safe, contexts running in parallel need one each.
+		class CScriptProfiler
+		{
+			private:
+				u32															_interval;
+				u32															_depth;
+				f64															_enterTime;
+				f64															_pendingTime;
+				u32															_pendingInstructions;
+				u32															_sampleCount;
+
+				Engine::Containers::CArray<CScriptProfilerEntry*>			_functions;
+				Engine::Containers::CArray<CScriptProfilerEntry*>			_lines;
+				Engine::Containers::CArray<CScriptProfilerStack*>			_stacks;
+				Engine::Containers::CHashTable<CScriptProfilerEntry*>		_functionTable;
+				Engine::Containers::CHashTable<CScriptProfilerEntry*>		_lineTable;
+				Engine::Containers::CHashTable<CScriptProfilerStack*>		_stackTable;
+
+				CScriptProfilerEntry*	FindFunction	(CScriptExecutionContext* context, u32 frame);
+				CScriptProfilerEntry*	FindLine		(CScriptExecutionContext* context, u32 frame);
+				void					Sample			(CScriptExecutionContext* context);
+
+			public:
+				CScriptProfiler			(u32 interval = SCRIPT_PROFILER_DEFAULT_INTERVAL);
+				~CScriptProfiler		();
+
+				void	SetInterval		(u32 interval);
+				u32		GetInterval		();
+				u32		GetSampleCount	();
+				void	Reset			();
+
+				// Called by the execution context around each batch of instructions it runs, 
+				// and for each object it allocates.
+				void	Enter			();
+				void	Leave			(CScriptExecutionContext* context, u32 executed);
+				void	Allocation		(CScriptExecutionContext* context, u32 size);
+
+				// Results.
+				const Engine::Containers::CArray<CScriptProfilerEntry*>&	GetFunctions	();
+				const Engine::Containers::CArray<CScriptProfilerEntry*>&	GetLines		();
+				const Engine::Containers::CArray<CScriptProfilerStack*>&	GetStacks		();
+
+				// Prints the most expensive functions and lines.
+				void	Report			(u32 count = 20);
+
+				// Writes the stacks in the folded format taken by flamegraph.pl, one stack per line
+				// followed by its weight in instructions (or microseconds if weightByTime is set).
+				void	WriteFoldedStacks	(Engine::FileSystem::Streams::CStream* stream, bool weightByTime = false);
+
+		};
+
+	}
+}
@@ -0,0 +1,151 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#include "CScriptSelfTest.h"
+#include "CScriptManager.h"
+#include "CScriptCompileContext.h"
+#include "CScriptVirtualMachine.h"
+#include "CLog.h"
+
+#include <cstring>
+
+using namespace Engine::Scripting;
+
+// Sums the numbers below count, lots of local traffic for the optimizer to remove.
+static const u8* g_optimizationTestSource = 
+	"function Sum(count)\n"
+	"{\n"
+	"	var total = 0;\n"
+	"	var i = 0;\n"
+	"	while (i < count)\n"
+	"	{\n"
+	"		total = total + i;\n"
+	"		i = i + 1;\n"
+	"	}\n"
+	"	return total;\n"
+	"}\n";
+
+// Adds b to a a few times, called with ints by one context and floats by another.
+static const u8* g_quickeningTestSource = 
+	"function Report(value) = native(\"SelfTestReport\");\n"
+	"function Accumulate(a, b)\n"
+	"{\n"
+	"	var total = a;\n"
+	"	var i = 0;\n"
+	"	while (i < 4)\n"
+	"	{\n"
+	"		total = total + b;\n"
+	"		i = i + 1;\n"
+	"	}\n"
+	"	return total;\n"
+	"}\n"
+	"event OnTest(a, b)\n"
+	"{\n"
+	"	Report(Accumulate(a, b));\n"
+	"}\n";
+
+// Last value passed to SelfTestReport.
+static CScriptValue g_reportedValue;
+
+static void SelfTestReport(CScriptExecutionContext* context)
+{
+	g_reportedValue = context->GetParameter(0);
+}
+
+bool CScriptSelfTest::Check(bool condition, const Engine::Containers::CString& description)
+{
+	if (condition == false)
+		LOG_ERROR("Script self test failed: %s", description.c_str());
+	return condition;
+}
+
+bool CScriptSelfTest::RunAll()
+{
+	bool result = true;
+
+	result = TestOptimizationLevels() && result;
+	result = TestSharedQuickening() && result;
+
+	return result;
+}
+
+bool CScriptSelfTest::TestOptimizationLevels()
+{
+	CScriptManager manager(NULL);
+	manager.SetCompileCacheEnabled(false);
+
+	manager.SetOptimizationLevel(SCRIPT_OPTIMIZATION_NONE);
+	CScriptCompileContext* unoptimized = manager.CompileString(g_optimizationTestSource, "<selftest>");
+
+	manager.SetOptimizationLevel(SCRIPT_OPTIMIZATION_FULL);
+	CScriptCompileContext* optimized = manager.CompileString(g_optimizationTestSource, "<selftest>");
+
+	if (!Check(unoptimized->GetErrorCount(SCRIPT_ERROR_FATAL) == 0 && optimized->GetErrorCount(SCRIPT_ERROR_FATAL) == 0, "optimization test script failed to compile"))
+		return false;
+
+	const CScriptCompileStats& before = unoptimized->GetStats();
+	const CScriptCompileStats& after  = optimized->GetStats();
+
+	LOG_INFO("Script optimization: %i loads, %i stores unoptimized, %i loads, %i stores optimized.", before.Loads, before.Stores, after.Loads, after.Stores);
+
+	bool result = true;
+	result = Check(before.Loads == before.UnoptimizedLoads && before.Stores == before.UnoptimizedStores, "SCRIPT_OPTIMIZATION_NONE changed the number of loads / stores") && result;
+	result = Check(after.UnoptimizedLoads == before.Loads && after.UnoptimizedStores == before.Stores, "optimization levels generated different unoptimized code") && result;
+	result = Check(after.Loads + after.Stores < before.Loads + before.Stores, "SCRIPT_OPTIMIZATION_FULL did not reduce the number of loads / stores") && result;
+
+	return result;
+}
+
+bool CScriptSelfTest::TestSharedQuickening()
+{
+	CScriptManager manager(NULL);
+	manager.SetCompileCacheEnabled(false);
+
+	CScriptCompileContext* compiled = manager.CompileString(g_quickeningTestSource, "<selftest>");
+	if (!Check(compiled->GetErrorCount(SCRIPT_ERROR_FATAL) == 0, "quickening test script failed to compile"))
+		return false;
+
+	// Keep a copy of the shared instructions to compare against afterwards.
+	u32										count	 = compiled->GetInstructions().Size();
+	Instructions::CScriptPackedInstruction* original = GetScriptAllocator()->AllocArray<Instructions::CScriptPackedInstruction>(count);
+	memcpy(original, compiled->GetPackedInstructions(), count * sizeof(Instructions::CScriptPackedInstruction));
+
+	CScriptVirtualMachine machine;
+	machine.RegisterNativeFunction("SelfTestReport", SelfTestReport);
+
+	CScriptExecutionContext* intContext	  = GetScriptAllocator()->NewObj<CScriptExecutionContext>(compiled);
+	CScriptExecutionContext* floatContext = GetScriptAllocator()->NewObj<CScriptExecutionContext>(compiled);
+	machine.AddContext(intContext);
+	machine.AddContext(floatContext);
+	intContext->RunGlobalScope();
+	floatContext->RunGlobalScope();
+
+	// Alternate between the two, so a shared instruction stream would be quickened to
+	// one type and deoptimized by the other on every call.
+	bool result = true;
+	for (u32 i = 0; i < 4 && result == true; i++)
+	{
+		g_reportedValue.Type = SCRIPT_VALUE_TYPE_NULL;
+		intContext->PassIntParameter(1);
+		intContext->PassIntParameter(2);
+		intContext->CallEvent("OnTest", 2);
+		result = Check(g_reportedValue.Type == SCRIPT_VALUE_TYPE_INT && g_reportedValue.IntValue == 9, "int context returned the wrong result") && result;
+
+		g_reportedValue.Type = SCRIPT_VALUE_TYPE_NULL;
+		floatContext->PassFloatParameter(0.5f);
+		floatContext->PassFloatParameter(0.25f);
+		floatContext->CallEvent("OnTest", 2);
+		result = Check(g_reportedValue.Type == SCRIPT_VALUE_TYPE_FLOAT && g_reportedValue.FloatValue == 1.5f, "float context returned the wrong result") && result;
+	}
+
+	result = Check(memcmp(original, compiled->GetPackedInstructions(), count * sizeof(Instructions::CScriptPackedInstruction)) == 0, "running a context modified the compile contexts instructions") && result;
+
+	machine.RemoveContext(intContext);
+	machine.RemoveContext(floatContext);
+	GetScriptAllocator()->FreeObj(&intContext);
+	GetScriptAllocator()->FreeObj(&floatContext);
+	GetScriptAllocator()->FreeArray(&original);
+
+	return result;
+}
@@ -0,0 +1,40 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Conditionals.h"
+#include "Platform.h"
+
+#include "CString.h"
+
+namespace Engine
+{
+    namespace Scripting
+    {
+
+		// Self tests for the scripting engine. Each test compiles and runs a small script
+		// and checks what it did, failures are written to the log. The game runs these on
+		// startup in debug builds (see GAME_RUN_SCRIPT_SELF_TESTS).
+		class CScriptSelfTest
+		{
+			private:
+				static bool Check						(bool condition, const Engine::Containers::CString& description);
+
+			public:
+				static bool RunAll						();
+
+				// Compiles the same script at SCRIPT_OPTIMIZATION_NONE and SCRIPT_OPTIMIZATION_FULL
+				// and checks the optimized version does fewer local/global loads and stores.
+				static bool TestOptimizationLevels		();
+
+				// Runs two contexts of the same compiled script with different operand types 
+				// and checks both get the right results, and that quickening them leaves the 
+				// compile contexts instructions alone.
+				static bool TestSharedQuickening		();
+
+		};
+
+	}
+}
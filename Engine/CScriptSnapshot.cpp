@@ -0,0 +1,283 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#include "CScriptSnapshot.h"
+#include "CScriptVirtualMachine.h"
+#include "CScriptCompileContext.h"
+#include "CScriptManager.h"
+#include "CScriptStringObject.h"
+#include "CScriptListObject.h"
+#include "CScriptDictObject.h"
+#include "CStream.h"
+
+using namespace Engine::Scripting;
+using namespace Engine::Scripting::Symbols;
+using namespace Engine::Scripting::Objects;
+
+// CScriptSnapshotWriter -----------------------------------------------------
+
+CScriptSnapshotWriter::CScriptSnapshotWriter(CScriptExecutionContext* context, Engine::FileSystem::Streams::CStream* stream)
+{
+	_context = context;
+	_stream	 = stream;
+	_written = 0;
+	_failed	 = false;
+}
+
+// Objects remember their index while the snapshot is written, so they don't have to be
+// looked up, put them back for next time.
+CScriptSnapshotWriter::~CScriptSnapshotWriter()
+{
+	for (u32 i = 0; i < _objects.Size(); i++)
+		_objects[i]->_snapshotIndex = SCRIPT_SNAPSHOT_NO_INDEX;
+}
+
+Engine::FileSystem::Streams::CStream* CScriptSnapshotWriter::GetStream()
+{
+	return _stream;
+}
+
+CScriptExecutionContext* CScriptSnapshotWriter::GetContext()
+{
+	return _context;
+}
+
+void CScriptSnapshotWriter::WriteValue(const CScriptValue& value)
+{
+	_stream->WriteU8((u8)value.Type);
+
+	switch (value.Type)
+	{
+		case SCRIPT_VALUE_TYPE_INT:				_stream->WriteS32(value.IntValue);		break;
+		case SCRIPT_VALUE_TYPE_FLOAT:			_stream->WriteF32(value.FloatValue);	break;
+		case SCRIPT_VALUE_TYPE_OBJECT:			WriteObject(value.Object);				break;
+		case SCRIPT_VALUE_TYPE_SYMBOL:			WriteSymbol(value.Symbol);				break;
+		case SCRIPT_VALUE_TYPE_FUNCTION:		WriteSymbol(value.Symbol);				break;
+		case SCRIPT_VALUE_TYPE_NATIVE_FUNCTION:	_stream->WriteString(value.NativeFunction == NULL ? "" : value.NativeFunction->Name); break;
+		default:																		break;
+	}
+}
+
+void CScriptSnapshotWriter::WriteObject(CScriptObject* object)
+{
+	if (object == NULL)
+	{
+		_stream->WriteU32(SCRIPT_SNAPSHOT_NULL_OBJECT);
+		return;
+	}
+
+	// Already written?
+	if (object->_snapshotIndex != SCRIPT_SNAPSHOT_NO_INDEX)
+	{
+		_stream->WriteU32(object->_snapshotIndex);
+		return;
+	}
+
+	ScriptSnapshotObjectType type = object->GetSnapshotType();
+	if (type == SCRIPT_SNAPSHOT_OBJECT_NONE)
+	{
+		Fail(S("Attempt to snapshot object of type '%s'.").Format(object->GetName().c_str()));
+		_stream->WriteU32(SCRIPT_SNAPSHOT_NULL_OBJECT);
+		return;
+	}
+
+	object->_snapshotIndex = _objects.Size();
+	_objects.AddToEnd(object);
+
+	_stream->WriteU32(SCRIPT_SNAPSHOT_NEW_OBJECT);
+	_stream->WriteU8((u8)type);
+	object->WriteSnapshotHeader(this);
+}
+
+// Symbols are written as their index in the compile context, which the reader checks 
+// is the same script.
+void CScriptSnapshotWriter::WriteSymbol(CScriptSymbol* symbol)
+{
+	s32 index = -1;
+	if (symbol != NULL)
+	{
+		for (u32 i = 0; i < _context->_context->_symbols.Size(); i++)
+		{
+			if (_context->_symbols[i] == symbol)
+			{
+				index = i;
+				break;
+			}
+		}
+	}
+
+	_stream->WriteS32(index);
+}
+
+void CScriptSnapshotWriter::WriteObjects()
+{
+	while (_written < _objects.Size())
+	{
+		CScriptObject* object = _objects[_written++];
+		object->WriteSnapshot(this);
+	}
+}
+
+void CScriptSnapshotWriter::Fail(const Engine::Containers::CString& reason)
+{
+	if (_failed == false)
+		_context->Error(reason);
+	_failed = true;
+}
+
+bool CScriptSnapshotWriter::Failed()
+{
+	return _failed;
+}
+
+// CScriptSnapshotReader -----------------------------------------------------
+
+CScriptSnapshotReader::CScriptSnapshotReader(CScriptExecutionContext* context, Engine::FileSystem::Streams::CStream* stream)
+{
+	_context = context;
+	_stream	 = stream;
+	_read	 = 0;
+	_failed	 = false;
+}
+
+Engine::FileSystem::Streams::CStream* CScriptSnapshotReader::GetStream()
+{
+	return _stream;
+}
+
+CScriptExecutionContext* CScriptSnapshotReader::GetContext()
+{
+	return _context;
+}
+
+CScriptValue CScriptSnapshotReader::ReadValue()
+{
+	CScriptValue value;
+	value.Type	 = SCRIPT_VALUE_TYPE_NULL;
+	value.Object = NULL;
+
+	if (_failed == true)
+		return value;
+
+	value.Type = (ScriptValueType)_stream->ReadU8();
+	switch (value.Type)
+	{
+		case SCRIPT_VALUE_TYPE_INT:				value.IntValue	 = _stream->ReadS32();	break;
+		case SCRIPT_VALUE_TYPE_FLOAT:			value.FloatValue = _stream->ReadF32();	break;
+		case SCRIPT_VALUE_TYPE_OBJECT:			value.Object	 = ReadObject();		break;
+		case SCRIPT_VALUE_TYPE_SYMBOL:			value.Symbol	 = ReadSymbol();		break;
+		case SCRIPT_VALUE_TYPE_FUNCTION:		value.Symbol	 = ReadSymbol();		break;
+		case SCRIPT_VALUE_TYPE_NATIVE_FUNCTION:
+			{
+				Engine::Containers::CString name = _stream->ReadString();
+				
+				s32 binding = CScriptVirtualMachine::FindNativeBinding(name);
+				if (binding >= 0)
+					value.NativeFunction = CScriptVirtualMachine::GetNativeBinding(binding);
+				else if (name != "" && _context->_virtualMachine != NULL)
+					value.NativeFunction = _context->_virtualMachine->FindNativeFunction(name);
+				else
+					value.NativeFunction = NULL;
+
+				if (name != "" && value.NativeFunction == NULL)
+					Fail(S("Snapshot references undefined native function '%s'.").Format(name.c_str()));
+				break;
+			}
+		case SCRIPT_VALUE_TYPE_NULL:																break;
+		default:								Fail("Snapshot contains an invalid value.");		break;
+	}
+
+	if (_failed == true)
+	{
+		value.Type	 = SCRIPT_VALUE_TYPE_NULL;
+		value.Object = NULL;
+	}
+
+	return value;
+}
+
+CScriptObject* CScriptSnapshotReader::ReadObject()
+{
+	if (_failed == true)
+		return NULL;
+
+	u32 index = _stream->ReadU32();
+	if (index == SCRIPT_SNAPSHOT_NULL_OBJECT)
+		return NULL;
+
+	if (index == SCRIPT_SNAPSHOT_NEW_OBJECT)
+	{
+		CScriptObject* object = CreateObject((ScriptSnapshotObjectType)_stream->ReadU8());
+		if (object != NULL)
+		{
+			_context->GCAdd(object);
+			_objects.AddToEnd(object);
+		}
+		return object;
+	}
+
+	if (index >= _objects.Size())
+	{
+		Fail("Snapshot references an object that does not exist.");
+		return NULL;
+	}
+
+	return _objects[index];
+}
+
+CScriptSymbol* CScriptSnapshotReader::ReadSymbol()
+{
+	if (_failed == true)
+		return NULL;
+
+	s32 index = _stream->ReadS32();
+	if (index < 0)
+		return NULL;
+
+	if (index >= (s32)_context->_context->_symbols.Size())
+	{
+		Fail("Snapshot references a symbol that does not exist.");
+		return NULL;
+	}
+
+	return _context->_symbols[index];
+}
+
+// Creates an object from the type and header written by WriteObject, its state is read 
+// later by ReadObjects.
+CScriptObject* CScriptSnapshotReader::CreateObject(ScriptSnapshotObjectType type)
+{
+	switch (type)
+	{
+		case SCRIPT_SNAPSHOT_OBJECT_STRING:			return _context->NewObject<CScriptStringObject>(_stream->ReadString());
+		case SCRIPT_SNAPSHOT_OBJECT_LIST:			return _context->NewObject<CScriptListObject>();
+		case SCRIPT_SNAPSHOT_OBJECT_DICT:			return _context->NewObject<CScriptDictObject>();
+		case SCRIPT_SNAPSHOT_OBJECT_LIST_ITERATOR:	return _context->NewObject<CScriptListIteratorObject>();
+		case SCRIPT_SNAPSHOT_OBJECT_DICT_ITERATOR:	return _context->NewObject<CScriptDictIteratorObject>();
+	}
+
+	Fail("Snapshot contains an object of an unknown type.");
+	return NULL;
+}
+
+void CScriptSnapshotReader::ReadObjects()
+{
+	while (_read < _objects.Size() && _failed == false)
+	{
+		CScriptObject* object = _objects[_read++];
+		object->ReadSnapshot(this);
+	}
+}
+
+void CScriptSnapshotReader::Fail(const Engine::Containers::CString& reason)
+{
+	if (_failed == false)
+		_context->Error(reason);
+	_failed = true;
+}
+
+bool CScriptSnapshotReader::Failed()
+{
+	return _failed;
+}
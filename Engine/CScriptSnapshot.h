@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Conditionals.h"
+#include "Platform.h"
+
+#include "CString.h"
+#include "CArray.h"
+
+#include "CScriptObject.h"
+
+namespace Engine
+{
+	namespace FileSystem
+	{
+		namespace Streams
+		{
+			class CStream;
+		}
+	}
+    namespace Scripting
+    {
+		class CScriptExecutionContext;
+		class CScriptValue;
+
+		namespace Symbols
+		{
+			class CScriptSymbol;
+		}
+
+		// Snapshot format identification.
+		#define SCRIPT_SNAPSHOT_SIGNATURE			*((u32*)"ISNP")
+		#define SCRIPT_SNAPSHOT_VERSION				1
+
+		// Object references in a snapshot are the index of the object, or one of these.
+		#define SCRIPT_SNAPSHOT_NULL_OBJECT			0xFFFFFFFF
+		#define SCRIPT_SNAPSHOT_NEW_OBJECT			0xFFFFFFFE
+
+		// Writes the state of an execution context to a stream.
+		//
+		// Objects are numbered in the order they are first referenced. The first reference
+		// to an object writes its type and header (enough to create it), its state is 
+		// written later by WriteObjects, so objects can reference each other in any shape.
+		class CScriptSnapshotWriter
+		{
+		private:
+			CScriptExecutionContext*							_context;
+			Engine::FileSystem::Streams::CStream*				_stream;
+			Engine::Containers::CArray<Objects::CScriptObject*>	_objects;
+			u32													_written;
+			bool												_failed;
+
+		public:
+			CScriptSnapshotWriter	(CScriptExecutionContext* context, Engine::FileSystem::Streams::CStream* stream);
+			~CScriptSnapshotWriter	();
+
+			Engine::FileSystem::Streams::CStream*	GetStream		();
+			CScriptExecutionContext*				GetContext		();
+
+			void									WriteValue		(const CScriptValue& value);
+			void									WriteObject		(Objects::CScriptObject* object);
+			void									WriteSymbol		(Symbols::CScriptSymbol* symbol);
+
+			// Writes the state of every object referenced so far (and anything they reference).
+			void									WriteObjects	();
+
+			void									Fail			(const Engine::Containers::CString& reason);
+			bool									Failed			();
+		};
+
+		// Reads a snapshot written by CScriptSnapshotWriter. Objects are created as their 
+		// first reference is read and have their state read by ReadObjects.
+		class CScriptSnapshotReader
+		{
+		private:
+			CScriptExecutionContext*							_context;
+			Engine::FileSystem::Streams::CStream*				_stream;
+			Engine::Containers::CArray<Objects::CScriptObject*>	_objects;
+			u32													_read;
+			bool												_failed;
+
+			Objects::CScriptObject*					CreateObject	(Objects::ScriptSnapshotObjectType type);
+
+		public:
+			CScriptSnapshotReader	(CScriptExecutionContext* context, Engine::FileSystem::Streams::CStream* stream);
+
+			Engine::FileSystem::Streams::CStream*	GetStream		();
+			CScriptExecutionContext*				GetContext		();
+
+			CScriptValue							ReadValue		();
+			Objects::CScriptObject*					ReadObject		();
+			Symbols::CScriptSymbol*					ReadSymbol		();
+
+			void									ReadObjects		();
+
+			void									Fail			(const Engine::Containers::CString& reason);
+			bool									Failed			();
+		};
+
+	}
+}
@@ -6,8 +6,11 @@
 #include "CScriptManager.h"
 #include "CScriptStringObject.h"
 #include "CScriptListObject.h"
+#include "CScriptStringTable.h"
 
 #include "CScriptVirtualMachine.h"
+#include "CScriptSnapshot.h"
+#include "CStream.h"
 
 #include <stdio.h>
 
@@ -23,7 +26,109 @@ using namespace Engine::Scripting::Objects;
 
 CScriptStringObject::CScriptStringObject(CScriptExecutionContext* context, const Engine::Containers::CString& str)
 {
-	_string = str;
+	_string		   = str;
+	_buffer		   = NULL;
+	_length		   = str.Length();
+	_flat		   = true;
+	_hashCode	   = 0;
+	_hashCodeValid = false;
+	_interned	   = NULL;
+}
+
+CScriptStringObject::CScriptStringObject(CScriptExecutionContext* context, CScriptInternedString* str)
+{
+	_string		   = str->String;
+	_buffer		   = NULL;
+	_length		   = str->String.Length();
+	_flat		   = true;
+	_hashCode	   = str->HashCode;
+	_hashCodeValid = true;
+	_interned	   = str;
+}
+
+CScriptStringObject::CScriptStringObject(CScriptExecutionContext* context, CScriptStringBuffer* buffer)
+{
+	_buffer		   = buffer;
+	_length		   = buffer->Length;
+	_flat		   = false;
+	_hashCode	   = 0;
+	_hashCodeValid = false;
+	_interned	   = NULL;
+
+	_buffer->RefCount++;
+}
+
+void CScriptStringObject::Finalize(CScriptExecutionContext* context)
+{
+	if (_buffer != NULL)
+	{
+		ReleaseBuffer(_buffer);
+		_buffer = NULL;
+	}
+
+	_finalized = true;
+}
+
+// String buffers.
+CScriptStringBuffer* CScriptStringObject::CreateBuffer(u32 capacity)
+{
+	CScriptStringBuffer* buffer = (CScriptStringBuffer*)GetScriptAllocator()->Alloc(sizeof(CScriptStringBuffer));
+	buffer->RefCount = 0;
+	buffer->Length	 = 0;
+	buffer->Capacity = capacity;
+	buffer->Data	 = (u8*)GetScriptAllocator()->Alloc(capacity);
+	return buffer;
+}
+
+// Data may point into the buffer itself (s + s), so the old data is only freed once
+// it has been copied across.
+void CScriptStringObject::AppendBuffer(CScriptStringBuffer* buffer, const u8* data, u32 length)
+{
+	if (buffer->Length + length > buffer->Capacity)
+	{
+		u32 capacity = buffer->Capacity * 2;
+		if (capacity < buffer->Length + length)
+			capacity = buffer->Length + length;
+
+		u8* newData = (u8*)GetScriptAllocator()->Alloc(capacity);
+		memcpy(newData, buffer->Data, buffer->Length);
+		memcpy(newData + buffer->Length, data, length);
+
+		GetScriptAllocator()->Free(&buffer->Data);
+		buffer->Data	 = newData;
+		buffer->Capacity = capacity;
+	}
+	else
+	{
+		memcpy(buffer->Data + buffer->Length, data, length);
+	}
+
+	buffer->Length += length;
+}
+
+void CScriptStringObject::ReleaseBuffer(CScriptStringBuffer* buffer)
+{
+	if (--buffer->RefCount > 0)
+		return;
+
+	GetScriptAllocator()->Free(&buffer->Data);
+	GetScriptAllocator()->Free(&buffer);
+}
+
+// If we are the last string built from our buffer we can append straight on to
+// it, otherwise something has already appended past us so we need our own copy.
+CScriptStringBuffer* CScriptStringObject::GetAppendBuffer(u32 capacity)
+{
+	if (_buffer != NULL && _buffer->Length == _length)
+		return _buffer;
+
+	if (capacity < _length * 2)
+		capacity = _length * 2;
+
+	CScriptStringBuffer* buffer = CreateBuffer(capacity);
+	AppendBuffer(buffer, GetData(), _length);
+
+	return buffer;
 }
 
 // Metadata.
@@ -32,28 +137,80 @@ Engine::Containers::CString	CScriptStringObject::GetName()
 	return "string";
 }
 
+// Snapshots. Written in the same layout as CStream::WriteString so the reader can 
+// pass it straight to the constructor.
+ScriptSnapshotObjectType CScriptStringObject::GetSnapshotType()
+{
+	return SCRIPT_SNAPSHOT_OBJECT_STRING;
+}
+
+void CScriptStringObject::WriteSnapshotHeader(CScriptSnapshotWriter* writer)
+{
+	writer->GetStream()->WriteU32(_length);
+	writer->GetStream()->WriteBytes(GetData(), _length);
+}
+
+// Accessors.
+const Engine::Containers::CString& CScriptStringObject::GetString()
+{
+	if (_flat == false)
+	{
+		_string = Engine::Containers::CString(_buffer->Data, _length);
+		_flat	= true;
+	}
+	return _string;
+}
+
+// Raw characters of the string, not null terminated unless the string is flat.
+const u8* CScriptStringObject::GetData()
+{
+	return _flat == true ? _string.c_str() : _buffer->Data;
+}
+
+u32 CScriptStringObject::GetLength()
+{
+	return _length;
+}
+
+// Strings are immutable so we only ever need to calculate this once.
+u32 CScriptStringObject::GetHashCode()
+{
+	if (_hashCodeValid == false)
+	{
+		_hashCode	   = GetString().ToHashCode();
+		_hashCodeValid = true;
+	}
+	return _hashCode;
+}
+
+// Interned version of this string, or NULL if it was not created from one.
+CScriptInternedString* CScriptStringObject::GetInterned()
+{
+	return _interned;
+}
+
 // Casting.
 bool CScriptStringObject::CoerceToInt(CScriptExecutionContext* context, s32& result)
 {
-	result = _string.ToInt();
+	result = GetString().ToInt();
 	return true;
 }
 
 bool CScriptStringObject::CoerceToFloat(CScriptExecutionContext* context, f32& result)
 {
-	result = _string.ToFloat();
+	result = GetString().ToFloat();
 	return true;
 }
 
 bool CScriptStringObject::CoerceToString(CScriptExecutionContext* context, Engine::Containers::CString& result)
 {
-	result = _string;
+	result = GetString();
 	return true;
 }
 
 bool CScriptStringObject::CoerceToBool(CScriptExecutionContext* context, bool& result)
 {
-	result = (_string != "");
+	result = (_length > 0);
 	return true;
 }
 
@@ -61,7 +218,16 @@ bool CScriptStringObject::CoerceToBool(CScriptExecutionContext* context, bool& r
 bool CScriptStringObject::Assign(CScriptExecutionContext* context, CScriptValue& dest)
 {
 	dest.Type = SCRIPT_VALUE_TYPE_OBJECT;
-	dest.Object = GetScriptAllocator()->NewObj<CScriptStringObject>(context, _string);
+	if (_flat == true)
+	{
+		dest.Object = context->NewObject<CScriptStringObject>(_string);
+	}
+	else
+	{
+		CScriptStringObject* copy = context->NewObject<CScriptStringObject>(_buffer);
+		copy->_length = _length;
+		dest.Object = copy;
+	}
 	context->GCAdd(dest.Object);
 
 	return true;
@@ -69,13 +235,43 @@ bool CScriptStringObject::Assign(CScriptExecutionContext* context, CScriptValue&
 
 bool CScriptStringObject::Add(CScriptExecutionContext* context, CScriptValue& lvalue, CScriptValue& rvalue)
 {
+	// Read other strings directly rather than coercing them, which would flatten them.
 	Engine::Containers::CString str = "";
-	if (!rvalue.Object->CoerceToString(context, str))
-		return false;
+	const u8* data = NULL;
+	u32 length = 0;
+
+	CScriptStringObject* other = typeid(*rvalue.Object) == typeid(CScriptStringObject) ? static_cast<CScriptStringObject*>(rvalue.Object) : NULL;
+	if (other != NULL)
+	{
+		data   = other->GetData();
+		length = other->GetLength();
+	}
+	else
+	{
+		if (!rvalue.Object->CoerceToString(context, str))
+			return false;
+
+		data   = str.c_str();
+		length = str.Length();
+	}
 
 	// Special casting is done with strings so we can assume the dest value will be a string as well.;
 	lvalue.Type = SCRIPT_VALUE_TYPE_OBJECT;
-	lvalue.Object = GetScriptAllocator()->NewObj<CScriptStringObject>(context,  _string + str);
+
+	// Small strings just live in the CString's inline storage.
+	if (_length + length < SCRIPT_STRING_BUILDER_MIN_LENGTH)
+	{
+		Engine::Containers::CString result(GetData(), _length);
+		result += Engine::Containers::CString(data, length);
+		lvalue.Object = context->NewObject<CScriptStringObject>(result);
+	}
+	else
+	{
+		CScriptStringBuffer* buffer = GetAppendBuffer(_length + length);
+		AppendBuffer(buffer, data, length);
+		lvalue.Object = context->NewObject<CScriptStringObject>(buffer);
+	}
+
 	context->GCAdd(lvalue.Object);
 
 	return true;
@@ -85,15 +281,31 @@ bool CScriptStringObject::Mul(CScriptExecutionContext* context, CScriptValue& lv
 {	
 	s32 val = context->CoerceValueToInt(rvalue);
 
-	Engine::Containers::CString str = "";
-	while (val > 0)
+	lvalue.Type = SCRIPT_VALUE_TYPE_OBJECT;
+
+	// Large results are built straight into a buffer of the final size.
+	u32 count = val > 0 ? (u32)val : 0;
+	if (_length * count >= SCRIPT_STRING_BUILDER_MIN_LENGTH)
 	{
-		str += _string;
-		val--;
+		CScriptStringBuffer* buffer = CreateBuffer(_length * count);
+		const u8* data = GetData();
+		for (u32 i = 0; i < count; i++)
+			AppendBuffer(buffer, data, _length);
+
+		lvalue.Object = context->NewObject<CScriptStringObject>(buffer);
+	}
+	else
+	{
+		Engine::Containers::CString str = "";
+		while (val > 0)
+		{
+			str += GetString();
+			val--;
+		}
+
+		lvalue.Object = context->NewObject<CScriptStringObject>(str);
 	}
 
-	lvalue.Type = SCRIPT_VALUE_TYPE_OBJECT;
-	lvalue.Object = GetScriptAllocator()->NewObj<CScriptStringObject>(context, str);
 	context->GCAdd(lvalue.Object);
 
 	return true;
@@ -109,22 +321,23 @@ bool CScriptStringObject::Mod(CScriptExecutionContext* context, CScriptValue& lv
 	}
 
 	CScriptListObject* list = dynamic_cast<CScriptListObject*>(rvalue.Object);
+	const Engine::Containers::CString& source = GetString();
 
 	// Format the output.
 	s32 formatIndex = -1;
 	Engine::Containers::CString output = "";
 
-	for (u32 i = 0; i < _string.Length(); i++)
+	for (u32 i = 0; i < source.Length(); i++)
 	{
-		u8 chr = _string[i];
-		if (chr == '%' && i < _string.Length() - 1)
+		u8 chr = source[i];
+		if (chr == '%' && i < source.Length() - 1)
 		{
-			if (_string[i + 1] != '%')
+			if (source[i + 1] != '%')
 			{
 				Engine::Containers::CString format = "";
-				while (i < _string.Length())
+				while (i < source.Length())
 				{
-					u8 formatChr = _string[i++];
+					u8 formatChr = source[i++];
 					format += formatChr;
 
 					if (formatChr == 'c' || formatChr == 'd' || formatChr == 'i' || formatChr == 'e' || formatChr == 'E' ||
@@ -232,7 +445,7 @@ bool CScriptStringObject::Mod(CScriptExecutionContext* context, CScriptValue& lv
 
 	// Return the output string.
 	lvalue.Type = SCRIPT_VALUE_TYPE_OBJECT;
-	lvalue.Object = GetScriptAllocator()->NewObj<CScriptStringObject>(context, output);
+	lvalue.Object = context->NewObject<CScriptStringObject>(output);
 	context->GCAdd(lvalue.Object);
 
 	return true;
@@ -243,7 +456,7 @@ bool CScriptStringObject::Mod(CScriptExecutionContext* context, CScriptValue& lv
 bool CScriptStringObject::Cmp(CScriptExecutionContext* context, const CScriptValue& dest, s32& result)
 {
 	Engine::Containers::CString str = context->CoerceValueToString(dest);
-	result = (_string == str);
+	result = (GetString() == str);
 	return true;
 }
 
@@ -252,11 +465,14 @@ bool CScriptStringObject::GetIndex(CScriptExecutionContext* context, CScriptValu
 {
 	s32 realIndex = context->CoerceValueToInt(index);
 
-	if (realIndex < 0 || realIndex >= (s32)_string.Length())
+	if (realIndex < 0 || realIndex >= (s32)_length)
+	{
 		context->InvalidIndex(dest, realIndex);
+		return true;
+	}
 
 	dest.Type = SCRIPT_VALUE_TYPE_OBJECT;
-	dest.Object = GetScriptAllocator()->NewObj<CScriptStringObject>(context, _string[realIndex]);
+	dest.Object = context->NewObject<CScriptStringObject>(Engine::Containers::CString(GetData()[realIndex]));
 	context->GCAdd(dest.Object);
 
 	return true;
@@ -13,6 +13,10 @@
 using namespace Engine::Scripting::Symbols;
 using namespace Engine::Scripting::Instructions;
 
+// Strings shorter than this fit in the CString's own inline buffer so are always kept 
+// flat, anything longer built by concatenation is kept in a string buffer.
+#define SCRIPT_STRING_BUILDER_MIN_LENGTH	STRING_ALLOC_START
+
 namespace Engine
 {
     namespace Scripting
@@ -20,19 +24,64 @@ namespace Engine
 		namespace Objects
 		{
 
+			// Append only character buffer shared by the strings built from it. Every string 
+			// viewing it holds a reference and sees the first n characters of it. As strings
+			// are immutable, only the string whose length matches the buffers (the last one
+			// built) may append to it, anything else has to copy to a new buffer first.
+			struct CScriptStringBuffer
+			{
+				u32		RefCount;
+				u32		Length;
+				u32		Capacity;
+				u8*		Data;
+			};
+
 			// String object! Stores the current state of a string.
+			//
+			// Strings are either flat (a CString) or a view of a string buffer. Concatenating
+			// onto the end of a buffer string appends to the buffer in place, so building a 
+			// string up in a loop is linear rather than copying the whole string every time. 
+			// Buffer strings are only flattened when something needs them as a CString.
 			class CScriptStringObject : public CScriptObject
 			{
 			private:
-				Engine::Containers::CString _string;
+				Engine::Containers::CString _string;		// Only valid if _flat is set.
+				CScriptStringBuffer*		_buffer;
+				u32							_length;
+				bool						_flat;
+				u32							_hashCode;
+				bool						_hashCodeValid;
+				CScriptInternedString*		_interned;
+
+				static CScriptStringBuffer*	CreateBuffer	(u32 capacity);
+				static void					AppendBuffer	(CScriptStringBuffer* buffer, const u8* data, u32 length);
+				static void					ReleaseBuffer	(CScriptStringBuffer* buffer);
+
+				// Returns a buffer this string can be appended to in place.
+				CScriptStringBuffer*		GetAppendBuffer	(u32 capacity);
 
 			public:
 
 				CScriptStringObject									(CScriptExecutionContext* context, const Engine::Containers::CString& str);
+				CScriptStringObject									(CScriptExecutionContext* context, CScriptInternedString* str);
+				CScriptStringObject									(CScriptExecutionContext* context, CScriptStringBuffer* buffer);
+
+				virtual void Finalize								(CScriptExecutionContext* context);
 
 				// Metadata.
 				virtual Engine::Containers::CString	GetName			();
 
+				// Snapshots, strings are written whole in their header.
+				virtual ScriptSnapshotObjectType	GetSnapshotType		();
+				virtual void						WriteSnapshotHeader	(CScriptSnapshotWriter* writer);
+
+				// Accessors. GetString flattens the string, the rest don't.
+				const Engine::Containers::CString&	GetString		();
+				const u8*							GetData			();
+				u32									GetLength		();
+				u32									GetHashCode		();
+				CScriptInternedString*				GetInterned		();
+
 				// Casting.
 				virtual bool						CoerceToInt		(CScriptExecutionContext* context, s32& result);
 				virtual bool						CoerceToFloat	(CScriptExecutionContext* context, f32& result);
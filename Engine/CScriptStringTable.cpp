@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#include "CScriptStringTable.h"
+#include "CScriptManager.h"
+
+using namespace Engine::Scripting;
+
+CScriptStringTable* Engine::Scripting::g_script_string_table = NULL;
+
+void Engine::Scripting::InitScriptStringTable()
+{
+	Engine::Scripting::g_script_string_table = GetScriptAllocator()->NewObj<CScriptStringTable>();
+}
+
+void Engine::Scripting::FreeScriptStringTable()
+{
+	GetScriptAllocator()->FreeObj(&Engine::Scripting::g_script_string_table);
+	Engine::Scripting::g_script_string_table = NULL;
+}
+
+CScriptStringTable::CScriptStringTable()
+{
+}
+
+CScriptStringTable::~CScriptStringTable()
+{
+	for (u32 i = 0; ; i++)
+	{
+		Engine::Containers::CHashTableValue<CScriptInternedString*>* bucket = _strings.AtIndex(i);
+		if (bucket == NULL)
+			break;
+
+		CScriptInternedString* str = bucket->Value;
+		while (str != NULL)
+		{
+			CScriptInternedString* next = str->Next;
+			GetScriptAllocator()->FreeObj(&str);
+			str = next;
+		}
+	}
+	_strings.Clear();
+}
+
+// Returns the interned version of the given string, adding it to
+// the table if it dosen't already exist.
+CScriptInternedString* CScriptStringTable::Intern(const Engine::Containers::CString& str)
+{
+	u32 hash = str.ToHashCode();
+
+	_mutex.Lock();
+
+	// Already interned?
+	CScriptInternedString* head = NULL;
+	Engine::Containers::CHashTableValue<CScriptInternedString*>* bucket = _strings.FromHash(hash);
+	if (bucket != NULL)
+	{
+		head = bucket->Value;
+		for (CScriptInternedString* entry = head; entry != NULL; entry = entry->Next)
+		{
+			if (entry->String == str)
+			{
+				_mutex.Unlock();
+				return entry;
+			}
+		}
+	}
+
+	// Nope, add it to the front of the bucket.
+	CScriptInternedString* entry = GetScriptAllocator()->NewObj<CScriptInternedString>();
+	entry->String	= str;
+	entry->HashCode = hash;
+	entry->Next		= head;
+
+	if (bucket != NULL)
+		bucket->Value = entry;
+	else
+		_strings.Insert(hash, entry);
+
+	_mutex.Unlock();
+
+	return entry;
+}
+
+// Returns the interned version of the given string or NULL
+// if it has not been interned.
+CScriptInternedString* CScriptStringTable::Find(const Engine::Containers::CString& str)
+{
+	u32 hash = str.ToHashCode();
+
+	_mutex.Lock();
+
+	CScriptInternedString* result = NULL;
+	Engine::Containers::CHashTableValue<CScriptInternedString*>* bucket = _strings.FromHash(hash);
+	if (bucket != NULL)
+	{
+		for (CScriptInternedString* entry = bucket->Value; entry != NULL; entry = entry->Next)
+		{
+			if (entry->String == str)
+			{
+				result = entry;
+				break;
+			}
+		}
+	}
+
+	_mutex.Unlock();
+
+	return result;
+}
@@ -0,0 +1,54 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Conditionals.h"
+#include "Platform.h"
+
+#include "CString.h"
+#include "CHashTable.h"
+#include "CMutex.h"
+
+namespace Engine
+{
+    namespace Scripting
+    {
+		class CScriptStringTable;
+
+		// An interned string. Only one of these ever exists for each unique string, so
+		// two interned strings can be compared for equality by just comparing pointers.
+		class CScriptInternedString
+		{
+			public:
+				Engine::Containers::CString		String;
+				u32								HashCode;
+				CScriptInternedString*			Next;		// Next string in the same hash bucket.
+		};
+
+		// Global table of interned strings used by the scripting runtime for identifiers
+		// and string literals. Strings are never removed from the table until it is freed.
+		class CScriptStringTable
+		{
+			private:
+				Engine::Threading::CMutex									_mutex;
+				Engine::Containers::CHashTable<CScriptInternedString*>		_strings;
+
+			public:
+				CScriptStringTable						();
+				~CScriptStringTable						();
+
+				CScriptInternedString*	Intern			(const Engine::Containers::CString& str);
+				CScriptInternedString*	Find			(const Engine::Containers::CString& str);
+
+		};
+
+		// Global string table!
+		extern CScriptStringTable* g_script_string_table;
+		void InitScriptStringTable();
+		void FreeScriptStringTable();
+		inline CScriptStringTable* GetScriptStringTable() { return Engine::Scripting::g_script_string_table; }
+
+	}
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////////////
+//  Icarus Game Engine
+//  Copyright  2011 Timothy Leonard
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Conditionals.h"
+#include "Platform.h"
+
+#include "CTaskJob.h"
+
+#include "CScriptVirtualMachine.h"
+
+namespace Engine
+{
+    namespace Scripting
+    {
+
+		// Task job used by the virtual machine to run a batch of execution 
+		// contexts on a worker thread. Contexts quicken their own copy of the
+		// instructions and hand natives back to the virtual machines thread,
+		// so any number of these can run at once.
+		class CScriptTaskJob : public Engine::Core::Tasks::Jobs::CTaskJob
+		{
+			private:
+				CScriptExecutionContext**	_contexts;
+				u32							_count;
+				f32							_timeslice;
+
+			public:
+
+				CScriptTaskJob()
+				{
+					_contexts  = NULL;
+					_count	   = 0;
+					_timeslice = 0;
+				}
+
+				void Setup(CScriptExecutionContext** contexts, u32 count, f32 timeslice)
+				{
+					_contexts  = contexts;
+					_count	   = count;
+					_timeslice = timeslice;
+				}
+
+				virtual void Run()
+				{
+					for (u32 i = 0; i < _count; i++)
+					{
+						_contexts[i]->Run(_timeslice);
+					}
+				}
+
+		};
+
+	}
+}
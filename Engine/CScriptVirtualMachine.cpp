@@ -17,24 +17,110 @@
 // Include our automatically generated scripting glue.
 #include "ScriptGlue.h"
 
+#include "CTaskManager.h"
+#include "CScriptTaskJob.h"
+#include "CScriptSnapshot.h"
+
+#include "CStream.h"
+#include "CMemoryStream.h"
+
 using namespace Engine::Scripting;
 using namespace Engine::Scripting::Instructions;
 using namespace Engine::Scripting::Objects;
 
+// Dispatch macros for the interpreter core. With threaded dispatch each handler
+// fetches and jumps directly to the next handler, otherwise we break out of the
+// switch and go back round the main loop. Handlers that can change the current
+// call frame use the _FRAME version which reloads it first.
+#ifdef SCRIPT_VM_THREADED_DISPATCH
+	#define SCRIPT_VM_OPCODE(op)		case SCRIPT_OPCODE_##op: opcode_##op:
+	#define SCRIPT_VM_DISPATCH()		{																\
+											if (executed >= budget)										\
+												goto finished;											\
+											instruction = &_instructions[context->PC++];				\
+											executed++;													\
+											goto *dispatchTable[(u32)instruction->Opcode];				\
+										}
+#else
+	#define SCRIPT_VM_OPCODE(op)		case SCRIPT_OPCODE_##op:
+	#define SCRIPT_VM_DISPATCH()		break
+#endif
+
+// Quickening macros. Generic arithmetic handlers use SCRIPT_VM_QUICKEN to rewrite the 
+// current instruction into its type specialized variant if both operands were the same 
+// primitive type. Specialized handlers use SCRIPT_VM_DEOPTIMIZE to rewrite the instruction
+// back to the generic version and re-execute it when they see a type they don't handle.
+#define SCRIPT_VM_QUICKEN(op, destType, srcType)														\
+										if (destType == srcType)										\
+										{																\
+											if (destType == SCRIPT_VALUE_TYPE_INT)						\
+												instruction->Opcode = SCRIPT_OPCODE_##op##II;			\
+											else if (destType == SCRIPT_VALUE_TYPE_FLOAT)				\
+												instruction->Opcode = SCRIPT_OPCODE_##op##FF;			\
+										}
+#define SCRIPT_VM_DEOPTIMIZE(op)		{																\
+											instruction->Opcode = SCRIPT_OPCODE_##op;					\
+											context->PC--;												\
+											executed--;													\
+											SCRIPT_VM_DISPATCH();										\
+										}
+
+#define SCRIPT_VM_DISPATCH_FRAME()		{																\
+											context = _currentContext;									\
+											if (_callStack.Size() <= stopDepth ||						\
+												_callStack.Size() == _waitDepth)						\
+												goto finished;											\
+											SCRIPT_VM_DISPATCH();										\
+										}
+
+// Hands the current frame to its native code if its function has been compiled. Used
+// where the interpreter moves into a frame (calls, returns) and on loop back edges. A
+// suspended frame (waiting) is never entered, the interpreter loop exits on it instead.
+#ifdef SCRIPT_VM_JIT
+	#define SCRIPT_VM_ENTER_COMPILED()	{																\
+											if (executed < budget && _callStack.Size() > stopDepth &&	\
+												_callStack.Size() != _waitDepth &&						\
+												_currentContext->Symbol != NULL &&						\
+												Engine::Platform::AtomicLoadPointer((void**)&_currentContext->Symbol->Compiled) != NULL) \
+												executed += RunCompiledCode(budget - executed);			\
+										}
+#else
+	#define SCRIPT_VM_ENTER_COMPILED()
+#endif
+
 // CScriptExecutionContext ---------------------------------------------------
 
 CScriptExecutionContext::CScriptExecutionContext(CScriptCompileContext* context)
 {
 	_context			  = context;
 	_globalScopeRun		  = false;
+	_marshalNatives		  = false;
 
 	_currentContext		  = NULL;
 	_gcLastRun			  = 0;
+	_gcRunCount			  = 0;
+	_gcBudget			  = SCRIPT_VM_GC_STEP_BUDGET;
+	_gcCollecting		  = false;
+	_gcGeneration		  = 0;
+	_gcCursor			  = NULL;
 
 	_instructionsExecuted = 0;
 	_instructionTimer	  = (f32)Engine::Platform::GetMillisecs();
+	_profiler			  = NULL;
+
+	_nativeFunction					= NULL;
+	_nativeFunctionParameterCount	= 0;
+	_nativeParameterBase			= 0;
+
+	_waitType		= SCRIPT_WAIT_NONE;
+	_waitDepth		= 0;
+	_waitUntil		= 0;
+	_waitSlot		= 0;
+	_waitEventHash	= 0;
+	_waitTask		= -1;
 
 	_state								= NULL;
+	_stateHashTable						= NULL;
 	_globalScopeSymbolHashTableCreated	= false;
 
 	// Allocate globals table.
@@ -57,18 +143,28 @@ CScriptExecutionContext::CScriptExecutionContext(CScriptCompileContext* context)
 		}
 	}		
 
-	// Copy instructions into flat array (more cache friendly).
-	_instructions = GetScriptAllocator()->AllocArray<Instructions::CScriptInstruction*>(context->_instructions.Size());
-	for (u32 i = 0; i < context->_instructions.Size(); i++)
+	// Take our own copy of the packed instruction stream. Quickening rewrites instructions 
+	// in place, so the compile contexts stream (shared between every execution context 
+	// created from it, which may be running on other threads) is left untouched.
+	_instructionCount = context->_instructions.Size();
+	_instructions	  = GetScriptAllocator()->AllocArray<Instructions::CScriptPackedInstruction>(_instructionCount);
+	_debugInfo		  = context->GetInstructionDebugInfo();
+
+	Instructions::CScriptPackedInstruction* packed = context->GetPackedInstructions();
+	for (u32 i = 0; i < _instructionCount; i++)
 	{
-		_instructions[i] = context->_instructions[i];
+		_instructions[i] = packed[i];
 	}
 	
-	// Copy symbols into flat array (more cache friendly).
-	_symbols = GetScriptAllocator()->AllocArray<Symbols::CScriptSymbol*>(context->_symbols.Size());
+	// Copy symbols into flat array (more cache friendly), and intern all their 
+	// names so we can use them for attribute lookups.
+	_symbols		 = GetScriptAllocator()->AllocArray<Symbols::CScriptSymbol*>(context->_symbols.Size());
+	_internedSymbols = GetScriptAllocator()->AllocArray<CScriptInternedString*>(context->_symbols.Size());
 	for (u32 i = 0; i < context->_symbols.Size(); i++)
 	{
 		_symbols[i] = context->_symbols[i];
+		_internedSymbols[i] = (_symbols[i]->GetType() == SCRIPT_SYMBOL_TYPE_JUMPTARGET ? NULL : GetScriptStringTable()->Intern(_symbols[i]->GetIdentifier()));
+
 		if (_symbols[i]->GetType() == SCRIPT_SYMBOL_TYPE_STATE &&
 			dynamic_cast<CScriptStateSymbol*>(_symbols[i])->IsDefault == true)
 		{
@@ -76,12 +172,26 @@ CScriptExecutionContext::CScriptExecutionContext(CScriptCompileContext* context)
 		}
 	}
 
+	// Inline caches are only allocated for attribute access and call instructions, and only
+	// once they actually get executed.
+	_inlineCaches	  = GetScriptAllocator()->AllocArray<CScriptInlineCache*>(_instructionCount);
+	for (u32 i = 0; i < _instructionCount; i++)
+	{
+		_inlineCaches[i] = NULL;
+	}
+
 	// Create the GC pool.
 	for (u32 i = 0; i < SCRIPT_MAX_GC_GENERATIONS; i++)
 	{
 		_gcObjectPool[i] = NULL;
 		_gcObjectPoolDirty[i] = false;
 	}
+
+	// Create the slab pools.
+	for (u32 i = 0; i < SCRIPT_VM_POOL_SIZE_CLASSES; i++)
+	{
+		_pools[i] = GetScriptAllocator()->NewObj<Engine::Memory::Allocators::CPoolAllocator>("Script Pool", GetScriptAllocator(), SCRIPT_VM_POOL_MIN_BLOCK_SIZE << i);
+	}
 }
 
 CScriptExecutionContext::~CScriptExecutionContext()
@@ -90,6 +200,7 @@ CScriptExecutionContext::~CScriptExecutionContext()
 
 	// Dispose of scope hash tables.
 	_globalScopeHashTable.Clear();
+	_eventCache.Clear();
 	for (u32 i = 0; i < _stateScopeHashTable.Size(); i++)
 	{
 		Engine::Containers::CHashTable<CScriptSymbol*>* subArray = _stateScopeHashTable[i];
@@ -101,6 +212,14 @@ CScriptExecutionContext::~CScriptExecutionContext()
 	_callStack.Clear();
 	_parameterStack.Clear();
 
+	// Dispose of undelivered messages.
+	for (u32 i = 0; i < _messages.Size(); i++)
+	{
+		CScriptMessage* message = _messages[i];
+		GetScriptAllocator()->FreeObj(&message);
+	}
+	_messages.Clear();
+
 	if (_globals != NULL)
 		GetScriptAllocator()->FreeArray(&_globals);
 	
@@ -109,10 +228,25 @@ CScriptExecutionContext::~CScriptExecutionContext()
 	
 	if (_instructions != NULL)
 		GetScriptAllocator()->FreeArray(&_instructions);
-	
+
+	_debugInfo	  = NULL;
+
 	if (_symbols != NULL)
 		GetScriptAllocator()->FreeArray(&_symbols);
 
+	if (_internedSymbols != NULL)
+		GetScriptAllocator()->FreeArray(&_internedSymbols);
+
+	if (_inlineCaches != NULL)
+	{
+		for (u32 i = 0; i < _instructionCount; i++)
+		{
+			if (_inlineCaches[i] != NULL)
+				GetScriptAllocator()->FreeObj(&_inlineCaches[i]);
+		}
+		GetScriptAllocator()->FreeArray(&_inlineCaches);
+	}
+
 	// Dispose the GC pool.
 	for (u32 i = 0; i < SCRIPT_MAX_GC_GENERATIONS; i++)
 	{
@@ -120,1147 +254,1609 @@ CScriptExecutionContext::~CScriptExecutionContext()
 		while (obj != NULL)
 		{
 			CScriptObject* next = obj->_next;
-			GetScriptAllocator()->FreeObj(&obj);
+			GCFree(obj);
 			obj = next;
 		}
 	}
+
+	// Dispose the slab pools (this releases any locals still held by the call stack).
+	for (u32 i = 0; i < SCRIPT_VM_POOL_SIZE_CLASSES; i++)
+	{
+		GetScriptAllocator()->FreeObj(&_pools[i]);
+	}
 }
 
-// Executs the next instruction in the context, returns true if 
-// we are giving up the rest of our timeslice, or false if we want
-// to continue running.
-bool CScriptExecutionContext::Execute()
+// Executes instructions in the context until either the instruction budget
+// runs out or the call stack unwinds to the given depth. Returns the number of
+// instructions that were executed.
+u32 CScriptExecutionContext::Execute(u32 budget, u32 stopDepth)
 {
-	// Grab the context we are executing on.
-	CScriptCallContext* context = _currentContext;
-	
-	// Instruction valid?
-	//LOG_ASSERT(context->PC < _context->_instructions.Size());
-	CScriptInstruction* instruction = _instructions[context->PC++];
+#ifdef SCRIPT_VM_THREADED_DISPATCH
+	// Address of each opcodes handler, generated from opcodes.def so it
+	// always lines up with the opcode enumeration.
+	static void* const dispatchTable[] = 
+	{
+		#define X(v) &&opcode_##v,
+		#include "opcodes.def"
+		#undef X
+	};
+#endif
 
-	// Keep track of instructions executed.
-	_instructionsExecuted++;
+	// Nothing to run?
+	if (_currentContext == NULL || _callStack.Size() <= stopDepth || _callStack.Size() == _waitDepth)
+		return 0;
 
-	// Run the GC?
-	if (_instructionsExecuted - _gcLastRun == SCRIPT_VM_GC_INTERVAL)
-	{
-		GCExecute();
-		_gcLastRun = _instructionsExecuted;
-	}
+	if (_profiler != NULL)
+		_profiler->Enter();
 
-	// Debug output.
-//	printf("EXECUTED[%i] %s\n", context->PC - 1, Instructions::ScriptInstructionOpCodes_String[instruction->Opcode]);
+	// Grab the context we are executing on.
+	CScriptCallContext*			context		= _currentContext;
+	CScriptPackedInstruction*	instruction = NULL;
+	u32							executed	= 0;
 
-	// Massive Switch Block! GOOO!
-	switch (instruction->Opcode)
+	while (executed < budget)
 	{
-		// --------------------------------------------------------------------------------------------
-		// Load / Store
-		// ------------------------------------------------ --------------------------------------------
-		case SCRIPT_OPCODE_LDI:			// load reg, int
-			{
-				u32 dstRegister = instruction->Operands[0].RegisterIndex;
-				s32 value       = instruction->Operands[1].IntLiteral;
+		// Instruction valid?
+		//LOG_ASSERT(context->PC < _context->_instructions.Size());
+		instruction = &_instructions[context->PC++];
+		executed++;
 
-				context->Registers[dstRegister].Type		= SCRIPT_VALUE_TYPE_INT;
-				context->Registers[dstRegister].IntValue	= value;
-			}
-			break;
+		// Debug output.
+	//	printf("EXECUTED[%i] %s\n", context->PC - 1, Instructions::ScriptInstructionOpCodes_String[instruction->Opcode]);
 
-		case SCRIPT_OPCODE_LDF:			// load	reg, float
-			{
-				u32 dstRegister = instruction->Operands[0].RegisterIndex;
-				f32 value       = instruction->Operands[1].FloatLiteral;
+		// Massive Switch Block! GOOO!
+		switch (instruction->Opcode)
+		{
+			// --------------------------------------------------------------------------------------------
+			// Load / Store
+			// ------------------------------------------------ --------------------------------------------
+			SCRIPT_VM_OPCODE(LDI)			// load reg, int
+				{
+					u32 dstRegister = instruction->A;
+					s32 value       = instruction->IntLiteral;
 
-				context->Registers[dstRegister].Type		= SCRIPT_VALUE_TYPE_FLOAT;
-				context->Registers[dstRegister].FloatValue	= value;
-			}
-			break;
+					context->Registers[dstRegister].Type		= SCRIPT_VALUE_TYPE_INT;
+					context->Registers[dstRegister].IntValue	= value;
+				}
+				SCRIPT_VM_DISPATCH();
+
+			SCRIPT_VM_OPCODE(LDF)			// load	reg, float
+				{
+					u32 dstRegister = instruction->A;
+					f32 value       = instruction->FloatLiteral;
+
+					context->Registers[dstRegister].Type		= SCRIPT_VALUE_TYPE_FLOAT;
+					context->Registers[dstRegister].FloatValue	= value;
+				}
+				SCRIPT_VM_DISPATCH();
 			
-		case SCRIPT_OPCODE_LDS:			// loadstring	reg, index
-			{
-				u32 dstRegister						= instruction->Operands[0].RegisterIndex;
-				Engine::Containers::CString& value  = instruction->Operands[1].Symbol->GetToken().Literal;
+			SCRIPT_VM_OPCODE(LDS)			// loadstring	reg, index
+				{
+					u32 dstRegister						= instruction->A;
+					CScriptInternedString* value		= _internedSymbols[instruction->Index];
 
-				CScriptStringObject* strObj			= Engine::Scripting::GetScriptAllocator()->NewObj<CScriptStringObject>(this, value);
-				GCAdd(strObj);
+					CScriptStringObject* strObj			= NewObject<CScriptStringObject>(value);
+					GCAdd(strObj);
 
-				context->Registers[dstRegister].Type	= SCRIPT_VALUE_TYPE_OBJECT;
-				context->Registers[dstRegister].Object	= strObj;
-			}
-			break;
+					context->Registers[dstRegister].Type	= SCRIPT_VALUE_TYPE_OBJECT;
+					context->Registers[dstRegister].Object	= strObj;
+				}
+				SCRIPT_VM_DISPATCH();
 			
-		case SCRIPT_OPCODE_LDN:			// loadnull	reg
-			{
-				u32 dstRegister = instruction->Operands[0].RegisterIndex;
+			SCRIPT_VM_OPCODE(LDN)			// loadnull	reg
+				{
+					u32 dstRegister = instruction->A;
 
-				context->Registers[dstRegister].Type = SCRIPT_VALUE_TYPE_NULL;
-			}
-			break;
+					context->Registers[dstRegister].Type = SCRIPT_VALUE_TYPE_NULL;
+				}
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_LFUNC:		// loadfunc    reg, index
-			{
-				u32 dstRegister = instruction->Operands[0].RegisterIndex;
-				u32 index       = instruction->Operands[1].IntLiteral;
+			SCRIPT_VM_OPCODE(LFUNC)		// loadfunc    reg, index
+				{
+					u32 dstRegister = instruction->A;
+					u32 index       = instruction->IntLiteral;
 
-				context->Registers[dstRegister] = _functionTable[index];
-			}
-			break;
+					context->Registers[dstRegister] = _functionTable[index];
+				}
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_SFUNC:		// storefunc   reg, index, value
-			{
-				u32 dstRegister = instruction->Operands[0].RegisterIndex;
-				u32 index       = instruction->Operands[1].IntLiteral;
+			SCRIPT_VM_OPCODE(SFUNC)		// storefunc   reg, index, value
+				{
+					u32 dstRegister = instruction->A;
+					u32 index       = instruction->IntLiteral;
 				
-				AssignTo(_functionTable[index], context->Registers[dstRegister]);
-			}
-			break;
+					AssignTo(_functionTable[index], context->Registers[dstRegister]);
+				}
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_LLOCAL:		// loadlocal   reg, index
-			{
-				u32 dstRegister = instruction->Operands[0].RegisterIndex;
-				u32 index       = instruction->Operands[1].IntLiteral;
+			SCRIPT_VM_OPCODE(LLOCAL)		// loadlocal   reg, index
+				{
+					u32 dstRegister = instruction->A;
+					u32 index       = instruction->IntLiteral;
 
-				context->Registers[dstRegister] = context->Locals[index];
-			}
-			break;
+					context->Registers[dstRegister] = context->Locals[index];
+				}
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_SLOCAL:		// storelocal  reg, index, value
-			{
-				u32 dstRegister = instruction->Operands[0].RegisterIndex;
-				u32 index       = instruction->Operands[1].IntLiteral;
+			SCRIPT_VM_OPCODE(SLOCAL)		// storelocal  reg, index, value
+				{
+					u32 dstRegister = instruction->A;
+					u32 index       = instruction->IntLiteral;
 
-				AssignTo(context->Locals[index], context->Registers[dstRegister]);
-			}
-			break;
+					AssignTo(context->Locals[index], context->Registers[dstRegister]);
+				}
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_LGLOBAL:		// loadglobal  reg, index
-			{
-				u32 dstRegister = instruction->Operands[0].RegisterIndex;
-				u32 index       = instruction->Operands[1].IntLiteral;
+			SCRIPT_VM_OPCODE(LGLOBAL)		// loadglobal  reg, index
+				{
+					u32 dstRegister = instruction->A;
+					u32 index       = instruction->IntLiteral;
 
-				context->Registers[dstRegister] = _globals[index];
-			}
-			break;
+					context->Registers[dstRegister] = _globals[index];
+				}
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_SGLOBAL:		// storeglobal reg, index, value
-			{
-				u32 dstRegister = instruction->Operands[0].RegisterIndex;
-				u32 index       = instruction->Operands[1].IntLiteral;
+			SCRIPT_VM_OPCODE(SGLOBAL)		// storeglobal reg, index, value
+				{
+					u32 dstRegister = instruction->A;
+					u32 index       = instruction->IntLiteral;
 
-				AssignTo(_globals[index], context->Registers[dstRegister]);
-			}
-			break;
+					AssignTo(_globals[index], context->Registers[dstRegister]);
+				}
+				SCRIPT_VM_DISPATCH();
 
-		// --------------------------------------------------------------------------------------------
-		// Arithmatic
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_MOV:			// mov dest, src
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			// --------------------------------------------------------------------------------------------
+			// Arithmatic
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(MOV)			// mov dest, src
+				{
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				dest = src;
-			}
-			break;
+					dest = src;
+				}
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_ADD:			// add dest, src
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(ADD)			// add dest, src
+				{
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				// Perform coercion of arguments.
-				ImplicitCast(dest, src);
+					ScriptValueType destType = dest.Type;
+					ScriptValueType srcType  = src.Type;
+					bool			stringOperands = (destType == SCRIPT_VALUE_TYPE_OBJECT && typeid(*dest.Object) == typeid(CScriptStringObject) &&
+													  srcType  == SCRIPT_VALUE_TYPE_OBJECT && typeid(*src.Object)  == typeid(CScriptStringObject));
 
-				switch (dest.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		+= src.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		+= src.FloatValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->Add(this, dest, src))
-							break;
-					default:						Error(S("Attempt to perform addition on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
-				}
-			}
-			break;
+					// Perform coercion of arguments.
+					ImplicitCast(dest, src);
 
-		case SCRIPT_OPCODE_SUB:			// sub dest, src
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		+= src.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		+= src.FloatValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->Add(this, dest, src))
+								break;
+						default:						Error(S("Attempt to perform addition on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 
-				// Perform coercion of arguments.
-				ImplicitCast(dest, src);
+					// Specialize for these operand types.
+					SCRIPT_VM_QUICKEN(ADD, destType, srcType);
+					if (stringOperands == true)
+						instruction->Opcode = SCRIPT_OPCODE_ADDSS;
+				}
+				SCRIPT_VM_DISPATCH();
 
-				switch (dest.Type)
+			SCRIPT_VM_OPCODE(SUB)			// sub dest, src
 				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		-= src.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		-= src.FloatValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->Sub(this, dest, src))
-							break;
-					default:						Error(S("Attempt to perform subtraction on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
-				}
-			}
-			break;
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-		case SCRIPT_OPCODE_MUL:			// mul dest, src
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+					ScriptValueType destType = dest.Type;
+					ScriptValueType srcType  = src.Type;
 
-				// Perform coercion of arguments.
-				ImplicitCast(dest, src);
+					// Perform coercion of arguments.
+					ImplicitCast(dest, src);
 
-				switch (dest.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		*= src.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		*= src.FloatValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->Mul(this, dest, src))
-							break;
-					default:						Error(S("Attempt to perform multiplication on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		-= src.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		-= src.FloatValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->Sub(this, dest, src))
+								break;
+						default:						Error(S("Attempt to perform subtraction on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
+
+					// Specialize for these operand types.
+					SCRIPT_VM_QUICKEN(SUB, destType, srcType);
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_DIV:			// div dest, src
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(MUL)			// mul dest, src
+				{
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				// Perform coercion of arguments.
-				ImplicitCast(dest, src);
+					ScriptValueType destType = dest.Type;
+					ScriptValueType srcType  = src.Type;
 
-				switch (dest.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		/= src.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		/= src.FloatValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->Div(this, dest, src))
-							break;
-					default:						Error(S("Attempt to perform division on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					// Perform coercion of arguments.
+					ImplicitCast(dest, src);
+
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		*= src.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		*= src.FloatValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->Mul(this, dest, src))
+								break;
+						default:						Error(S("Attempt to perform multiplication on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
+
+					// Specialize for these operand types.
+					SCRIPT_VM_QUICKEN(MUL, destType, srcType);
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_INC:			// inc dest
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				
-				switch (dest.Type)
+			SCRIPT_VM_OPCODE(DIV)			// div dest, src
 				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		+= 1;	break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		+= 1;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->Inc(this, dest))
-							break;
-					default:						Error(S("Attempt to perform increment on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					ScriptValueType destType = dest.Type;
+					ScriptValueType srcType  = src.Type;
+
+					// Perform coercion of arguments.
+					ImplicitCast(dest, src);
+
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		/= src.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		/= src.FloatValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->Div(this, dest, src))
+								break;
+						default:						Error(S("Attempt to perform division on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
+
+					// Specialize for these operand types.
+					SCRIPT_VM_QUICKEN(DIV, destType, srcType);
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_DEC:			// dec dest
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				
-				switch (dest.Type)
+			SCRIPT_VM_OPCODE(INC)			// inc dest
 				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		-= 1;	break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		-= 1;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->Dec(this, dest))
-							break;
-					default:						Error(S("Attempt to perform increment on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					CScriptValue& dest = context->Registers[instruction->A];
+				
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		+= 1;	break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		+= 1;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->Inc(this, dest))
+								break;
+						default:						Error(S("Attempt to perform increment on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_NEG:			// neg dest
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				
-				switch (dest.Type)
+			SCRIPT_VM_OPCODE(DEC)			// dec dest
 				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		= -dest.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		= -dest.FloatValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->Neg(this, dest))
-							break;
-					default:						Error(S("Attempt to perform negatation on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					CScriptValue& dest = context->Registers[instruction->A];
+				
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		-= 1;	break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		-= 1;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->Dec(this, dest))
+								break;
+						default:						Error(S("Attempt to perform increment on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_ABS:			// abs dest
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
+			SCRIPT_VM_OPCODE(NEG)			// neg dest
+				{
+					CScriptValue& dest = context->Registers[instruction->A];
 				
-				switch (dest.Type)
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		= -dest.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		= -dest.FloatValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->Neg(this, dest))
+								break;
+						default:						Error(S("Attempt to perform negatation on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
+				}
+				SCRIPT_VM_DISPATCH();
+
+			SCRIPT_VM_OPCODE(ABS)			// abs dest
 				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		= dest.IntValue >= 0 ? dest.IntValue : -dest.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		= dest.FloatValue >= 0 ? dest.FloatValue : -dest.FloatValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->Abs(this, dest))
-							break;
-					default:						Error(S("Attempt to perform absolution on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					CScriptValue& dest = context->Registers[instruction->A];
+				
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		= dest.IntValue >= 0 ? dest.IntValue : -dest.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		= dest.FloatValue >= 0 ? dest.FloatValue : -dest.FloatValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->Abs(this, dest))
+								break;
+						default:						Error(S("Attempt to perform absolution on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_MOD:			// mod dest, src=			
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(MOD)			// mod dest, src=			
+				{
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				// Perform coercion of arguments.
-				//ImplicitCast(dest, src);
+					// Perform coercion of arguments.
+					//ImplicitCast(dest, src);
 
-				switch (dest.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue %= src.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:		
-						if (dest.Object->Mod(this, src, dest))
-							break;
-					default:						Error(S("Attempt to perform modulus on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue %= src.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:		
+							if (dest.Object->Mod(this, src, dest))
+								break;
+						default:						Error(S("Attempt to perform modulus on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_BWOR:		// bwor	 dest, src
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(BWOR)		// bwor	 dest, src
+				{
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				// Perform coercion of arguments.
-				//ImplicitCast(dest, src);
+					// Perform coercion of arguments.
+					//ImplicitCast(dest, src);
 
-				switch (dest.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue |= src.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->BWOr(this, src, dest))
-							break;
-					default:						Error(S("Attempt to perform bitwise or on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue |= src.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->BWOr(this, src, dest))
+								break;
+						default:						Error(S("Attempt to perform bitwise or on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_BWXOR:		// bwxor dest, src
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(BWXOR)		// bwxor dest, src
+				{
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				// Perform coercion of arguments.
-				//ImplicitCast(dest, src);
+					// Perform coercion of arguments.
+					//ImplicitCast(dest, src);
 
-				switch (dest.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue ^= src.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->BWXor(this, src, dest))
-							break;
-					default:						Error(S("Attempt to perform bitwise xor on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue ^= src.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->BWXor(this, src, dest))
+								break;
+						default:						Error(S("Attempt to perform bitwise xor on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_BWAND:		// bwand dest, src
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(BWAND)		// bwand dest, src
+				{
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				// Perform coercion of arguments.
-				//ImplicitCast(dest, src);
+					// Perform coercion of arguments.
+					//ImplicitCast(dest, src);
 
-				switch (dest.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue &= src.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:		
-						if (dest.Object->BWAnd(this, src, dest))
-							break;
-					default:						Error(S("Attempt to perform bitwise and on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue &= src.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:		
+							if (dest.Object->BWAnd(this, src, dest))
+								break;
+						default:						Error(S("Attempt to perform bitwise and on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_BWNOT:		// bwnot dest
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-
-				switch (dest.Type)
+			SCRIPT_VM_OPCODE(BWNOT)		// bwnot dest
 				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue = !dest.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:		
-						if (dest.Object->BWNot(this, dest))
-							break;
-					default:						Error(S("Attempt to perform bitwise not on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					CScriptValue& dest = context->Registers[instruction->A];
+
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue = !dest.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:		
+							if (dest.Object->BWNot(this, dest))
+								break;
+						default:						Error(S("Attempt to perform bitwise not on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_BWSHL:		// bwshl dest, src
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(BWSHL)		// bwshl dest, src
+				{
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				// Perform coercion of arguments.
-				//ImplicitCast(dest, src);
+					// Perform coercion of arguments.
+					//ImplicitCast(dest, src);
 
-				switch (dest.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue <<= src.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->BWShl(this, src, dest))
-							break;
-					default:						Error(S("Attempt to perform bitwise shift left on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue <<= src.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->BWShl(this, src, dest))
+								break;
+						default:						Error(S("Attempt to perform bitwise shift left on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_BWSHR:		// bwshr dest, src
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(BWSHR)		// bwshr dest, src
+				{
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				// Perform coercion of arguments.
-				//ImplicitCast(dest, src);
+					// Perform coercion of arguments.
+					//ImplicitCast(dest, src);
 
-				switch (dest.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		dest.IntValue >>= src.IntValue;	break;
-					case SCRIPT_VALUE_TYPE_OBJECT:		
-						if (dest.Object->BWShr(this, src, dest))
-							break;
-					default:						Error(S("Attempt to perform bitwise shift right on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue >>= src.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:		
+							if (dest.Object->BWShr(this, src, dest))
+								break;
+						default:						Error(S("Attempt to perform bitwise shift right on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		// --------------------------------------------------------------------------------------------
-		// Branching
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_JMP:			// jmp	 address
-			{
-				context->PC = instruction->Operands[0].InstructionIndex;
-				break;
-			}
+			// --------------------------------------------------------------------------------------------
+			// Branching
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(JMP)			// jmp	 address
+				{
+					// Loops go back into native code once their function has been compiled.
+					if (instruction->Index < context->PC)
+					{
+						context->PC = instruction->Index;
+						SCRIPT_VM_ENTER_COMPILED();
+						SCRIPT_VM_DISPATCH_FRAME();
+					}
 
-		case SCRIPT_OPCODE_JEQ:			// jeq	 address
-			{
-				if (context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue == 0)
+					context->PC = instruction->Index;
+					SCRIPT_VM_DISPATCH();
+				}
+
+			SCRIPT_VM_OPCODE(JEQ)			// jeq	 address
 				{
-					context->PC = instruction->Operands[0].InstructionIndex;
+					if (context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue == 0)
+					{
+						context->PC = instruction->Index;
+					}
+					SCRIPT_VM_DISPATCH();
 				}
-				break;
-			}
 
-		case SCRIPT_OPCODE_JL:			// jl	 address
-			{
-				if (context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue < 0)
+			SCRIPT_VM_OPCODE(JL)			// jl	 address
 				{
-					context->PC = instruction->Operands[0].InstructionIndex;
+					if (context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue < 0)
+					{
+						context->PC = instruction->Index;
+					}
+					SCRIPT_VM_DISPATCH();
 				}
-				break;
-			}
 
-		case SCRIPT_OPCODE_JG:			// jg	 address
-			{
-				if (context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue > 0)
+			SCRIPT_VM_OPCODE(JG)			// jg	 address
 				{
-					context->PC = instruction->Operands[0].InstructionIndex;
+					if (context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue > 0)
+					{
+						context->PC = instruction->Index;
+					}
+					SCRIPT_VM_DISPATCH();
 				}
-				break;
-			}
 
-		case SCRIPT_OPCODE_JLE:			// jle	 address
-			{
-				if (context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue <= 0)
+			SCRIPT_VM_OPCODE(JLE)			// jle	 address
 				{
-					context->PC = instruction->Operands[0].InstructionIndex;
+					if (context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue <= 0)
+					{
+						context->PC = instruction->Index;
+					}
+					SCRIPT_VM_DISPATCH();
 				}
-				break;
-			}
 
-		case SCRIPT_OPCODE_JGE:			// jge	 address
-			{
-				if (context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue >= 0)
+			SCRIPT_VM_OPCODE(JGE)			// jge	 address
 				{
-					context->PC = instruction->Operands[0].InstructionIndex;
+					if (context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue >= 0)
+					{
+						context->PC = instruction->Index;
+					}
+					SCRIPT_VM_DISPATCH();
 				}
-				break;
-			}
 
-		case SCRIPT_OPCODE_JNE:			// jne	 address
-			{
-				if (context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue != 0)
+			SCRIPT_VM_OPCODE(JNE)			// jne	 address
 				{
-					context->PC = instruction->Operands[0].InstructionIndex;
+					if (context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue != 0)
+					{
+						context->PC = instruction->Index;
+					}
+					SCRIPT_VM_DISPATCH();
 				}
-				break;
-			}
 
-		case SCRIPT_OPCODE_CMP:			// cmp	 reg1, reg2
-			{		
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(CMP)			// cmp	 reg1, reg2
+				{		
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					// Specialize for these operand types.
+					SCRIPT_VM_QUICKEN(CMP, dest.Type, src.Type);
 
-				context->Registers[SCRIPT_CONST_REGISTER_CMP].Type	 = SCRIPT_VALUE_TYPE_INT;
-				context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue = CompareValues(dest, src);
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].Type	 = SCRIPT_VALUE_TYPE_INT;
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue = CompareValues(dest, src);
 				
-				break;
-			}
+					SCRIPT_VM_DISPATCH();
+				}
 
-		case SCRIPT_OPCODE_IEQ:			// ieq	 reg1, reg2
-			{		
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(IEQ)			// ieq	 reg1, reg2
+				{		
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				dest.IntValue = CompareValues(dest, src) == 0 ? 1 : 0;
-				dest.Type	  = SCRIPT_VALUE_TYPE_INT;
+					dest.IntValue = CompareValues(dest, src) == 0 ? 1 : 0;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
 				
-				break;
-			}
+					SCRIPT_VM_DISPATCH();
+				}
 
-		case SCRIPT_OPCODE_IL:			// il	 reg1, reg2
-			{		
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(IL)			// il	 reg1, reg2
+				{		
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 				
-				dest.IntValue = CompareValues(dest, src) < 0 ? 1 : 0;
-				dest.Type	  = SCRIPT_VALUE_TYPE_INT;
+					dest.IntValue = CompareValues(dest, src) < 0 ? 1 : 0;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
 
-				break;
-			}
+					SCRIPT_VM_DISPATCH();
+				}
 
-		case SCRIPT_OPCODE_IG:			// ig	 reg1, reg2
-			{		
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(IG)			// ig	 reg1, reg2
+				{		
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 				
-				dest.IntValue = CompareValues(dest, src) > 0 ? 1 : 0;
-				dest.Type	  = SCRIPT_VALUE_TYPE_INT;
+					dest.IntValue = CompareValues(dest, src) > 0 ? 1 : 0;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
 
-				break;
-			}
+					SCRIPT_VM_DISPATCH();
+				}
 
-		case SCRIPT_OPCODE_ILE:			// ile	 reg1, reg2
-			{		
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(ILE)			// ile	 reg1, reg2
+				{		
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 				
-				dest.IntValue = CompareValues(dest, src) <= 0 ? 1 : 0;
-				dest.Type	  = SCRIPT_VALUE_TYPE_INT;
+					dest.IntValue = CompareValues(dest, src) <= 0 ? 1 : 0;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
 
-				break;
-			}
+					SCRIPT_VM_DISPATCH();
+				}
 
-		case SCRIPT_OPCODE_IGE:			// ige	 reg1, reg2
-			{		
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(IGE)			// ige	 reg1, reg2
+				{		
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 				
-				dest.IntValue = CompareValues(dest, src) >= 0 ? 1 : 0;
-				dest.Type	  = SCRIPT_VALUE_TYPE_INT;
+					dest.IntValue = CompareValues(dest, src) >= 0 ? 1 : 0;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
 
-				break;
-			}
+					SCRIPT_VM_DISPATCH();
+				}
 
-		case SCRIPT_OPCODE_INE:			// ine	 reg1, reg2
-			{		
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(INE)			// ine	 reg1, reg2
+				{		
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 				
-				dest.IntValue = CompareValues(dest, src) != 0 ? 1 : 0;
-				dest.Type	  = SCRIPT_VALUE_TYPE_INT;
+					dest.IntValue = CompareValues(dest, src) != 0 ? 1 : 0;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
 
-				break;
-			}			
+					SCRIPT_VM_DISPATCH();
+				}			
 
-		// --------------------------------------------------------------------------------------------
-		// Boolean Logic
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_LAND:		// land	 reg1, reg2
-			{		
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			// --------------------------------------------------------------------------------------------
+			// Boolean Logic
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(LAND)		// land	 reg1, reg2
+				{		
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				bool srcValid  = false;
-				bool destValid = false;
+					bool srcValid  = false;
+					bool destValid = false;
 
-				switch (src.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		srcValid = (src.IntValue != 0);				break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	srcValid = (src.FloatValue != 0);			break;
-					case SCRIPT_VALUE_TYPE_NULL:	srcValid = false;							break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (src.Object->CoerceToBool(this, srcValid))
-							break;
-					default:						Error(S("Attempt to perform logical and on invalid data type '%s'.").Format(GetDataTypeName(src).c_str()), instruction);	break;
-				}
+					switch (src.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		srcValid = (src.IntValue != 0);				break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	srcValid = (src.FloatValue != 0);			break;
+						case SCRIPT_VALUE_TYPE_NULL:	srcValid = false;							break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (src.Object->CoerceToBool(this, srcValid))
+								break;
+						default:						Error(S("Attempt to perform logical and on invalid data type '%s'.").Format(GetDataTypeName(src).c_str()), instruction);	break;
+					}
 				
-				switch (dest.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		destValid = (dest.IntValue != 0);			break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	destValid = (dest.FloatValue != 0);			break;
-					case SCRIPT_VALUE_TYPE_NULL:	destValid = false;							break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->CoerceToBool(this, destValid))
-							break;
-					default:						Error(S("Attempt to perform logical and on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
-				}
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		destValid = (dest.IntValue != 0);			break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	destValid = (dest.FloatValue != 0);			break;
+						case SCRIPT_VALUE_TYPE_NULL:	destValid = false;							break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->CoerceToBool(this, destValid))
+								break;
+						default:						Error(S("Attempt to perform logical and on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 
-				dest.Type	   = SCRIPT_VALUE_TYPE_INT;
-				dest.IntValue = srcValid == true && destValid == true ? 1 : 0;
+					dest.Type	   = SCRIPT_VALUE_TYPE_INT;
+					dest.IntValue = srcValid == true && destValid == true ? 1 : 0;
 
-				break;
-			}	
+					SCRIPT_VM_DISPATCH();
+				}	
 		
-		case SCRIPT_OPCODE_LOR:			// lor	 reg1, reg2
-			{		
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& src  = context->Registers[instruction->Operands[1].RegisterIndex];
+			SCRIPT_VM_OPCODE(LOR)			// lor	 reg1, reg2
+				{		
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				bool srcValid  = false;
-				bool destValid = false;
+					bool srcValid  = false;
+					bool destValid = false;
 
-				switch (src.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		srcValid = (src.IntValue != 0);				break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	srcValid = (src.FloatValue != 0);			break;
-					case SCRIPT_VALUE_TYPE_NULL:	srcValid = false;							break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (src.Object->CoerceToBool(this, srcValid))
-							break;
-					default:						Error(S("Attempt to perform logical and on invalid data type '%s'.").Format(GetDataTypeName(src).c_str()), instruction);	break;
-				}
+					switch (src.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		srcValid = (src.IntValue != 0);				break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	srcValid = (src.FloatValue != 0);			break;
+						case SCRIPT_VALUE_TYPE_NULL:	srcValid = false;							break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (src.Object->CoerceToBool(this, srcValid))
+								break;
+						default:						Error(S("Attempt to perform logical and on invalid data type '%s'.").Format(GetDataTypeName(src).c_str()), instruction);	break;
+					}
 				
-				switch (dest.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		destValid = (dest.IntValue != 0);			break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	destValid = (dest.FloatValue != 0);			break;
-					case SCRIPT_VALUE_TYPE_NULL:	destValid = false;							break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->CoerceToBool(this, destValid))
-							break;
-					default:						Error(S("Attempt to perform logical or on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
-				}
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		destValid = (dest.IntValue != 0);			break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	destValid = (dest.FloatValue != 0);			break;
+						case SCRIPT_VALUE_TYPE_NULL:	destValid = false;							break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->CoerceToBool(this, destValid))
+								break;
+						default:						Error(S("Attempt to perform logical or on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 
-				dest.Type	   = SCRIPT_VALUE_TYPE_INT;
-				dest.IntValue = srcValid == true || destValid == true ? 1 : 0;
+					dest.Type	   = SCRIPT_VALUE_TYPE_INT;
+					dest.IntValue = srcValid == true || destValid == true ? 1 : 0;
 
-				break;
-			}	
+					SCRIPT_VM_DISPATCH();
+				}	
 
-		case SCRIPT_OPCODE_LNOT:		// lnot	 reg1
-			{		
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
+			SCRIPT_VM_OPCODE(LNOT)		// lnot	 reg1
+				{		
+					CScriptValue& dest = context->Registers[instruction->A];
 
-				bool destValid = false;
+					bool destValid = false;
 
-				switch (dest.Type)
-				{
-					case SCRIPT_VALUE_TYPE_INT:		destValid = (dest.IntValue != 0);			break;
-					case SCRIPT_VALUE_TYPE_FLOAT:	destValid = (dest.FloatValue != 0);			break;
-					case SCRIPT_VALUE_TYPE_NULL:	destValid = false;							break;
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->CoerceToBool(this, destValid))
-							break;
-					default:						Error(S("Attempt to perform logical not on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
-				}
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		destValid = (dest.IntValue != 0);			break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	destValid = (dest.FloatValue != 0);			break;
+						case SCRIPT_VALUE_TYPE_NULL:	destValid = false;							break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->CoerceToBool(this, destValid))
+								break;
+						default:						Error(S("Attempt to perform logical not on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 
-				dest.Type	  = SCRIPT_VALUE_TYPE_INT;
-				dest.IntValue = destValid == true ? 0 : 1;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
+					dest.IntValue = destValid == true ? 0 : 1;
 
-				break;
-			}	
+					SCRIPT_VM_DISPATCH();
+				}	
 
-		// --------------------------------------------------------------------------------------------
-		// Subscript
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_IDX:			// idx	reg1, reg2					- Get symbol at index.
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& idx  = context->Registers[instruction->Operands[1].RegisterIndex];
-				
-				switch (dest.Type)
+			// --------------------------------------------------------------------------------------------
+			// Subscript
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(IDX)			// idx	reg1, reg2					- Get symbol at index.
 				{
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->GetIndex(this, dest, idx))
-							break;
-					default:	Error(S("Attempt to perform subscript on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& idx  = context->Registers[instruction->B];
+				
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->GetIndex(this, dest, idx))
+								break;
+						default:	Error(S("Attempt to perform subscript on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 				}
-			}
-			break;
+				SCRIPT_VM_DISPATCH();
 
-		case SCRIPT_OPCODE_IDXS:		// idx	reg1, reg2, valuereg 		- Set symbol at index.
-			{
-				CScriptValue& dest = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& idx  = context->Registers[instruction->Operands[1].RegisterIndex];
-				CScriptValue& val  = context->Registers[instruction->Operands[2].RegisterIndex];
+			SCRIPT_VM_OPCODE(IDXS)		// idx	reg1, reg2, valuereg 		- Set symbol at index.
+				{
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& idx  = context->Registers[instruction->B];
+					CScriptValue& val  = context->Registers[instruction->C];
 				
-				switch (dest.Type)
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->SetIndex(this, dest, idx, val))
+								break;
+						default:	Error(S("Attempt to perform subscript on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
+				}
+				SCRIPT_VM_DISPATCH();
+
+			// --------------------------------------------------------------------------------------------
+			// Lists
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(LISTNEW)		// listnew register
 				{
-					case SCRIPT_VALUE_TYPE_OBJECT:	
-						if (dest.Object->SetIndex(this, dest, idx, val))
-							break;
-					default:	Error(S("Attempt to perform subscript on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					u32 dstRegister			   = instruction->A;
+
+					CScriptListObject* listObj = NewObject<CScriptListObject>();
+					GCAdd(listObj);
+
+					context->Registers[dstRegister].Type	= SCRIPT_VALUE_TYPE_OBJECT;
+					context->Registers[dstRegister].Object	= listObj;
+
+					SCRIPT_VM_DISPATCH();
 				}
-			}
-			break;
 
-		// --------------------------------------------------------------------------------------------
-		// Lists
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_LISTNEW:		// listnew register
-			{
-				u32 dstRegister			   = instruction->Operands[0].RegisterIndex;
+			SCRIPT_VM_OPCODE(LISTADD)		// listadd register, value_register	
+				{
+					CScriptValue& listRegister = context->Registers[instruction->A];
+					CScriptValue& valRegister  = context->Registers[instruction->B];
+
+					if (listRegister.Type == SCRIPT_VALUE_TYPE_OBJECT &&
+						typeid(CScriptListObject) == typeid(*listRegister.Object))
+					{					
+						CScriptListObject* list = dynamic_cast<CScriptListObject*>(listRegister.Object);
+						list->AddItem(this, valRegister);
+					}
+					else
+					{
+						Error(S("Attempt to add item to list of invalid data type '%s'.").Format(GetDataTypeName(listRegister).c_str()), instruction);
+					}
 
-				CScriptListObject* listObj = Engine::Scripting::GetScriptAllocator()->NewObj<CScriptListObject>(this);
-				GCAdd(listObj);
+					SCRIPT_VM_DISPATCH();
+				}
+			
+			// --------------------------------------------------------------------------------------------
+			// Dictionaries
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(DICTNEW)		// dictnew register
+				{
+					u32 dstRegister			   = instruction->A;
 
-				context->Registers[dstRegister].Type	= SCRIPT_VALUE_TYPE_OBJECT;
-				context->Registers[dstRegister].Object	= listObj;
+					CScriptDictObject* listObj = NewObject<CScriptDictObject>();
+					GCAdd(listObj);
 
-				break;
-			}
+					context->Registers[dstRegister].Type	= SCRIPT_VALUE_TYPE_OBJECT;
+					context->Registers[dstRegister].Object	= listObj;
 
-		case SCRIPT_OPCODE_LISTADD:		// listadd register, value_register	
-			{
-				CScriptValue& listRegister = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& valRegister  = context->Registers[instruction->Operands[1].RegisterIndex];
+					SCRIPT_VM_DISPATCH();
+				}
+
+			SCRIPT_VM_OPCODE(DICTADD)		// dictadd register, key_register, value_register
+				{
+					CScriptValue& listRegister = context->Registers[instruction->A];
+					CScriptValue& keyRegister  = context->Registers[instruction->B];
+					CScriptValue& valRegister  = context->Registers[instruction->C];
+
+					if (listRegister.Type == SCRIPT_VALUE_TYPE_OBJECT &&
+						typeid(CScriptDictObject) == typeid(*listRegister.Object))
+					{					
+						CScriptDictObject* list = dynamic_cast<CScriptDictObject*>(listRegister.Object);
+						list->AddItem(this, keyRegister, valRegister);
+					}
+					else
+					{
+						Error(S("Attempt to add item to dictionary of invalid data type '%s'.").Format(GetDataTypeName(listRegister).c_str()), instruction);
+					}
 
-				if (listRegister.Type == SCRIPT_VALUE_TYPE_OBJECT &&
-					typeid(CScriptListObject) == typeid(*listRegister.Object))
-				{					
-					CScriptListObject* list = dynamic_cast<CScriptListObject*>(listRegister.Object);
-					list->AddItem(this, valRegister);
+					SCRIPT_VM_DISPATCH();
 				}
-				else
+
+			// --------------------------------------------------------------------------------------------
+			// Indirection
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(INDR)		// indr reg1, symbol    - This takes the object in reg1 and returns the object with the same name as symbol inside it. eg. module.x would turn into indr module, x		
 				{
-					Error(S("Attempt to add item to list of invalid data type '%s'.").Format(GetDataTypeName(listRegister).c_str()), instruction);
+					CScriptValue&			objRegister	= context->Registers[instruction->A];
+					CScriptInternedString*	symbolName	= _internedSymbols[instruction->Index];
+
+					if (objRegister.Type == SCRIPT_VALUE_TYPE_OBJECT && objRegister.Object != NULL)
+					{					
+						CScriptObject*	object	= objRegister.Object;
+						s32				slot	= ResolveAttributeSlot(instruction, object, symbolName);
+						bool			success = (slot >= 0 ? object->GetAttributeSlot(this, objRegister, slot) : object->GetAttribute(this, objRegister, symbolName));
+
+						if (!success)
+						{
+							Error(S("Attempt to access invalid attribute '%s' of object '%s'.").Format(symbolName->String.c_str(), GetDataTypeName(objRegister).c_str()), instruction);
+						}
+					}
+					else
+					{
+						Error(S("Attempt to access attribute of invalid data type '%s'.").Format(GetDataTypeName(objRegister).c_str()), instruction);
+					}
+
+					SCRIPT_VM_DISPATCH();
 				}
+			SCRIPT_VM_OPCODE(INDRS)		// indrs reg1, symbol, valuereg   - Same as above, except it sets rather than gets the value.
+				{
+					CScriptValue&			objRegister		= context->Registers[instruction->A];
+					CScriptInternedString*	symbolName		= _internedSymbols[instruction->Index];
+					CScriptValue&			valueRegister	= context->Registers[instruction->B];
+
+					if (objRegister.Type == SCRIPT_VALUE_TYPE_OBJECT && objRegister.Object != NULL)
+					{					
+						CScriptObject*	object	= objRegister.Object;
+						s32				slot	= ResolveAttributeSlot(instruction, object, symbolName);
+						bool			success = (slot >= 0 ? object->SetAttributeSlot(this, slot, valueRegister) : object->SetAttribute(this, symbolName, valueRegister));
+
+						if (!success)
+						{
+							Error(S("Attempt to access invalid attribute '%s' of object '%s'.").Format(symbolName->String.c_str(), GetDataTypeName(objRegister).c_str()), instruction);
+						}
+					}
+					else
+					{
+						Error(S("Attempt to access attribute of invalid data type '%s'.").Format(GetDataTypeName(objRegister).c_str()), instruction);
+					}
 
-				break;
-			}
+					SCRIPT_VM_DISPATCH();
+				}
 			
-		// --------------------------------------------------------------------------------------------
-		// Dictionaries
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_DICTNEW:		// dictnew register
-			{
-				u32 dstRegister			   = instruction->Operands[0].RegisterIndex;
+			// --------------------------------------------------------------------------------------------
+			// Parameter Stack
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(PUSH)		// push register
+				{
+					CScriptValue& objRegister = context->Registers[instruction->A];				
+					_parameterStack.Push(objRegister);
+					SCRIPT_VM_DISPATCH();
+				}
 
-				CScriptDictObject* listObj = Engine::Scripting::GetScriptAllocator()->NewObj<CScriptDictObject>(this);
-				GCAdd(listObj);
+			// --------------------------------------------------------------------------------------------
+			// Invokation.
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(INVK)		// invk register, parametercount
+				{
+					CScriptValue& funcRegister = context->Registers[instruction->A];					
+					s32			  paramCount   = instruction->IntLiteral;	
 
-				context->Registers[dstRegister].Type	= SCRIPT_VALUE_TYPE_OBJECT;
-				context->Registers[dstRegister].Object	= listObj;
+					// Invoke native function.
+					bool success = false;
+					if (funcRegister.Type == SCRIPT_VALUE_TYPE_NATIVE_FUNCTION && funcRegister.NativeFunction != NULL)
+					{
+						InvokeNativeFunction(funcRegister.NativeFunction, paramCount);
+						success = true;
+					}
 
-				break;
-			}
+					// Invoke script function.
+					else if (funcRegister.Type == SCRIPT_VALUE_TYPE_FUNCTION && funcRegister.Symbol != NULL)
+					{
+						Symbols::CScriptFunctionSymbol* funcSymbol = ResolveCallTarget(instruction, funcRegister.Symbol);
+						if (funcSymbol != NULL)
+						{
+							success = InvokeFunction(funcSymbol, paramCount);
+						}
+						else
+						{
+							success = false;
+							Error(S("Attempt to invoke invalid data type '%s'.").Format(GetDataTypeName(funcRegister).c_str()));
+						}
+
+						//if (funcSymbol->IsGenerator == true)
+						//	funcRegister = context->Registers[SCRIPT_CONST_REGISTER_RETURN];
+					}
 
-		case SCRIPT_OPCODE_DICTADD:		// dictadd register, key_register, value_register
-			{
-				CScriptValue& listRegister = context->Registers[instruction->Operands[0].RegisterIndex];
-				CScriptValue& keyRegister  = context->Registers[instruction->Operands[1].RegisterIndex];
-				CScriptValue& valRegister  = context->Registers[instruction->Operands[2].RegisterIndex];
+					// Invoke object.
+					else if (funcRegister.Type == SCRIPT_VALUE_TYPE_OBJECT && funcRegister.Object != NULL)
+					{
+						success = funcRegister.Object->Invoke(this, paramCount);
+
+						_parameterStack.Pop(paramCount);
+
+					}
+					else
+					{
+						success = false;
+						Error(S("Attempt to invoke invalid data type '%s'.").Format(GetDataTypeName(funcRegister).c_str()));
+					}
 
-				if (listRegister.Type == SCRIPT_VALUE_TYPE_OBJECT &&
-					typeid(CScriptDictObject) == typeid(*listRegister.Object))
-				{					
-					CScriptDictObject* list = dynamic_cast<CScriptDictObject*>(listRegister.Object);
-					list->AddItem(this, keyRegister, valRegister);
+					SCRIPT_VM_ENTER_COMPILED();
+					SCRIPT_VM_DISPATCH_FRAME();
 				}
-				else
+			SCRIPT_VM_OPCODE(INVKNATIVE)	// invknative call
 				{
-					Error(S("Attempt to add item to dictionary of invalid data type '%s'.").Format(GetDataTypeName(listRegister).c_str()), instruction);
-				}
+					// Resolved at compile time. The index is range checked against the binding 
+					// table when compiled output is loaded from disk.
+					InvokeNativeFunction(&Native::Glue::BindingTable[SCRIPT_NATIVE_CALL_INDEX(instruction->Index)], SCRIPT_NATIVE_CALL_PARAMETERS(instruction->Index));
 
-				break;
-			}
+					// The native may have called back into script.
+					SCRIPT_VM_DISPATCH_FRAME();
+				}
+			SCRIPT_VM_OPCODE(RET)			// ret		OR		ret ret_val_reg
+				{				
+					if (instruction->OperandCount == 1)
+					{
+						CScriptValue retVal = context->Registers[instruction->A];
 
-		// --------------------------------------------------------------------------------------------
-		// Indirection
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_INDR:		// indr reg1, symbol    - This takes the object in reg1 and returns the object with the same name as symbol inside it. eg. module.x would turn into indr module, x		
-			{
-				CScriptValue& objRegister			   = context->Registers[instruction->Operands[0].RegisterIndex];
-				Engine::Containers::CString symbolName = CoerceToString(context->Registers[instruction->Operands[1].RegisterIndex]);
+						PopCallContext();
 
-				if (objRegister.Type == SCRIPT_VALUE_TYPE_OBJECT && objRegister.Object != NULL)
-				{					
-					if (!objRegister.Object->GetAttribute(this, objRegister, symbolName))
+						// Set the return value on the next lower call stack.
+						if (_callStack.Size() > 1)
+						{
+							_callStack[_callStack.Size() - 1].Registers[SCRIPT_CONST_REGISTER_RETURN] = retVal;
+						}
+					}
+					else
 					{
-						Error(S("Attempt to access invalid attribute '%s' of object '%s'.").Format(symbolName.c_str(), GetDataTypeName(objRegister).c_str()), instruction);
+						if (_currentContext->GeneratorIterator != NULL)
+						{
+							_currentContext->GeneratorIterator->CallbackComplete();
+						}
+						PopCallContext();
 					}
+
+					SCRIPT_VM_ENTER_COMPILED();
+					SCRIPT_VM_DISPATCH_FRAME();
 				}
-				else
+			
+			// --------------------------------------------------------------------------------------------
+			// Generators.
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(YIELD)		// yield valuereg
 				{
-					Error(S("Attempt to access attribute of invalid data type '%s'.").Format(GetDataTypeName(objRegister).c_str()), instruction);
+					CScriptValue retVal = context->Registers[instruction->A];
+				
+					if (_currentContext->GeneratorIterator != NULL)
+					{
+						_currentContext->GeneratorIterator->CallbackNext(*_currentContext, retVal);
+					}
+
+					PopCallContext();
+
+					SCRIPT_VM_DISPATCH_FRAME();
 				}
 
-				break;
-			}
-		case SCRIPT_OPCODE_INDRS:		// indrs reg1, symbol, valuereg   - Same as above, except it sets rather than gets the value.
-			{
-				CScriptValue& objRegister			   = context->Registers[instruction->Operands[0].RegisterIndex];
-				Engine::Containers::CString symbolName = CoerceToString(context->Registers[instruction->Operands[1].RegisterIndex]);
-				CScriptValue& valueRegister			   = context->Registers[instruction->Operands[2].RegisterIndex];
+			// --------------------------------------------------------------------------------------------
+			// Natives.
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(GETNATIVE)		// native valuereg
+				{
+					CScriptValue&				outReg		= context->Registers[instruction->A];	
+					Engine::Containers::CString symbolName	= CoerceToString(outReg);
 
-				if (objRegister.Type == SCRIPT_VALUE_TYPE_OBJECT && objRegister.Object != NULL)
-				{					
-					if (!objRegister.Object->SetAttribute(this, symbolName, valueRegister))
+					// Look for function first.
+					CScriptNativeFunction* func = _virtualMachine->FindNativeFunction(symbolName);
+					if (func != NULL)
 					{
-						Error(S("Attempt to access invalid attribute '%s' of object '%s'.").Format(symbolName.c_str(), GetDataTypeName(objRegister).c_str()), instruction);
+						outReg.Type				= SCRIPT_VALUE_TYPE_NATIVE_FUNCTION;
+						outReg.NativeFunction	= func;
+				
+						SCRIPT_VM_DISPATCH();
 					}
+				
+					// ERRROOOORZ.
+					Error(S("Undefined native symbol '%s'.").Format(symbolName.c_str()), instruction);
+					SCRIPT_VM_DISPATCH();
+				}
+			SCRIPT_VM_OPCODE(LDNATIVE)		// ldnative valuereg, index
+				{
+					// Index is range checked the same way as INVKNATIVE's.
+					CScriptValue& outReg	= context->Registers[instruction->A];	
+					outReg.Type				= SCRIPT_VALUE_TYPE_NATIVE_FUNCTION;
+					outReg.NativeFunction	= &Native::Glue::BindingTable[instruction->Index];
+					SCRIPT_VM_DISPATCH();
 				}
-				else
+			
+			// --------------------------------------------------------------------------------------------
+			// State code.
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(SETSTATE)	// setstate symbol
 				{
-					Error(S("Attempt to access attribute of invalid data type '%s'.").Format(GetDataTypeName(objRegister).c_str()), instruction);
+					ChangeState(reinterpret_cast<CScriptStateSymbol*>(_symbols[instruction->Index]));
+					SCRIPT_VM_DISPATCH();
 				}
-
-				break;
-			}
 			
-		// --------------------------------------------------------------------------------------------
-		// Parameter Stack
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_PUSH:		// push register
-			{
-				CScriptValue& objRegister = context->Registers[instruction->Operands[0].RegisterIndex];				
-				_parameterStack.AddToEnd(objRegister);
-				break;
-			}
+			// --------------------------------------------------------------------------------------------
+			// Dependencies.
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(LOADMODULE)	// loadmodule output_reg, name
+				{
 
-		// --------------------------------------------------------------------------------------------
-		// Invokation.
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_INVK:		// invk register, parametercount
-			{
-				CScriptValue& funcRegister = context->Registers[instruction->Operands[0].RegisterIndex];					
-				s32			  paramCount   = instruction->Operands[1].IntLiteral;	
+					SCRIPT_VM_DISPATCH();
+				}
 
-				// Invoke native function.
-				bool success = false;
-				if (funcRegister.Type == SCRIPT_VALUE_TYPE_NATIVE_FUNCTION && funcRegister.NativeFunction != NULL)
+			// --------------------------------------------------------------------------------------------
+			// Iteration.
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(ITERNEW)		// ITERNEW  context_reg, value_reg			:		Creates a iterator from value that can be iterated over.
 				{
-					_nativeFunctionParameterCount = paramCount;
-					_nativeFunctionIdentifier = funcRegister.NativeFunction->Name;
+					CScriptValue& outputreg = context->Registers[instruction->A];	
+					CScriptValue& valuereg = context->Registers[instruction->B];	
+						
+					// Check we have a valid object to iterate over.
+					if (valuereg.Type != SCRIPT_VALUE_TYPE_OBJECT)
+					{
+						UniterableObject(valuereg);
+						SCRIPT_VM_DISPATCH_FRAME();
+					}
 
-					funcRegister.NativeFunction->FunctionPtr(this);
-					
-					for (s32 i = 0; i < paramCount; i++)
+					// Create iterator based on type.
+					CScriptIteratorObject* iterObj = valuereg.Object->CreateIterator(this);
+					if (iterObj == NULL)
 					{
-						_parameterStack.RemoveFromEnd();
+						UniterableObject(valuereg);
+						SCRIPT_VM_DISPATCH_FRAME();
 					}
 
-					success = true;
+					// Return the iterator.
+					outputreg.Type = SCRIPT_VALUE_TYPE_OBJECT;
+					outputreg.Object = iterObj;
+
+					SCRIPT_VM_DISPATCH_FRAME();
 				}
+			
+			SCRIPT_VM_OPCODE(ITERDONE)		// ITERDONE output_reg, context_reg 
+				{
+					CScriptValue& outputreg = context->Registers[instruction->A];	
+					CScriptValue& contextreg = context->Registers[instruction->B];	
+
+					if (contextreg.Type != SCRIPT_VALUE_TYPE_OBJECT)
+					{
+						UniterableObject(contextreg);
+						SCRIPT_VM_DISPATCH();
+					}
+
+					CScriptIteratorObject* iterObj = dynamic_cast<CScriptIteratorObject*>(contextreg.Object);
+					if (iterObj == NULL)
+					{
+						UniterableObject(contextreg);
+						SCRIPT_VM_DISPATCH();
+					}
+
+					outputreg.Type		= SCRIPT_VALUE_TYPE_INT;
+					outputreg.IntValue	= (iterObj->IsFinished(this) ? 1 : 0);
 
-				// Invoke script function.
-				else if (funcRegister.Type == SCRIPT_VALUE_TYPE_FUNCTION && funcRegister.Symbol != NULL)
+					SCRIPT_VM_DISPATCH();
+				}
+			
+			SCRIPT_VM_OPCODE(ITERNEXT)		// ITERNEXT output_reg, context_reg
 				{
-					Symbols::CScriptFunctionSymbol* funcSymbol = dynamic_cast<CScriptFunctionSymbol*>(funcRegister.Symbol);
-					success = InvokeFunction(funcSymbol, paramCount);
+					CScriptValue& outputreg = context->Registers[instruction->A];	
+					CScriptValue& contextreg = context->Registers[instruction->B];	
+
+					if (contextreg.Type != SCRIPT_VALUE_TYPE_OBJECT)
+					{
+						UniterableObject(contextreg);
+						SCRIPT_VM_DISPATCH_FRAME();
+					}
 
-					//if (funcSymbol->IsGenerator == true)
-					//	funcRegister = context->Registers[SCRIPT_CONST_REGISTER_RETURN];
+					CScriptIteratorObject* iterObj = dynamic_cast<CScriptIteratorObject*>(contextreg.Object);
+					if (iterObj == NULL)
+					{
+						UniterableObject(contextreg);
+						SCRIPT_VM_DISPATCH_FRAME();
+					}
+
+					outputreg = iterObj->NextValue(this);
+
+					SCRIPT_VM_DISPATCH_FRAME();
 				}
+			
+			// --------------------------------------------------------------------------------------------
+			// Symbol type.
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(ISTYPE)		// istype output_reg, symbol
+				{
+					CScriptValue&				outReg		= context->Registers[instruction->A];	
+					Engine::Containers::CString symbolName	= _symbols[instruction->Index]->GetIdentifier();
+
+					symbolName = symbolName.ToLower();
+
+					if (symbolName == "int")
+					{
+						outReg.IntValue	= (outReg.Type == SCRIPT_VALUE_TYPE_INT) ? 1 : 0;
+						outReg.Type		= SCRIPT_VALUE_TYPE_INT;
+					}
+					else if (symbolName == "float")
+					{
+						outReg.IntValue   = (outReg.Type == SCRIPT_VALUE_TYPE_FLOAT) ? 1 : 0;
+						outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					}
+					else if (symbolName == "null" || (outReg.Type == SCRIPT_VALUE_TYPE_OBJECT && outReg.Object == NULL))
+					{
+						outReg.IntValue   = (outReg.Type == SCRIPT_VALUE_TYPE_NULL) ? 1 : 0;
+						outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					}
+					else if (symbolName == "symbol")
+					{
+						outReg.IntValue   = (outReg.Type == SCRIPT_VALUE_TYPE_SYMBOL) ? 1 : 0;
+						outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					}
+					else if (symbolName == "function")
+					{
+						outReg.IntValue   = (outReg.Type == SCRIPT_VALUE_TYPE_FUNCTION) ? 1 : 0;
+						outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					}
+					else if (symbolName == "object")
+					{
+						outReg.IntValue   = (outReg.Type == SCRIPT_VALUE_TYPE_OBJECT) ? 1 : 0;
+						outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					}
+					else if (outReg.Type == SCRIPT_VALUE_TYPE_OBJECT && outReg.Object != NULL)
+					{
+						outReg.IntValue   = (outReg.Object->GetName().ToLower() == symbolName || outReg.Object->DerivedFrom(this, symbolName));
+						outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					}
+					else
+					{
+						outReg.IntValue   = 0;
+						outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					}
 
-				// Invoke object.
-				else if (funcRegister.Type == SCRIPT_VALUE_TYPE_OBJECT && funcRegister.Object != NULL)
+					SCRIPT_VM_DISPATCH();
+				}
+			
+			SCRIPT_VM_OPCODE(ASTYPE)		// astype output_reg, symbol
 				{
-					success = funcRegister.Object->Invoke(this, paramCount);
+					CScriptValue&				outReg		= context->Registers[instruction->A];	
+					Engine::Containers::CString symbolName	= _symbols[instruction->Index]->GetIdentifier();
 
-					for (s32 i = 0; i < paramCount; i++)
+					symbolName = symbolName.ToLower();
+
+					bool success = true;
+
+					if (symbolName == "string")
+					{
+						CScriptStringObject* strObj	= NewObject<CScriptStringObject>(CoerceToString(outReg));
+						GCAdd(strObj);
+
+						outReg.Type		= SCRIPT_VALUE_TYPE_OBJECT;
+						outReg.Object	= strObj;
+					}
+					else if (symbolName == "int")
 					{
-						_parameterStack.RemoveFromEnd();
+						outReg.Type		= SCRIPT_VALUE_TYPE_INT;
+						outReg.IntValue	= CoerceToInt(outReg);
 					}
+					else if (symbolName == "float")
+					{
+						outReg.Type			= SCRIPT_VALUE_TYPE_FLOAT;
+						outReg.FloatValue	= CoerceToFloat(outReg);
+					}
+					else if (outReg.Type == SCRIPT_VALUE_TYPE_OBJECT && outReg.Object != NULL)
+					{
+						if (outReg.Object->GetName().ToLower() != symbolName && !outReg.Object->DerivedFrom(this, symbolName))
+						{
+							success = outReg.Object->CastTo(this, outReg, symbolName);
+						}
+					}
+					else
+					{
+						success = false;
+					}
+
+					// Not able to cast? D:
+					if (success == false)
+					{
+						InvalidCast(outReg, symbolName, instruction);
+					}		
 
+					SCRIPT_VM_DISPATCH();
 				}
-				else
+			
+			// --------------------------------------------------------------------------------------------
+			// Superinstructions
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(CMPJEQ)		// cmpjeq reg1, reg2, address
 				{
-					success = false;
-					Error(S("Attempt to invoke invalid data type '%s'.").Format(GetDataTypeName(funcRegister).c_str()));
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					s32 result = CompareValues(dest, src);
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].Type	   = SCRIPT_VALUE_TYPE_INT;
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue = result;
+
+					if (result == 0)
+					{
+						context->PC = instruction->Index;
+					}
+					SCRIPT_VM_DISPATCH();
 				}
 
-				break;
-			}
-		case SCRIPT_OPCODE_RET:			// ret		OR		ret ret_val_reg
-			{				
-				if (instruction->OperandCount == 1)
+			SCRIPT_VM_OPCODE(CMPJNE)		// cmpjne reg1, reg2, address
 				{
-					CScriptValue retVal = context->Registers[instruction->Operands[0].RegisterIndex];
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-					PopCallContext();
+					s32 result = CompareValues(dest, src);
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].Type	   = SCRIPT_VALUE_TYPE_INT;
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue = result;
 
-					// Set the return value on the next lower call stack.
-					if (_callStack.Size() > 1)
+					if (result != 0)
 					{
-						_callStack[_callStack.Size() - 1].Registers[SCRIPT_CONST_REGISTER_RETURN] = retVal;
+						context->PC = instruction->Index;
 					}
+					SCRIPT_VM_DISPATCH();
 				}
-				else
+
+			SCRIPT_VM_OPCODE(IEQJZ)	// ieqjz	 reg1, reg2, address
 				{
-					if (_currentContext->GeneratorIterator != NULL)
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					dest.IntValue = CompareValues(dest, src) == 0 ? 1 : 0;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
+
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].Type	   = SCRIPT_VALUE_TYPE_INT;
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue = dest.IntValue;
+
+					if (dest.IntValue == 0)
 					{
-						_currentContext->GeneratorIterator->CallbackComplete();
+						context->PC = instruction->Index;
 					}
-					PopCallContext();
+					SCRIPT_VM_DISPATCH();
 				}
 
-				break;
-			}
-			
-		// --------------------------------------------------------------------------------------------
-		// Generators.
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_YIELD:		// yield valuereg
-			{
-				CScriptValue retVal = context->Registers[instruction->Operands[0].RegisterIndex];
-				
-				if (_currentContext->GeneratorIterator != NULL)
+			SCRIPT_VM_OPCODE(ILJZ)		// iljz	 reg1, reg2, address
 				{
-					_currentContext->GeneratorIterator->CallbackNext(*_currentContext, retVal);
-				}
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				PopCallContext();
+					dest.IntValue = CompareValues(dest, src) < 0 ? 1 : 0;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
 
-				break;
-			}
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].Type	   = SCRIPT_VALUE_TYPE_INT;
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue = dest.IntValue;
 
-		// --------------------------------------------------------------------------------------------
-		// Natives.
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_GETNATIVE:		// native valuereg
-			{
-				CScriptValue&				outReg		= context->Registers[instruction->Operands[0].RegisterIndex];	
-				Engine::Containers::CString symbolName	= CoerceToString(outReg);
+					if (dest.IntValue == 0)
+					{
+						context->PC = instruction->Index;
+					}
+					SCRIPT_VM_DISPATCH();
+				}
 
-				// Look for function first.
-				CScriptNativeFunction* func = _virtualMachine->FindNativeFunction(symbolName);
-				if (func != NULL)
+			SCRIPT_VM_OPCODE(IGJZ)		// igjz	 reg1, reg2, address
 				{
-					outReg.Type				= SCRIPT_VALUE_TYPE_NATIVE_FUNCTION;
-					outReg.NativeFunction	= func;
-				
-					break;
-				}
-				
-				// ERRROOOORZ.
-				Error(S("Undefined native symbol '%s'.").Format(symbolName.c_str()), instruction);
-			}
-			
-		// --------------------------------------------------------------------------------------------
-		// State code.
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_SETSTATE:	// setstate symbol
-			{
-				ChangeState(reinterpret_cast<CScriptStateSymbol*>(instruction->Operands[0].Symbol));
-				break;
-			}
-			
-		// --------------------------------------------------------------------------------------------
-		// Dependencies.
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_LOADMODULE:	// loadmodule output_reg, name
-			{
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				break;
-			}
+					dest.IntValue = CompareValues(dest, src) > 0 ? 1 : 0;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
 
-		// --------------------------------------------------------------------------------------------
-		// Iteration.
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_ITERNEW:		// ITERNEW  context_reg, value_reg			:		Creates a iterator from value that can be iterated over.
-			{
-				CScriptValue& outputreg = context->Registers[instruction->Operands[0].RegisterIndex];	
-				CScriptValue& valuereg = context->Registers[instruction->Operands[1].RegisterIndex];	
-						
-				// Check we have a valid object to iterate over.
-				if (valuereg.Type != SCRIPT_VALUE_TYPE_OBJECT)
-				{
-					UniterableObject(valuereg);
-					break;
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].Type	   = SCRIPT_VALUE_TYPE_INT;
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue = dest.IntValue;
+
+					if (dest.IntValue == 0)
+					{
+						context->PC = instruction->Index;
+					}
+					SCRIPT_VM_DISPATCH();
 				}
 
-				// Create iterator based on type.
-				CScriptIteratorObject* iterObj = valuereg.Object->CreateIterator(this);
-				if (iterObj == NULL)
+			SCRIPT_VM_OPCODE(ILEJZ)	// ilejz	 reg1, reg2, address
 				{
-					UniterableObject(valuereg);
-					break;
-				}
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				// Return the iterator.
-				outputreg.Type = SCRIPT_VALUE_TYPE_OBJECT;
-				outputreg.Object = iterObj;
+					dest.IntValue = CompareValues(dest, src) <= 0 ? 1 : 0;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
 
-				break;
-			}
-			
-		case SCRIPT_OPCODE_ITERDONE:		// ITERDONE output_reg, context_reg 
-			{
-				CScriptValue& outputreg = context->Registers[instruction->Operands[0].RegisterIndex];	
-				CScriptValue& contextreg = context->Registers[instruction->Operands[1].RegisterIndex];	
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].Type	   = SCRIPT_VALUE_TYPE_INT;
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue = dest.IntValue;
 
-				if (contextreg.Type != SCRIPT_VALUE_TYPE_OBJECT)
-				{
-					UniterableObject(contextreg);
-					break;
+					if (dest.IntValue == 0)
+					{
+						context->PC = instruction->Index;
+					}
+					SCRIPT_VM_DISPATCH();
 				}
 
-				CScriptIteratorObject* iterObj = dynamic_cast<CScriptIteratorObject*>(contextreg.Object);
-				if (iterObj == NULL)
+			SCRIPT_VM_OPCODE(IGEJZ)	// igejz	 reg1, reg2, address
 				{
-					UniterableObject(contextreg);
-					break;
-				}
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				outputreg.Type		= SCRIPT_VALUE_TYPE_INT;
-				outputreg.IntValue	= (iterObj->IsFinished(this) ? 1 : 0);
+					dest.IntValue = CompareValues(dest, src) >= 0 ? 1 : 0;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
 
-				break;
-			}
-			
-		case SCRIPT_OPCODE_ITERNEXT:		// ITERNEXT output_reg, context_reg
-			{
-				CScriptValue& outputreg = context->Registers[instruction->Operands[0].RegisterIndex];	
-				CScriptValue& contextreg = context->Registers[instruction->Operands[1].RegisterIndex];	
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].Type	   = SCRIPT_VALUE_TYPE_INT;
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue = dest.IntValue;
 
-				if (contextreg.Type != SCRIPT_VALUE_TYPE_OBJECT)
-				{
-					UniterableObject(contextreg);
-					break;
+					if (dest.IntValue == 0)
+					{
+						context->PC = instruction->Index;
+					}
+					SCRIPT_VM_DISPATCH();
 				}
 
-				CScriptIteratorObject* iterObj = dynamic_cast<CScriptIteratorObject*>(contextreg.Object);
-				if (iterObj == NULL)
+			SCRIPT_VM_OPCODE(INEJZ)	// inejz	 reg1, reg2, address
 				{
-					UniterableObject(contextreg);
-					break;
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					dest.IntValue = CompareValues(dest, src) != 0 ? 1 : 0;
+					dest.Type	  = SCRIPT_VALUE_TYPE_INT;
+
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].Type	   = SCRIPT_VALUE_TYPE_INT;
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue = dest.IntValue;
+
+					if (dest.IntValue == 0)
+					{
+						context->PC = instruction->Index;
+					}
+					SCRIPT_VM_DISPATCH();
 				}
 
-				outputreg = iterObj->NextValue(this);
+			SCRIPT_VM_OPCODE(INCLOCAL)		// inclocal reg, index
+				{
+					CScriptValue& dest  = context->Registers[instruction->A];
+					CScriptValue& local = context->Locals[instruction->IntLiteral];
 
-				break;
-			}
-			
-		// --------------------------------------------------------------------------------------------
-		// Symbol type.
-		// --------------------------------------------------------------------------------------------
-		case SCRIPT_OPCODE_ISTYPE:		// istype output_reg, symbol
-			{
-				CScriptValue&				outReg		= context->Registers[instruction->Operands[0].RegisterIndex];	
-				Engine::Containers::CString symbolName	= instruction->Operands[1].Symbol->GetIdentifier();
+					dest = local;
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		+= 1;	break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		+= 1;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->Inc(this, dest))
+								break;
+						default:						Error(S("Attempt to perform increment on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
 
-				symbolName = symbolName.ToLower();
+					AssignTo(local, dest);
+				}
+				SCRIPT_VM_DISPATCH();
 
-				if (symbolName == "int")
+			SCRIPT_VM_OPCODE(DECLOCAL)		// declocal reg, index
 				{
-					outReg.IntValue	= (outReg.Type == SCRIPT_VALUE_TYPE_INT) ? 1 : 0;
-					outReg.Type		= SCRIPT_VALUE_TYPE_INT;
+					CScriptValue& dest  = context->Registers[instruction->A];
+					CScriptValue& local = context->Locals[instruction->IntLiteral];
+
+					dest = local;
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		-= 1;	break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		-= 1;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->Dec(this, dest))
+								break;
+						default:						Error(S("Attempt to perform decrement on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
+
+					AssignTo(local, dest);
 				}
-				else if (symbolName == "float")
+				SCRIPT_VM_DISPATCH();
+
+			SCRIPT_VM_OPCODE(ADDSLOCAL)		// addslocal dest, src, index
 				{
-					outReg.IntValue   = (outReg.Type == SCRIPT_VALUE_TYPE_FLOAT) ? 1 : 0;
-					outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					// Perform coercion of arguments.
+					ImplicitCast(dest, src);
+
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		+= src.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		+= src.FloatValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->Add(this, dest, src))
+								break;
+						default:						Error(S("Attempt to perform addition on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
+
+					AssignTo(context->Locals[instruction->IntLiteral], dest);
 				}
-				else if (symbolName == "null" || (outReg.Type == SCRIPT_VALUE_TYPE_OBJECT && outReg.Object == NULL))
+				SCRIPT_VM_DISPATCH();
+
+			SCRIPT_VM_OPCODE(SUBSLOCAL)		// subslocal dest, src, index
 				{
-					outReg.IntValue   = (outReg.Type == SCRIPT_VALUE_TYPE_NULL) ? 1 : 0;
-					outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					// Perform coercion of arguments.
+					ImplicitCast(dest, src);
+
+					switch (dest.Type)
+					{
+						case SCRIPT_VALUE_TYPE_INT:		dest.IntValue		-= src.IntValue;	break;
+						case SCRIPT_VALUE_TYPE_FLOAT:	dest.FloatValue		-= src.FloatValue;	break;
+						case SCRIPT_VALUE_TYPE_OBJECT:	
+							if (dest.Object->Sub(this, dest, src))
+								break;
+						default:						Error(S("Attempt to perform subtraction on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);	break;
+					}
+
+					AssignTo(context->Locals[instruction->IntLiteral], dest);
 				}
-				else if (symbolName == "symbol")
+				SCRIPT_VM_DISPATCH();
+
+			// --------------------------------------------------------------------------------------------
+			// Quickened instructions
+			// --------------------------------------------------------------------------------------------
+			SCRIPT_VM_OPCODE(ADDII)			// addii dest, src
 				{
-					outReg.IntValue   = (outReg.Type == SCRIPT_VALUE_TYPE_SYMBOL) ? 1 : 0;
-					outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					if (dest.Type != SCRIPT_VALUE_TYPE_INT || src.Type != SCRIPT_VALUE_TYPE_INT)
+						SCRIPT_VM_DEOPTIMIZE(ADD);
+
+					dest.IntValue += src.IntValue;
 				}
-				else if (symbolName == "function")
+				SCRIPT_VM_DISPATCH();
+
+			SCRIPT_VM_OPCODE(ADDFF)			// addff dest, src
 				{
-					outReg.IntValue   = (outReg.Type == SCRIPT_VALUE_TYPE_FUNCTION) ? 1 : 0;
-					outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					if (dest.Type != SCRIPT_VALUE_TYPE_FLOAT || src.Type != SCRIPT_VALUE_TYPE_FLOAT)
+						SCRIPT_VM_DEOPTIMIZE(ADD);
+
+					dest.FloatValue += src.FloatValue;
 				}
-				else if (symbolName == "object")
+				SCRIPT_VM_DISPATCH();
+
+			SCRIPT_VM_OPCODE(ADDSS)			// addss dest, src
 				{
-					outReg.IntValue   = (outReg.Type == SCRIPT_VALUE_TYPE_OBJECT) ? 1 : 0;
-					outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					if (dest.Type != SCRIPT_VALUE_TYPE_OBJECT || typeid(*dest.Object) != typeid(CScriptStringObject) ||
+						src.Type  != SCRIPT_VALUE_TYPE_OBJECT || typeid(*src.Object)  != typeid(CScriptStringObject))
+						SCRIPT_VM_DEOPTIMIZE(ADD);
+
+					if (!dest.Object->Add(this, dest, src))
+						Error(S("Attempt to perform addition on invalid data type '%s'.").Format(GetDataTypeName(dest).c_str()), instruction);
 				}
-				else if (outReg.Type == SCRIPT_VALUE_TYPE_OBJECT && outReg.Object != NULL)
+				SCRIPT_VM_DISPATCH();
+
+			SCRIPT_VM_OPCODE(SUBII)			// subii dest, src
 				{
-					outReg.IntValue   = (outReg.Object->GetName().ToLower() == symbolName || outReg.Object->DerivedFrom(this, symbolName));
-					outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					if (dest.Type != SCRIPT_VALUE_TYPE_INT || src.Type != SCRIPT_VALUE_TYPE_INT)
+						SCRIPT_VM_DEOPTIMIZE(SUB);
+
+					dest.IntValue -= src.IntValue;
 				}
-				else
+				SCRIPT_VM_DISPATCH();
+
+			SCRIPT_VM_OPCODE(SUBFF)			// subff dest, src
 				{
-					outReg.IntValue   = 0;
-					outReg.Type		  = SCRIPT_VALUE_TYPE_INT;
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					if (dest.Type != SCRIPT_VALUE_TYPE_FLOAT || src.Type != SCRIPT_VALUE_TYPE_FLOAT)
+						SCRIPT_VM_DEOPTIMIZE(SUB);
+
+					dest.FloatValue -= src.FloatValue;
 				}
+				SCRIPT_VM_DISPATCH();
 
-				break;
-			}
-			
-		case SCRIPT_OPCODE_ASTYPE:		// astype output_reg, symbol
-			{
-				CScriptValue&				outReg		= context->Registers[instruction->Operands[0].RegisterIndex];	
-				Engine::Containers::CString symbolName	= instruction->Operands[1].Symbol->GetIdentifier();
+			SCRIPT_VM_OPCODE(MULII)			// mulii dest, src
+				{
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-				symbolName = symbolName.ToLower();
+					if (dest.Type != SCRIPT_VALUE_TYPE_INT || src.Type != SCRIPT_VALUE_TYPE_INT)
+						SCRIPT_VM_DEOPTIMIZE(MUL);
 
-				bool success = true;
+					dest.IntValue *= src.IntValue;
+				}
+				SCRIPT_VM_DISPATCH();
 
-				if (symbolName == "string")
+			SCRIPT_VM_OPCODE(MULFF)			// mulff dest, src
 				{
-					CScriptStringObject* strObj	= Engine::Scripting::GetScriptAllocator()->NewObj<CScriptStringObject>(this, CoerceToString(outReg));
-					GCAdd(strObj);
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
 
-					outReg.Type		= SCRIPT_VALUE_TYPE_OBJECT;
-					outReg.Object	= strObj;
+					if (dest.Type != SCRIPT_VALUE_TYPE_FLOAT || src.Type != SCRIPT_VALUE_TYPE_FLOAT)
+						SCRIPT_VM_DEOPTIMIZE(MUL);
+
+					dest.FloatValue *= src.FloatValue;
 				}
-				else if (symbolName == "int")
+				SCRIPT_VM_DISPATCH();
+
+			SCRIPT_VM_OPCODE(DIVII)			// divii dest, src
 				{
-					outReg.Type		= SCRIPT_VALUE_TYPE_INT;
-					outReg.IntValue	= CoerceToInt(outReg);
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					if (dest.Type != SCRIPT_VALUE_TYPE_INT || src.Type != SCRIPT_VALUE_TYPE_INT)
+						SCRIPT_VM_DEOPTIMIZE(DIV);
+
+					dest.IntValue /= src.IntValue;
 				}
-				else if (symbolName == "float")
+				SCRIPT_VM_DISPATCH();
+
+			SCRIPT_VM_OPCODE(DIVFF)			// divff dest, src
 				{
-					outReg.Type			= SCRIPT_VALUE_TYPE_FLOAT;
-					outReg.FloatValue	= CoerceToFloat(outReg);
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					if (dest.Type != SCRIPT_VALUE_TYPE_FLOAT || src.Type != SCRIPT_VALUE_TYPE_FLOAT)
+						SCRIPT_VM_DEOPTIMIZE(DIV);
+
+					dest.FloatValue /= src.FloatValue;
 				}
-				else if (outReg.Type == SCRIPT_VALUE_TYPE_OBJECT && outReg.Object != NULL)
+				SCRIPT_VM_DISPATCH();
+
+			SCRIPT_VM_OPCODE(CMPII)			// cmpii reg1, reg2
 				{
-					if (outReg.Object->GetName().ToLower() != symbolName && !outReg.Object->DerivedFrom(this, symbolName))
-					{
-						success = outReg.Object->CastTo(this, outReg, symbolName);
-					}
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					if (dest.Type != SCRIPT_VALUE_TYPE_INT || src.Type != SCRIPT_VALUE_TYPE_INT)
+						SCRIPT_VM_DEOPTIMIZE(CMP);
+
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].Type	   = SCRIPT_VALUE_TYPE_INT;
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue = dest.IntValue - src.IntValue;
 				}
-				else
+				SCRIPT_VM_DISPATCH();
+
+			SCRIPT_VM_OPCODE(CMPFF)			// cmpff reg1, reg2
 				{
-					success = false;
+					CScriptValue& dest = context->Registers[instruction->A];
+					CScriptValue& src  = context->Registers[instruction->B];
+
+					if (dest.Type != SCRIPT_VALUE_TYPE_FLOAT || src.Type != SCRIPT_VALUE_TYPE_FLOAT)
+						SCRIPT_VM_DEOPTIMIZE(CMP);
+
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].Type	   = SCRIPT_VALUE_TYPE_INT;
+					context->Registers[SCRIPT_CONST_REGISTER_CMP].IntValue = (s32)(dest.FloatValue - src.FloatValue);
 				}
+				SCRIPT_VM_DISPATCH();
 
-				// Not able to cast? D:
-				if (success == false)
+			// --------------------------------------------------------------------------------------------
+			//  dafaq?
+			// --------------------------------------------------------------------------------------------
+			default:
 				{
-					InvalidCast(outReg, symbolName, instruction);
-				}		
+					Error(S("Encountered invalid opcode (0x%x)\n").Format(instruction->Opcode), instruction);
+					SCRIPT_VM_DISPATCH();
+				}
+		}
+	}
+
+finished:
+
+	if (_profiler != NULL)
+		_profiler->Leave(this, executed);
 
-				break;
-			}
-			
-		// --------------------------------------------------------------------------------------------
-		//  dafaq?
-		// --------------------------------------------------------------------------------------------
-		default:
-			{
-				Error(S("Encountered invalid opcode (0x%x)\n").Format(instruction->Opcode), instruction);
-				break;
-			}
+	// Keep track of instructions executed and run the GC if its due (or if its 
+	// part way through a pass).
+	_instructionsExecuted += executed;
+	if (_gcCollecting == true || _instructionsExecuted - _gcLastRun >= SCRIPT_VM_GC_INTERVAL)
+	{
+		GCExecute();
+		_gcLastRun = _instructionsExecuted;
 	}
 
-	// Continue running!
-	return false;
+	return executed;
 }
 
 void CScriptExecutionContext::Run(f32 timeslice)
@@ -1270,23 +1866,22 @@ void CScriptExecutionContext::Run(f32 timeslice)
 
 	if (_globalScopeRun == false)
 		RunGlobalScope();
+
+	DispatchMessages();
 	
-	if (_callStack.Size() <= 0)
+	// Nothing to do if the only thing on the stack is the frame we are waiting in.
+	if (_callStack.Size() <= 0 || _callStack.Size() == _waitDepth)
 		return;
 
 	// Keep executing until we are done.
 	while (!finishedRun)
 	{
-		// Execute instruction!
+		// Execute a batch of instructions!
 		f32 timer = (f32)Engine::Platform::GetMillisecs();
-		for (u32 i = 0; i < SCRIPT_VM_TIMESLICE_CHECK_INTERVAL; i++)
+		Execute(SCRIPT_VM_TIMESLICE_CHECK_INTERVAL);
+		if (_callStack.Size() == 0 || _callStack.Size() == _waitDepth)
 		{
-			bool ret = Execute();
-			if (ret == true || _callStack.Size() == 0)
-			{
-				finishedRun = true;
-				break;
-			}
+			finishedRun = true;
 		}
 		timesliceRemaining -= ((f32)Engine::Platform::GetMillisecs() - timer);
 
@@ -1296,6 +1891,45 @@ void CScriptExecutionContext::Run(f32 timeslice)
 	}
 }
 
+void CScriptExecutionContext::QueueMessage(const CScriptMessage& message)
+{
+	CScriptMessage* copy = GetScriptAllocator()->NewObj<CScriptMessage>(message);
+
+	_messageMutex.Lock();
+	_messages.AddToEnd(copy);
+	_messageMutex.Unlock();
+}
+
+void CScriptExecutionContext::DispatchMessages()
+{
+	// Take the queued messages, so we don't hold the lock while running script code.
+	_messageMutex.Lock();
+	if (_messages.Size() == 0)
+	{
+		_messageMutex.Unlock();
+		return;
+	}
+	Engine::Containers::CArray<CScriptMessage*> messages = _messages;
+	_messages.Clear();
+	_messageMutex.Unlock();
+
+	// Call the event for each message. Messages for events that don't exist (or take 
+	// a different number of parameters) are dropped.
+	for (u32 i = 0; i < messages.Size(); i++)
+	{
+		CScriptMessage*					message = messages[i];
+		Symbols::CScriptFunctionSymbol* func	= GetFunctionSymbol(message->Event);
+
+		if (func != NULL && func->ParameterCount == message->Parameters.Size())
+		{
+			PassMessageParameters(*message);
+			CallEvent(func, message->Parameters.Size(), false);
+		}
+
+		GetScriptAllocator()->FreeObj(&message);
+	}
+}
+
 void CScriptExecutionContext::RunGlobalScope()
 {
 	LOG_ASSERT(_globalScopeRun == false);
@@ -1306,15 +1940,39 @@ void CScriptExecutionContext::RunGlobalScope()
 	context.PC			= 0; // Global scope always starts at instruction 0.
 	PushCallContext(context);
 
-	// Keep executing until we are complete.
-	while (_callStack.Size() > 0)
-		Execute();
+	// Keep executing until we are complete (or the global scope starts waiting).
+	while (_callStack.Size() > 0 && _callStack.Size() != _waitDepth)
+		Execute(SCRIPT_VM_TIMESLICE_CHECK_INTERVAL);
 
 	printf("Executed %i instructions.\n", _instructionsExecuted);
 
 	_globalScopeRun = true;
 }
 
+void CScriptExecutionContext::InvokeNativeFunction(CScriptNativeFunction* func, u32 paramCount)
+{
+	// Natives can call back into script which can call another native, so keep hold
+	// of the outer call's slice.
+	CScriptNativeFunction*	outerFunction		= _nativeFunction;
+	u32						outerParameterCount	= _nativeFunctionParameterCount;
+	u32						outerParameterBase	= _nativeParameterBase;
+
+	_nativeFunction					= func;
+	_nativeFunctionParameterCount	= paramCount;
+	_nativeParameterBase			= _parameterStack.Size() - paramCount;
+
+	if (_marshalNatives == true)
+		_virtualMachine->MarshalNativeCall(this, func);
+	else
+		func->FunctionPtr(this);
+
+	_parameterStack.Pop(paramCount);
+
+	_nativeFunction					= outerFunction;
+	_nativeFunctionParameterCount	= outerParameterCount;
+	_nativeParameterBase			= outerParameterBase;
+}
+
 bool CScriptExecutionContext::InvokeFunction(Symbols::CScriptFunctionSymbol* symbol, u32 paramCount)
 {
 	// Check the parameter count.
@@ -1324,12 +1982,52 @@ bool CScriptExecutionContext::InvokeFunction(Symbols::CScriptFunctionSymbol* sym
 		return false;
 	}
 
-	// Check the call context.
-	CScriptCallContext context;
+	// If this is a generator set the return value to a new context object
+	// otherwise push the call context.
+	if (symbol->Type == AST::SCRIPT_FUNCTION_GENERATOR)
+	{
+		CScriptCallContext context;
+		SetupCallContext(context, symbol, paramCount);
+
+		CScriptContextObject* ctxObj = NewObject<CScriptContextObject>(context);
+		GCAdd(ctxObj);
+
+		_currentContext->Registers[SCRIPT_CONST_REGISTER_RETURN].Type   = SCRIPT_VALUE_TYPE_OBJECT;
+		_currentContext->Registers[SCRIPT_CONST_REGISTER_RETURN].Object = ctxObj;
+	}
+	else
+	{
+		// Frame is setup in place on the call stack.
+		CScriptCallContext& context = _callStack.Push();
+		SetupCallContext(context, symbol, paramCount);
+
+		_currentContext = &context;
+
+#ifdef SCRIPT_VM_JIT
+		// Compile the function once its been called enough to be worth it. If it fails
+		// we'll try again after another round of calls.
+		if (_virtualMachine != NULL &&
+			Engine::Platform::AtomicLoadPointer((void**)&symbol->Compiled) == NULL && 
+			Engine::Platform::AtomicAdd(&symbol->CallCount, 1) + 1 >= SCRIPT_JIT_CALL_THRESHOLD)
+		{
+			if (!_virtualMachine->GetJIT()->Compile(symbol, _context->GetPackedInstructions(), _instructionCount))
+				Engine::Platform::AtomicSwap(&symbol->CallCount, 0);
+		}
+#endif
+	}
+
+	// Remove parameters.
+	_parameterStack.Pop(paramCount);
+
+	return true;
+}
+
+void CScriptExecutionContext::SetupCallContext(CScriptCallContext& context, Symbols::CScriptFunctionSymbol* symbol, u32 paramCount)
+{
 	context.Symbol		= symbol;
 	context.PC			= symbol->EntryPoint;
 	context.LocalCount	= symbol->LocalCount;
-	context.Locals		= GetScriptAllocator()->AllocArray<CScriptValue>(symbol->LocalCount);
+	context.Locals		= AllocLocals(symbol->LocalCount);
 
 	// Null out locals and store parameters.
 	for (u32 i = 0; i < symbol->LocalCount; i++)
@@ -1337,7 +2035,7 @@ bool CScriptExecutionContext::InvokeFunction(Symbols::CScriptFunctionSymbol* sym
 		context.Locals[i].Type = SCRIPT_VALUE_TYPE_NULL;
 		if (i < paramCount)
 		{
-			context.Locals[i] = _parameterStack[i];
+			context.Locals[i] = _parameterStack[_parameterStack.Size() - paramCount + i];
 
 			if (context.Locals[i].Type == SCRIPT_VALUE_TYPE_OBJECT && context.Locals[i].Object != NULL)
 				context.Locals[i].Object->_refCount++;
@@ -1349,43 +2047,71 @@ bool CScriptExecutionContext::InvokeFunction(Symbols::CScriptFunctionSymbol* sym
 	{
 		context.Registers[i].Type = SCRIPT_VALUE_TYPE_NULL;
 	}
+}
 
-	// Remove parameters.
-	for (u32 i = 0; i < paramCount; i++)
-	{
-		_parameterStack.RemoveFromEnd();
-	}
+void CScriptExecutionContext::PushCallContext(CScriptCallContext& context)
+{
+	_callStack.Push() = context;
+	_currentContext = &_callStack[_callStack.Size() - 1];
+}
 
-	// If this is a generator set the return value to this context
-	// otherwise push the call context.
-	if (symbol->Type == AST::SCRIPT_FUNCTION_GENERATOR)
-	{
-		CScriptContextObject* ctxObj = Engine::Scripting::GetScriptAllocator()->NewObj<CScriptContextObject>(this, context);
-		GCAdd(ctxObj);
+u32 CScriptExecutionContext::RunCompiledCode(u32 budget)
+{
+	CScriptCallContext* context = _currentContext;
 
-		_currentContext->Registers[SCRIPT_CONST_REGISTER_RETURN].Type   = SCRIPT_VALUE_TYPE_OBJECT;
-		_currentContext->Registers[SCRIPT_CONST_REGISTER_RETURN].Object = ctxObj;
-	}
-	else
-	{
-		PushCallContext(context);
-	}
+	// Suspended frames must not run any compiled code until they are resumed. 
+	if (_callStack.Size() == _waitDepth)
+		return 0;
 
-	return true;
+	CScriptJITFrame frame;
+	frame.Context	= this;
+	frame.Registers	= context->Registers;
+	frame.Locals	= context->Locals;
+	frame.Depth		= _callStack.Size();
+	frame.Executed	= 0;
+	frame.Budget	= budget;
+
+	CScriptCompiledFunction* function = (CScriptCompiledFunction*)Engine::Platform::AtomicLoadPointer((void**)&context->Symbol->Compiled);
+	u32 pc = CScriptJIT::Run(function, &frame, context->PC);
+
+	// If the frame is still current continue it from wherever the compiled code got to.
+	if (pc != SCRIPT_JIT_EXIT)
+		_currentContext->PC = pc;
+
+	return frame.Executed;
 }
 
-void CScriptExecutionContext::PushCallContext(CScriptCallContext& context)
+u32 CScriptExecutionContext::StepCompiledCode(CScriptJITFrame* frame, u32 pc)
 {
-	_callStack.AddToEnd(context);
-	_currentContext = &_callStack[_callStack.Size() - 1];
+	_currentContext->PC = pc;
+
+	// Frame got suspended, leave it to the interpreter once its resumed.
+	if (_callStack.Size() == _waitDepth)
+		return SCRIPT_JIT_EXIT;
+
+	frame->Executed++;
+
+	Execute(1, frame->Depth - 1);
+
+	// Frame was popped, something was called on top of it or its started waiting, leave 
+	// it to the interpreter.
+	if (_callStack.Size() != frame->Depth || _waitDepth != 0)
+		return SCRIPT_JIT_EXIT;
+
+	frame->Registers = _currentContext->Registers;
+	frame->Locals	 = _currentContext->Locals;
+
+	return _currentContext->PC;
 }
 
 void CScriptExecutionContext::PopCallContext()
 {
-	CScriptCallContext context = _callStack.RemoveFromEnd();
+	CScriptCallContext& context = _callStack[_callStack.Size() - 1];
 
 	if (context.GeneratorIterator == NULL)
-		context.Dispose();
+		context.Dispose(this);
+
+	_callStack.Pop();
 
 	// Set new context.
 	if (_callStack.Size() <= 0)
@@ -1394,7 +2120,7 @@ void CScriptExecutionContext::PopCallContext()
 		_currentContext = &_callStack[_callStack.Size() - 1];
 }
 
-void CScriptExecutionContext::Error(const Engine::Containers::CString& str, Instructions::CScriptInstruction* instruction)
+void CScriptExecutionContext::Error(const Engine::Containers::CString& str, Instructions::CScriptPackedInstruction* instruction)
 {
 	// If instruction is null, use current instruction.
 	if (instruction == NULL)
@@ -1402,13 +2128,23 @@ void CScriptExecutionContext::Error(const Engine::Containers::CString& str, Inst
 		if (_callStack.Size() > 0)
 		{
 			CScriptCallContext* context = &_callStack[_callStack.Size() - 1];
-			if (context->PC - 1 > 0)
+			if (context->PC > 0)
 			{
-				instruction =  _instructions[context->PC - 1];
+				instruction = &_instructions[context->PC - 1];
 			}
 		}
 	}
 
+	// Look up the source position in the debug table.
+	u32 errorLine	= 0;
+	u32 errorColumn = 0;
+	if (instruction != NULL)
+	{
+		CScriptInstructionDebugInfo& debugInfo = _debugInfo[instruction - _instructions];
+		errorLine	= debugInfo.Line;
+		errorColumn = debugInfo.Column;
+	}
+
 	// Write out the call stack.
 	u32							lineIndex = 1;
 	Engine::Containers::CString line	  = "";
@@ -1423,7 +2159,7 @@ void CScriptExecutionContext::Error(const Engine::Containers::CString& str, Inst
 		u8 chr = _context->_rawSource[offset];
 		if (chr == '\n')
 		{
-			if (lineIndex == instruction->Token.Line)
+			if (lineIndex == errorLine)
 			{
 				line = line.Trim();
 				break;
@@ -1452,12 +2188,12 @@ void CScriptExecutionContext::Error(const Engine::Containers::CString& str, Inst
 	// _ctest = func(123, x());
 	//					  ^	
 	Engine::Containers::CString msg = "";
-	msg += S(_context->_initialFile) + "(" + instruction->Token.Line + ":" + instruction->Token.Column + "): Error: ";
+	msg += S(_context->_initialFile) + "(" + errorLine + ":" + errorColumn + "): Error: ";
 	msg += str + "\n";
 	msg += line + "\n";
 
-	if (instruction->Token.Column > 1)
-		msg += Engine::Containers::CString(' ', instruction->Token.Column - 1);
+	if (errorColumn > 1)
+		msg += Engine::Containers::CString(' ', errorColumn - 1);
 
 	msg += "^\n";
 
@@ -1468,19 +2204,19 @@ void CScriptExecutionContext::Error(const Engine::Containers::CString& str, Inst
 	Engine::Platform::DebugBreak();
 }
 
-void CScriptExecutionContext::InvalidOp(const Engine::Containers::CString& op, const CScriptValue& value, Instructions::CScriptInstruction* instruction)
+void CScriptExecutionContext::InvalidOp(const Engine::Containers::CString& op, const CScriptValue& value, Instructions::CScriptPackedInstruction* instruction)
 {
 	Engine::Containers::CString k = GetDataTypeName(value);
 	Error(S("Attempt to perform '%s' operator on unsupported data type '%s'.").Format(op.c_str(), k.c_str()), instruction);
 }
 
-void CScriptExecutionContext::InvalidIndex(const CScriptValue& obj, s32 index, Instructions::CScriptInstruction* instruction)
+void CScriptExecutionContext::InvalidIndex(const CScriptValue& obj, s32 index, Instructions::CScriptPackedInstruction* instruction)
 {
 	Engine::Containers::CString v = GetDataTypeName(obj);
 	Error(S("Attempt to access invalid index '%i' of object '%s'.").Format(index, v.c_str()), instruction);
 }
 
-void CScriptExecutionContext::InvalidIndex(const CScriptValue& obj, const CScriptValue& key, Instructions::CScriptInstruction* instruction)
+void CScriptExecutionContext::InvalidIndex(const CScriptValue& obj, const CScriptValue& key, Instructions::CScriptPackedInstruction* instruction)
 {
 	Engine::Containers::CString k = CoerceToString(key);
 	Engine::Containers::CString v = GetDataTypeName(obj);
@@ -1488,36 +2224,36 @@ void CScriptExecutionContext::InvalidIndex(const CScriptValue& obj, const CScrip
 	Error(str, instruction);
 }
 
-void CScriptExecutionContext::ImmutableError(const CScriptValue& obj, Instructions::CScriptInstruction* instruction)
+void CScriptExecutionContext::ImmutableError(const CScriptValue& obj, Instructions::CScriptPackedInstruction* instruction)
 {
 	Engine::Containers::CString v = GetDataTypeName(obj);
 	Error(S("Attempt modify immutable object '%s'.").Format(v.c_str()), instruction);
 }
 
-void CScriptExecutionContext::ImmutableError(const Engine::Containers::CString& str, Instructions::CScriptInstruction* instruction)
+void CScriptExecutionContext::ImmutableError(const Engine::Containers::CString& str, Instructions::CScriptPackedInstruction* instruction)
 {
 	Error(S("Attempt modify immutable object '%s'.").Format(str.c_str()), instruction);
 }
 
-void CScriptExecutionContext::DuplicateIndex(const CScriptValue& obj, const CScriptValue& key, Instructions::CScriptInstruction* instruction)
+void CScriptExecutionContext::DuplicateIndex(const CScriptValue& obj, const CScriptValue& key, Instructions::CScriptPackedInstruction* instruction)
 {
 	Engine::Containers::CString k = GetDataTypeName(key);
 	Engine::Containers::CString v = GetDataTypeName(obj);
 	Error(S("Duplicate index '%s' in object '%s'.").Format(k.c_str(), v.c_str()), instruction);
 }
 
-void CScriptExecutionContext::InvalidCast(const CScriptValue& obj, const Engine::Containers::CString& type, Instructions::CScriptInstruction* instruction)
+void CScriptExecutionContext::InvalidCast(const CScriptValue& obj, const Engine::Containers::CString& type, Instructions::CScriptPackedInstruction* instruction)
 {
 	Engine::Containers::CString v = GetDataTypeName(obj);
 	Error(S("Invalid cast from '%s' to '%s'.").Format(v.c_str(), type.c_str()), instruction);
 }
 
-void CScriptExecutionContext::InvalidParameterCount(u32 expectedParamCount, Instructions::CScriptInstruction* instruction)
+void CScriptExecutionContext::InvalidParameterCount(u32 expectedParamCount, Instructions::CScriptPackedInstruction* instruction)
 {
-	Error(S("Attempt to call function '%s' with invalid parameter count '%i', expecting '%i' parameters.").Format(_nativeFunctionIdentifier.c_str(), _nativeFunctionParameterCount, expectedParamCount), instruction);
+	Error(S("Attempt to call function '%s' with invalid parameter count '%i', expecting '%i' parameters.").Format(_nativeFunction != NULL ? _nativeFunction->Name : (const u8*)"", _nativeFunctionParameterCount, expectedParamCount), instruction);
 }
 
-void CScriptExecutionContext::UniterableObject(const CScriptValue& obj, Instructions::CScriptInstruction* instruction)
+void CScriptExecutionContext::UniterableObject(const CScriptValue& obj, Instructions::CScriptPackedInstruction* instruction)
 {
 	Engine::Containers::CString v = GetDataTypeName(obj);
 	Error(S("Attempt to iterate over uniterable object '%s'.").Format(v.c_str()), instruction);
@@ -1535,8 +2271,7 @@ void CScriptExecutionContext::AssignTo(CScriptValue& dest, CScriptValue& val, bo
 		// Decrease reference of old object.
 		if (dest.Type == SCRIPT_VALUE_TYPE_OBJECT && dest.Object != NULL)
 		{
-			dest.Object->_refCount--;
-			//dest.Object->DecRef();
+			dest.Object->DecRef();
 
 			_gcObjectPoolDirty[dest.Object->_generation] = true;
 		}
@@ -1619,7 +2354,7 @@ void CScriptExecutionContext::ImplicitCast(CScriptValue& src, CScriptValue& dest
 	{
 		if (dest.Type == SCRIPT_VALUE_TYPE_OBJECT && typeid(*dest.Object) == typeid(CScriptStringObject))
 		{
-			CScriptStringObject* strObj	= Engine::Scripting::GetScriptAllocator()->NewObj<CScriptStringObject>(this, CoerceToString(src));
+			CScriptStringObject* strObj	= NewObject<CScriptStringObject>(CoerceToString(src));
 			GCAdd(strObj);
 
 			src.Object = strObj;
@@ -1627,7 +2362,7 @@ void CScriptExecutionContext::ImplicitCast(CScriptValue& src, CScriptValue& dest
 		}
 		else
 		{
-			CScriptStringObject* strObj	= Engine::Scripting::GetScriptAllocator()->NewObj<CScriptStringObject>(this, CoerceToString(dest));
+			CScriptStringObject* strObj	= NewObject<CScriptStringObject>(CoerceToString(dest));
 			GCAdd(strObj);
 
 			dest.Object = strObj;
@@ -1670,7 +2405,7 @@ s32 CScriptExecutionContext::CoerceToInt(const CScriptValue& value)
 			{
 				s32 result = 0;
 				if (value.Object->CoerceToInt(this, result))
-					break;
+					return result;
 			}
 		default:							InvalidOp("cast to int", value);
 	}
@@ -1687,7 +2422,7 @@ f32 CScriptExecutionContext::CoerceToFloat(const CScriptValue& value)
 			{
 				f32 result = 0;
 				if (value.Object->CoerceToFloat(this, result))
-					break;
+					return result;
 			}
 		default:							InvalidOp("cast to float", value);
 	}
@@ -1758,9 +2493,6 @@ void CScriptExecutionContext::GCAdd(CScriptObject* object, u32 generation)
 
 	if (next != NULL)
 		next->_prev = object;
-
-	if (generation == 0)
-		object->_allocCallDepth = _callStack.Size();
 }
 
 void CScriptExecutionContext::GCRemove(CScriptObject* object)
@@ -1776,130 +2508,166 @@ void CScriptExecutionContext::GCRemove(CScriptObject* object)
 	}
 }
 
-void CScriptExecutionContext::GCExecute()
+void CScriptExecutionContext::GCFree(CScriptObject* object)
+{
+	Engine::Memory::Allocators::CAllocator* alloc = object->_allocator;
+	if (alloc == NULL)
+		alloc = GetScriptAllocator();
+
+	alloc->FreeObj(&object);
+}
+
+Engine::Memory::Allocators::CAllocator* CScriptExecutionContext::GetPoolAllocator(u32 size)
+{
+	for (u32 i = 0; i < SCRIPT_VM_POOL_SIZE_CLASSES; i++)
+	{
+		if (size <= _pools[i]->GetBlockSize())
+			return _pools[i];
+	}
+	return GetScriptAllocator();
+}
+
+CScriptValue* CScriptExecutionContext::AllocLocals(u32 count)
+{
+	if (count == 0)
+		return NULL;
+
+	u32 size = count * sizeof(CScriptValue);
+	return (CScriptValue*)GetPoolAllocator(size)->Alloc(size);
+}
+
+void CScriptExecutionContext::FreeLocals(CScriptValue* locals, u32 count)
 {
-	//f32 timer = Engine::Platform::GetMillisecs();
+	GetPoolAllocator(count * sizeof(CScriptValue))->Free(&locals);
+}
 
-	// IcarusScript uses a simple generational GC.
+void CScriptExecutionContext::GCExecute()
+{
+	// IcarusScript uses an incremental generational GC on top of reference counting.
 	//
 	// The main aim of the GC is to provide automatic garbage collection without
 	// any recognisable delay to the script programmer. The GC in IScript will always
-	// prioritize no-delays over memory efficiency. If it has a large amount of objects to collect
-	// it will prefer to do it slowly over several frames rather than at once and potentially 
-	// "lag" the script.
+	// prioritize no-delays over memory efficiency. Each time it is invoked it only runs 
+	// for _gcBudget microseconds, a pass over a generation is spread over as many 
+	// invocations as it takes.
 	//
-	// Each generation is collected every SCRIPT_VM_GC_INTERVAL * (10 pow generation)
+	// A pass over each generation is started every SCRIPT_VM_GC_INTERVAL * (10 pow generation)
 	// Generations are only collected if their dirty flag is set (which is set when new objects are added, 
 	// or referenced counts are decremented).
 	//
-	// When a collection is performed any objects that are not in any registers in the callstack and
-	// have zero references are disposed off.
+	// At the start of a pass the call stack registers are scanned once and any objects in them 
+	// are shaded. During the pass any object with zero references that is not shaded is disposed off.
+	// Objects are also shaded when allocated and when they lose a reference (the write barrier in 
+	// DecRef) so objects that move into registers while the pass is in progress are not freed.
 	//
-	// If an object survives a collection it moves up to the next highest generation.
+	// If an object survives a collection with references left it moves up to the next highest 
+	// generation. Objects only kept alive by being shaded stay where they are and leave the 
+	// generation dirty, so they are looked at again (and freed if nothing has shaded them since).
 	//
-	// The garbage collection is incremental, only a certain amount of objects will be checked per run
-	// this keeps the gc "lag" down to a minimum (pretty much required for interactive games!).
+	// Objects that survive with references left after losing one may be part of a garbage cycle,
+	// these are buffered and a trial deletion cycle collector (Bacon & Rajan) runs on them when
+	// the oldest generation is collected.
 	//
 	// Downsides:
-	//	- Cyclic references are not dealt with at all. Avoid!
 	//	- If a lot of items are allocated at the same time the memory will take a while to be collected
 	//	  due to the incremental GC. Better than delaying the game logic though!
 	//	- As registers can hold onto references of objects until they are overwriten, objects may
 	//	  stay alive for longer than they actually need to. This shouldn't be to much of an issue
 	//	  though as its likely the registers will get overwritten soon enough.
-	
-	// TODO: Make garbage collection incremental.
+	//	- The cycle collector itself is not incremental, its cost depends on the amount of data 
+	//	  reachable from the buffered objects.
 
-	// Which generation will we run.
-	u32 generation = 0;
-	for (u32 i = 1; i < SCRIPT_MAX_GC_GENERATIONS; i++)
+	// Start a new pass if we are not in the middle of one.
+	if (_gcCollecting == false)
 	{
-		u32 interval = SCRIPT_VM_GC_INTERVAL * Math::Pow(10, i);
-		if ((_instructionsExecuted % interval) == 0)
-			generation = i;
+		// Which generation will we run.
+		u32 generation = 0;
+		_gcRunCount++;
+		for (u32 i = 1; i < SCRIPT_MAX_GC_GENERATIONS; i++)
+		{
+			u32 interval = Math::Pow(10, i);
+			if ((_gcRunCount % interval) == 0)
+				generation = i;
+		}
+
+		// Don't run if this generation is not dirty.
+		if (_gcObjectPoolDirty[generation] == false)
+		{
+			if (generation == SCRIPT_MAX_GC_GENERATIONS - 1)
+				GCCollectCycles();
+			return;
+		}
+
+		GCBeginPass(generation);
 	}
 
-	// Run the generation.
-	GCCollectGeneration(generation);
-	
-	//f32 elapsed = Engine::Platform::GetMillisecs() - timer;
-	//printf("EXECUTED GEN %i IN %f\n", generation, elapsed);
-
-//	if (generation == 1)
-//	{
-//		printf("GC State:\n");
-//		for (u32 i = 0; i < SCRIPT_MAX_GC_GENERATIONS; i++)
-//		{
-//			CScriptObject* obj = _gcObjectPool[i];
-//			u32 size = 0;
-//			while (obj != NULL)
-//			{
-//				obj = obj->_next;
-//				size++;
-//			}
-//			printf("\t[%i] %i\n", i, size);
-//		}
-//	}
-}
-
-void CScriptExecutionContext::GCCollectGeneration(u32 generation)
-{
-	// Don't run if this generation is not dirty.
-	if (_gcObjectPoolDirty[generation] == false)
+	// Sweep as much as we can in our budget.
+	if (GCSweep(_gcBudget) == true && _gcGeneration == SCRIPT_MAX_GC_GENERATIONS - 1)
 	{
-		return;
+		GCCollectCycles();
 	}
+}
+
+void CScriptExecutionContext::GCBeginPass(u32 generation)
+{
 	_gcObjectPoolDirty[generation] = false;
+	_gcGeneration = generation;
+	_gcCursor	  = _gcObjectPool[generation];
+	_gcCollecting = true;
+
+	// Roots are only scanned once per pass. Anything that gets into a register after
+	// this point has either just been allocated or was referenced by something else, 
+	// in which case the write barrier will shade it if it loses that reference.
+	GCShadeRoots();
+}
 
-	CScriptObject* obj = _gcObjectPool[generation];
+bool CScriptExecutionContext::GCSweep(u32 budget)
+{
+	f64 start = Engine::Platform::GetMillisecs();
 	u32 count = 0;
-	while (obj != NULL)
-	{
-		bool referenced	= false;
-		s32	 refs		= obj->_refCount;
 
-		if (refs <= 0)
-		{
-			// Oh god wtf. Why is the reference count below zero? Something
-			// is seriously seriously wrong D:
-			LOG_ASSERT(refs >= 0);
+	while (_gcCursor != NULL)
+	{
+		CScriptObject* obj = _gcCursor;
 
-			// Go through the call stack and check its not in any registers currently.
-			for (u32 depth = obj->_allocCallDepth - 1; depth < _callStack.Size() && referenced == false; depth++)
-			{
-				CScriptCallContext& context = _callStack[depth];
-				for (u32 reg = 0; reg < SCRIPT_TOTAL_REGISTERS; reg++)
-				{
-					if (context.Registers[reg].Type == SCRIPT_VALUE_TYPE_OBJECT &&
-						context.Registers[reg].Object == obj)
-					{
-						referenced = true;
-						break;
-					}
-				}
-			}
-		}
-		else
-		{
-			referenced = true;
-		}
-		
 		// Keep a reference to the next node incase we remove this one.
-		CScriptObject* next = obj->_next;
+		_gcCursor = obj->_next;
+
+		// Oh god wtf. Why is the reference count below zero? Something
+		// is seriously seriously wrong D:
+		LOG_ASSERT(obj->_refCount >= 0);
+
+		bool shaded = obj->_gcShaded;
+		obj->_gcShaded = false;
 
 		// Move the object up a generation if its still referenced.
-		if (referenced == true)
+		if (obj->_refCount > 0)
 		{
-			if (generation < SCRIPT_MAX_GC_GENERATIONS - 1)
+			// Lost a reference but still alive? Could be part of a cycle.
+			if (obj->_gcColor == SCRIPT_GC_COLOR_PURPLE && obj->_gcBuffered == false)
+			{
+				obj->_gcBuffered = true;
+				_gcCycleRoots.AddToEnd(obj);
+			}
+
+			if (_gcGeneration < SCRIPT_MAX_GC_GENERATIONS - 1)
 			{
 				// Remove from old pool.
 				GCRemove(obj);	
-				GCAdd(obj, generation + 1);
+				GCAdd(obj, _gcGeneration + 1);
 			}
 		}
 
-		// Otherwise dispose.
-		else
+		// Only shaded (in a register, just allocated or just lost its last reference), keep it 
+		// for this pass but don't promote it, the next pass decides if its really garbage.
+		else if (shaded == true)
+		{
+			_gcObjectPoolDirty[_gcGeneration] = true;
+		}
+
+		// Otherwise dispose. Objects in the cycle buffer are left for the cycle collector
+		// to release.
+		else if (obj->_gcBuffered == false)
 		{		
 			// Remove from old pool.
 			GCRemove(obj);
@@ -1907,27 +2675,273 @@ void CScriptExecutionContext::GCCollectGeneration(u32 generation)
 			// Finalize the object.
 			obj->Finalize(this);
 
-			// I'm FREEEEEEEEEEEEEEEEEEEEEE.
-			GetScriptAllocator()->FreeObj(&obj);
-		}
+			// I'm FREEEEEEEEEEEEEEEEEEEEEE.
+			GCFree(obj);
+		}
+
+		// Out of time?
+		count++;
+		if (budget != 0 &&
+			(count % SCRIPT_VM_GC_TIME_CHECK_INTERVAL) == 0 && 
+			(Engine::Platform::GetMillisecs() - start) * 1000.0 >= budget)
+		{
+			return false;
+		}
+	}
+
+	_gcCollecting = false;
+	return true;
+}
+
+void CScriptExecutionContext::GCShadeRoots()
+{
+	for (u32 depth = 0; depth < _callStack.Size(); depth++)
+	{
+		CScriptCallContext& context = _callStack[depth];
+		for (u32 reg = 0; reg < SCRIPT_TOTAL_REGISTERS; reg++)
+		{
+			if (context.Registers[reg].Type == SCRIPT_VALUE_TYPE_OBJECT && context.Registers[reg].Object != NULL)
+				context.Registers[reg].Object->_gcShaded = true;
+		}
+	}
+	for (u32 i = 0; i < _parameterStack.Size(); i++)
+	{
+		if (_parameterStack[i].Type == SCRIPT_VALUE_TYPE_OBJECT && _parameterStack[i].Object != NULL)
+			_parameterStack[i].Object->_gcShaded = true;
+	}
+}
+
+void CScriptExecutionContext::GCCountRootReferences(s32 delta)
+{
+	for (u32 depth = 0; depth < _callStack.Size(); depth++)
+	{
+		CScriptCallContext& context = _callStack[depth];
+		for (u32 reg = 0; reg < SCRIPT_TOTAL_REGISTERS; reg++)
+		{
+			if (context.Registers[reg].Type == SCRIPT_VALUE_TYPE_OBJECT && context.Registers[reg].Object != NULL)
+				context.Registers[reg].Object->_refCount += delta;
+		}
+	}
+	for (u32 i = 0; i < _parameterStack.Size(); i++)
+	{
+		if (_parameterStack[i].Type == SCRIPT_VALUE_TYPE_OBJECT && _parameterStack[i].Object != NULL)
+			_parameterStack[i].Object->_refCount += delta;
+	}
+}
+
+void CScriptExecutionContext::GCCollect()
+{
+	// Finish off the current pass, then run a full pass over every generation.
+	if (_gcCollecting == true)
+		GCSweep(0);
+
+	for (u32 i = 0; i < SCRIPT_MAX_GC_GENERATIONS; i++)
+	{
+		GCBeginPass(i);
+		GCSweep(0);
+	}
+
+	GCCollectCycles();
+}
+
+void CScriptExecutionContext::GCSetBudget(u32 microseconds)
+{
+	_gcBudget = microseconds;
+}
+
+// Cycle collection ----------------------------------------------------------
+//
+// Synchronous trial deletion. Every buffered object has the references held by the
+// objects reachable from it subtracted (mark gray), anything that still has references
+// left is reachable from outside and gets its references restored (scan black), whatever 
+// is left (white) is only referenced by itself and is freed.
+
+void CScriptExecutionContext::GCCollectCycles()
+{
+	if (_gcCycleRoots.Size() == 0)
+		return;
+
+	// Registers are not reference counted, count them for now so nothing they 
+	// reference can be collected.
+	GCCountRootReferences(1);
+
+	// Mark roots.
+	for (u32 i = 0; i < _gcCycleRoots.Size(); i++)
+	{
+		CScriptObject* obj = _gcCycleRoots[i];
+		if (obj->_gcColor == SCRIPT_GC_COLOR_PURPLE && obj->_refCount > 0)
+		{
+			GCMarkGray(obj);
+		}
+		else
+		{
+			obj->_gcBuffered = false;
+			if (obj->_gcColor == SCRIPT_GC_COLOR_PURPLE)
+				obj->_gcColor = SCRIPT_GC_COLOR_BLACK;
+
+			// The sweep skipped it while it was buffered, make sure it gets looked at again.
+			if (obj->_refCount == 0)
+				_gcObjectPoolDirty[obj->_generation] = true;
+		}
+	}
+
+	// Scan roots.
+	for (u32 i = 0; i < _gcCycleRoots.Size(); i++)
+	{
+		CScriptObject* obj = _gcCycleRoots[i];
+		if (obj->_gcBuffered == true)
+			GCScan(obj);
+	}
+
+	// Collect roots.
+	for (u32 i = 0; i < _gcCycleRoots.Size(); i++)
+	{
+		CScriptObject* obj = _gcCycleRoots[i];
+		if (obj->_gcBuffered == true)
+		{
+			obj->_gcBuffered = false;
+			GCCollectWhite(obj);
+		}
+	}
+	_gcCycleRoots.Clear();
+
+	GCCountRootReferences(-1);
+
+	// Garbage objects still have the references they hold subtracted, put them back
+	// so finalizing them dosen't release them twice.
+	for (u32 i = 0; i < _gcWhite.Size(); i++)
+		_gcWhite[i]->VisitReferences(this, GCVisitRestore);
+
+	// Finalize everything before freeing anything, as finalizers release 
+	// references to each other.
+	for (u32 i = 0; i < _gcWhite.Size(); i++)
+		_gcWhite[i]->Finalize(this);
+
+	for (u32 i = 0; i < _gcWhite.Size(); i++)
+	{
+		CScriptObject* obj = _gcWhite[i];
+		GCRemove(obj);
+		GCFree(obj);
+	}
+	_gcWhite.Clear();
+}
+
+void CScriptExecutionContext::GCMarkGray(CScriptObject* object)
+{
+	_gcStack.AddToEnd(object);
+	while (_gcStack.Size() > 0)
+	{
+		CScriptObject* obj = _gcStack.RemoveFromEnd();
+		if (obj->_gcColor != SCRIPT_GC_COLOR_GRAY)
+		{
+			obj->_gcColor = SCRIPT_GC_COLOR_GRAY;
+			obj->VisitReferences(this, GCVisitMarkGray);
+		}
+	}
+}
+
+void CScriptExecutionContext::GCScan(CScriptObject* object)
+{
+	_gcStack.AddToEnd(object);
+	while (_gcStack.Size() > 0)
+	{
+		CScriptObject* obj = _gcStack.RemoveFromEnd();
+		if (obj->_gcColor == SCRIPT_GC_COLOR_GRAY)
+		{
+			if (obj->_refCount > 0)
+			{
+				GCScanBlack(obj);
+			}
+			else
+			{
+				obj->_gcColor = SCRIPT_GC_COLOR_WHITE;
+				obj->VisitReferences(this, GCVisitScan);
+			}
+		}
+	}
+}
+
+void CScriptExecutionContext::GCScanBlack(CScriptObject* object)
+{
+	object->_gcColor = SCRIPT_GC_COLOR_BLACK;
+
+	_gcBlackStack.AddToEnd(object);
+	while (_gcBlackStack.Size() > 0)
+	{
+		CScriptObject* obj = _gcBlackStack.RemoveFromEnd();
+		obj->VisitReferences(this, GCVisitScanBlack);
+	}
+}
+
+void CScriptExecutionContext::GCCollectWhite(CScriptObject* object)
+{
+	GCVisitCollectWhite(this, object);
+	while (_gcStack.Size() > 0)
+	{
+		CScriptObject* obj = _gcStack.RemoveFromEnd();
+		obj->VisitReferences(this, GCVisitCollectWhite);
+	}
+}
+
+void CScriptExecutionContext::GCVisitMarkGray(CScriptExecutionContext* context, CScriptObject* object)
+{
+	object->_refCount--;
+	context->_gcStack.AddToEnd(object);
+}
+
+void CScriptExecutionContext::GCVisitScan(CScriptExecutionContext* context, CScriptObject* object)
+{
+	context->_gcStack.AddToEnd(object);
+}
 
-		// Proceed to next node.
-		obj = next;
+void CScriptExecutionContext::GCVisitScanBlack(CScriptExecutionContext* context, CScriptObject* object)
+{
+	object->_refCount++;
+	if (object->_gcColor != SCRIPT_GC_COLOR_BLACK)
+	{
+		object->_gcColor = SCRIPT_GC_COLOR_BLACK;
+		context->_gcBlackStack.AddToEnd(object);
+	}
+}
 
-		count++;
+void CScriptExecutionContext::GCVisitCollectWhite(CScriptExecutionContext* context, CScriptObject* object)
+{
+	if (object->_gcColor == SCRIPT_GC_COLOR_WHITE && object->_gcBuffered == false)
+	{
+		object->_gcColor = SCRIPT_GC_COLOR_BLACK;
+		context->_gcWhite.AddToEnd(object);
+		context->_gcStack.AddToEnd(object);
 	}
+}
+
+void CScriptExecutionContext::GCVisitRestore(CScriptExecutionContext* context, CScriptObject* object)
+{
+	object->_refCount++;
+}
+
+void CScriptExecutionContext::SetProfiler(CScriptProfiler* profiler)
+{
+	_profiler = profiler;
+}
 
+CScriptProfiler* CScriptExecutionContext::GetProfiler()
+{
+	return _profiler;
 }
 
 u32 CScriptExecutionContext::GetParameterCount()
 {
 	return _nativeFunctionParameterCount;
 }
+
+CScriptNativeFrame CScriptExecutionContext::GetNativeFrame()
+{
+	return CScriptNativeFrame(this, _parameterStack.Data(_nativeParameterBase), _nativeFunctionParameterCount);
+}
 			
-CScriptValue CScriptExecutionContext::GetParameter(u32 index)
+const CScriptValue& CScriptExecutionContext::GetParameter(u32 index)
 {
-	u32 firstParamIndex = _parameterStack.Size() - _nativeFunctionParameterCount;
-	return _parameterStack[firstParamIndex + index];
+	return _parameterStack[_nativeParameterBase + index];
 }
 
 s32 CScriptExecutionContext::GetIntParameter(u32 index)
@@ -2000,7 +3014,7 @@ void CScriptExecutionContext::SetReturnStringValue(const Engine::Containers::CSt
 {
 	CScriptValue v;
 	v.Type = SCRIPT_VALUE_TYPE_OBJECT;
-	v.Object = GetScriptAllocator()->NewObj<CScriptStringObject>(this, str);
+	v.Object = NewObject<CScriptStringObject>(str);
 	GCAdd(v.Object);
 
 	SetReturnValue(v);
@@ -2019,7 +3033,7 @@ void CScriptExecutionContext::PassStringParameter(const Engine::Containers::CStr
 {
 	CScriptValue v;
 	v.Type = SCRIPT_VALUE_TYPE_OBJECT;
-	v.Object = GetScriptAllocator()->NewObj<CScriptStringObject>(this, param);
+	v.Object = NewObject<CScriptStringObject>(param);
 	GCAdd(v.Object);
 
 	PassParameter(v);
@@ -2051,7 +3065,7 @@ void CScriptExecutionContext::PassObjectParameter(CScriptObject* obj)
 
 void CScriptExecutionContext::PassParameter(const CScriptValue& param)
 {
-	_parameterStack.AddToEnd(param);
+	_parameterStack.Push(param);
 }
 
 bool CScriptExecutionContext::CallFunction(const Engine::Containers::CString& name, u32 parameterCount)
@@ -2093,35 +3107,63 @@ bool CScriptExecutionContext::CallEvent(Symbols::CScriptFunctionSymbol* symbol,
 	if (!InvokeFunction(symbol, parameterCount))
 		return false;
 
-	// Run until this function is off the stack.
+	// Run until this function is off the stack. If it starts waiting its left on the stack
+	// and resumed by Run once the wait is over.
 	if (async == true)
 	{
-		while (_callStack.Size() > call_stack_depth)
-			Execute();
+		while (_callStack.Size() > call_stack_depth && _callStack.Size() != _waitDepth)
+			Execute(SCRIPT_VM_TIMESLICE_CHECK_INTERVAL, call_stack_depth);
 	}
 
 	return true;
 }
 
+bool CScriptExecutionContext::CallEvent(const CScriptEventHandle& handle, u32 parameterCount, bool async, bool stackable)
+{
+	Symbols::CScriptFunctionSymbol* func = GetFunctionSymbol(handle);
+	if (func == NULL)
+		return false;
+
+	return CallEvent(func, parameterCount, async, stackable);
+}
+
 Symbols::CScriptFunctionSymbol*	CScriptExecutionContext::GetFunctionSymbol(const Engine::Containers::CString& name)
 {
-	u32 lowerNameHash = name.ToLower().ToHashCode();
+	return FindFunctionSymbol(name.ToLower().ToHashCode());
+}
+
+Symbols::CScriptFunctionSymbol*	CScriptExecutionContext::GetFunctionSymbol(const CScriptEventHandle& handle)
+{
+	Engine::Containers::CHashTableValue<Symbols::CScriptFunctionSymbol*>* cached = _eventCache.FromHash(handle.NameHash);
+	if (cached != NULL)
+		return cached->Value;
+
+	Symbols::CScriptFunctionSymbol* func = FindFunctionSymbol(handle.NameHash);
+	_eventCache.Insert(handle.NameHash, func);
 
+	return func;
+}
+
+Symbols::CScriptFunctionSymbol*	CScriptExecutionContext::FindFunctionSymbol(u32 lowerNameHash)
+{
 	// If state exists, look in there for info.
 	if (_state != NULL)
 	{
-		u32 lowerStateNameHash = _state->GetIdentifier().ToLower().ToHashCode();
-
 		// Rebuild the states symbol hash table.
-		if (!_stateScopeHashTable.Contains(lowerStateNameHash))
-			RebuildStateScopeSymbolHashTable(_state);
+		if (_stateHashTable == NULL)
+		{
+			u32 lowerStateNameHash = _state->GetIdentifier().ToLower().ToHashCode();
+			if (!_stateScopeHashTable.Contains(lowerStateNameHash))
+				RebuildStateScopeSymbolHashTable(_state);
+
+			_stateHashTable = _stateScopeHashTable[lowerStateNameHash];
+		}
 
 		// Look in hash table.
-		Engine::Containers::CHashTable<CScriptSymbol*>* hashTable = _stateScopeHashTable[lowerStateNameHash];
-		CScriptSymbol* symbol = (*hashTable)[lowerNameHash];
-		if (symbol != NULL && symbol->GetType() == SCRIPT_SYMBOL_TYPE_FUNCTION)
+		Engine::Containers::CHashTableValue<CScriptSymbol*>* symbol = _stateHashTable->FromHash(lowerNameHash);
+		if (symbol != NULL && symbol->Value->GetType() == SCRIPT_SYMBOL_TYPE_FUNCTION)
 		{
-			return reinterpret_cast<Symbols::CScriptFunctionSymbol*>(symbol);
+			return reinterpret_cast<Symbols::CScriptFunctionSymbol*>(symbol->Value);
 		}
 	}
 
@@ -2130,16 +3172,30 @@ Symbols::CScriptFunctionSymbol*	CScriptExecutionContext::GetFunctionSymbol(const
 		RebuildGlobalScopeSymbolHashTable();
 
 	// Look in global scope hash table.
-	CScriptSymbol* symbol = _globalScopeHashTable[lowerNameHash];
-	if (symbol != NULL && symbol->GetType() == SCRIPT_SYMBOL_TYPE_FUNCTION)
+	Engine::Containers::CHashTableValue<CScriptSymbol*>* symbol = _globalScopeHashTable.FromHash(lowerNameHash);
+	if (symbol != NULL && symbol->Value->GetType() == SCRIPT_SYMBOL_TYPE_FUNCTION)
 	{
-		return reinterpret_cast<Symbols::CScriptFunctionSymbol*>(symbol);
+		return reinterpret_cast<Symbols::CScriptFunctionSymbol*>(symbol->Value);
 	}
 
 	return NULL;
 
 }
 
+void CScriptExecutionContext::PassMessageParameters(const CScriptMessage& message)
+{
+	for (u32 p = 0; p < message.Parameters.Size(); p++)
+	{
+		CScriptMessageParameter& param = message.Parameters[p];
+		switch (param.Type)
+		{
+			case SCRIPT_VALUE_TYPE_INT:		PassIntParameter(param.IntValue);		 break;
+			case SCRIPT_VALUE_TYPE_FLOAT:	PassFloatParameter(param.FloatValue);	 break;
+			default:						PassStringParameter(param.StringValue);	 break;
+		}
+	}
+}
+
 Symbols::CScriptVariableSymbol*	CScriptExecutionContext::GetVariableSymbol(const Engine::Containers::CString& name)
 {	
 	u32 lowerNameHash = name.ToLower().ToHashCode();
@@ -2158,6 +3214,175 @@ Symbols::CScriptVariableSymbol*	CScriptExecutionContext::GetVariableSymbol(const
 	return NULL;
 }
 
+// Returns 2 if the symbol is a function in the given state, 1 if it's a global function
+// or variable, otherwise 0.
+static u32 MatchScopeSymbol(CScriptSymbol* symbol, Symbols::CScriptStateSymbol* state)
+{
+	if (symbol->GetType() == SCRIPT_SYMBOL_TYPE_FUNCTION)
+	{
+		CScriptFunctionSymbol* func = reinterpret_cast<CScriptFunctionSymbol*>(symbol);
+		if (func->State == NULL)
+			return 1;
+		return (state != NULL && func->State == state ? 2 : 0);
+	}
+	else if (symbol->GetType() == SCRIPT_SYMBOL_TYPE_VARIABLE)
+	{
+		return (reinterpret_cast<CScriptVariableSymbol*>(symbol)->IsGlobal == true ? 1 : 0);
+	}
+	return 0;
+}
+
+s32 CScriptExecutionContext::FindScopeSlot(Symbols::CScriptStateSymbol* state, CScriptInternedString* name)
+{
+	u32 count  = _context->_symbols.Size();
+	s32 global = -1;
+
+	// Symbol names are interned so they can be compared by pointer. Functions in the state
+	// take precedence over globals, the same as FindFunctionSymbol.
+	for (u32 i = 0; i < count; i++)
+	{
+		if (_internedSymbols[i] != name)
+			continue;
+
+		u32 match = MatchScopeSymbol(_symbols[i], state);
+		if (match == 2)
+			return i;
+		else if (match == 1 && global < 0)
+			global = i;
+	}
+
+	if (global >= 0)
+		return global;
+
+	// Identifiers are case insensitive, so names that only differ in case from the
+	// declaration need comparing the slow way.
+	Engine::Containers::CString lowerName = name->String.ToLower();
+	for (u32 i = 0; i < count; i++)
+	{
+		if (_internedSymbols[i] == NULL || _internedSymbols[i]->String.ToLower() != lowerName)
+			continue;
+
+		u32 match = MatchScopeSymbol(_symbols[i], state);
+		if (match == 2)
+			return i;
+		else if (match == 1 && global < 0)
+			global = i;
+	}
+
+	return global;
+}
+
+bool CScriptExecutionContext::GetScopeSlot(s32 slot, CScriptValue& dest)
+{
+	if (slot < 0 || (u32)slot >= _context->_symbols.Size())
+		return false;
+
+	CScriptSymbol* symbol = _symbols[slot];
+	if (symbol->GetType() == SCRIPT_SYMBOL_TYPE_FUNCTION)
+	{
+		dest = _functionTable[reinterpret_cast<CScriptFunctionSymbol*>(symbol)->Index];
+		return true;
+	}
+	else if (symbol->GetType() == SCRIPT_SYMBOL_TYPE_VARIABLE)
+	{
+		dest = _globals[reinterpret_cast<CScriptVariableSymbol*>(symbol)->Index];
+		return true;
+	}
+
+	return false;
+}
+
+// Only variables can be assigned to, functions are immutable.
+bool CScriptExecutionContext::SetScopeSlot(s32 slot, const CScriptValue& value)
+{
+	if (slot < 0 || (u32)slot >= _context->_symbols.Size())
+		return false;
+
+	CScriptSymbol* symbol = _symbols[slot];
+	if (symbol->GetType() != SCRIPT_SYMBOL_TYPE_VARIABLE)
+		return false;
+
+	CScriptValue val = value;
+	AssignTo(_globals[reinterpret_cast<CScriptVariableSymbol*>(symbol)->Index], val);
+	return true;
+}
+
+s32 CScriptExecutionContext::ResolveAttributeSlot(Instructions::CScriptPackedInstruction* instruction, CScriptObject* object, CScriptInternedString* name)
+{
+	void* shape = object->GetShape(this);
+	if (shape == NULL)
+		return -1;
+
+	// Hit?
+	u32 pc = (u32)(instruction - _instructions);
+	CScriptInlineCache* cache = _inlineCaches[pc];
+	if (cache != NULL)
+	{
+		for (u32 i = 0; i < cache->Count; i++)
+		{
+			if (cache->Entries[i].Shape == shape)
+				return cache->Entries[i].Slot;
+		}
+	}
+
+	// Miss, resolve the slot the slow way.
+	s32 slot = object->FindAttributeSlot(this, name);
+	if (slot < 0)
+		return -1;
+
+	if (cache == NULL)
+	{
+		cache			 = GetScriptAllocator()->NewObj<CScriptInlineCache>();
+		cache->Count	 = 0;
+		_inlineCaches[pc] = cache;
+	}
+
+	// Megamorphic sites just stop adding entries, the slow path still works.
+	if (cache->Count < SCRIPT_VM_INLINE_CACHE_ENTRIES)
+	{
+		cache->Entries[cache->Count].Shape = shape;
+		cache->Entries[cache->Count].Slot  = slot;
+		cache->Count++;
+	}
+
+	return slot;
+}
+
+Symbols::CScriptFunctionSymbol* CScriptExecutionContext::ResolveCallTarget(Instructions::CScriptPackedInstruction* instruction, Symbols::CScriptSymbol* symbol)
+{
+	// Hit?
+	u32 pc = (u32)(instruction - _instructions);
+	CScriptInlineCache* cache = _inlineCaches[pc];
+	if (cache != NULL)
+	{
+		for (u32 i = 0; i < cache->Count; i++)
+		{
+			if (cache->Entries[i].Shape == symbol)
+				return reinterpret_cast<Symbols::CScriptFunctionSymbol*>(symbol);
+		}
+	}
+
+	// Miss, check it's actually a function.
+	if (symbol->GetType() != SCRIPT_SYMBOL_TYPE_FUNCTION)
+		return NULL;
+
+	if (cache == NULL)
+	{
+		cache			 = GetScriptAllocator()->NewObj<CScriptInlineCache>();
+		cache->Count	 = 0;
+		_inlineCaches[pc] = cache;
+	}
+
+	if (cache->Count < SCRIPT_VM_INLINE_CACHE_ENTRIES)
+	{
+		cache->Entries[cache->Count].Shape = symbol;
+		cache->Entries[cache->Count].Slot  = 0;
+		cache->Count++;
+	}
+
+	return reinterpret_cast<Symbols::CScriptFunctionSymbol*>(symbol);
+}
+
 void CScriptExecutionContext::RebuildGlobalScopeSymbolHashTable()
 {
 	for (u32 i = 0; i < _context->_symbols.Size(); i++)
@@ -2209,12 +3434,324 @@ void CScriptExecutionContext::RebuildStateScopeSymbolHashTable(Symbols::CScriptS
 		}
 	}
 
-	_stateScopeHashTable.Insert(lowerStateNameHash, arr);
+	_stateScopeHashTable.Insert(lowerStateNameHash, arr);
+}
+
+bool CScriptExecutionContext::BeginWait(ScriptWaitType type)
+{
+	if (_virtualMachine == NULL)
+	{
+		Error("Attempt to wait in a context that is not being run by a virtual machine.");
+		return false;
+	}
+	if (_callStack.Size() <= 0 || _waitType != SCRIPT_WAIT_NONE)
+	{
+		Error("Attempt to wait while already waiting.");
+		return false;
+	}
+
+	_waitType  = type;
+	_waitDepth = _callStack.Size();
+	return true;
+}
+
+// Called by the virtual machine with the scheduler locked.
+void CScriptExecutionContext::EndWait()
+{
+	_waitType  = SCRIPT_WAIT_NONE;
+	_waitDepth = 0;
+}
+
+bool CScriptExecutionContext::WaitForTime(f32 milliseconds)
+{
+	if (!BeginWait(SCRIPT_WAIT_TIME))
+		return false;
+
+	_waitUntil = Engine::Platform::GetMillisecs() + milliseconds;
+	_virtualMachine->Park(this);
+
+	return true;
+}
+
+bool CScriptExecutionContext::WaitForEvent(const CScriptEventHandle& handle)
+{
+	if (!BeginWait(SCRIPT_WAIT_EVENT))
+		return false;
+
+	_waitEventHash = handle.NameHash;
+	_virtualMachine->Park(this);
+
+	return true;
+}
+
+bool CScriptExecutionContext::WaitForTask(Engine::Core::Tasks::TaskID task)
+{
+	if (!BeginWait(SCRIPT_WAIT_TASK))
+		return false;
+
+	_waitTask = task;
+	_virtualMachine->Park(this);
+
+	return true;
+}
+
+bool CScriptExecutionContext::IsWaiting()
+{
+	return (_waitType != SCRIPT_WAIT_NONE);
+}
+
+void CScriptExecutionContext::Wake()
+{
+	if (_waitType == SCRIPT_WAIT_NONE)
+		return;
+
+	if (_virtualMachine != NULL)
+		_virtualMachine->Unpark(this);
+	else
+		EndWait();
+}
+
+bool CScriptExecutionContext::Signal(const CScriptEventHandle& handle)
+{
+	if (_waitType != SCRIPT_WAIT_EVENT || _waitEventHash != handle.NameHash)
+		return false;
+
+	Wake();
+	return true;
+}
+
+bool CScriptExecutionContext::Snapshot(Engine::FileSystem::Streams::CStream* stream)
+{
+	if (_nativeFunction != NULL)
+	{
+		Error("Attempt to snapshot context during a native function call.");
+		return false;
+	}
+	if (_waitType == SCRIPT_WAIT_TASK)
+	{
+		Error("Attempt to snapshot context while it is waiting on a task.");
+		return false;
+	}
+
+	CScriptSnapshotWriter writer(this, stream);
+
+	// Header, used to check the snapshot is restored into the same script.
+	stream->WriteU32(SCRIPT_SNAPSHOT_SIGNATURE);
+	stream->WriteU32(SCRIPT_SNAPSHOT_VERSION);
+	stream->WriteU32(_instructionCount);
+	stream->WriteU32(_context->_symbols.Size());
+	stream->WriteU32(_context->_globalVariableCount);
+
+	// Globals and state.
+	stream->WriteU8(_globalScopeRun == true ? 1 : 0);
+	for (u32 i = 0; i < _context->_globalVariableCount; i++)
+		writer.WriteValue(_globals[i]);
+	writer.WriteSymbol(_state);
+
+	// Call stack.
+	stream->WriteU32(_callStack.Size());
+	for (u32 i = 0; i < _callStack.Size(); i++)
+	{
+		CScriptCallContext& frame = _callStack[i];
+		if (frame.GeneratorIterator != NULL)
+		{
+			writer.Fail("Attempt to snapshot context while a generator is running.");
+			break;
+		}
+
+		writer.WriteSymbol(frame.Symbol);
+		stream->WriteU32(frame.PC);
+		stream->WriteU32(frame.LocalCount);
+		for (u32 j = 0; j < frame.LocalCount; j++)
+			writer.WriteValue(frame.Locals[j]);
+		for (u32 j = 0; j < SCRIPT_TOTAL_REGISTERS; j++)
+			writer.WriteValue(frame.Registers[j]);
+	}
+
+	// Parameters being passed.
+	stream->WriteU32(_parameterStack.Size());
+	for (u32 i = 0; i < _parameterStack.Size(); i++)
+		writer.WriteValue(_parameterStack[i]);
+
+	// Waits are stored relative to now, so they survive being restored later.
+	stream->WriteU8((u8)_waitType);
+	stream->WriteU32(_waitDepth);
+	stream->WriteF32(_waitType == SCRIPT_WAIT_TIME ? (f32)(_waitUntil - Engine::Platform::GetMillisecs()) : 0.0f);
+	stream->WriteU32(_waitEventHash);
+
+	// And finally the objects all of the above reference.
+	writer.WriteObjects();
+
+	return !writer.Failed();
+}
+
+bool CScriptExecutionContext::Restore(Engine::FileSystem::Streams::CStream* stream)
+{
+	if (_nativeFunction != NULL)
+	{
+		Error("Attempt to restore context during a native function call.");
+		return false;
+	}
+
+	// Check this is a snapshot of our script.
+	if (stream->ReadU32() != SCRIPT_SNAPSHOT_SIGNATURE ||
+		stream->ReadU32() != SCRIPT_SNAPSHOT_VERSION)
+	{
+		Error("Attempt to restore context from an invalid snapshot.");
+		return false;
+	}
+	if (stream->ReadU32() != _instructionCount ||
+		stream->ReadU32() != _context->_symbols.Size() ||
+		stream->ReadU32() != _context->_globalVariableCount)
+	{
+		Error("Attempt to restore context from a snapshot of a different script.");
+		return false;
+	}
+
+	// Throw away our current state. Objects that were only referenced by it are 
+	// collected as normal.
+	Wake();
+
+	for (u32 i = 0; i < _callStack.Size(); i++)
+		_callStack[i].Dispose(this);
+	_callStack.Clear();
+	_currentContext = NULL;
+
+	for (u32 i = 0; i < _context->_globalVariableCount; i++)
+	{
+		if (_globals[i].Type == SCRIPT_VALUE_TYPE_OBJECT && _globals[i].Object != NULL)
+			_globals[i].Object->DecRef();
+		_globals[i].Type = SCRIPT_VALUE_TYPE_NULL;
+	}
+
+	_parameterStack.Clear();
+
+	CScriptSnapshotReader reader(this, stream);
+
+	// Globals and state.
+	_globalScopeRun = (stream->ReadU8() != 0);
+	for (u32 i = 0; i < _context->_globalVariableCount; i++)
+	{
+		_globals[i] = reader.ReadValue();
+		if (_globals[i].Type == SCRIPT_VALUE_TYPE_OBJECT && _globals[i].Object != NULL)
+			_globals[i].Object->IncRef();
+	}
+
+	CScriptSymbol* state = reader.ReadSymbol();
+	if (state != NULL && state->GetType() == SCRIPT_SYMBOL_TYPE_STATE)
+		ChangeState(reinterpret_cast<CScriptStateSymbol*>(state));
+
+	// Call stack.
+	u32 frameCount = stream->ReadU32();
+	for (u32 i = 0; i < frameCount && reader.Failed() == false; i++)
+	{
+		CScriptCallContext& frame = _callStack.Push();
+
+		CScriptSymbol* symbol = reader.ReadSymbol();
+		if (symbol != NULL && symbol->GetType() != SCRIPT_SYMBOL_TYPE_FUNCTION)
+			reader.Fail("Snapshot contains a call to a symbol that is not a function.");
+
+		frame.Symbol	 = reinterpret_cast<CScriptFunctionSymbol*>(symbol);
+		frame.PC		 = stream->ReadU32();
+		frame.LocalCount = stream->ReadU32();
+		
+		if (frame.PC > _instructionCount || 
+			(frame.Symbol != NULL && frame.LocalCount != frame.Symbol->LocalCount))
+		{
+			reader.Fail("Snapshot contains an invalid call frame.");
+			frame.LocalCount = 0;
+			break;
+		}
+
+		frame.Locals = (frame.LocalCount > 0 ? AllocLocals(frame.LocalCount) : NULL);
+		for (u32 j = 0; j < frame.LocalCount; j++)
+		{
+			frame.Locals[j] = reader.ReadValue();
+			if (frame.Locals[j].Type == SCRIPT_VALUE_TYPE_OBJECT && frame.Locals[j].Object != NULL)
+				frame.Locals[j].Object->IncRef();
+		}
+		for (u32 j = 0; j < SCRIPT_TOTAL_REGISTERS; j++)
+			frame.Registers[j] = reader.ReadValue();
+	}
+
+	// Pushing can move the frames, so only point at the top one once we're done.
+	if (_callStack.Size() > 0)
+		_currentContext = &_callStack[_callStack.Size() - 1];
+
+	// Parameters being passed.
+	u32 parameterCount = (reader.Failed() ? 0 : stream->ReadU32());
+	for (u32 i = 0; i < parameterCount && reader.Failed() == false; i++)
+		_parameterStack.Push(reader.ReadValue());
+
+	// Objects, these have to be read before we can be woken up.
+	ScriptWaitType waitType = SCRIPT_WAIT_NONE;
+	u32 waitDepth			= 0;
+	f32 waitRemaining		= 0.0f;
+	u32 waitEventHash		= 0;
+	if (reader.Failed() == false)
+	{
+		waitType	  = (ScriptWaitType)stream->ReadU8();
+		waitDepth	  = stream->ReadU32();
+		waitRemaining = stream->ReadF32();
+		waitEventHash = stream->ReadU32();
+
+		reader.ReadObjects();
+	}
+
+	if (reader.Failed() == true)
+	{
+		for (u32 i = 0; i < _callStack.Size(); i++)
+			_callStack[i].Dispose(this);
+		_callStack.Clear();
+		_currentContext = NULL;
+		_parameterStack.Clear();
+		return false;
+	}
+
+	// Park again if we were waiting.
+	if (waitType != SCRIPT_WAIT_NONE && waitDepth > 0 && waitDepth <= _callStack.Size() && _virtualMachine != NULL)
+	{
+		_waitType		= waitType;
+		_waitDepth		= waitDepth;
+		_waitUntil		= Engine::Platform::GetMillisecs() + waitRemaining;
+		_waitEventHash	= waitEventHash;
+		_virtualMachine->Park(this);
+	}
+
+	return true;
+}
+
+bool CScriptExecutionContext::Clone(CScriptExecutionContext* source)
+{
+	if (source->_context != _context)
+	{
+		Error("Attempt to clone context of a different script.");
+		return false;
+	}
+
+	Engine::FileSystem::Streams::CMemoryStream stream;
+	stream.Open();
+
+	bool result = source->Snapshot(&stream);
+	if (result == true)
+	{
+		stream.Seek(0);
+		result = Restore(&stream);
+	}
+
+	stream.Close();
+	return result;
 }
 
 void CScriptExecutionContext::ChangeState(Symbols::CScriptStateSymbol* symbol)
 {
-	_state = symbol;
+	if (_state == symbol)
+		return;
+
+	// Events resolved in the old state may resolve differently in this one.
+	_state			= symbol;
+	_stateHashTable = NULL;
+	_eventCache.Clear();
 }
 
 /*
@@ -2247,7 +3784,7 @@ void CScriptExecutionContext::SetGlobalStringVariable(const Engine::Containers::
 {
 	CScriptValue v;
 	v.Type = SCRIPT_VALUE_TYPE_OBJECT;
-	v.Object = GetScriptAllocator()->NewObj<CScriptStringObject>(this, val);
+	v.Object = NewObject<CScriptStringObject>(val);
 	GCAdd(v.Object);
 
 	SetGlobalVariable(name, v);
@@ -2287,7 +3824,7 @@ void CScriptExecutionContext::SetGlobalVariable(const Engine::Containers::CStrin
 
 // CScriptCallCOntext -----------------------------------------------------
 
-void CScriptCallContext::Dispose()
+void CScriptCallContext::Dispose(CScriptExecutionContext* context)
 {
 	// Reduce ref-count of all objects.
 	if (Symbol != NULL && Locals != NULL)
@@ -2295,15 +3832,150 @@ void CScriptCallContext::Dispose()
 		for (u32 i = 0; i < Symbol->LocalCount; i++)
 		{
 			if (Locals[i].Type == SCRIPT_VALUE_TYPE_OBJECT && Locals[i].Object != NULL)
-				Locals[i].Object->_refCount--;
+				Locals[i].Object->DecRef();
 		}
 	}
 
 	// Deallocate locals memory.
 	if (Locals != NULL)
 	{	
-		GetScriptAllocator()->FreeArray(&Locals);
+		context->FreeLocals(Locals, LocalCount);
+		Locals = NULL;
+	}
+}
+
+// CScriptCallStack ----------------------------------------------------------
+
+CScriptCallStack::CScriptCallStack()
+{
+	_size	  = 0;
+	_capacity = SCRIPT_VM_INITIAL_CALL_STACK_SIZE;
+	_frames	  = GetScriptAllocator()->AllocArray<CScriptCallContext>(_capacity);
+}
+
+CScriptCallStack::~CScriptCallStack()
+{
+	GetScriptAllocator()->FreeArray(&_frames);
+}
+
+CScriptCallContext& CScriptCallStack::Push()
+{
+	// Out of space? Double it. Any pointers into the stack are invalid after this.
+	if (_size >= _capacity)
+	{
+		u32					newCapacity = _capacity * 2;
+		CScriptCallContext* newFrames	= GetScriptAllocator()->AllocArray<CScriptCallContext>(newCapacity);
+
+		for (u32 i = 0; i < _size; i++)
+			newFrames[i] = _frames[i];
+
+		GetScriptAllocator()->FreeArray(&_frames);
+		_frames	  = newFrames;
+		_capacity = newCapacity;
 	}
+
+	CScriptCallContext& frame = _frames[_size++];
+	frame.Reset();
+
+	return frame;
+}
+
+void CScriptCallStack::Pop()
+{
+	LOG_ASSERT(_size > 0);
+	_size--;
+}
+
+void CScriptCallStack::Clear()
+{
+	_size = 0;
+}
+
+// CScriptParameterStack -----------------------------------------------------
+
+CScriptParameterStack::CScriptParameterStack()
+{
+	_size	  = 0;
+	_capacity = SCRIPT_VM_INITIAL_PARAMETER_STACK_SIZE;
+	_values	  = GetScriptAllocator()->AllocArray<CScriptValue>(_capacity);
+}
+
+CScriptParameterStack::~CScriptParameterStack()
+{
+	GetScriptAllocator()->FreeArray(&_values);
+}
+
+// Out of space? Double it. Any pointers into the stack (native frames) are invalid after this.
+void CScriptParameterStack::Grow()
+{
+	u32				newCapacity = _capacity * 2;
+	CScriptValue*	newValues	= GetScriptAllocator()->AllocArray<CScriptValue>(newCapacity);
+
+	for (u32 i = 0; i < _size; i++)
+		newValues[i] = _values[i];
+
+	GetScriptAllocator()->FreeArray(&_values);
+	_values	  = newValues;
+	_capacity = newCapacity;
+}
+
+void CScriptParameterStack::Clear()
+{
+	_size = 0;
+}
+
+// CScriptNativeFrame --------------------------------------------------------
+
+CScriptNativeFrame::CScriptNativeFrame(CScriptExecutionContext* context, CScriptValue* parameters, u32 count)
+{
+	_context	= context;
+	_parameters	= parameters;
+	_count		= count;
+}
+
+s32 CScriptNativeFrame::GetInt(u32 index) const
+{
+	const CScriptValue& value = _parameters[index];
+	if (value.Type == SCRIPT_VALUE_TYPE_INT)
+		return value.IntValue;
+
+	return _context->CoerceToInt(value);
+}
+
+f32 CScriptNativeFrame::GetFloat(u32 index) const
+{
+	const CScriptValue& value = _parameters[index];
+	if (value.Type == SCRIPT_VALUE_TYPE_FLOAT)
+		return value.FloatValue;
+
+	return _context->CoerceToFloat(value);
+}
+
+CScriptObject* CScriptNativeFrame::GetObject(u32 index) const
+{
+	return _context->CoerceToObject(_parameters[index]);
+}
+
+const Engine::Containers::CString& CScriptNativeFrame::GetString(u32 index, Engine::Containers::CString& scratch) const
+{
+	const CScriptValue& value = _parameters[index];
+	if (value.Type == SCRIPT_VALUE_TYPE_OBJECT && typeid(*value.Object) == typeid(CScriptStringObject))
+		return static_cast<CScriptStringObject*>(value.Object)->GetString();
+
+	scratch = _context->CoerceToString(value);
+	return scratch;
+}
+
+bool CScriptNativeFrame::GetStringView(u32 index, const u8*& data, u32& length) const
+{
+	const CScriptValue& value = _parameters[index];
+	if (value.Type != SCRIPT_VALUE_TYPE_OBJECT || typeid(*value.Object) != typeid(CScriptStringObject))
+		return false;
+
+	CScriptStringObject* str = static_cast<CScriptStringObject*>(value.Object);
+	data   = str->GetData();
+	length = str->GetLength();
+	return true;
 }
 
 // CScriptVirtualMachine -----------------------------------------------------
@@ -2313,8 +3985,49 @@ void CScriptVirtualMachine::LoadNativeLibrary()
 	Engine::Scripting::Native::Glue::RegisterScriptFunctions(this);
 }
 
+CScriptMessage::CScriptMessage(const Engine::Containers::CString& evt)
+{
+	Event = evt;
+}
+
+void CScriptMessage::AddInt(s32 value)
+{
+	CScriptMessageParameter param;
+	param.Type	   = SCRIPT_VALUE_TYPE_INT;
+	param.IntValue = value;
+	Parameters.AddToEnd(param);
+}
+
+void CScriptMessage::AddFloat(f32 value)
+{
+	CScriptMessageParameter param;
+	param.Type		 = SCRIPT_VALUE_TYPE_FLOAT;
+	param.FloatValue = value;
+	Parameters.AddToEnd(param);
+}
+
+void CScriptMessage::AddString(const Engine::Containers::CString& value)
+{
+	CScriptMessageParameter param;
+	param.Type		  = SCRIPT_VALUE_TYPE_OBJECT;
+	param.StringValue = value;
+	Parameters.AddToEnd(param);
+}
+
+CScriptEventHandle::CScriptEventHandle(const Engine::Containers::CString& name)
+{
+	Name	 = name;
+	NameHash = name.ToLower().ToHashCode();
+}
+
 CScriptVirtualMachine::CScriptVirtualMachine()
 {
+	_parallel		 = false;
+	_taskManager	 = NULL;
+	_jobs			 = NULL;
+	_jobContexts	 = NULL;
+	_jobContextsSize = 0;
+	_timerWheelTick	 = (u32)(Engine::Platform::GetMillisecs() / SCRIPT_VM_TIMER_WHEEL_RESOLUTION);
 }
 
 CScriptVirtualMachine::~CScriptVirtualMachine()
@@ -2326,27 +4039,182 @@ CScriptVirtualMachine::~CScriptVirtualMachine()
 	for (u32 i = 0; i < _nativeFunctions.Size(); i++)
 	{
 		CScriptNativeFunction* func = _nativeFunctions.AtIndex(i)->Value;
+
+		// Binding table entries are static.
+		if (func >= Native::Glue::BindingTable && func < Native::Glue::BindingTable + Native::Glue::BindingTableSize)
+			continue;
+
 		alloc->FreeObj(&func);
 	}
+
+	if (_jobs != NULL)
+		alloc->FreeArray(&_jobs);
+	if (_jobContexts != NULL)
+		alloc->FreeArray(&_jobContexts);
+
+	for (u32 i = 0; i < _eventWaiters.Size(); i++)
+	{
+		Engine::Containers::CArray<CScriptExecutionContext*>* waiters = _eventWaiters.AtIndex(i)->Value;
+		alloc->FreeObj(&waiters);
+	}
 }
 
 void CScriptVirtualMachine::Run(f32 timeslice)
 {
+	UpdateScheduler();
+
+	bool parallel = (_parallel == true && _taskManager != NULL && _contexts.Size() > 1);
+
 	f32 timeLeft = timeslice;
 	while (timeLeft >= 0)
 	{
-		f32 contextTimeslice = _contexts.Size() / timeLeft;
 		f32 timer = (f32)Engine::Platform::GetMillisecs();
 
-		for (u32 i = 0; i < _contexts.Size(); i++)
+		if (parallel == true)
+		{
+			RunParallel(timeslice == 0 ? 0 : timeLeft);
+		}
+		else
 		{
-			_contexts[i]->Run(timeslice == 0 ? 0 : contextTimeslice);
+			f32 contextTimeslice = timeLeft / _contexts.Size();
+			for (u32 i = 0; i < _contexts.Size(); i++)
+			{
+				_contexts[i]->Run(timeslice == 0 ? 0 : contextTimeslice);
+			}
 		}
 
 		timeLeft -= (f32)(Engine::Platform::GetMillisecs() - timer);
 	}
 }
 
+void CScriptVirtualMachine::RunParallel(f32 timeslice)
+{
+	u32 contextCount = _contexts.Size();
+	u32 jobCount	 = (contextCount < SCRIPT_VM_MAX_PARALLEL_JOBS ? contextCount : SCRIPT_VM_MAX_PARALLEL_JOBS);
+	u32 perJob		 = (contextCount + jobCount - 1) / jobCount;
+
+	// Jobs are allocated once, the extra one is the (empty) parent job.
+	if (_jobs == NULL)
+		_jobs = GetScriptAllocator()->AllocArray<CScriptTaskJob>(SCRIPT_VM_MAX_PARALLEL_JOBS + 1);
+
+	// Flat copy of the context list for the jobs to work from.
+	if (_jobContextsSize < contextCount)
+	{
+		if (_jobContexts != NULL)
+			GetScriptAllocator()->FreeArray(&_jobContexts);
+		_jobContexts	 = GetScriptAllocator()->AllocArray<CScriptExecutionContext*>(contextCount);
+		_jobContextsSize = contextCount;
+	}
+	for (u32 i = 0; i < contextCount; i++)
+	{
+		_jobContexts[i] = _contexts[i];
+		_jobContexts[i]->_marshalNatives = true;
+	}
+
+	// Each job runs its contexts one after another, so each gets a share of the 
+	// timeslice based on how many contexts are in its job.
+	f32 contextTimeslice = (timeslice == 0 ? 0 : timeslice / perJob);
+
+	// Add all the tasks before queueing any of them, workers modify the parent 
+	// task as they complete.
+	Engine::Core::Tasks::TaskID parent = _taskManager->AddTask(&_jobs[SCRIPT_VM_MAX_PARALLEL_JOBS]);
+	Engine::Core::Tasks::TaskID tasks[SCRIPT_VM_MAX_PARALLEL_JOBS];
+	u32 taskCount = 0;
+
+	for (u32 start = 0; start < contextCount; start += perJob)
+	{
+		u32 count = contextCount - start;
+		if (count > perJob)
+			count = perJob;
+
+		_jobs[taskCount].Setup(&_jobContexts[start], count, contextTimeslice);
+		tasks[taskCount] = _taskManager->AddTask(&_jobs[taskCount], parent);
+		taskCount++;
+	}
+
+	for (u32 i = 0; i < taskCount; i++)
+		_taskManager->QueueTask(tasks[i]);
+	_taskManager->QueueTask(parent);
+
+	// Rather than helping out with the jobs, run the natives they call until they are all
+	// done. Natives are free to touch engine state so they are only ever run from here.
+	while (!_taskManager->IsComplete(parent))
+		RunMarshalledNatives(1);
+
+	for (u32 i = 0; i < contextCount; i++)
+		_jobContexts[i]->_marshalNatives = false;
+}
+
+// Called on a worker, blocks until the thread running the virtual machine has run the native.
+void CScriptVirtualMachine::MarshalNativeCall(CScriptExecutionContext* context, CScriptNativeFunction* func)
+{
+	CScriptNativeCall call;
+	call.Context  = context;
+	call.Function = func;
+	call.Complete = false;
+
+	_nativeCallMutex.Lock();
+
+	_nativeCalls.AddToEnd(&call);
+	_nativeCallCondition.Broadcast();
+
+	while (call.Complete == false)
+		_nativeCallCondition.Wait(&_nativeCallMutex);
+
+	_nativeCallMutex.Unlock();
+}
+
+// Runs any natives called by contexts on workers, waiting up to timeout milliseconds for one
+// if there are none.
+void CScriptVirtualMachine::RunMarshalledNatives(u32 timeout)
+{
+	_nativeCallMutex.Lock();
+
+	if (_nativeCalls.Size() == 0)
+		_nativeCallCondition.Wait(&_nativeCallMutex, timeout);
+
+	Engine::Containers::CArray<CScriptNativeCall*> calls = _nativeCalls;
+	_nativeCalls.Clear();
+
+	_nativeCallMutex.Unlock();
+
+	if (calls.Size() == 0)
+		return;
+
+	// The worker that called each native is blocked until it completes, so its context is
+	// ours until then. Natives that call back into script call further natives directly.
+	for (u32 i = 0; i < calls.Size(); i++)
+	{
+		CScriptNativeCall* call = calls[i];
+		call->Context->_marshalNatives = false;
+		call->Function->FunctionPtr(call->Context);
+		call->Context->_marshalNatives = true;
+	}
+
+	_nativeCallMutex.Lock();
+
+	for (u32 i = 0; i < calls.Size(); i++)
+		calls[i]->Complete = true;
+	_nativeCallCondition.Broadcast();
+
+	_nativeCallMutex.Unlock();
+}
+
+void CScriptVirtualMachine::SetTaskManager(Engine::Core::Tasks::CTaskManager* manager)
+{
+	_taskManager = manager;
+}
+
+void CScriptVirtualMachine::SetParallel(bool parallel)
+{
+	_parallel = parallel;
+}
+
+bool CScriptVirtualMachine::IsParallel()
+{
+	return _parallel;
+}
+
 void CScriptVirtualMachine::AddContext(CScriptExecutionContext* context)
 {
 	_contexts.AddToEnd(context);
@@ -2355,6 +4223,9 @@ void CScriptVirtualMachine::AddContext(CScriptExecutionContext* context)
 
 void CScriptVirtualMachine::RemoveContext(CScriptExecutionContext* context)
 {
+	if (context->_waitType != SCRIPT_WAIT_NONE)
+		Unpark(context);
+
 	_contexts.Remove(context);
 	context->_virtualMachine = NULL;
 }
@@ -2364,12 +4235,204 @@ const Engine::Containers::CArray<CScriptExecutionContext*>&	CScriptVirtualMachin
 	return _contexts;
 }
 
+// Waits for time go in the slot after the one their wake up time falls in, so by the 
+// time the wheel reaches them they are always due. Waits longer than a full turn of 
+// the wheel just get looked at (and left) each time it comes round.
+void CScriptVirtualMachine::Park(CScriptExecutionContext* context)
+{
+	_schedulerMutex.Lock();
+
+	switch (context->_waitType)
+	{
+		case SCRIPT_WAIT_TIME:
+			{
+				u32 tick = (u32)(context->_waitUntil / SCRIPT_VM_TIMER_WHEEL_RESOLUTION) + 1;
+				if (tick <= _timerWheelTick)
+					tick = _timerWheelTick + 1;
+
+				context->_waitSlot = tick % SCRIPT_VM_TIMER_WHEEL_SLOTS;
+				_timerWheel[context->_waitSlot].AddToEnd(context);
+				break;
+			}
+		case SCRIPT_WAIT_EVENT:
+			{
+				Engine::Containers::CHashTableValue<Engine::Containers::CArray<CScriptExecutionContext*>*>* waiters = _eventWaiters.FromHash(context->_waitEventHash);
+				if (waiters == NULL)
+				{
+					_eventWaiters.Insert(context->_waitEventHash, GetScriptAllocator()->NewObj<Engine::Containers::CArray<CScriptExecutionContext*>>());
+					waiters = _eventWaiters.FromHash(context->_waitEventHash);
+				}
+				waiters->Value->AddToEnd(context);
+				break;
+			}
+		case SCRIPT_WAIT_TASK:
+			{
+				_taskWaiters.AddToEnd(context);
+				break;
+			}
+	}
+
+	_schedulerMutex.Unlock();
+}
+
+void CScriptVirtualMachine::Unpark(CScriptExecutionContext* context)
+{
+	_schedulerMutex.Lock();
+
+	Engine::Containers::CArray<CScriptExecutionContext*>* waiters = NULL;
+	switch (context->_waitType)
+	{
+		case SCRIPT_WAIT_TIME:
+			{
+				waiters = &_timerWheel[context->_waitSlot];
+				break;
+			}
+		case SCRIPT_WAIT_EVENT:
+			{
+				Engine::Containers::CHashTableValue<Engine::Containers::CArray<CScriptExecutionContext*>*>* value = _eventWaiters.FromHash(context->_waitEventHash);
+				if (value != NULL)
+					waiters = value->Value;
+				break;
+			}
+		case SCRIPT_WAIT_TASK:
+			{
+				waiters = &_taskWaiters;
+				break;
+			}
+	}
+
+	if (waiters != NULL)
+	{
+		s32 index = waiters->IndexOf(context);
+		if (index >= 0)
+			waiters->RemoveIndex(index);
+	}
+	context->EndWait();
+
+	_schedulerMutex.Unlock();
+}
+
+void CScriptVirtualMachine::UpdateScheduler()
+{
+	f64 now	 = Engine::Platform::GetMillisecs();
+	u32 tick = (u32)(now / SCRIPT_VM_TIMER_WHEEL_RESOLUTION);
+
+	_schedulerMutex.Lock();
+
+	// Only the slots the clock has moved through since last time need looking at.
+	u32 slots = tick - _timerWheelTick;
+	if (slots > SCRIPT_VM_TIMER_WHEEL_SLOTS)
+		slots = SCRIPT_VM_TIMER_WHEEL_SLOTS;
+
+	for (u32 i = 1; i <= slots; i++)
+	{
+		Engine::Containers::CArray<CScriptExecutionContext*>& slot = _timerWheel[(_timerWheelTick + i) % SCRIPT_VM_TIMER_WHEEL_SLOTS];
+		for (u32 j = 0; j < slot.Size(); )
+		{
+			CScriptExecutionContext* context = slot[j];
+			if (context->_waitUntil <= now)
+			{
+				slot[j] = slot[slot.Size() - 1];
+				slot.RemoveFromEnd();
+				context->EndWait();
+			}
+			else
+			{
+				j++;
+			}
+		}
+	}
+	_timerWheelTick = tick;
+
+	// Task waits.
+	for (u32 j = 0; j < _taskWaiters.Size(); )
+	{
+		CScriptExecutionContext* context = _taskWaiters[j];
+		if (_taskManager == NULL || _taskManager->IsComplete(context->_waitTask))
+		{
+			_taskWaiters[j] = _taskWaiters[_taskWaiters.Size() - 1];
+			_taskWaiters.RemoveFromEnd();
+			context->EndWait();
+		}
+		else
+		{
+			j++;
+		}
+	}
+
+	_schedulerMutex.Unlock();
+}
+
+u32 CScriptVirtualMachine::SignalEvent(const CScriptEventHandle& handle)
+{
+	u32 woken = 0;
+
+	_schedulerMutex.Lock();
+
+	Engine::Containers::CHashTableValue<Engine::Containers::CArray<CScriptExecutionContext*>*>* waiters = _eventWaiters.FromHash(handle.NameHash);
+	if (waiters != NULL)
+	{
+		woken = waiters->Value->Size();
+		for (u32 i = 0; i < woken; i++)
+			(*waiters->Value)[i]->EndWait();
+		waiters->Value->Clear();
+	}
+
+	_schedulerMutex.Unlock();
+
+	return woken;
+}
+
+u32 CScriptVirtualMachine::BroadcastEvent(const CScriptEventHandle& handle, const CScriptMessage* parameters, bool async, bool stackable)
+{
+	if (_contexts.Size() <= 0)
+		return 0;
+
+	return BroadcastEvent(&_contexts[0], _contexts.Size(), handle, parameters, async, stackable);
+}
+
+// Resolving through the handle is a single hash probe per context, and contexts that 
+// don't handle the event are skipped before any parameters are pushed to them.
+u32 CScriptVirtualMachine::BroadcastEvent(CScriptExecutionContext** contexts, u32 count, const CScriptEventHandle& handle, const CScriptMessage* parameters, bool async, bool stackable)
+{
+	u32 parameterCount = (parameters == NULL ? 0 : parameters->Parameters.Size());
+	u32 called		   = 0;
+
+	for (u32 i = 0; i < count; i++)
+	{
+		CScriptExecutionContext*		context = contexts[i];
+		Symbols::CScriptFunctionSymbol* func	= context->GetFunctionSymbol(handle);
+		if (func == NULL || func->ParameterCount != parameterCount)
+			continue;
+
+		if (parameters != NULL)
+			context->PassMessageParameters(*parameters);
+
+		if (context->CallEvent(func, parameterCount, async, stackable))
+		{
+			called++;
+		}
+		else
+		{
+			// Event wasn't invoked so nothing will consume the parameters.
+			context->_parameterStack.Pop(parameterCount);
+		}
+	}
+
+	return called;
+}
+
 void CScriptVirtualMachine::RegisterNativeFunction(const u8* name, ScriptNativeFunctionPrototype funcPtr)
 {
 	CScriptNativeFunction* func = GetScriptAllocator()->NewObj<CScriptNativeFunction>(name, funcPtr);
 	_nativeFunctions.Insert(S(name).ToLower().ToHashCode(), func);
 }
 
+void CScriptVirtualMachine::RegisterNativeFunction(CScriptNativeFunction* func)
+{
+	_nativeFunctions.Insert(S(func->Name).ToLower().ToHashCode(), func);
+}
+
 CScriptNativeFunction* CScriptVirtualMachine::FindNativeFunction(const Engine::Containers::CString& name)
 {
 	u32 hash = name.ToLower().ToHashCode();
@@ -2378,6 +4441,37 @@ CScriptNativeFunction* CScriptVirtualMachine::FindNativeFunction(const Engine::C
 	return _nativeFunctions[hash];
 }
 
+s32 CScriptVirtualMachine::FindNativeBinding(const Engine::Containers::CString& name)
+{
+	Engine::Containers::CString lowerName = name.ToLower();
+	for (u32 i = 0; i < Native::Glue::BindingTableSize; i++)
+	{
+		if (S(Native::Glue::BindingTable[i].Name).ToLower() == lowerName)
+			return i;
+	}
+	return -1;
+}
+
+CScriptNativeFunction* CScriptVirtualMachine::GetNativeBinding(u32 index)
+{
+	return &Native::Glue::BindingTable[index];
+}
+
+u32 CScriptVirtualMachine::GetNativeBindingCount()
+{
+	return Native::Glue::BindingTableSize;
+}
+
+u32 CScriptVirtualMachine::GetNativeBindingHash()
+{
+	return Native::Glue::BindingTableHash;
+}
+
+CScriptJIT* CScriptVirtualMachine::GetJIT()
+{
+	return &_jit;
+}
+
 
 // CScriptNativeFunction -----------------------------------------------------
 
@@ -15,12 +15,18 @@
 #include "Memory.h"
 #include "CAllocator.h"
 #include "CProxyAllocator.h"
+#include "CPoolAllocator.h"
+#include "CMutex.h"
+#include "CConditionVariable.h"
 
 #include "CScriptSymbol.h"
 #include "CScriptFunctionSymbol.h"
 #include "CScriptVariableSymbol.h"
 #include "CScriptCompileContext.h"
 #include "CScriptInstruction.h"
+#include "CScriptStringTable.h"
+#include "CScriptJIT.h"
+#include "CScriptProfiler.h"
 
 #include "CScriptObject.h"
 
@@ -30,6 +36,21 @@ using namespace Engine::Scripting::Objects;
 
 namespace Engine
 {
+	namespace Core
+	{
+		namespace Tasks
+		{
+			class CTaskManager;
+			typedef s32 TaskID;
+		}
+	}
+	namespace FileSystem
+	{
+		namespace Streams
+		{
+			class CStream;
+		}
+	}
     namespace Scripting
     {
 		namespace Objects
@@ -40,11 +61,46 @@ namespace Engine
 		// Prototypes
 		class CScriptVirtualMachine;
 		class CScriptNativeFunction;
+		class CScriptTaskJob;
+		class CScriptSnapshotWriter;
+		class CScriptSnapshotReader;
 
-		// How many instructions between each time we should check our timeslice.
+		// How many instructions between each time we should check our timeslice. This
+		// is also the instruction budget given to each call to Execute.
 		#define SCRIPT_VM_TIMESLICE_CHECK_INTERVAL	50
+
+		// Use the direct-threaded interpreter core (computed goto) rather than the switch
+		// based one. This needs labels-as-values, so its opt-in: define 
+		// SCRIPT_VM_ENABLE_THREADED_DISPATCH in the build to use it. MSVC doesn't support
+		// computed goto, so the Win32 and Xbox 360 builds always use the switch core.
+		#ifdef SCRIPT_VM_ENABLE_THREADED_DISPATCH
+			#if !defined(__GNUC__)
+				#error "SCRIPT_VM_ENABLE_THREADED_DISPATCH requires a compiler with computed goto support (GCC or Clang)."
+			#endif
+			#define SCRIPT_VM_THREADED_DISPATCH		1
+		#endif
+
 		#define SCRIPT_VM_GC_INTERVAL				1000	// Generation 0 is done every time we run this many instructions, generation 1 runs every this*10 instructions, generation 2 is this*100 etc.
 		#define SCRIPT_MAX_GC_GENERATIONS			3
+		#define SCRIPT_VM_GC_STEP_BUDGET			100		// Default number of microseconds the GC is allowed to run for each time its invoked.
+		#define SCRIPT_VM_GC_TIME_CHECK_INTERVAL	32		// How many objects the GC looks at between checking its budget.
+		#define SCRIPT_VM_POOL_SIZE_CLASSES			5		// Each execution context has slab pools for objects and locals with block sizes of 32, 64, 128, 256 and 512 bytes. Anything larger uses the script allocator.
+		#define SCRIPT_VM_POOL_MIN_BLOCK_SIZE		32
+		#define SCRIPT_VM_INITIAL_CALL_STACK_SIZE	16
+		#define SCRIPT_VM_INITIAL_PARAMETER_STACK_SIZE	64
+		#define SCRIPT_VM_MAX_PARALLEL_JOBS			64		// Maximum number of task jobs the contexts are split between when running in parallel.
+		#define SCRIPT_VM_INLINE_CACHE_ENTRIES		4		// Number of different object shapes an INDR/INDRS instruction remembers before it stops caching.
+		#define SCRIPT_VM_TIMER_WHEEL_SLOTS			256		// Number of slots in the timer wheel that contexts waiting on time are parked in.
+		#define SCRIPT_VM_TIMER_WHEEL_RESOLUTION	10		// Milliseconds covered by each timer wheel slot, waits can end up to this late.
+
+		// What a suspended context is waiting on before it can be run again.
+		enum ScriptWaitType
+		{
+			SCRIPT_WAIT_NONE,
+			SCRIPT_WAIT_TIME,
+			SCRIPT_WAIT_EVENT,
+			SCRIPT_WAIT_TASK,
+		};
 
 		// Defines the value currently being stored by a script value.
 		enum ScriptValueType
@@ -101,6 +157,20 @@ namespace Engine
 			//Engine::Containers::CString	StringValue; // String is not allowed in union :( Silly constructors.
 		};
 
+		// Inline cache attached to a single attribute access or call instruction. 
+		// Stores the attribute slots resolved for the last few object shapes seen,
+		// or for calls the function symbols already checked.
+		struct CScriptInlineCacheEntry
+		{
+			void*	Shape;
+			s32		Slot;
+		};
+		struct CScriptInlineCache
+		{
+			u32						Count;
+			CScriptInlineCacheEntry	Entries[SCRIPT_VM_INLINE_CACHE_ENTRIES];
+		};
+
 		// A call stack entry stores a single function call
 		// thats currently in the callstack of an execution
 		// context.
@@ -116,9 +186,14 @@ namespace Engine
 			CScriptValue							Registers[SCRIPT_TOTAL_REGISTERS];
 			Objects::CScriptContextIteratorObject*	GeneratorIterator;
 
-			void Dispose();
+			void Dispose(CScriptExecutionContext* context);
 
 			CScriptCallContext()
+			{
+				Reset();
+			}
+
+			void Reset()
 			{
 				GeneratorIterator = NULL;
 
@@ -136,14 +211,145 @@ namespace Engine
 
 		};
 
+		// A single parameter of a message.
+		class CScriptMessageParameter
+		{
+		public:
+			ScriptValueType				Type;
+			s32							IntValue;
+			f32							FloatValue;
+			Engine::Containers::CString	StringValue;
+		};
+
+		// Messages are the way execution contexts talk to each other (and the way 
+		// anything on another thread talks to them). Contexts can't share objects 
+		// so messages only carry ints, floats and copies of strings. They are 
+		// delivered as an event call on the receiving contexts next Run.
+		class CScriptMessage
+		{
+		public:
+			Engine::Containers::CString							Event;
+			Engine::Containers::CArray<CScriptMessageParameter>	Parameters;
+
+			CScriptMessage		(const Engine::Containers::CString& evt);
+
+			void AddInt			(s32 value);
+			void AddFloat		(f32 value);
+			void AddString		(const Engine::Containers::CString& value);
+		};
+
+		// Pre-resolved event name. Events called through a handle skip lower casing and
+		// hashing the name, and each context resolves a handle to a function at most 
+		// once per state. Create them once up front (eg. one for OnTick) and keep them.
+		class CScriptEventHandle
+		{
+		public:
+			Engine::Containers::CString	Name;
+			u32							NameHash;	// Hash of the lower case name.
+
+			CScriptEventHandle	(const Engine::Containers::CString& name);
+		};
+
+		// Contiguous stack of call frames. Frames are reset in place when pushed
+		// rather than being copied in and out, the storage only ever grows.
+		class CScriptCallStack
+		{
+		private:
+			CScriptCallContext*	_frames;
+			u32					_size;
+			u32					_capacity;
+
+		public:
+			CScriptCallStack	();
+			~CScriptCallStack	();
+
+			FORCE_INLINE u32					Size		() const			{ return _size; }
+			FORCE_INLINE CScriptCallContext&	operator[]	(u32 index) const	{ return _frames[index]; }
+
+			CScriptCallContext&					Push		();
+			void								Pop			();
+			void								Clear		();
+		};
+
+		// Contiguous stack of values being passed as parameters. As with the call stack
+		// the storage only ever grows, popping just drops the size, so once its warmed up
+		// pushing parameters never allocates.
+		class CScriptParameterStack
+		{
+		private:
+			CScriptValue*	_values;
+			u32				_size;
+			u32				_capacity;
+
+			void								Grow		();
+
+		public:
+			CScriptParameterStack	();
+			~CScriptParameterStack	();
+
+			FORCE_INLINE u32					Size		() const			{ return _size; }
+			FORCE_INLINE CScriptValue&			operator[]	(u32 index) const	{ return _values[index]; }
+			FORCE_INLINE CScriptValue*			Data		(u32 index) const	{ return _values + index; }
+
+			FORCE_INLINE void					Push		(const CScriptValue& value)
+			{
+				if (_size >= _capacity)
+					Grow();
+				_values[_size++] = value;
+			}
+
+			FORCE_INLINE void					Pop			(u32 count = 1)
+			{
+				LOG_ASSERT(_size >= count);
+				_size -= count;
+			}
+
+			void								Clear		();
+		};
+
+		// View of the parameters of the native function currently being called. Values are 
+		// read in place on the parameter stack rather than copied out, and strings can be 
+		// read straight out of the string objects. Only valid until the native pushes 
+		// parameters or calls back into the script.
+		class CScriptNativeFrame
+		{
+		private:
+			CScriptExecutionContext*	_context;
+			CScriptValue*				_parameters;
+			u32							_count;
+
+		public:
+			CScriptNativeFrame	(CScriptExecutionContext* context, CScriptValue* parameters, u32 count);
+
+			FORCE_INLINE u32					Count		() const			{ return _count; }
+			FORCE_INLINE const CScriptValue&	operator[]	(u32 index) const	{ return _parameters[index]; }
+
+			// Typed accessors, ints and floats are read directly and only objects are coerced.
+			s32									GetInt		(u32 index) const;
+			f32									GetFloat	(u32 index) const;
+			CScriptObject*						GetObject	(u32 index) const;
+
+			// Returns the string objects own string if the parameter is one, otherwise the 
+			// parameter is coerced into scratch and that is returned.
+			const Engine::Containers::CString&	GetString	(u32 index, Engine::Containers::CString& scratch) const;
+
+			// Characters of a string parameter without flattening or copying it. Not null 
+			// terminated. Returns false if the parameter isn't a string.
+			bool								GetStringView(u32 index, const u8*& data, u32& length) const;
+		};
+
 		// An execution context stores the state of a single
 		// currently executing script.
 		class CScriptExecutionContext
 		{
 		private:
 			CScriptCompileContext*					_context;
-			Instructions::CScriptInstruction**		_instructions;
+			Instructions::CScriptPackedInstruction*	_instructions;
+			Instructions::CScriptInstructionDebugInfo*	_debugInfo;
 			Symbols::CScriptSymbol**				_symbols;
+			CScriptInternedString**					_internedSymbols;
+			CScriptInlineCache**					_inlineCaches;		// Indexed by PC, allocated on first use.
+			u32										_instructionCount;
 
 			CScriptVirtualMachine*					_virtualMachine;
 
@@ -153,34 +359,81 @@ namespace Engine
 			CScriptValue*							_functionTable;
 
 			// Instruction tracking / call stack.
-			Containers::CArray<CScriptCallContext>	_callStack;
+			CScriptCallStack						_callStack;
 			CScriptCallContext*						_currentContext;
-			Containers::CArray<CScriptValue>		_parameterStack;
+			CScriptParameterStack					_parameterStack;
+
+			// Messages waiting to be delivered, may be posted to from any thread.
+			Engine::Threading::CMutex				_messageMutex;
+			Containers::CArray<CScriptMessage*>		_messages;
+
+			// Slab pools for objects and locals.
+			Engine::Memory::Allocators::CPoolAllocator*	_pools[SCRIPT_VM_POOL_SIZE_CLASSES];
 
 			// GC Stack.
 			CScriptObject*							_gcObjectPool[SCRIPT_MAX_GC_GENERATIONS];
 			bool									_gcObjectPoolDirty[SCRIPT_MAX_GC_GENERATIONS];
 			u32										_gcLastRun;
+			u32										_gcRunCount;
+			u32										_gcBudget;
+
+			// Incremental collection state.
+			bool									_gcCollecting;
+			u32										_gcGeneration;
+			CScriptObject*							_gcCursor;
+
+			// Cycle collection state.
+			Containers::CArray<CScriptObject*>		_gcCycleRoots;
+			Containers::CArray<CScriptObject*>		_gcStack;
+			Containers::CArray<CScriptObject*>		_gcBlackStack;
+			Containers::CArray<CScriptObject*>		_gcWhite;
 
 			// Statistics.
 			u32										_instructionsExecuted;
 			f32										_instructionTimer;
+			CScriptProfiler*						_profiler;
 
-			// Native call information.
+			// Native call information. Parameters of the native being called are the
+			// slice of the parameter stack starting at _nativeParameterBase.
+			CScriptNativeFunction*					_nativeFunction;
 			u32										_nativeFunctionParameterCount;
-			Engine::Containers::CString				_nativeFunctionIdentifier;
+			u32										_nativeParameterBase;
+
+			// Set while the context is running on a task worker, natives it calls are then
+			// run by the thread running the virtual machine.
+			bool									_marshalNatives;
 
 			// State based information.
 			CScriptStateSymbol*																_state;
 			bool																			_globalScopeSymbolHashTableCreated;
 			Engine::Containers::CHashTable<CScriptSymbol*>									_globalScopeHashTable;
 			Engine::Containers::CHashTable<Engine::Containers::CHashTable<CScriptSymbol*>*>	_stateScopeHashTable;
+			Engine::Containers::CHashTable<CScriptSymbol*>*									_stateHashTable;	// Table of _state, built on first lookup.
+
+			// Event handles resolved against the current state, by name hash. Events the
+			// script doesn't define are stored as NULL. Cleared on ChangeState.
+			Engine::Containers::CHashTable<Symbols::CScriptFunctionSymbol*>					_eventCache;
+
+			// Scheduling state. While waiting the frame at _waitDepth is suspended, anything
+			// called on top of it (events) still runs but execution stops once back at it.
+			ScriptWaitType							_waitType;
+			u32										_waitDepth;
+			f64										_waitUntil;
+			u32										_waitSlot;		// Timer wheel slot we are parked in.
+			u32										_waitEventHash;
+			Engine::Core::Tasks::TaskID				_waitTask;
+
+			bool							BeginWait				(ScriptWaitType type);
+			void							EndWait					();
+
+			Symbols::CScriptFunctionSymbol*	FindFunctionSymbol		(u32 lowerNameHash);
+			void							PassMessageParameters	(const CScriptMessage& message);
 
 			// Data type bits and pieces.
 			FORCE_INLINE Engine::Containers::CString	GetDataTypeName		(const CScriptValue& value);
 
-			// Executs the next instruction in the script.
-			FORCE_INLINE  bool	Execute										();
+			// Executes a batch of instructions in the script.
+			u32					Execute										(u32 budget, u32 stopDepth=0);
 
 			// Coercion functions.
 			FORCE_INLINE  s32							CompareValues		(CScriptValue& src, CScriptValue& dest);
@@ -196,11 +449,50 @@ namespace Engine
 			FORCE_INLINE  void							PopCallContext		();
 
 			FORCE_INLINE void							GCExecute			();
-			FORCE_INLINE void							GCCollectGeneration	(u32 generation);
+			void										GCBeginPass			(u32 generation);
+			bool										GCSweep				(u32 budget);
+			void										GCShadeRoots		();
+			void										GCCountRootReferences(s32 delta);
+
+			// Cycle collection.
+			void										GCCollectCycles		();
+			void										GCMarkGray			(CScriptObject* object);
+			void										GCScan				(CScriptObject* object);
+			void										GCScanBlack			(CScriptObject* object);
+			void										GCCollectWhite		(CScriptObject* object);
+
+			static void									GCVisitMarkGray		(CScriptExecutionContext* context, CScriptObject* object);
+			static void									GCVisitScan			(CScriptExecutionContext* context, CScriptObject* object);
+			static void									GCVisitScanBlack	(CScriptExecutionContext* context, CScriptObject* object);
+			static void									GCVisitCollectWhite	(CScriptExecutionContext* context, CScriptObject* object);
+			static void									GCVisitRestore		(CScriptExecutionContext* context, CScriptObject* object);
+
+			// Delivers any queued messages.
+			void										DispatchMessages	();
 
 			// Invokes a script symbol.
 			bool										InvokeFunction		(Symbols::CScriptFunctionSymbol* symbol, u32 paramCount=0);
 
+			// Calls a native function with the top paramCount values of the parameter stack,
+			// and pops them once it returns.
+			void										InvokeNativeFunction(CScriptNativeFunction* func, u32 paramCount);
+			void										SetupCallContext	(CScriptCallContext& context, Symbols::CScriptFunctionSymbol* symbol, u32 paramCount);
+
+			// Compiled code. RunCompiledCode runs the current frame natively from its PC until
+			// it hands control back, returning roughly how many instructions it executed. 
+			// StepCompiledCode executes a single instruction for compiled code.
+			u32											RunCompiledCode		(u32 budget);
+			u32											StepCompiledCode	(CScriptJITFrame* frame, u32 pc);
+
+			// Resolves the attribute slot for an INDR/INDRS instruction through its inline 
+			// cache. Returns -1 if the object can't be accessed by slot.
+			s32											ResolveAttributeSlot(Instructions::CScriptPackedInstruction* instruction, CScriptObject* object, CScriptInternedString* name);
+
+			// Resolves the function an INVK instruction calls through its inline cache, so
+			// a site calling the same functions only type checks them once. Returns NULL if 
+			// the symbol isn't a function.
+			Symbols::CScriptFunctionSymbol*				ResolveCallTarget	(Instructions::CScriptPackedInstruction* instruction, Symbols::CScriptSymbol* symbol);
+
 			// Symbol hash table rebuilding.
 			void										RebuildGlobalScopeSymbolHashTable	();
 			void										RebuildStateScopeSymbolHashTable	(Symbols::CScriptStateSymbol* symbol);
@@ -216,13 +508,55 @@ namespace Engine
 			Engine::Containers::CString CoerceValueToString		(const CScriptValue& value);
 			CScriptObject*				CoerceValueToObject		(const CScriptValue& value);
 
+			// Attribute access for objects that expose this contexts scope (see CScriptContextObject).
+			// Slots are indexes in the symbol table, FindScopeSlot returns the function in the 
+			// given state or global function/variable with the name, or -1 if there is none.
+			s32							FindScopeSlot			(Symbols::CScriptStateSymbol* state, CScriptInternedString* name);
+			bool						GetScopeSlot			(s32 slot, CScriptValue& dest);
+			bool						SetScopeSlot			(s32 slot, const CScriptValue& value);
+
 			s32							CompareScriptValues		(CScriptValue& src, CScriptValue& dest);
 			
 			// Should not really be public, but here to allow objects to modify the internal gc
 			// state.
 			void	GCAdd				(CScriptObject* object, u32 generation=0);
 			void	GCRemove			(CScriptObject* object);
+			void	GCFree				(CScriptObject* object);
 			void	GCCollect			();
+			void	GCSetBudget			(u32 microseconds);
+
+			// Allocation of objects and locals. Small blocks come from this contexts slab 
+			// pools (unlocked, as a context only runs on one thread at a time), anything 
+			// larger than the largest pool goes to the script allocator.
+			Engine::Memory::Allocators::CAllocator*	GetPoolAllocator	(u32 size);
+			CScriptValue*							AllocLocals			(u32 count);
+			void									FreeLocals			(CScriptValue* locals, u32 count);
+
+			// Creates an object from the pools, the context is passed as the first constructor
+			// argument. Objects must be released with GCFree.
+			template <class T> T* NewObject()
+			{
+				Engine::Memory::Allocators::CAllocator* alloc = GetPoolAllocator(sizeof(T));
+				T* obj = alloc->NewObj<T>(this);
+				obj->_allocator = alloc;
+				if (_profiler != NULL)
+					_profiler->Allocation(this, sizeof(T));
+				return obj;
+			}
+			template <class T, class T2> T* NewObject(T2 a)
+			{
+				Engine::Memory::Allocators::CAllocator* alloc = GetPoolAllocator(sizeof(T));
+				T* obj = alloc->NewObj<T>(this, a);
+				obj->_allocator = alloc;
+				if (_profiler != NULL)
+					_profiler->Allocation(this, sizeof(T));
+				return obj;
+			}
+
+			// Profiling, the profiler is owned by the caller and can be shared between contexts
+			// as long as they aren't run in parallel. NULL to stop profiling.
+			void						SetProfiler				(CScriptProfiler* profiler);
+			CScriptProfiler*			GetProfiler				();
 
 			// Runs the context as much as possible within the timeslice given.
 			void	Run					(f32 timeslice = 0);
@@ -230,8 +564,9 @@ namespace Engine
 
 			// For script->native calling.
 			u32							GetParameterCount		();
+			CScriptNativeFrame			GetNativeFrame			();
 			
-			CScriptValue				GetParameter			(u32 index);
+			const CScriptValue&			GetParameter			(u32 index);
 			s32							GetIntParameter			(u32 index);
 			f32							GetFloatParameter		(u32 index);
 			Engine::Containers::CString	GetStringParameter		(u32 index);
@@ -259,12 +594,42 @@ namespace Engine
 			bool						CallFunction			(const Engine::Containers::CString& name, u32 parameterCount=0);
 			bool						CallFunction			(Symbols::CScriptFunctionSymbol* symbol, u32 parameterCount=0);
 
+			// Cross-context messaging. Safe to call from any thread, the message is copied
+			// and delivered at the start of this contexts next Run.
+			void						QueueMessage			(const CScriptMessage& message);
+
 			// Event invokation.
 			bool						CallEvent				(const Engine::Containers::CString& name, u32 parameterCount=0, bool async=true, bool stackable=true);
 			bool						CallEvent				(Symbols::CScriptFunctionSymbol* symbol, u32 parameterCount=0, bool async=true, bool stackable=true);
+			bool						CallEvent				(const CScriptEventHandle& handle, u32 parameterCount=0, bool async=true, bool stackable=true);
+
+			// Scheduling. Suspends the current frame once the native call its made from returns,
+			// the virtual machine parks the context and doesn't run it again until the wait
+			// is over. Returns false if the context can't wait (not in a virtual machine, or 
+			// already waiting).
+			bool						WaitForTime				(f32 milliseconds);
+			bool						WaitForEvent			(const CScriptEventHandle& handle);
+			bool						WaitForTask				(Engine::Core::Tasks::TaskID task);
+			bool						IsWaiting				();
+
+			// Ends the wait early / ends it if waiting on the given event.
+			void						Wake					();
+			bool						Signal					(const CScriptEventHandle& handle);
+
+			// Snapshots. Snapshot writes the globals, call stack, wait and every object they
+			// reference to the stream, Restore replaces this contexts state with one written 
+			// by a context of the same compiled script. Clone copies the state of source into
+			// this context, which is cheaper than running a new context up to the same point.
+			// Contexts can't be snapshotted inside a native call or while waiting on a task, 
+			// and objects that belong to other contexts can't be written. Pending messages
+			// are not included.
+			bool						Snapshot				(Engine::FileSystem::Streams::CStream* stream);
+			bool						Restore					(Engine::FileSystem::Streams::CStream* stream);
+			bool						Clone					(CScriptExecutionContext* source);
 
 			// Symbol retrieval.
 			Symbols::CScriptFunctionSymbol*	GetFunctionSymbol	(const Engine::Containers::CString& name);
+			Symbols::CScriptFunctionSymbol*	GetFunctionSymbol	(const CScriptEventHandle& handle);
 			Symbols::CScriptVariableSymbol*	GetVariableSymbol	(const Engine::Containers::CString& name);
 			void							ChangeState			(Symbols::CScriptStateSymbol* symbol);
 
@@ -298,19 +663,24 @@ namespace Engine
 			*/
 
 			// Error types.
-			void	Error					(const Engine::Containers::CString& str, Instructions::CScriptInstruction* instruction=NULL);
-			void	InvalidOp				(const Engine::Containers::CString& op, const CScriptValue& value, Instructions::CScriptInstruction* instruction=NULL);
-			void	InvalidIndex			(const CScriptValue& obj, s32 index, Instructions::CScriptInstruction* instruction=NULL);
-			void	InvalidIndex			(const CScriptValue& obj, const CScriptValue& key, Instructions::CScriptInstruction* instruction=NULL);
-			void	ImmutableError			(const CScriptValue& obj, Instructions::CScriptInstruction* instruction=NULL);
-			void	ImmutableError			(const Engine::Containers::CString& str, Instructions::CScriptInstruction* instruction=NULL);
-			void	DuplicateIndex			(const CScriptValue& obj, const CScriptValue& key, Instructions::CScriptInstruction* instruction=NULL);
-			void	InvalidCast				(const CScriptValue& obj, const Engine::Containers::CString& type, Instructions::CScriptInstruction* instruction=NULL);
-			void	InvalidParameterCount	(u32 expectedParamCount, Instructions::CScriptInstruction* instruction=NULL);
-			void	UniterableObject		(const CScriptValue& obj, Instructions::CScriptInstruction* instruction=NULL);
+			void	Error					(const Engine::Containers::CString& str, Instructions::CScriptPackedInstruction* instruction=NULL);
+			void	InvalidOp				(const Engine::Containers::CString& op, const CScriptValue& value, Instructions::CScriptPackedInstruction* instruction=NULL);
+			void	InvalidIndex			(const CScriptValue& obj, s32 index, Instructions::CScriptPackedInstruction* instruction=NULL);
+			void	InvalidIndex			(const CScriptValue& obj, const CScriptValue& key, Instructions::CScriptPackedInstruction* instruction=NULL);
+			void	ImmutableError			(const CScriptValue& obj, Instructions::CScriptPackedInstruction* instruction=NULL);
+			void	ImmutableError			(const Engine::Containers::CString& str, Instructions::CScriptPackedInstruction* instruction=NULL);
+			void	DuplicateIndex			(const CScriptValue& obj, const CScriptValue& key, Instructions::CScriptPackedInstruction* instruction=NULL);
+			void	InvalidCast				(const CScriptValue& obj, const Engine::Containers::CString& type, Instructions::CScriptPackedInstruction* instruction=NULL);
+			void	InvalidParameterCount	(u32 expectedParamCount, Instructions::CScriptPackedInstruction* instruction=NULL);
+			void	UniterableObject		(const CScriptValue& obj, Instructions::CScriptPackedInstruction* instruction=NULL);
 
 			friend class CScriptVirtualMachine;
 			friend class CScriptContextIteratorObject;
+			friend class CScriptJIT;
+			friend class CScriptProfiler;
+			friend class CScriptNativeFrame;
+			friend class CScriptSnapshotWriter;
+			friend class CScriptSnapshotReader;
 		};
 		
 		// Prototype of a native function.
@@ -329,6 +699,15 @@ namespace Engine
 
 		};
 
+		// A native call handed from a context running on a task worker to the
+		// thread running the virtual machine.
+		struct CScriptNativeCall
+		{
+			CScriptExecutionContext*	Context;
+			CScriptNativeFunction*		Function;
+			bool						Complete;
+		};
+
 		// The virtual machine class looks after executing all the 
 		// different script processes currently being run by the game.
 		class CScriptVirtualMachine
@@ -339,28 +718,93 @@ namespace Engine
 
 			Engine::Containers::CHashTable<CScriptNativeFunction*>	_nativeFunctions;
 
+			// Parallel execution.
+			bool													_parallel;
+			Engine::Core::Tasks::CTaskManager*						_taskManager;
+			CScriptTaskJob*											_jobs;
+			CScriptExecutionContext**								_jobContexts;
+			u32														_jobContextsSize;
+
+			// Natives called by contexts running on workers, waiting to be run by the 
+			// thread running the virtual machine.
+			Engine::Threading::CMutex								_nativeCallMutex;
+			Engine::Threading::CConditionVariable					_nativeCallCondition;
+			Engine::Containers::CArray<CScriptNativeCall*>			_nativeCalls;
+
+			void	RunParallel				(f32 timeslice);
+			void	MarshalNativeCall		(CScriptExecutionContext* context, CScriptNativeFunction* func);
+			void	RunMarshalledNatives	(u32 timeout);
+
+			// Compiles hot functions for all contexts.
+			CScriptJIT												_jit;
+
+			// Scheduler. Contexts waiting on time are parked in a timer wheel, contexts waiting
+			// on an event in a queue per event. Task waits are polled as there are only ever a
+			// few latent natives in flight. Contexts can start waiting from worker threads.
+			Engine::Threading::CMutex																_schedulerMutex;
+			Engine::Containers::CArray<CScriptExecutionContext*>									_timerWheel[SCRIPT_VM_TIMER_WHEEL_SLOTS];
+			u32																						_timerWheelTick;
+			Engine::Containers::CHashTable<Engine::Containers::CArray<CScriptExecutionContext*>*>	_eventWaiters;
+			Engine::Containers::CArray<CScriptExecutionContext*>									_taskWaiters;
+
+			void	Park					(CScriptExecutionContext* context);
+			void	Unpark					(CScriptExecutionContext* context);
+			void	UpdateScheduler			();
+
 		public:
 
 			CScriptVirtualMachine			();
 			~CScriptVirtualMachine			();
 
-			// Runs all executions contexts with a share of the given timeslice.
+			// Runs all executions contexts with a share of the given timeslice. Waiting contexts
+			// whose wait is over are woken first, ones still waiting are skipped.
 			void	Run						(f32 timeslice = 0);
 
+			// Wakes every context waiting on the event. Returns the number woken.
+			u32		SignalEvent				(const CScriptEventHandle& handle);
+
+			// In parallel mode (off by default) contexts are run on the task managers workers
+			// rather than one after another on the calling thread, which then runs any natives
+			// they call. It needs a task manager with workers to be set, without one contexts
+			// are run serially. Each context has its own GC, pools and quickened instructions,
+			// they should only talk to each other with QueueMessage.
+			void	SetTaskManager			(Engine::Core::Tasks::CTaskManager* manager);
+			void	SetParallel				(bool parallel);
+			bool	IsParallel				();
+
 			// Add/Remove execution contexts.
 			void														AddContext				(CScriptExecutionContext* context);
 			void														RemoveContext			(CScriptExecutionContext* context);
 			const Engine::Containers::CArray<CScriptExecutionContext*>&	GetContexts				();
 
+			// Calls an event on every context (or the given contexts) that defines it, in one
+			// pass. Parameters are taken from the message (its event name is not used) and are
+			// copied into each context, contexts whose event takes a different number of 
+			// parameters are skipped. Returns the number of contexts the event was called on.
+			u32				BroadcastEvent			(const CScriptEventHandle& handle, const CScriptMessage* parameters=NULL, bool async=true, bool stackable=true);
+			static u32		BroadcastEvent			(CScriptExecutionContext** contexts, u32 count, const CScriptEventHandle& handle, const CScriptMessage* parameters=NULL, bool async=true, bool stackable=true);
+
 			// Module loading.
 		//	void	SetModulePath			(const Engine::Containers::CString& path);
 		//	void	LoadModule				(const Engine::Containers::CString& name);
 
 			// Register native bindings.
 			void					RegisterNativeFunction	(const u8* name, ScriptNativeFunctionPrototype funcPtr);
+			void					RegisterNativeFunction	(CScriptNativeFunction* func);
 			CScriptNativeFunction*	FindNativeFunction		(const Engine::Containers::CString& name);
 
+			// Binding table generated by the glue code, used by the compiler to resolve
+			// natives imported by name to an index. Returns -1 if there is no binding.
+			static s32						FindNativeBinding		(const Engine::Containers::CString& name);
+			static CScriptNativeFunction*	GetNativeBinding		(u32 index);
+			static u32						GetNativeBindingCount	();
+			static u32						GetNativeBindingHash	();
+
 			void					LoadNativeLibrary		();
+
+			CScriptJIT*				GetJIT					();
+
+			friend class CScriptExecutionContext;
 		};
 
 	}
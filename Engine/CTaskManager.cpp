@@ -138,12 +138,18 @@ CTask* CTaskManager::GetAvailableTask()
 
 void CTaskManager::WorkerTaskCompleted(CTask* task)
 {
+	// Several workers can complete children of the same parent at once, so 
+	// this needs to be done under the task list lock.
+	_workerTaskListMutex->Lock();
+
 	task->TaskRemaining--;
 	task->ID = -1;
 	
 	CTask* parent = GetTaskByID(task->Parent);
 	if (parent != NULL)
 		parent->TaskRemaining--;
+
+	_workerTaskListMutex->Unlock();
 	
 	_workerTaskMutex->Lock();
 	_workerTaskConVar->Broadcast();
@@ -276,6 +282,11 @@ void CTaskManager::DependsOn(TaskID work, TaskID on)
 	}
 }
 
+bool CTaskManager::IsComplete(TaskID work)
+{
+	return (GetTaskByID(work) == NULL);
+}
+
 void CTaskManager::WaitFor(TaskID work)
 {
 	while (true)
@@ -95,6 +95,7 @@ namespace Engine
 					TaskID		AddTask		(Jobs::CTaskJob* work, TaskID parent = -1);
 					void		DependsOn	(TaskID work, TaskID on);
 					void		WaitFor		(TaskID work);
+					bool		IsComplete	(TaskID work);
 					void		QueueTask	(TaskID work);
 
 			};
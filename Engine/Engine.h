@@ -29,8 +29,10 @@
 // Memory stuff.
 #include "Memory.h"
 #include "CAllocator.h"
+#include "CArenaAllocator.h"
 #include "CFrameAllocator.h"
 #include "CHeapAllocator.h"
+#include "CPoolAllocator.h"
 #include "CProxyAllocator.h"
 
 // Threading stuff.
@@ -93,6 +95,7 @@
 #include "CScriptLexer.h"				
 #include "CScriptGenerator.h"				
 #include "CScriptManager.h"				
+#include "CScriptStringTable.h"				
 #include "CScriptVirtualMachine.h"		
 
 // Misc stuff.
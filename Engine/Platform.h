@@ -268,6 +268,13 @@ namespace Engine
         void*                     MemoryAlloc			(u32 size);
         void                      MemoryFree			(void* ptr);
 
+		// Memory that code can be executed from (for generated code). It starts out writable 
+		// but not executable, once the code has been written into it MemoryProtectExecutable 
+		// makes it executable and read-only.
+        void*                     MemoryAllocExecutable	 (u32 size);
+        bool                      MemoryProtectExecutable(void* ptr, u32 size);
+        void                      MemoryFreeExecutable	 (void* ptr);
+
 		u64						  GetTotalMemory		(MemoryType type);
 		u64						  GetFreeMemory			(MemoryType type);
 		u64						  GetUsedMemory			(MemoryType type);
@@ -324,6 +331,11 @@ namespace Engine
         s32             AtomicSwap             (s32* target, s32 value);
         s32             AtomicCompareAndSwap   (s32* target, s32 newValue, s32 compareValue);
 
+		// Pointer publication. Anything written before AtomicSwapPointer is visible to a 
+		// thread that sees the new pointer through AtomicLoadPointer.
+        void*           AtomicSwapPointer      (void** target, void* value);
+        void*           AtomicLoadPointer      (void** target);
+
         bool            ThreadLocalDataCreate  (ThreadLocalDataHandle* handle);
         void            ThreadLocalDataDelete  (ThreadLocalDataHandle* handle);
         void            ThreadLocalDataSet	   (ThreadLocalDataHandle* handle, void* ptr);
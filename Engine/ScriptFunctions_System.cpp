@@ -11,4 +11,14 @@ using namespace Engine::Scripting::Native::System;
 void Engine::Scripting::Native::System::Print(const Engine::Containers::CString& str)
 {
 	LOG_INFO("Script: " + str);
+}
+
+void Engine::Scripting::Native::System::Wait(CScriptExecutionContext* context, f32 milliseconds)
+{
+	context->WaitForTime(milliseconds);
+}
+
+void Engine::Scripting::Native::System::WaitForEvent(CScriptExecutionContext* context, const Engine::Containers::CString& name)
+{
+	context->WaitForEvent(CScriptEventHandle(name));
 }
\ No newline at end of file
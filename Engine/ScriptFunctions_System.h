@@ -23,6 +23,13 @@ namespace Engine
 				
 				// [Script]
 				void Print(const Engine::Containers::CString& str);
+
+				// Suspends the script until the time has passed or the event has been signaled.
+				// [Script]
+				void Wait(CScriptExecutionContext* context, f32 milliseconds);
+				
+				// [Script]
+				void WaitForEvent(CScriptExecutionContext* context, const Engine::Containers::CString& name);
 				
 			}
 		}
@@ -27,23 +27,65 @@ namespace Engine
 				///////////////////////////////////////////////////////////////////////////////	
 void ScriptGlue_0_Print(CScriptExecutionContext* context)
 {
-	if (context->GetParameterCount() != 1)
+	CScriptNativeFrame frame = context->GetNativeFrame();
+	if (frame.Count() != 1)
 	{
 		context->InvalidParameterCount(1);
 		return;
 	}
-	const Engine::Containers::CString& param0 = context->GetStringParameter(0);
+	Engine::Containers::CString param0_scratch;
+	const Engine::Containers::CString& param0 = frame.GetString(0, param0_scratch);
 	Engine::Scripting::Native::System::Print(param0);
 }
+void ScriptGlue_1_Wait(CScriptExecutionContext* context)
+{
+	CScriptNativeFrame frame = context->GetNativeFrame();
+	if (frame.Count() != 1)
+	{
+		context->InvalidParameterCount(1);
+		return;
+	}
+	CScriptExecutionContext* param0 = context;
+	f32 param1 = frame.GetFloat(0);
+	Engine::Scripting::Native::System::Wait(param0, param1);
+}
+void ScriptGlue_2_WaitForEvent(CScriptExecutionContext* context)
+{
+	CScriptNativeFrame frame = context->GetNativeFrame();
+	if (frame.Count() != 1)
+	{
+		context->InvalidParameterCount(1);
+		return;
+	}
+	CScriptExecutionContext* param0 = context;
+	Engine::Containers::CString param1_scratch;
+	const Engine::Containers::CString& param1 = frame.GetString(0, param1_scratch);
+	Engine::Scripting::Native::System::WaitForEvent(param0, param1);
+}
 
 
+				///////////////////////////////////////////////////////////////////////////////	
+				// Binding table.
+				///////////////////////////////////////////////////////////////////////////////	
+				CScriptNativeFunction BindingTable[] = 
+				{
+CScriptNativeFunction("Print", &ScriptGlue_0_Print),
+CScriptNativeFunction("Wait", &ScriptGlue_1_Wait),
+CScriptNativeFunction("WaitForEvent", &ScriptGlue_2_WaitForEvent),
+
+				};
+				const u32 BindingTableSize = sizeof(BindingTable) / sizeof(CScriptNativeFunction);
+				const u32 BindingTableHash = 0x9c025281;
+
 				///////////////////////////////////////////////////////////////////////////////	
 				// Registration functions to be called from inside the codebase.
 				///////////////////////////////////////////////////////////////////////////////	
 				void RegisterScriptFunctions(CScriptVirtualMachine* context)
 				{
-context->RegisterNativeFunction("Print", &ScriptGlue_0_Print);
-
+					for (u32 i = 0; i < BindingTableSize; i++)
+					{
+						context->RegisterNativeFunction(&BindingTable[i]);
+					}
 				}	
 			}
 		}
@@ -30,8 +30,20 @@ namespace Engine
 				// Our pretty glue functions!
 				///////////////////////////////////////////////////////////////////////////////	
 void ScriptGlue_0_Print(CScriptExecutionContext* context);
+void ScriptGlue_1_Wait(CScriptExecutionContext* context);
+void ScriptGlue_2_WaitForEvent(CScriptExecutionContext* context);
 
 
+				///////////////////////////////////////////////////////////////////////////////	
+				// Binding table. Scripts that import a native with a literal name are compiled
+				// to reference it by its index in here rather than looking it up by name. The
+				// hash is of the names in table order, compiled scripts are only valid against 
+				// a table with the same hash.
+				///////////////////////////////////////////////////////////////////////////////	
+				extern CScriptNativeFunction	BindingTable[];
+				extern const u32				BindingTableSize;
+				extern const u32				BindingTableHash;
+
 				///////////////////////////////////////////////////////////////////////////////	
 				// Registration functions to be called from inside the codebase.
 				///////////////////////////////////////////////////////////////////////////////	
@@ -374,6 +374,8 @@ s32 main(s32 argc, u8* argv[])
 	Engine::Containers::InitArrayAllocator();
 	Engine::Containers::InitHashTableAllocator();
 	Engine::Scripting::InitScriptAllocator();
+	Engine::Scripting::InitScriptStringTable();
+	Engine::Scripting::InitScriptKeywordTable();
 
 	{
 		// Change working directory to the directory the executable is in.
@@ -432,6 +434,7 @@ s32 main(s32 argc, u8* argv[])
 	}
 
     // Goodbye memory, it was nice knowing ye.
+	Engine::Scripting::FreeScriptStringTable();
 	Engine::Scripting::FreeScriptAllocator();
 	Engine::Containers::FreeHashTableAllocator();
 	Engine::Containers::FreeArrayAllocator();
@@ -310,6 +310,25 @@ namespace Engine
 			//VirtualFree(ptr, MEM_RELEASE, 0);
         }
 
+        void* MemoryAllocExecutable(u32 size)
+        {
+			return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        }
+
+        bool MemoryProtectExecutable(void* ptr, u32 size)
+        {
+			DWORD oldProtect;
+			if (VirtualProtect(ptr, size, PAGE_EXECUTE_READ, &oldProtect) == 0)
+				return false;
+
+			return FlushInstructionCache(GetCurrentProcess(), ptr, size) != 0;
+        }
+
+        void MemoryFreeExecutable(void* ptr)
+        {
+			VirtualFree(ptr, 0, MEM_RELEASE);
+        }
+
 		u64	GetTotalMemory(MemoryType type)
 		{
 			MEMORYSTATUSEX statex;
@@ -300,6 +300,17 @@ namespace Engine
 			return InterlockedCompareExchange((LONG*)target, (LONG)newValue, (LONG)compareValue);
 		}
 
+        void* AtomicSwapPointer(void** target, void* value)
+		{
+			return InterlockedExchangePointer(target, value);
+		}
+
+        void* AtomicLoadPointer(void** target)
+		{
+			// Aligned pointer reads are atomic, and volatile reads have acquire semantics under MSVC.
+			return *(void* volatile*)target;
+		}
+
 
 	}
 }
\ No newline at end of file
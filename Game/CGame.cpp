@@ -19,6 +19,7 @@
 #include "..\Engine\CScriptParser.h"
 #include "..\Engine\CScriptGenerator.h"
 #include "..\Engine\CScriptVirtualMachine.h"
+#include "..\Engine\CScriptSelfTest.h"
 
 #include "..\Engine\CCRC32Encoder.h"
 
@@ -47,13 +48,19 @@ void CGame::PrintHeader()
 
 void CGame::Update()
 {
-	CScriptCompileContext* context = GetScriptManager()->CompileFile("/test.script");
-	if (context != NULL)
+	Engine::Containers::CArray<Engine::Containers::CString> paths;
+	paths.AddToEnd("/test.script");
+
+	Engine::Containers::CArray<CScriptCompileContext*> contexts = GetScriptManager()->CompileFiles(paths);
+	for (u32 c = 0; c < contexts.Size(); c++)
 	{
+		CScriptCompileContext* context = contexts[c];
+		if (context == NULL)
+			continue;
+
 		if (context->GetErrorCount() == 0)
 		{
 			CScriptExecutionContext* execution_context = GetScriptManager()->Load(context);
-			GetScriptManager()->Run();
 		}
 		else
 		{
@@ -64,6 +71,8 @@ void CGame::Update()
 			}
 		}
 	}
+
+	GetScriptManager()->Run();
 	
 
 	//Engine::FileSystem::Streams::CFileStream file("Assets/test.script");
@@ -259,6 +268,15 @@ bool CGame::Initialize()
 	GetFileSystem()->SetAttributes(attributes);
 	"name.ps3.english.cooked.debg.pak"
 	*/
+
+#ifdef GAME_RUN_SCRIPT_SELF_TESTS
+	if (!CScriptSelfTest::RunAll())
+	{
+		LOG_ERROR("Scripting engine self tests failed, aborting.");
+		return false;
+	}
+#endif
+
 	return true;
 }
 
@@ -43,4 +43,10 @@
 
 // This is the file name of the profile configuration file. This is loaded
 // from within the save folder.
-#define GAME_PROFILE_FILE					"game.script"
\ No newline at end of file
+#define GAME_PROFILE_FILE					"game.script"
+
+// If defined the scripting engines self tests (see CScriptSelfTest) are run when 
+// the game is initialized, the game will refuse to start if any of them fail.
+#ifdef DEBUG
+#define GAME_RUN_SCRIPT_SELF_TESTS			1
+#endif
\ No newline at end of file
@@ -80,6 +80,16 @@ namespace Engine
 				///////////////////////////////////////////////////////////////////////////////	
 {glue_definition}
 
+				///////////////////////////////////////////////////////////////////////////////	
+				// Binding table. Scripts that import a native with a literal name are compiled
+				// to reference it by its index in here rather than looking it up by name. The
+				// hash is of the names in table order, compiled scripts are only valid against 
+				// a table with the same hash.
+				///////////////////////////////////////////////////////////////////////////////	
+				extern CScriptNativeFunction	BindingTable[];
+				extern const u32				BindingTableSize;
+				extern const u32				BindingTableHash;
+
 				///////////////////////////////////////////////////////////////////////////////	
 				// Registration functions to be called from inside the codebase.
 				///////////////////////////////////////////////////////////////////////////////	
@@ -119,12 +129,25 @@ namespace Engine
 				///////////////////////////////////////////////////////////////////////////////	
 {glue_implementation}
 
+				///////////////////////////////////////////////////////////////////////////////	
+				// Binding table.
+				///////////////////////////////////////////////////////////////////////////////	
+				CScriptNativeFunction BindingTable[] = 
+				{
+{glue_registration}
+				};
+				const u32 BindingTableSize = sizeof(BindingTable) / sizeof(CScriptNativeFunction);
+				const u32 BindingTableHash = {glue_binding_hash};
+
 				///////////////////////////////////////////////////////////////////////////////	
 				// Registration functions to be called from inside the codebase.
 				///////////////////////////////////////////////////////////////////////////////	
 				void RegisterScriptFunctions(CScriptVirtualMachine* context)
 				{
-{glue_registration}
+					for (u32 i = 0; i < BindingTableSize; i++)
+					{
+						context->RegisterNativeFunction(&BindingTable[i]);
+					}
 				}	
 			}
 		}
@@ -177,6 +200,7 @@ def main():
 		return 1
 		
 	glue['timestamp'] = datetime.datetime.now().strftime("%d-%m-%Y %H:%M")
+	glue['glue_binding_hash'] = CalculateBindingHash(glue['functions'])
 	glue['hpp_file_name'] = os.path.basename(hpp_file_name)
 	
 	# Write out the files.
@@ -323,6 +347,16 @@ def CalculateGlue(dir):
 		
 	return values
 	
+# 32bit FNV-1a over the lower case names of the functions in binding table order, 
+# each terminated with a null.
+def CalculateBindingHash(functions):
+	hash = 2166136261
+	for f in functions:
+		for c in f['name'].lower() + "\0":
+			hash ^= ord(c)
+			hash = (hash * 16777619) & 0xFFFFFFFF
+	return "0x%08x" % hash
+	
 # Get the library namespace.
 def GetLibraryNamespace(namespace):	
 	full_namespace = ConcatNamespaces(namespace).lower()
@@ -356,8 +390,8 @@ def CalculateFunctionGlue(output, state, header_file, namespace, return_type, id
 	if (output['glue_includes'].find(include_line) < 0):
 		output['glue_includes'] = output['glue_includes'] + include_line
 	
-	# Generate registration code.
-	output['glue_registration'] += "context->RegisterNativeFunction(\"" + identifier + "\", &" + glue_function_name + ");\n";
+	# Generate binding table entry.
+	output['glue_registration'] += "CScriptNativeFunction(\"" + identifier + "\", &" + glue_function_name + "),\n";
 	
 	# Generate definition code.
 	output['glue_definition'] += "void " + glue_function_name + "(CScriptExecutionContext* context);\n";
@@ -393,8 +427,11 @@ def CalculateFunctionGlue(output, state, header_file, namespace, return_type, id
 				
 		clean_params.append(p)
 	
+	# Parameters are read in place through a view of the call frame.
+	imp += "\tCScriptNativeFrame frame = context->GetNativeFrame();\n"
+
 	# Check parameter count is correct.
-	imp += "\tif (context->GetParameterCount() != " + str(non_context_param_count) + ")\n"	
+	imp += "\tif (frame.Count() != " + str(non_context_param_count) + ")\n"	
 	imp += "\t{\n";
 	imp += "\t\tcontext->InvalidParameterCount(" + str(non_context_param_count) + ");\n";
 	imp += "\t\treturn;\n";
@@ -405,20 +442,22 @@ def CalculateFunctionGlue(output, state, header_file, namespace, return_type, id
 	param_var_index = 0
 	for p in clean_params:
 				
-		get_param_func_name = "GetParameter";
+		get_param_func_name = "GetObject";
 		perform_cast = False
+		use_scratch = False
 
 		if (p.lower() == "u32" or p.lower() == "s32"):
-			get_param_func_name = "GetIntParameter";
+			get_param_func_name = "GetInt";
 			
 		elif (p.lower() == "f32"):
-			get_param_func_name = "GetFloatParameter";
+			get_param_func_name = "GetFloat";
 			
 		elif (p.lower() == "cstring"):
-			get_param_func_name = "GetStringParameter";
+			get_param_func_name = "GetString";
+			use_scratch = True;
 			
 		else:
-			get_param_func_name = "GetObjectParameter";
+			get_param_func_name = "GetObject";
 			perform_cast = True;
 				
 		# Retrieve the parameter.
@@ -426,9 +465,12 @@ def CalculateFunctionGlue(output, state, header_file, namespace, return_type, id
 			imp += "\tCScriptExecutionContext* param" + str(param_var_index) + " = context;\n";	
 		else:
 			if (perform_cast == True):
-				imp += "\t" + parameters[param_var_index] + " param" + str(param_var_index) + " = dynamic_cast<"+parameters[param_var_index]+">(context->" + get_param_func_name + "(" + str(param_index) + "));\n";			
+				imp += "\t" + parameters[param_var_index] + " param" + str(param_var_index) + " = dynamic_cast<"+parameters[param_var_index]+">(frame." + get_param_func_name + "(" + str(param_index) + "));\n";			
+			elif (use_scratch == True):
+				imp += "\tEngine::Containers::CString param" + str(param_var_index) + "_scratch;\n";
+				imp += "\t" + parameters[param_var_index] + " param" + str(param_var_index) + " = frame." + get_param_func_name + "(" + str(param_index) + ", param" + str(param_var_index) + "_scratch);\n";
 			else:
-				imp += "\t" + parameters[param_var_index] + " param" + str(param_var_index) + " = context->" + get_param_func_name + "(" + str(param_index) + ");\n";			
+				imp += "\t" + parameters[param_var_index] + " param" + str(param_var_index) + " = frame." + get_param_func_name + "(" + str(param_index) + ");\n";			
 		
 		# Increment parameter offset to retrieve.
 		if (p != "CScriptExecutionContext*"):